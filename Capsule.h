@@ -24,6 +24,9 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #define CAPSULE_INCLUDED
 
 #include <utility>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <Math/Math.h>
 #include <Math/Interval.h>
 
@@ -125,6 +128,65 @@ class Capsule
 		/* Line intersects if the intersection interval is not empty: */
 		return !intersect.isNull();
 		}
+	unsigned int rejectSegments(const Point* points,unsigned int numSegments) const // Returns a bit mask of those of the given 1-4 line segments between consecutive points that are guaranteed to not intersect the capsule
+		{
+		/* A segment misses the capsule if the distance from its midpoint to the capsule axis exceeds the radius plus the segment's half length: */
+		Scalar invAxisLen2=axisLen2>Scalar(0)?Scalar(1)/axisLen2:Scalar(0);
+		unsigned int laneMask=(1U<<numSegments)-1U;
+		
+		#ifdef __SSE2__
+		
+		/* Load the segments' end points in structure-of-arrays form, repeating the last segment in unused lanes: */
+		const Point* s0=points;
+		const Point* s1=points+(numSegments>1?1:0);
+		const Point* s2=points+(numSegments>2?2:numSegments-1);
+		const Point* s3=points+(numSegments-1);
+		__m128 x0=_mm_setr_ps(s0[0][0],s1[0][0],s2[0][0],s3[0][0]);
+		__m128 y0=_mm_setr_ps(s0[0][1],s1[0][1],s2[0][1],s3[0][1]);
+		__m128 z0=_mm_setr_ps(s0[0][2],s1[0][2],s2[0][2],s3[0][2]);
+		__m128 dx=_mm_sub_ps(_mm_setr_ps(s0[1][0],s1[1][0],s2[1][0],s3[1][0]),x0);
+		__m128 dy=_mm_sub_ps(_mm_setr_ps(s0[1][1],s1[1][1],s2[1][1],s3[1][1]),y0);
+		__m128 dz=_mm_sub_ps(_mm_setr_ps(s0[1][2],s1[1][2],s2[1][2],s3[1][2]),z0);
+		
+		/* Calculate the segments' half lengths and midpoints relative to the capsule's center: */
+		__m128 half=_mm_set1_ps(0.5f);
+		__m128 hl=_mm_mul_ps(_mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx,dx),_mm_mul_ps(dy,dy)),_mm_mul_ps(dz,dz))),half);
+		__m128 mx=_mm_sub_ps(_mm_add_ps(x0,_mm_mul_ps(dx,half)),_mm_set1_ps(center[0]));
+		__m128 my=_mm_sub_ps(_mm_add_ps(y0,_mm_mul_ps(dy,half)),_mm_set1_ps(center[1]));
+		__m128 mz=_mm_sub_ps(_mm_add_ps(z0,_mm_mul_ps(dz,half)),_mm_set1_ps(center[2]));
+		
+		/* Find the closest points on the capsule axis to the midpoints: */
+		__m128 ax=_mm_set1_ps(axis[0]);
+		__m128 ay=_mm_set1_ps(axis[1]);
+		__m128 az=_mm_set1_ps(axis[2]);
+		__m128 t=_mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(mx,ax),_mm_mul_ps(my,ay)),_mm_mul_ps(mz,az)),_mm_set1_ps(invAxisLen2));
+		t=_mm_min_ps(_mm_max_ps(t,_mm_set1_ps(-1.0f)),_mm_set1_ps(1.0f));
+		__m128 qx=_mm_sub_ps(mx,_mm_mul_ps(t,ax));
+		__m128 qy=_mm_sub_ps(my,_mm_mul_ps(t,ay));
+		__m128 qz=_mm_sub_ps(mz,_mm_mul_ps(t,az));
+		
+		/* Compare the squared midpoint distances against the squared sums of radius and half length: */
+		__m128 dist2=_mm_add_ps(_mm_add_ps(_mm_mul_ps(qx,qx),_mm_mul_ps(qy,qy)),_mm_mul_ps(qz,qz));
+		__m128 rh=_mm_add_ps(_mm_set1_ps(radius),hl);
+		return (unsigned int)(_mm_movemask_ps(_mm_cmpgt_ps(dist2,_mm_mul_ps(rh,rh))))&laneMask;
+		
+		#else
+		
+		/* Test each segment in turn: */
+		unsigned int result=0x0U;
+		for(unsigned int i=0;i<numSegments;++i)
+			{
+			Vector d=points[i+1]-points[i];
+			Scalar hl=Math::sqrt(d.sqr())*Scalar(0.5);
+			Vector m=(points[i]-center)+d*Scalar(0.5);
+			Scalar t=Math::clamp((m*axis)*invAxisLen2,Scalar(-1),Scalar(1));
+			if((m-axis*t).sqr()>Math::sqr(radius+hl))
+				result|=0x1U<<i;
+			}
+		return result&laneMask;
+		
+		#endif
+		}
 	Interval intersectLine(const Point& p0,const Point& p1) const // Intersects a line segment with the capsule; returns interval of line parameters inside capsule
 		{
 		/* Initialize the result interval to empty: */
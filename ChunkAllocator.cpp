@@ -0,0 +1,168 @@
+/***********************************************************************
+ChunkAllocator - Class to manage allocation of contiguous chunks inside
+a set of fixed-size memory blocks, with logarithmic-time best-fit
+allocation and release.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "ChunkAllocator.h"
+
+#include <Misc/StdError.h>
+
+/*******************************
+Methods of class ChunkAllocator:
+*******************************/
+
+void ChunkAllocator::insertFree(unsigned int block,size_t offset,size_t size)
+	{
+	blocks[block].freeChunks[offset]=size;
+	blocks[block].freeSize+=size;
+	sizeSet.insert(SizeKey(size,block,offset));
+	totalFreeSize+=size;
+	}
+
+void ChunkAllocator::eraseFree(unsigned int block,ChunkAllocator::FreeMap::iterator fcIt)
+	{
+	sizeSet.erase(SizeKey(fcIt->second,block,fcIt->first));
+	blocks[block].freeSize-=fcIt->second;
+	totalFreeSize-=fcIt->second;
+	blocks[block].freeChunks.erase(fcIt);
+	}
+
+ChunkAllocator::Chunk ChunkAllocator::take(ChunkAllocator::SizeSet::iterator ssIt,size_t size)
+	{
+	/* Remove the free chunk from the free structures: */
+	SizeKey key=*ssIt;
+	eraseFree(key.block,blocks[key.block].freeChunks.find(key.offset));
+	
+	/* Return the unused end of the free chunk to the free structures: */
+	if(key.size>size)
+		insertFree(key.block,key.offset+size,key.size-size);
+	
+	return Chunk(key.block,key.offset,size);
+	}
+
+ChunkAllocator::ChunkAllocator(void)
+	:totalFreeSize(0)
+	{
+	}
+
+unsigned int ChunkAllocator::addBlock(size_t size)
+	{
+	if(size==0)
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Zero-sized memory block");
+	
+	/* Find an unused block slot or create a new one: */
+	unsigned int block;
+	for(block=0;block<blocks.size()&&blocks[block].size!=0;++block)
+		;
+	if(block==blocks.size())
+		blocks.push_back(Block());
+	
+	/* Initialize the block as entirely free: */
+	blocks[block].size=size;
+	blocks[block].freeSize=0;
+	insertFree(block,0,size);
+	
+	return block;
+	}
+
+void ChunkAllocator::removeBlock(unsigned int block)
+	{
+	Block& b=blocks[block];
+	if(b.freeSize!=b.size)
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Memory block %u is still in use",block);
+	
+	/* Remove the block's single free chunk and mark the block slot as unused: */
+	eraseFree(block,b.freeChunks.begin());
+	b.size=0;
+	}
+
+bool ChunkAllocator::allocate(size_t size,ChunkAllocator::Chunk& chunk,unsigned int excludeBlock)
+	{
+	/* Find the smallest free chunk that can hold the request, skipping chunks in the excluded block: */
+	SizeSet::iterator ssIt;
+	for(ssIt=sizeSet.lower_bound(SizeKey(size,0U,0));ssIt!=sizeSet.end()&&ssIt->block==excludeBlock;++ssIt)
+		;
+	if(ssIt==sizeSet.end())
+		return false;
+	
+	chunk=take(ssIt,size);
+	return true;
+	}
+
+bool ChunkAllocator::allocateLargest(size_t minSize,ChunkAllocator::Chunk& chunk)
+	{
+	/* Check the largest free chunk: */
+	if(sizeSet.empty()||sizeSet.rbegin()->size<minSize)
+		return false;
+	
+	SizeSet::iterator ssIt=sizeSet.end();
+	--ssIt;
+	chunk=take(ssIt,ssIt->size);
+	return true;
+	}
+
+bool ChunkAllocator::allocateBelow(unsigned int block,size_t size,size_t maxOffset,ChunkAllocator::Chunk& chunk)
+	{
+	/* Find the first free chunk in the block that fits the request and ends below the given offset: */
+	FreeMap& freeChunks=blocks[block].freeChunks;
+	for(FreeMap::iterator fcIt=freeChunks.begin();fcIt!=freeChunks.end()&&fcIt->first+size<=maxOffset;++fcIt)
+		{
+		if(fcIt->second>=size)
+			{
+			chunk=take(sizeSet.find(SizeKey(fcIt->second,block,fcIt->first)),size);
+			return true;
+			}
+		}
+	
+	return false;
+	}
+
+void ChunkAllocator::release(const ChunkAllocator::Chunk& chunk)
+	{
+	FreeMap& freeChunks=blocks[chunk.block].freeChunks;
+	size_t offset=chunk.offset;
+	size_t size=chunk.size;
+	
+	/* Merge with the free chunk to the right: */
+	FreeMap::iterator rightIt=freeChunks.lower_bound(offset);
+	if(rightIt!=freeChunks.end()&&rightIt->first==offset+size)
+		{
+		size+=rightIt->second;
+		eraseFree(chunk.block,rightIt);
+		}
+	
+	/* Merge with the free chunk to the left: */
+	FreeMap::iterator leftIt=freeChunks.lower_bound(offset);
+	if(leftIt!=freeChunks.begin())
+		{
+		--leftIt;
+		if(leftIt->first+leftIt->second==offset)
+			{
+			offset=leftIt->first;
+			size+=leftIt->second;
+			eraseFree(chunk.block,leftIt);
+			}
+		}
+	
+	/* Add the merged free chunk: */
+	insertFree(chunk.block,offset,size);
+	}
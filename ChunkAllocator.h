@@ -0,0 +1,149 @@
+/***********************************************************************
+ChunkAllocator - Class to manage allocation of contiguous chunks inside
+a set of fixed-size memory blocks, with logarithmic-time best-fit
+allocation and release.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef CHUNKALLOCATOR_INCLUDED
+#define CHUNKALLOCATOR_INCLUDED
+
+#include <stddef.h>
+#include <map>
+#include <set>
+#include <vector>
+
+class ChunkAllocator
+	{
+	/* Embedded classes: */
+	public:
+	struct Chunk // Structure describing an allocated or free chunk
+		{
+		/* Elements: */
+		public:
+		unsigned int block; // Index of the memory block containing the chunk
+		size_t offset,size; // Offset and size of the chunk inside its memory block
+		
+		/* Constructors and destructors: */
+		Chunk(void)
+			:block(~0U),offset(0),size(0)
+			{
+			}
+		Chunk(unsigned int sBlock,size_t sOffset,size_t sSize)
+			:block(sBlock),offset(sOffset),size(sSize)
+			{
+			}
+		};
+	
+	private:
+	typedef std::map<size_t,size_t> FreeMap; // Type for maps from free chunk offsets to free chunk sizes inside a memory block
+	
+	struct Block // Structure describing a memory block
+		{
+		/* Elements: */
+		public:
+		size_t size; // Size of the memory block; 0 for unused block slots
+		size_t freeSize; // Total size of all free chunks in the memory block
+		FreeMap freeChunks; // Free chunks in the memory block, ordered by offset
+		};
+	
+	struct SizeKey // Structure to order free chunks by increasing size, then by block and offset
+		{
+		/* Elements: */
+		public:
+		size_t size;
+		unsigned int block;
+		size_t offset;
+		
+		/* Constructors and destructors: */
+		SizeKey(size_t sSize,unsigned int sBlock,size_t sOffset)
+			:size(sSize),block(sBlock),offset(sOffset)
+			{
+			}
+		
+		/* Methods: */
+		bool operator<(const SizeKey& other) const
+			{
+			if(size!=other.size)
+				return size<other.size;
+			if(block!=other.block)
+				return block<other.block;
+			return offset<other.offset;
+			}
+		};
+	
+	typedef std::set<SizeKey> SizeSet; // Type for sets of free chunks ordered by size
+	
+	/* Elements: */
+	std::vector<Block> blocks; // List of memory block slots
+	SizeSet sizeSet; // Set of all free chunks in all memory blocks, ordered by size
+	size_t totalFreeSize; // Total size of all free chunks in all memory blocks
+	
+	/* Private methods: */
+	void insertFree(unsigned int block,size_t offset,size_t size); // Adds a free chunk to the free structures without merging
+	void eraseFree(unsigned int block,FreeMap::iterator fcIt); // Removes a free chunk from the free structures
+	Chunk take(SizeSet::iterator ssIt,size_t size); // Allocates the given number of units from the beginning of the given free chunk
+	
+	/* Constructors and destructors: */
+	public:
+	ChunkAllocator(void); // Creates an allocator without memory blocks
+	
+	/* Methods: */
+	unsigned int addBlock(size_t size); // Adds a new memory block of the given size, entirely free, and returns its index
+	void removeBlock(unsigned int block); // Removes the given memory block, which must be entirely free
+	unsigned int getNumBlockSlots(void) const // Returns the number of memory block slots, including unused ones
+		{
+		return (unsigned int)blocks.size();
+		}
+	bool isValidBlock(unsigned int block) const // Returns true if the given block slot contains a memory block
+		{
+		return block<blocks.size()&&blocks[block].size!=0;
+		}
+	size_t getBlockSize(unsigned int block) const // Returns the size of the given memory block
+		{
+		return blocks[block].size;
+		}
+	size_t getFreeSize(unsigned int block) const // Returns the total free size in the given memory block
+		{
+		return blocks[block].freeSize;
+		}
+	size_t getNumFreeChunks(unsigned int block) const // Returns the number of free chunks in the given memory block
+		{
+		return blocks[block].freeChunks.size();
+		}
+	size_t getTotalFreeSize(void) const // Returns the total free size in all memory blocks
+		{
+		return totalFreeSize;
+		}
+	size_t getNumFreeChunks(void) const // Returns the total number of free chunks in all memory blocks
+		{
+		return sizeSet.size();
+		}
+	size_t getLargestFreeSize(void) const // Returns the size of the largest free chunk in any memory block
+		{
+		return sizeSet.empty()?0:sizeSet.rbegin()->size;
+		}
+	bool allocate(size_t size,Chunk& chunk,unsigned int excludeBlock=~0U); // Allocates a chunk of the given size from the best-fitting free chunk outside the given memory block; returns false if no free chunk is large enough
+	bool allocateLargest(size_t minSize,Chunk& chunk); // Allocates the entire largest free chunk if it has at least the given size; returns false otherwise
+	bool allocateBelow(unsigned int block,size_t size,size_t maxOffset,Chunk& chunk); // Allocates a chunk of the given size in the given memory block that ends at or below the given offset; returns false if there is none
+	void release(const Chunk& chunk); // Releases the given chunk and merges it with adjacent free chunks
+	};
+
+#endif
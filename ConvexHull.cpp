@@ -0,0 +1,158 @@
+/***********************************************************************
+ConvexHull - Class to incrementally maintain the convex hull of a set of
+points in the sketching plane.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "ConvexHull.h"
+
+#include <algorithm>
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+inline Scalar orientation(const Point& p0,const Point& p1,const Point& p2) // Returns a positive value if the three points form a counter-clockwise triangle in the (x,y) plane
+	{
+	return (p1[0]-p0[0])*(p2[1]-p0[1])-(p1[1]-p0[1])*(p2[0]-p0[0]);
+	}
+
+inline bool lessXY(const Point& p0,const Point& p1) // Orders points by increasing x, then increasing y
+	{
+	return p0[0]<p1[0]||(p0[0]==p1[0]&&p0[1]<p1[1]);
+	}
+
+inline Scalar dot2(const Point& p,const Vector& direction) // Returns the dot product of the given point's (x,y) components with the given direction's
+	{
+	return p[0]*direction[0]+p[1]*direction[1];
+	}
+
+}
+
+/***************************
+Methods of class ConvexHull:
+***************************/
+
+void ConvexHull::addToChain(ConvexHull::Chain& chain,const Point& point,Scalar turn)
+	{
+	/* Find the point's position in the chain: */
+	Chain::iterator pos=std::lower_bound(chain.begin(),chain.end(),point,lessXY);
+	if(pos!=chain.end()&&(*pos)[0]==point[0]&&(*pos)[1]==point[1])
+		return;
+	
+	/* Ignore the point if it lies between the chain's ends and does not turn the chain in the chain's direction: */
+	if(pos!=chain.begin()&&pos!=chain.end()&&orientation(*(pos-1),point,*pos)*turn<=Scalar(0))
+		return;
+	
+	/* Insert the point, which is close to either end of the chain for most points along a stroke: */
+	size_t index=pos-chain.begin();
+	chain.insert(pos,point);
+	
+	/* Remove the vertices on either side of the new point that no longer turn the chain in the chain's direction; each vertex is removed at most once: */
+	while(index>=2&&orientation(chain[index-2],chain[index-1],chain[index])*turn<=Scalar(0))
+		{
+		chain.erase(chain.begin()+(index-1));
+		--index;
+		}
+	while(index+2<chain.size()&&orientation(chain[index],chain[index+1],chain[index+2])*turn<=Scalar(0))
+		chain.erase(chain.begin()+(index+1));
+	}
+
+void ConvexHull::getChainExtent(const ConvexHull::Chain& chain,const Vector& direction,Scalar& min,Scalar& max)
+	{
+	/* Check the chain's end points: */
+	Scalar d0=dot2(chain.front(),direction);
+	Scalar d1=dot2(chain.back(),direction);
+	min=std::min(min,std::min(d0,d1));
+	max=std::max(max,std::max(d0,d1));
+	
+	/*******************************************************************
+	The chain's edge directions rotate monotonically through less than
+	180 degrees, so the dot products of its edges with the direction
+	change sign at most once, and the dot products of its vertices have
+	at most one interior extremum, at the vertex where the sign changes.
+	*******************************************************************/
+	
+	size_t numEdges=chain.size()-1;
+	if(numEdges>=2)
+		{
+		/* Find the first edge whose dot product has a different sign than the first edge's by binary search: */
+		bool firstSign=dot2(chain[1],direction)>dot2(chain[0],direction);
+		size_t l=1;
+		size_t r=numEdges;
+		while(l<r)
+			{
+			size_t m=(l+r)/2;
+			if((dot2(chain[m+1],direction)>dot2(chain[m],direction))==firstSign)
+				l=m+1;
+			else
+				r=m;
+			}
+		
+		/* Check the vertex at which the sign changes: */
+		if(l<numEdges)
+			{
+			Scalar d=dot2(chain[l],direction);
+			min=std::min(min,d);
+			max=std::max(max,d);
+			}
+		}
+	}
+
+ConvexHull::ConvexHull(void)
+	:z(0),planar(true)
+	{
+	}
+
+void ConvexHull::clear(void)
+	{
+	upper.clear();
+	lower.clear();
+	z=Scalar(0);
+	planar=true;
+	}
+
+void ConvexHull::addPoint(const Point& point)
+	{
+	/* Track whether all points stay in the same plane: */
+	if(upper.empty())
+		z=point[2];
+	else if(point[2]!=z)
+		planar=false;
+	
+	/* Add the point to both monotone chains: */
+	addToChain(upper,point,Scalar(-1));
+	addToChain(lower,point,Scalar(1));
+	}
+
+void ConvexHull::getExtent(const Vector& direction,Scalar& min,Scalar& max) const
+	{
+	/* The extremal dot products are attained at vertices of the upper or lower chains: */
+	min=max=dot2(upper.front(),direction);
+	getChainExtent(upper,direction,min,max);
+	getChainExtent(lower,direction,min,max);
+	
+	/* Add the common z coordinate's contribution: */
+	Scalar dz=z*direction[2];
+	min+=dz;
+	max+=dz;
+	}
@@ -0,0 +1,70 @@
+/***********************************************************************
+ConvexHull - Class to incrementally maintain the convex hull of a set of
+points in the sketching plane.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef CONVEXHULL_INCLUDED
+#define CONVEXHULL_INCLUDED
+
+#include <stddef.h>
+#include <deque>
+
+#include "SketchGeometry.h"
+
+class ConvexHull
+	{
+	/* Embedded classes: */
+	private:
+	typedef std::deque<Point> Chain; // Type for monotone hull chains, sorted by increasing x, then increasing y
+	
+	/* Elements: */
+	Chain upper; // Upper hull chain, turning clockwise
+	Chain lower; // Lower hull chain, turning counter-clockwise; shares its first and last vertices with the upper chain
+	Scalar z; // Common z coordinate of all added points
+	bool planar; // Flag whether all added points have the same z coordinate
+	
+	/* Private methods: */
+	static void addToChain(Chain& chain,const Point& point,Scalar turn); // Adds a point to the given chain, whose vertices turn in the direction of the given sign
+	static void getChainExtent(const Chain& chain,const Vector& direction,Scalar& min,Scalar& max); // Extends the given range by the dot products of the given chain's vertices with the given direction
+	
+	/* Constructors and destructors: */
+	public:
+	ConvexHull(void); // Creates an empty hull
+	
+	/* Methods: */
+	bool isEmpty(void) const // Returns true if no points were added to the hull
+		{
+		return upper.empty();
+		}
+	bool isPlanar(void) const // Returns true if all added points have the same z coordinate; extents are only valid for planar hulls
+		{
+		return planar;
+		}
+	size_t getNumVertices(void) const // Returns the number of hull vertices
+		{
+		return upper.size()<2?upper.size():upper.size()+lower.size()-2;
+		}
+	void clear(void); // Removes all points from the hull
+	void addPoint(const Point& point); // Adds a point to the hull; takes logarithmic time to locate the point, and amortized constant time to update the hull if the point extends the hull's x range, as most points along a stroke do
+	void getExtent(const Vector& direction,Scalar& min,Scalar& max) const; // Returns the range of dot products of all added points with the given direction in time logarithmic in the number of hull vertices; hull must be planar and not empty
+	};
+
+#endif
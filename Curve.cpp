@@ -22,7 +22,13 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include "Curve.h"
 
+#include <math.h>
+#include <stdio.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <Misc/SizedTypes.h>
+#include <Misc/Utility.h>
 #include <Misc/StdError.h>
 #include <IO/File.h>
 #include <Math/Math.h>
@@ -44,6 +50,7 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include "Config.h"
 #include "Capsule.h"
 #include "SketchObjectContainer.h"
+#include "SketchObjectCreator.h"
 #include "SketchSettings.h"
 #include "RenderState.h"
 #include "PolylineRenderer.h"
@@ -54,6 +61,7 @@ Static elements of class Curve:
 
 unsigned int Curve::typeCode=0;
 PolylineRenderer* Curve::renderer=0;
+ObjectPool Curve::pool(sizeof(Curve));
 
 /**********************
 Methods of class Curve:
@@ -69,14 +77,14 @@ void Curve::initClass(unsigned int newTypeCode)
 	}
 
 Curve::Curve(void)
-	:version(0)
+	:shape(new Shape),cacheKey(new PolylineRenderer::CacheKey),
+	 version(0),translation(Vector::zero)
 	{
 	}
 
 Curve::~Curve(void)
 	{
-	/* Remove this curve from the renderer's cache: */
-	renderer->drop(this);
+	/* The cached vertices are dropped when the last curve sharing them is destroyed */
 	}
 
 void Curve::deinitClass(void)
@@ -86,29 +94,219 @@ void Curve::deinitClass(void)
 	renderer=0;
 	}
 
+void* Curve::operator new(size_t size)
+	{
+	/* Allocate from the pool unless the object is of a larger derived class: */
+	if(size==sizeof(Curve))
+		return pool.allocate();
+	else
+		return ::operator new(size);
+	}
+
+void Curve::operator delete(void* object,size_t size)
+	{
+	if(size==sizeof(Curve))
+		pool.release(object);
+	else
+		::operator delete(object);
+	}
+
+void Curve::Shape::updateSegmentBounds(void)
+	{
+	/* Serialize building the hierarchy, as curves sharing the shape might be cloned or rubbed out in parallel: */
+	Threads::Spinlock::Lock segmentBoundsLock(segmentBoundsMutex);
+	
+	if(!segmentBoundsValid)
+		{
+		segmentBounds.clear();
+		
+		/* Calculate the bounding box of each chunk of segments, including the chunk's start and end points: */
+		size_t numSegments=points.size()-1;
+		segmentBounds.push_back(std::vector<Box>());
+		for(size_t first=0;first<numSegments;first+=numChunkSegments)
+			{
+			size_t last=Misc::min(first+numChunkSegments,numSegments);
+			Box chunkBox=Box::empty;
+			for(size_t i=first;i<=last;++i)
+				chunkBox.addPoint(points[i]);
+			segmentBounds.back().push_back(chunkBox);
+			}
+		
+		/* Merge pairs of boxes until there is a single root box: */
+		while(segmentBounds.back().size()>1)
+			{
+			const std::vector<Box>& below=segmentBounds.back();
+			std::vector<Box> level;
+			for(size_t i=0;i<below.size();i+=2)
+				{
+				Box box=below[i];
+				if(i+1<below.size())
+					box.addBox(below[i+1]);
+				level.push_back(box);
+				}
+			segmentBounds.push_back(level);
+			}
+		
+		segmentBoundsValid=true;
+		}
+	}
+
+void Curve::updateDerivedState(void)
+	{
+	PolylineRenderer::createLodTiers(shape->points,shape->lodTiers);
+	shape->segmentBoundsValid=false;
+	}
+
+Curve::Shape& Curve::getUniqueShape(void)
+	{
+	/* Copy the shape if other curves share it: */
+	if(shape->isShared())
+		shape=new Shape(*shape);
+	
+	return *shape;
+	}
+
+void Curve::setPoints(PointList& newPoints)
+	{
+	/* Start a new shape if other curves share the current one: */
+	if(shape->isShared())
+		shape=new Shape;
+	
+	std::swap(shape->points,newPoints);
+	updateDerivedState();
+	}
+
+void Curve::invalidateCache(void)
+	{
+	/* Stop sharing cached vertices with clones: */
+	if(cacheKey->isShared())
+		cacheKey=new PolylineRenderer::CacheKey;
+	
+	++version;
+	}
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+inline Scalar sqrDist(const Box& box,const Point& p) // Returns the squared distance from the given point to the given box
+	{
+	Scalar result(0);
+	for(int i=0;i<3;++i)
+		{
+		if(p[i]<box.min[i])
+			result+=Math::sqr(box.min[i]-p[i]);
+		else if(p[i]>box.max[i])
+			result+=Math::sqr(p[i]-box.max[i]);
+		}
+	return result;
+	}
+
+}
+
+bool Curve::pickChunks(SketchObject::PickResult& result,unsigned int level,size_t index)
+	{
+	/* Bail out if the node's box is outside the pick sphere: */
+	if(sqrDist(shape->segmentBounds[level][index],result.center)>=result.radius2)
+		return false;
+	
+	bool picked=false;
+	const PointList& points=shape->points;
+	if(level>0)
+		{
+		/* Pick the node's children in curve order: */
+		const std::vector<Box>& below=shape->segmentBounds[level-1];
+		picked=pickChunks(result,level-1,index*2)||picked;
+		if(index*2+1<below.size())
+			picked=pickChunks(result,level-1,index*2+1)||picked;
+		}
+	else
+		{
+		/* Check every segment in the chunk against the given sphere: */
+		size_t first=index*numChunkSegments;
+		size_t last=Misc::min(first+numChunkSegments,points.size()-1);
+		size_t lastPoint=points.size()-1;
+		for(size_t i=first;i<last;++i)
+			{
+			/* Check the segment's end vertex against the given sphere: */
+			picked=result.update(this,i+1==lastPoint?0:1,points[i+1])||picked;
+			
+			/* Check the line segment against the given sphere: */
+			picked=result.update(this,points[i],points[i+1])||picked;
+			}
+		}
+	
+	return picked;
+	}
+
+bool Curve::isErased(const Capsule& eraser,unsigned int level,size_t index) const
+	{
+	/* Bail out if the node's box misses the eraser: */
+	if(!eraser.doesIntersect(shape->segmentBounds[level][index]))
+		return false;
+	
+	if(level>0)
+		{
+		/* Check the node's children: */
+		const std::vector<Box>& below=shape->segmentBounds[level-1];
+		if(isErased(eraser,level-1,index*2))
+			return true;
+		return index*2+1<below.size()&&isErased(eraser,level-1,index*2+1);
+		}
+	else
+		{
+		/* Check the chunk's segments in groups of four: */
+		const PointList& points=shape->points;
+		size_t last=Misc::min((index+1)*numChunkSegments,points.size()-1);
+		for(size_t s=index*numChunkSegments;s<last;s+=4)
+			{
+			unsigned int numGroup=(unsigned int)(Misc::min(last-s,size_t(4)));
+			if(eraser.rejectSegments(&points[s],numGroup)!=(1U<<numGroup)-1U)
+				return true;
+			}
+		
+		return false;
+		}
+	}
+
 unsigned int Curve::getTypeCode(void) const
 	{
 	return typeCode;
 	}
 
+Scalar Curve::getMaxLineWidth(void) const
+	{
+	return lineWidth;
+	}
+
+size_t Curve::getMemorySize(void) const
+	{
+	size_t result=sizeof(Curve);
+	
+	/* Account for the curve's points and level-of-detail tiers unless they are shared with clones: */
+	if(!shape->isShared())
+		{
+		result+=sizeof(Shape)+shape->points.size()*sizeof(Point);
+		for(PolylineRenderer::LodTierList::const_iterator ltIt=shape->lodTiers.begin();ltIt!=shape->lodTiers.end();++ltIt)
+			result+=sizeof(PolylineRenderer::LodTier)+ltIt->polyline.size()*sizeof(Point);
+		}
+	
+	return result;
+	}
+
 bool Curve::pick(SketchObject::PickResult& result)
 	{
 	bool picked=false;
 	
 	/* Check the beginning vertex against the given sphere: */
-	std::vector<Point>::const_iterator p0It=points.begin();
-	picked=result.update(this,0,*p0It)||picked;
+	picked=result.update(this,0,shape->points.front())||picked;
 	
-	/* Check every curve segment against the given sphere: */
-	std::vector<Point>::const_iterator lastIt=points.end()-1;
-	for(std::vector<Point>::const_iterator p1It=p0It+1;p1It!=points.end();p0It=p1It,++p1It)
-		{
-		/* Check the segment's end vertex against the given sphere: */
-		picked=result.update(this,p1It==lastIt?0:1,*p1It)||picked;
-		
-		/* Check the line segment against the given sphere: */
-		picked=result.update(this,*p0It,*p1It)||picked;
-		}
+	/* Check all curve segments and the vertices ending them in chunks close to the given sphere: */
+	shape->updateSegmentBounds();
+	if(!shape->segmentBounds.back().empty())
+		picked=pickChunks(result,shape->segmentBounds.size()-1,0)||picked;
 	
 	return picked;
 	}
@@ -118,11 +316,19 @@ SketchObject* Curve::clone(void) const
 	/* Create a new curve object: */
 	Curve* result=new Curve;
 	
-	/* Copy this curve's bounding box, parameters, and point vector: */
+	/* Copy this curve's bounding box and parameters: */
 	result->boundingBox=boundingBox;
 	result->color=color;
 	result->lineWidth=lineWidth;
-	result->points=points;
+	
+	/* Share this curve's shape, after building its segment bounding box hierarchy as shared shapes must not change: */
+	shape->updateSegmentBounds();
+	result->shape=shape;
+	
+	/* Share this curve's cached vertices: */
+	result->cacheKey=cacheKey;
+	result->version=version;
+	result->translation=translation;
 	
 	return result;
 	}
@@ -132,19 +338,9 @@ void Curve::applySettings(const SketchSettings& settings)
 	/* Copy the settings object's color and line width: */
 	color=settings.getColor();
 	lineWidth=settings.getLineWidth();
-	}
-
-void Curve::transform(const Transformation& transform)
-	{
-	/* Transform all curve points and re-calculate the bounding box: */
-	boundingBox=Box::empty;
-	for(std::vector<Point>::iterator pIt=points.begin();pIt!=points.end();++pIt)
-		{
-		*pIt=transform.transform(*pIt);
-		boundingBox.addPoint(*pIt);
-		}
 	
-	++version;
+	/* Invalidate the cached curve, whose vertices store the color and line width: */
+	invalidateCache();
 	}
 
 namespace {
@@ -153,6 +349,62 @@ namespace {
 Helper functions:
 ****************/
 
+void transformPoints(const Transformation& transform,PointList& points,Box& box) // Transforms the given points in place and returns the bounding box of the transformed points
+	{
+	box=Box::empty;
+	
+	/* Convert the transformation to a 3x4 matrix, which is much cheaper to apply than a rotation quaternion: */
+	Vector col[3];
+	for(int j=0;j<3;++j)
+		col[j]=transform.transform(Vector(Scalar(j==0),Scalar(j==1),Scalar(j==2)));
+	Vector trans=transform.getTranslation();
+	
+	#ifdef __SSE2__
+	
+	if(points.empty())
+		return;
+	
+	/* Transform one point per register and accumulate the bounding box in registers: */
+	__m128 c0=_mm_setr_ps(col[0][0],col[0][1],col[0][2],0.0f);
+	__m128 c1=_mm_setr_ps(col[1][0],col[1][1],col[1][2],0.0f);
+	__m128 c2=_mm_setr_ps(col[2][0],col[2][1],col[2][2],0.0f);
+	__m128 ct=_mm_setr_ps(trans[0],trans[1],trans[2],0.0f);
+	__m128 bmin=_mm_set1_ps(0.0f);
+	__m128 bmax=_mm_set1_ps(0.0f);
+	for(PointList::iterator pIt=points.begin();pIt!=points.end();++pIt)
+		{
+		Point& p=*pIt;
+		__m128 r=_mm_add_ps(_mm_add_ps(_mm_mul_ps(c0,_mm_set1_ps(p[0])),_mm_mul_ps(c1,_mm_set1_ps(p[1]))),_mm_add_ps(_mm_mul_ps(c2,_mm_set1_ps(p[2])),ct));
+		if(pIt==points.begin())
+			bmin=bmax=r;
+		bmin=_mm_min_ps(bmin,r);
+		bmax=_mm_max_ps(bmax,r);
+		float result[4];
+		_mm_storeu_ps(result,r);
+		for(int i=0;i<3;++i)
+			p[i]=result[i];
+		}
+	float min[4],max[4];
+	_mm_storeu_ps(min,bmin);
+	_mm_storeu_ps(max,bmax);
+	box=Box(Point(min[0],min[1],min[2]),Point(max[0],max[1],max[2]));
+	
+	#else
+	
+	/* Transform each point in turn: */
+	for(PointList::iterator pIt=points.begin();pIt!=points.end();++pIt)
+		{
+		Point& p=*pIt;
+		Point result;
+		for(int i=0;i<3;++i)
+			result[i]=(col[0][i]*p[0]+col[1][i]*p[1])+(col[2][i]*p[2]+trans[i]);
+		p=result;
+		box.addPoint(p);
+		}
+	
+	#endif
+	}
+
 inline Point snapPointToGrid(const Point& p,Scalar gridSize)
 	{
 	Point result;
@@ -161,79 +413,209 @@ inline Point snapPointToGrid(const Point& p,Scalar gridSize)
 	return result;
 	}
 
-}
-
-void Curve::snapToGrid(Scalar gridSize)
+void snapPoints(const PointList& points,Scalar gridSize,PointList& snapped,Box& box) // Appends the given points snapped to the grid to the given list, dropping consecutive duplicates, and returns the bounding box of the snapped points
 	{
-	/* Snap all curve points to the grid and re-calculate the bounding box: */
-	boundingBox=Box::empty;
-	std::vector<Point> newPoints;
-	std::vector<Point>::iterator pIt=points.begin();
-	newPoints.push_back(snapPointToGrid(*pIt,gridSize));
-	boundingBox.addPoint(newPoints.back());
-	for(++pIt;pIt!=points.end();++pIt)
+	box=Box::empty;
+	snapped.reserve(snapped.size()+points.size());
+	
+	#ifdef __SSE2__
+	
+	/* Snap one point per register; the results are identical to snapPointToGrid: */
+	__m128 g=_mm_set1_ps(gridSize);
+	__m128 half=_mm_set1_ps(0.5f);
+	__m128 one=_mm_set1_ps(1.0f);
+	__m128 exact=_mm_set1_ps(8388608.0f); // Magnitude above which all floats are integers
+	__m128 absMask=_mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	__m128 last=_mm_set1_ps(0.0f);
+	__m128 bmin=_mm_set1_ps(0.0f);
+	__m128 bmax=_mm_set1_ps(0.0f);
+	for(PointList::const_iterator pIt=points.begin();pIt!=points.end();++pIt)
+		{
+		const Point& p=*pIt;
+		__m128 x=_mm_add_ps(_mm_div_ps(_mm_setr_ps(p[0],p[1],p[2],0.0f),g),half);
+		
+		/* Round down by truncating and correcting negative fractions; values of large magnitude are already integers: */
+		__m128 t=_mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+		t=_mm_sub_ps(t,_mm_and_ps(_mm_cmpgt_ps(t,x),one));
+		__m128 small=_mm_cmplt_ps(_mm_and_ps(x,absMask),exact);
+		__m128 r=_mm_mul_ps(_mm_or_ps(_mm_and_ps(small,t),_mm_andnot_ps(small,x)),g);
+		
+		/* Append the snapped point unless it is identical to the previous one: */
+		if(pIt==points.begin())
+			bmin=bmax=r;
+		else if((_mm_movemask_ps(_mm_cmpneq_ps(r,last))&0x7)==0)
+			continue;
+		last=r;
+		bmin=_mm_min_ps(bmin,r);
+		bmax=_mm_max_ps(bmax,r);
+		float result[4];
+		_mm_storeu_ps(result,r);
+		snapped.push_back(Point(result[0],result[1],result[2]));
+		}
+	if(!points.empty())
+		{
+		float min[4],max[4];
+		_mm_storeu_ps(min,bmin);
+		_mm_storeu_ps(max,bmax);
+		box=Box(Point(min[0],min[1],min[2]),Point(max[0],max[1],max[2]));
+		}
+	
+	#else
+	
+	/* Snap each point in turn: */
+	for(PointList::const_iterator pIt=points.begin();pIt!=points.end();++pIt)
 		{
 		Point p=snapPointToGrid(*pIt,gridSize);
-		if(p!=newPoints.back())
+		if(pIt==points.begin()||p!=snapped.back())
 			{
-			newPoints.push_back(p);
-			boundingBox.addPoint(newPoints.back());
+			snapped.push_back(p);
+			box.addPoint(p);
 			}
 		}
-	std::swap(points,newPoints);
 	
-	++version;
+	#endif
+	}
+
+}
+
+void Curve::transform(const Transformation& transform)
+	{
+	/* Transform all curve points and re-calculate the bounding box: */
+	Shape& s=getUniqueShape();
+	transformPoints(transform,s.points,boundingBox);
+	
+	/* Transform the level-of-detail tiers; orthogonal transformations scale simplification errors uniformly: */
+	Scalar scaling=transform.getScaling();
+	for(PolylineRenderer::LodTierList::iterator ltIt=s.lodTiers.begin();ltIt!=s.lodTiers.end();++ltIt)
+		{
+		ltIt->tolerance*=scaling;
+		Box tierBox;
+		transformPoints(transform,ltIt->polyline,tierBox);
+		}
+	
+	/* Invalidate the segment bounding box hierarchy: */
+	s.segmentBoundsValid=false;
+	
+	/* Check if the transformation is a pure translation: */
+	const Scalar* q=transform.getRotation().getQuaternion();
+	if(transform.getScaling()==Scalar(1)&&q[0]==Scalar(0)&&q[1]==Scalar(0)&&q[2]==Scalar(0))
+		{
+		/* Let the renderer move the cached vertices instead of uploading the transformed points: */
+		translation+=transform.getTranslation();
+		}
+	else
+		{
+		/* Invalidate the cached curve: */
+		invalidateCache();
+		}
+	}
+
+void Curve::snapToGrid(Scalar gridSize)
+	{
+	/* Snap all curve points to the grid and re-calculate the bounding box: */
+	PointList newPoints;
+	snapPoints(shape->points,gridSize,newPoints,boundingBox);
+	setPoints(newPoints);
+	
+	invalidateCache();
+	}
+
+bool Curve::isErased(const Capsule& eraser)
+	{
+	/* The curve is unchanged if its beginning vertex is outside the capsule and all segments are guaranteed to miss it: */
+	shape->updateSegmentBounds();
+	return eraser.isInside(shape->points.front())||(!shape->segmentBounds.back().empty()&&isErased(eraser,shape->segmentBounds.size()-1,0));
 	}
 
 void Curve::rubout(const Capsule& eraser,SketchObjectContainer& container)
 	{
+	const PointList& points=shape->points;
+	size_t numSegments=points.size()-1;
+	
+	/* Bail out if the curve is guaranteed to be unchanged: */
+	if(!isErased(eraser))
+		return;
+	const std::vector<Box>& chunkBoxes=shape->segmentBounds.front();
+	
 	/* Create a temporary list of curve points outside the capsule: */
-	std::vector<Point> outside;
+	PointList outside;
 	Box outsideBox=Box::empty;
 	
 	/* Check if the curve's beginning vertex lies within the capsule: */
-	std::vector<Point>::iterator p0It=points.begin();
-	bool inside=eraser.isInside(*p0It);
+	bool inside=eraser.isInside(points.front());
 	bool anyChanges=inside;
 	
 	/* Store the beginning vertex in the outside list if it is outside: */
 	if(!inside)
 		{
-		outside.push_back(*p0It);
-		outsideBox.addPoint(*p0It);
+		outside.push_back(points.front());
+		outsideBox.addPoint(points.front());
 		}
 	
 	/* Process the rest of the curve: */
-	for(std::vector<Point>::iterator p1It=p0It+1;p1It!=points.end();p0It=p1It,++p1It)
+	size_t s=0;
+	while(s<numSegments)
 		{
+		if(!inside)
+			{
+			/* Copy an entire chunk of segments whose bounding box misses the capsule: */
+			if(s%numChunkSegments==0&&!eraser.doesIntersect(chunkBoxes[s/numChunkSegments]))
+				{
+				size_t last=Misc::min(s+numChunkSegments,numSegments);
+				outside.insert(outside.end(),points.begin()+(s+1),points.begin()+(last+1));
+				outsideBox.addBox(chunkBoxes[s/numChunkSegments]);
+				s=last;
+				continue;
+				}
+			
+			/* Copy a group of up to four segments, not crossing into the next chunk, that are guaranteed to miss the capsule: */
+			size_t chunkEnd=(s/numChunkSegments+1)*numChunkSegments;
+			unsigned int numGroup=(unsigned int)(Misc::min(Misc::min(numSegments,chunkEnd)-s,size_t(4)));
+			if(eraser.rejectSegments(&points[s],numGroup)==(1U<<numGroup)-1U)
+				{
+				for(unsigned int i=1;i<=numGroup;++i)
+					{
+					outside.push_back(points[s+i]);
+					outsideBox.addPoint(points[s+i]);
+					}
+				s+=numGroup;
+				continue;
+				}
+			}
+		
+		/* Process the current line segment exactly: */
+		const Point& p0=points[s];
+		const Point& p1=points[s+1];
+		++s;
+		
 		/* Check if the current line segment enters or exits the capsule: */
 		if(inside) // Segment start point is inside the capsule
 			{
 			/* The segment does not change state if the end point is also inside the capsule (convexity): */
-			if(!eraser.isInside(*p1It))
+			if(!eraser.isInside(p1))
 				{
 				/* The end point is outside; find the exact exit point: */
-				Capsule::Interval ii=eraser.intersectLine(*p0It,*p1It);
-				Point exit=Geometry::affineCombination(*p0It,*p1It,ii.getMax());
+				Capsule::Interval ii=eraser.intersectLine(p0,p1);
+				Point exit=Geometry::affineCombination(p0,p1,ii.getMax());
 				
 				/* Start a new temporary curve with the exit point and the segment end point: */
 				outside.push_back(exit);
 				outsideBox.addPoint(exit);
-				outside.push_back(*p1It);
-				outsideBox.addPoint(*p1It);
+				outside.push_back(p1);
+				outsideBox.addPoint(p1);
 				inside=false;
 				}
 			}
 		else // Segment start point is outside the capsule
 			{
 			/* Intersect the curve segment with the capsule: */
-			Capsule::Interval ii=eraser.intersectLine(*p0It,*p1It);
+			Capsule::Interval ii=eraser.intersectLine(p0,p1);
 			
 			/* Check if the segment enters the capsule: */
 			if(ii.getMin()>Scalar(0)&&ii.getMin()<=Scalar(1))
 				{
 				/* End the temporary curve with the exact entry point: */
-				Point entry=Geometry::affineCombination(*p0It,*p1It,ii.getMin());
+				Point entry=Geometry::affineCombination(p0,p1,ii.getMin());
 				outside.push_back(entry);
 				outsideBox.addPoint(entry);
 				
@@ -242,7 +624,8 @@ void Curve::rubout(const Capsule& eraser,SketchObjectContainer& container)
 				newCurve->boundingBox=outsideBox;
 				newCurve->color=color;
 				newCurve->lineWidth=lineWidth;
-				std::swap(newCurve->points,outside);
+				std::swap(newCurve->shape->points,outside);
+				newCurve->updateDerivedState();
 				++newCurve->version;
 				container.insertAfter(this,newCurve);
 				
@@ -259,11 +642,11 @@ void Curve::rubout(const Capsule& eraser,SketchObjectContainer& container)
 				else
 					{
 					/* Start a new temporary curve with the exit point and the segment end point: */
-					Point exit=Geometry::affineCombination(*p0It,*p1It,ii.getMax());
+					Point exit=Geometry::affineCombination(p0,p1,ii.getMax());
 					outside.push_back(exit);
 					outsideBox.addPoint(exit);
-					outside.push_back(*p1It);
-					outsideBox.addPoint(*p1It);
+					outside.push_back(p1);
+					outsideBox.addPoint(p1);
 					}
 				
 				anyChanges=true;
@@ -271,8 +654,8 @@ void Curve::rubout(const Capsule& eraser,SketchObjectContainer& container)
 			else // Entire segment is outside the capsule
 				{
 				/* Add segment end point to temporary curve: */
-				outside.push_back(*p1It);
-				outsideBox.addPoint(*p1It);
+				outside.push_back(p1);
+				outsideBox.addPoint(p1);
 				}
 			}
 		}
@@ -280,13 +663,14 @@ void Curve::rubout(const Capsule& eraser,SketchObjectContainer& container)
 	/* Check if there is a leftover outside curve segment: */
 	if(!inside)
 		{
-		/* Store the leftover curve in this curve object: */
-		boundingBox=outsideBox;
-		std::swap(points,outside);
-		
-		/* Invalidate the cache if any changes were made: */
+		/* Store the leftover curve in this curve object, invalidate the cache, and notify the container if any changes were made: */
 		if(anyChanges)
-			++version;
+			{
+			boundingBox=outsideBox;
+			setPoints(outside);
+			invalidateCache();
+			container.update(this);
+			}
 		}
 	else
 		{
@@ -295,6 +679,134 @@ void Curve::rubout(const Capsule& eraser,SketchObjectContainer& container)
 		}
 	}
 
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+bool quantizePoints(const PointList& points,float lineWidth,int& exponent,std::vector<Misc::SInt32>& quantized) // Quantizes the given points' x and y coordinates to a power-of-two grid fine enough for the given line width; returns false if the points can not be quantized
+	{
+	/* Use the largest power of two not larger than 1/64 of the line width as grid size: */
+	if(!(lineWidth>0.0f))
+		return false;
+	frexp(double(lineWidth)/64.0,&exponent);
+	--exponent;
+	if(exponent<-120||exponent>120)
+		return false;
+	double scale=ldexp(1.0,-exponent);
+	
+	quantized.reserve(points.size()*2);
+	for(PointList::const_iterator pIt=points.begin();pIt!=points.end();++pIt)
+		{
+		/* Only points in the sketching plane whose grid coordinates fit into 31 bits can be quantized: */
+		if((*pIt)[2]!=Scalar(0))
+			return false;
+		for(int i=0;i<2;++i)
+			{
+			double q=Math::floor(double((*pIt)[i])*scale+0.5);
+			if(Math::abs(q)>=double(1<<30))
+				return false;
+			quantized.push_back(Misc::SInt32(q));
+			}
+		}
+	
+	return true;
+	}
+
+void encodeDeltas(const std::vector<Misc::SInt32>& quantized,std::vector<Misc::UInt8>& bytes) // Encodes the differences between consecutive quantized points as zig-zag varints
+	{
+	bytes.reserve(quantized.size()*2);
+	Misc::SInt32 last[2]={0,0};
+	for(size_t i=0;i<quantized.size();++i)
+		{
+		/* Map the difference to an unsigned value with small magnitudes first: */
+		Misc::SInt32 delta=quantized[i]-last[i&0x1U];
+		last[i&0x1U]=quantized[i];
+		Misc::UInt32 zigzag=(Misc::UInt32(delta)<<1)^Misc::UInt32(delta>>31);
+		
+		/* Write seven bits per byte, setting the high bit in all but the last byte: */
+		while(zigzag>=0x80U)
+			{
+			bytes.push_back(Misc::UInt8(zigzag|0x80U));
+			zigzag>>=7;
+			}
+		bytes.push_back(Misc::UInt8(zigzag));
+		}
+	}
+
+void decodeDeltas(const Misc::UInt8* bytes,size_t numBytes,int exponent,PointList& points) // Decodes zig-zag varint differences into the given list of points in the sketching plane
+	{
+	/* Decode all varints first, to leave the prefix sum a tight loop; differences are kept as unsigned two's-complement values so that summing untrusted differences wraps around instead of overflowing: */
+	size_t numPoints=points.size();
+	std::vector<Misc::UInt32> deltas(numPoints*2);
+	const Misc::UInt8* bPtr=bytes;
+	const Misc::UInt8* bEnd=bytes+numBytes;
+	for(std::vector<Misc::UInt32>::iterator dIt=deltas.begin();dIt!=deltas.end();++dIt)
+		{
+		Misc::UInt32 zigzag=0;
+		int shift=0;
+		do
+			{
+			if(bPtr==bEnd)
+				throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Curve point stream ends prematurely");
+			if(shift>28||(shift==28&&(*bPtr&0x70U)!=0x0U))
+				throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Corrupted curve point stream");
+			zigzag|=Misc::UInt32(*bPtr&0x7fU)<<shift;
+			shift+=7;
+			}
+		while(*(bPtr++)&0x80U);
+		*dIt=(zigzag>>1)^(0x0U-(zigzag&0x1U));
+		}
+	
+	/* Check that the stream contained exactly the encoded points: */
+	if(bPtr!=bEnd)
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Curve point stream has %u trailing bytes",(unsigned int)(bEnd-bPtr));
+	
+	/* Sum up the differences and scale the sums back to points: */
+	float step=float(ldexp(1.0,exponent));
+	size_t i=0;
+	#ifdef __SSE2__
+	
+	/* Process two points at a time, keeping the running sums of x and y in both halves of a register: */
+	__m128i sum=_mm_setzero_si128();
+	__m128 scale=_mm_set1_ps(step);
+	for(;i+2<=numPoints;i+=2)
+		{
+		/* Add the first point's differences to the second point's, then add the running sums: */
+		__m128i d=_mm_loadu_si128(reinterpret_cast<const __m128i*>(&deltas[i*2]));
+		d=_mm_add_epi32(d,_mm_slli_si128(d,8));
+		sum=_mm_add_epi32(sum,d);
+		
+		float p[4];
+		_mm_storeu_ps(p,_mm_mul_ps(_mm_cvtepi32_ps(sum),scale));
+		points[i]=Point(p[0],p[1],Scalar(0));
+		points[i+1]=Point(p[2],p[3],Scalar(0));
+		
+		/* Broadcast the second point's sums to both halves: */
+		sum=_mm_shuffle_epi32(sum,_MM_SHUFFLE(3,2,3,2));
+		}
+	Misc::UInt32 x=Misc::UInt32(_mm_cvtsi128_si32(sum));
+	Misc::UInt32 y=Misc::UInt32(_mm_cvtsi128_si32(_mm_shuffle_epi32(sum,_MM_SHUFFLE(1,1,1,1))));
+	
+	#else
+	
+	Misc::UInt32 x=0;
+	Misc::UInt32 y=0;
+	
+	#endif
+	
+	/* Process the remaining point, converting the wrapped-around sums back to signed grid coordinates: */
+	for(;i<numPoints;++i)
+		{
+		x+=deltas[i*2+0];
+		y+=deltas[i*2+1];
+		points[i]=Point(Scalar(Misc::SInt32(x))*step,Scalar(Misc::SInt32(y))*step,Scalar(0));
+		}
+	}
+
+}
+
 void Curve::write(IO::File& file,const SketchObjectCreator& creator) const
 	{
 	/* Write the color and line width: */
@@ -303,12 +815,29 @@ void Curve::write(IO::File& file,const SketchObjectCreator& creator) const
 	file.write<Misc::Float32>(lineWidth);
 	
 	/* Write the number of points: */
-	file.write<Misc::UInt16>(points.size());
+	const PointList& points=shape->points;
+	file.write<Misc::UInt32>(points.size());
 	
-	/* Write all points: */
-	for(std::vector<Point>::const_iterator pIt=points.begin();pIt!=points.end();++pIt)
-		for(int i=0;i<3;++i)
-			file.write<Misc::Float32>((*pIt)[i]);
+	int exponent;
+	std::vector<Misc::SInt32> quantized;
+	if(creator.getPointEncoding()==SketchObjectCreator::DeltaPoints&&quantizePoints(points,lineWidth,exponent,quantized))
+		{
+		/* Write the points as quantized differences packed into varints: */
+		std::vector<Misc::UInt8> bytes;
+		encodeDeltas(quantized,bytes);
+		file.write<Misc::UInt8>(SketchObjectCreator::DeltaPoints);
+		file.write<Misc::SInt8>(exponent);
+		file.write<Misc::UInt32>(bytes.size());
+		if(!bytes.empty())
+			file.write(&bytes.front(),bytes.size());
+		}
+	else
+		{
+		/* Write all points as a single contiguous array: */
+		file.write<Misc::UInt8>(SketchObjectCreator::RawPoints);
+		if(!points.empty())
+			file.write(points.front().getComponents(),points.size()*3);
+		}
 	}
 
 void Curve::read(IO::File& file,SketchObjectCreator& creator)
@@ -318,34 +847,78 @@ void Curve::read(IO::File& file,SketchObjectCreator& creator)
 		color[i]=file.read<Misc::UInt8>();
 	lineWidth=file.read<Misc::Float32>();
 	
-	/* Read the number of points: */
-	size_t numPoints=file.read<Misc::UInt16>();
+	/* Read the number of points; version 1 files use 16-bit point counts: */
+	size_t numPoints=creator.getFileVersion()>=2?size_t(file.read<Misc::UInt32>()):size_t(file.read<Misc::UInt16>());
 	
-	/* Read a new point vector and calculate a new bounding box: */
-	std::vector<Point> newPoints;
-	newPoints.reserve(numPoints);
-	Box newBoundingBox=Box::empty;
-	for(size_t i=0;i<numPoints;++i)
+	/* Read the points' encoding; files before version 4 always contain raw points: */
+	unsigned int encoding=creator.getFileVersion()>=4?(unsigned int)(file.read<Misc::UInt8>()):(unsigned int)(SketchObjectCreator::RawPoints);
+	PointList newPoints(numPoints);
+	if(encoding==SketchObjectCreator::DeltaPoints)
+		{
+		/* Read the packed point differences and decode them into a new point vector: */
+		int exponent=file.read<Misc::SInt8>();
+		std::vector<Misc::UInt8> bytes(file.read<Misc::UInt32>());
+		if(!bytes.empty())
+			file.read(&bytes.front(),bytes.size());
+		decodeDeltas(bytes.empty()?0:&bytes.front(),bytes.size(),exponent,newPoints);
+		}
+	else if(encoding==SketchObjectCreator::RawPoints)
 		{
-		Point p;
-		for(int j=0;j<3;++j)
-			p[j]=file.read<Misc::Float32>();
-		newPoints.push_back(p);
-		newBoundingBox.addPoint(p);
+		/* Read a new point vector as a single contiguous array: */
+		if(numPoints>0)
+			file.read(newPoints.front().getComponents(),numPoints*3);
 		}
+	else
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Invalid curve point encoding %u",encoding);
+	
+	/* Calculate a new bounding box: */
+	Box newBoundingBox=Box::empty;
+	for(PointList::iterator pIt=newPoints.begin();pIt!=newPoints.end();++pIt)
+		newBoundingBox.addPoint(*pIt);
 	
 	/* Swap the old and new bounding box and point vector: */
 	boundingBox=newBoundingBox;
-	std::swap(points,newPoints);
+	setPoints(newPoints);
 	
-	++version;
+	invalidateCache();
+	}
+
+void Curve::writeSVG(std::string& svg) const
+	{
+	/* Write the curve's color and line width; the polyline renderer draws round caps and joins: */
+	char buffer[128];
+	snprintf(buffer,sizeof(buffer),"<polyline fill=\"none\" stroke=\"#%02x%02x%02x\"",color[0],color[1],color[2]);
+	svg.append(buffer);
+	if(color[3]!=255U)
+		{
+		snprintf(buffer,sizeof(buffer)," stroke-opacity=\"%.4g\"",double(color[3])/255.0);
+		svg.append(buffer);
+		}
+	snprintf(buffer,sizeof(buffer)," stroke-width=\"%.7g\" stroke-linecap=\"round\" stroke-linejoin=\"round\" points=\"",double(lineWidth));
+	svg.append(buffer);
+	
+	/* Write the curve's points; a single point is written twice so that its round caps draw a dot: */
+	const PointList& points=shape->points;
+	for(PointList::const_iterator pIt=points.begin();pIt!=points.end();++pIt)
+		{
+		snprintf(buffer,sizeof(buffer),pIt!=points.begin()?" %.7g,%.7g":"%.7g,%.7g",double((*pIt)[0]),double((*pIt)[1]));
+		svg.append(buffer);
+		if(points.size()==1)
+			{
+			svg.push_back(' ');
+			svg.append(buffer);
+			}
+		}
+	svg.append("\"/>\n");
 	}
 
 void Curve::glRenderAction(RenderState& renderState) const
 	{
-	/* Draw the curve using a polyline renderer: */
+	/* Draw the curve's coarsest level-of-detail tier that looks identical to the full curve using a polyline renderer: */
 	renderState.setRenderer(renderer);
-	renderer->draw(this,version,points,color,lineWidth,renderState.getDataItem());
+	unsigned int lodTier;
+	const PointList& tierPoints=renderer->selectLodTier(shape->points,shape->lodTiers,lodTier,renderState.getDataItem());
+	renderer->draw(cacheKey.getPointer(),version,lodTier,tierPoints,translation,color,lineWidth,renderState.getDataItem());
 	}
 
 void Curve::glRenderActionHighlight(Scalar cycle,RenderState& renderState) const
@@ -356,9 +929,11 @@ void Curve::glRenderActionHighlight(Scalar cycle,RenderState& renderState) const
 	for(int i=0;i<4;++i)
 		highlight[i]=GLubyte(Math::floor(Scalar(color[i])*(Scalar(1)-cycle)+Scalar(highlight[i])*cycle+Scalar(0.5)));
 	
-	/* Draw the curve using a polyline renderer: */
+	/* Draw the curve's coarsest level-of-detail tier that looks identical to the full curve using a polyline renderer: */
 	renderState.setRenderer(renderer);
-	renderer->draw(this,version,points,highlight,lineWidth,renderState.getDataItem());
+	unsigned int lodTier;
+	const PointList& tierPoints=renderer->selectLodTier(shape->points,shape->lodTiers,lodTier,renderState.getDataItem());
+	renderer->draw(cacheKey.getPointer(),version,lodTier,tierPoints,translation,highlight,lineWidth,renderState.getDataItem());
 	}
 
 /*****************************
@@ -390,13 +965,15 @@ void CurveFactory::buttonDown(const Point& pos)
 	lineMode=false;
 	
 	/* Append the first curve point: */
-	current->points.push_back(pos);
+	current->shape->points.push_back(pos);
 	current->boundingBox.addPoint(pos);
 	++current->version;
 	
 	/* Reset the curve suffix: */
 	curveLast=pos;
 	points.clear();
+	suffixHull.clear();
+	stepHull.clear();
 	
 	/* Initialize linger detection: */
 	lastLinger=false;
@@ -416,22 +993,40 @@ void CurveFactory::motion(const Point& pos,bool lingering,bool firstNeighborhood
 		if(startLingering)
 			end=settings.snap(pos);
 			
-		current->points.back()=end;
+		current->shape->points.back()=end;
 		++current->version;
 		}
 	else if(startLingering)
 		{
 		/* Check if the current curve should be turned into a line: */
-		Vector dir=pos-current->points.front();
+		Vector dir=pos-current->shape->points.front();
 		Scalar maxBackspace=settings.getDetailSize()*dir.mag();
-		std::vector<Point>::iterator pIt=current->points.begin();
-		Scalar offset=*pIt*dir;
 		bool straight=true;
-		for(++pIt;straight&&pIt!=current->points.end();++pIt)
+		if(stepHull.isPlanar())
 			{
-			Scalar nextOffset=*pIt*dir;
-			straight=nextOffset>=offset-maxBackspace;
-			offset=nextOffset;
+			/* Check that no fixed curve step backs up along the line by more than the allowed amount: */
+			if(!stepHull.isEmpty())
+				{
+				Scalar min,max;
+				stepHull.getExtent(dir,min,max);
+				straight=max<=maxBackspace;
+				}
+			
+			/* Check the step to the tentative last curve point, which is not in the step hull: */
+			if(straight&&current->shape->points.size()>=2)
+				straight=(*(current->shape->points.end()-2)-current->shape->points.back())*dir<=maxBackspace;
+			}
+		else
+			{
+			/* Check all curve steps explicitly: */
+			PointList::iterator pIt=current->shape->points.begin();
+			Scalar offset=*pIt*dir;
+			for(++pIt;straight&&pIt!=current->shape->points.end();++pIt)
+				{
+				Scalar nextOffset=*pIt*dir;
+				straight=nextOffset>=offset-maxBackspace;
+				offset=nextOffset;
+				}
 			}
 		if(firstNeighborhood||straight)
 			{
@@ -441,7 +1036,7 @@ void CurveFactory::motion(const Point& pos,bool lingering,bool firstNeighborhood
 			line->lineWidth=current->lineWidth;
 			
 			/* Find the line's starting point: */
-			Point first=current->points.front();
+			Point first=current->shape->points.front();
 			if(firstNeighborhood)
 				{
 				/* Snap the first curve point to nearby sketch objects: */
@@ -449,9 +1044,9 @@ void CurveFactory::motion(const Point& pos,bool lingering,bool firstNeighborhood
 				}
 			
 			/* Create the line: */
-			line->points.push_back(first);
+			line->shape->points.push_back(first);
 			line->boundingBox.addPoint(first);
-			line->points.push_back(pos);
+			line->shape->points.push_back(pos);
 			++line->version;
 			
 			/* Go to line mode: */
@@ -464,22 +1059,37 @@ void CurveFactory::motion(const Point& pos,bool lingering,bool firstNeighborhood
 		{
 		/* Update the curve suffix: */
 		if(points.empty())
-			current->points.push_back(pos);
+			current->shape->points.push_back(pos);
 		else
-			current->points.back()=pos;
+			current->shape->points.back()=pos;
 		++current->version;
 		points.push_back(pos);
+		suffixHull.addPoint(pos);
 		
 		/* Check if the current curve suffix is well-represented by a line segment: */
 		Vector dir=pos-curveLast;
-		Vector normal=Geometry::normal(dir);
-		normal.normalize();
-		Scalar dist0=curveLast*normal;
 		bool straight=pos!=curveLast;
-		for(std::vector<Point>::iterator pIt=points.begin();straight&&pIt!=points.end();++pIt)
+		if(straight)
 			{
-			Scalar dist=Math::abs(*pIt*normal-dist0);
-			straight=dist<settings.getDetailSize();
+			Vector normal=Geometry::normal(dir);
+			normal.normalize();
+			Scalar dist0=curveLast*normal;
+			if(suffixHull.isPlanar())
+				{
+				/* The suffix's largest distances from the line are attained at vertices of its convex hull: */
+				Scalar min,max;
+				suffixHull.getExtent(normal,min,max);
+				straight=max-dist0<settings.getDetailSize()&&dist0-min<settings.getDetailSize();
+				}
+			else
+				{
+				/* Check all suffix points explicitly: */
+				for(PointList::iterator pIt=points.begin();straight&&pIt!=points.end();++pIt)
+					{
+					Scalar dist=Math::abs(*pIt*normal-dist0);
+					straight=dist<settings.getDetailSize();
+					}
+				}
 			}
 		if(straight&&points.size()>=2)
 			{
@@ -492,12 +1102,18 @@ void CurveFactory::motion(const Point& pos,bool lingering,bool firstNeighborhood
 			{
 			/* Add the previous end of the curve suffix to the curve: */
 			curveLast=*(points.end()-2);
-			current->points.back()=curveLast;
+			current->shape->points.back()=curveLast;
 			current->boundingBox.addPoint(curveLast);
-			current->points.push_back(pos);
+			
+			/* Record the new fixed curve step for line mode detection: */
+			stepHull.addPoint(Point::origin+(*(current->shape->points.end()-2)-curveLast));
+			
+			current->shape->points.push_back(pos);
 			++current->version;
 			points.clear();
 			points.push_back(pos);
+			suffixHull.clear();
+			suffixHull.addPoint(pos);
 			}
 		}
 	
@@ -508,7 +1124,7 @@ void CurveFactory::motion(const Point& pos,bool lingering,bool firstNeighborhood
 bool CurveFactory::buttonUp(const Point& pos)
 	{
 	/* Fix the tentative last curve point: */
-	current->boundingBox.addPoint(current->points.back());
+	current->boundingBox.addPoint(current->shape->points.back());
 	
 	/* Tell the caller that the curve is done: */
 	return true;
@@ -519,7 +1135,10 @@ SketchObject* CurveFactory::finish(void)
 	if(current!=0)
 		{
 		/* Fix the tentative last curve point: */
-		current->boundingBox.addPoint(current->points.back());
+		current->boundingBox.addPoint(current->shape->points.back());
+		
+		/* Create the finished curve's level-of-detail tiers: */
+		current->updateDerivedState();
 		}
 	
 	/* Return the current curve object: */
@@ -532,8 +1151,22 @@ void CurveFactory::glRenderAction(RenderState& renderState) const
 	{
 	if(current!=0)
 		{
-		/* Draw the currently created curve using a polyline renderer: */
+		/* Draw the currently created curve using a polyline renderer; all curve points except the last are fixed: */
+		renderState.setRenderer(Curve::renderer);
+		Curve::renderer->drawLive(current->cacheKey.getPointer(),current->version,current->shape->points,current->shape->points.size()-1,current->color,current->lineWidth,renderState.getDataItem());
+		}
+	}
+
+void CurveFactory::glRenderPrediction(const Point& predictedPos,RenderState& renderState) const
+	{
+	if(current!=0)
+		{
+		/* Draw an uncached extension from the tentative last curve point to the predicted position; it is replaced by real samples on the next frame: */
+		PolylineRenderer::Polyline extension;
+		extension.reserve(2);
+		extension.push_back(current->shape->points.back());
+		extension.push_back(predictedPos);
 		renderState.setRenderer(Curve::renderer);
-		Curve::renderer->draw(current->points,current->color,current->lineWidth,renderState.getDataItem());
+		Curve::renderer->draw(extension,current->color,current->lineWidth,renderState.getDataItem());
 		}
 	}
@@ -23,28 +23,88 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef CURVE_INCLUDED
 #define CURVE_INCLUDED
 
+#include <stddef.h>
 #include <vector>
+#include <Misc/Autopointer.h>
+#include <Threads/Atomic.h>
+#include <Threads/Spinlock.h>
 
 #include "SketchGeometry.h"
 #include "SketchObject.h"
-
-/* Forward declarations: */
-class PolylineRenderer;
+#include "ObjectPool.h"
+#include "PointArena.h"
+#include "ConvexHull.h"
+#include "PolylineRenderer.h"
 
 class Curve:public SketchObject
 	{
 	friend class SketchObjectCreator;
 	friend class CurveFactory;
 	
-	/* Elements: */
+	/* Embedded classes: */
 	private:
+	struct Shape // Structure holding a curve's points and derived state, shared between cloned curves until one of them changes its points
+		{
+		/* Elements: */
+		public:
+		Threads::Atomic<unsigned int> refCount; // Number of curves sharing the shape
+		PointList points; // Vector of curve points
+		PolylineRenderer::LodTierList lodTiers; // Simplified versions of the curve for rendering at coarse scales
+		std::vector<std::vector<Box> > segmentBounds; // Hierarchy of bounding boxes of curve segments; level 0 has one box per chunk of segments, and each higher level merges pairs of boxes from the level below
+		bool segmentBoundsValid; // Flag whether the segment bounding box hierarchy matches the shape's current points
+		Threads::Spinlock segmentBoundsMutex; // Mutex serializing building the segment bounding box hierarchy from curves sharing the shape
+		
+		/* Constructors and destructors: */
+		Shape(void) // Creates an empty shape
+			:refCount(0),segmentBoundsValid(false)
+			{
+			}
+		Shape(const Shape& source) // Creates an unshared copy of the given shape
+			:refCount(0),
+			 points(source.points),lodTiers(source.lodTiers),
+			 segmentBounds(source.segmentBounds),segmentBoundsValid(source.segmentBoundsValid)
+			{
+			}
+		
+		/* Methods: */
+		void ref(void) // Adds a reference to the shape
+			{
+			refCount.preAdd(1);
+			}
+		void unref(void) // Removes a reference from the shape and destroys it when the last reference is removed
+			{
+			if(refCount.preSub(1)==0)
+				delete this;
+			}
+		bool isShared(void) const // Returns true if more than one curve shares the shape
+			{
+			return refCount.get()>1;
+			}
+		void updateSegmentBounds(void); // Builds the segment bounding box hierarchy if it is invalid
+		};
+	
+	typedef Misc::Autopointer<Shape> ShapePtr; // Type for pointers to shared curve shapes
+	
+	/* Elements: */
 	static unsigned int typeCode; // The curve class's type code
 	static PolylineRenderer* renderer; // A renderer to render curves
+	static ObjectPool pool; // Pool of memory slots for curve objects
+	static const size_t numChunkSegments=32; // Number of curve segments per bounding box chunk
 	
 	Color color; // Curve's color
 	float lineWidth; // Curve's cosmetic line width
-	std::vector<Point> points; // Vector of curve points
+	ShapePtr shape; // The curve's points and derived state, which must not be changed while shared
+	PolylineRenderer::CacheKeyPtr cacheKey; // Cache ID of the curve's cached vertices, shared with clones until one of them changes other than by translation
 	unsigned int version; // Version number of curve point list
+	Vector translation; // Accumulated translation applied to the curve, used to move cached vertices without uploading them again
+	
+	/* Private methods: */
+	Shape& getUniqueShape(void); // Returns the curve's shape after copying it if it is shared with other curves
+	void setPoints(PointList& newPoints); // Replaces the curve's points with the contents of the given point list, which are swapped out, and re-creates derived state
+	void updateDerivedState(void); // Re-creates the curve's level-of-detail tiers and invalidates its segment bounding box hierarchy after its points changed; the curve's shape must not be shared
+	void invalidateCache(void); // Invalidates the curve's cached vertices, first detaching them from clones sharing them
+	bool pickChunks(PickResult& result,unsigned int level,size_t index); // Picks the segments and interior vertices of all chunks below the given node of the segment bounding box hierarchy
+	bool isErased(const Capsule& eraser,unsigned int level,size_t index) const; // Returns false if all segments below the given node of the segment bounding box hierarchy are guaranteed to miss the given eraser
 	
 	/* Constructors and destructors: */
 	public:
@@ -52,17 +112,27 @@ class Curve:public SketchObject
 	Curve(void); // Creates an empty curve with undefined parameters
 	virtual ~Curve(void);
 	static void deinitClass(void); // De-initializes the curve object class
+	static void* operator new(size_t size); // Allocates memory for a new curve from the curve pool
+	static void operator delete(void* object,size_t size); // Returns a destroyed curve's memory to the curve pool
+	static const PolylineRenderer* getRenderer(void) // Returns the renderer shared by all curves, e.g., to draw curves that are not sketch objects
+		{
+		return renderer;
+		}
 	
 	/* Methods from SketchObject: */
 	virtual unsigned int getTypeCode(void) const;
+	virtual Scalar getMaxLineWidth(void) const;
+	virtual size_t getMemorySize(void) const;
 	virtual bool pick(PickResult& result);
 	virtual SketchObject* clone(void) const;
 	virtual void applySettings(const SketchSettings& settings);
 	virtual void transform(const Transformation& transform);
 	virtual void snapToGrid(Scalar gridSize);
+	virtual bool isErased(const Capsule& eraser);
 	virtual void rubout(const Capsule& eraser,SketchObjectContainer& container);
 	virtual void write(IO::File& file,const SketchObjectCreator& creator) const;
 	virtual void read(IO::File& file,SketchObjectCreator& creator);
+	virtual void writeSVG(std::string& svg) const;
 	virtual void glRenderAction(RenderState& renderState) const;
 	virtual void glRenderActionHighlight(Scalar cycle,RenderState& renderState) const;
 	};
@@ -75,7 +145,9 @@ class CurveFactory:public SketchObjectFactory
 	bool lineMode; // Flag whether the factory has changed mode to line drawing
 	bool lastLinger; // Flag if the tool was lingering during the previous motion callback
 	Point curveLast; // The last fixed curve point
-	std::vector<Point> points; // Tentative points at the end of the current curve
+	PointList points; // Tentative points at the end of the current curve
+	ConvexHull suffixHull; // Convex hull of the tentative points at the end of the current curve
+	ConvexHull stepHull; // Convex hull of the differences between consecutive fixed curve points, pointing backwards along the curve
 	
 	/* Constructors and destructors: */
 	public:
@@ -88,6 +160,7 @@ class CurveFactory:public SketchObjectFactory
 	virtual bool buttonUp(const Point& pos);
 	virtual SketchObject* finish(void);
 	virtual void glRenderAction(RenderState& renderState) const;
+	virtual void glRenderPrediction(const Point& predictedPos,RenderState& renderState) const;
 	};
 
 #endif
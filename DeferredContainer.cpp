@@ -0,0 +1,76 @@
+/***********************************************************************
+DeferredContainer - Class for sketch object containers that record
+changes made to them and apply them to another container later.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "DeferredContainer.h"
+
+/**********************************
+Methods of class DeferredContainer:
+**********************************/
+
+void DeferredContainer::append(SketchObject* newObject)
+	{
+	changes.push_back(Change(Append,newObject,0));
+	}
+
+void DeferredContainer::insertAfter(SketchObject* pred,SketchObject* newObject)
+	{
+	changes.push_back(Change(InsertAfter,newObject,pred));
+	}
+
+void DeferredContainer::remove(SketchObject* object)
+	{
+	changes.push_back(Change(Remove,object,0));
+	}
+
+void DeferredContainer::update(SketchObject* object)
+	{
+	changes.push_back(Change(Update,object,0));
+	}
+
+void DeferredContainer::commit(SketchObjectContainer& container)
+	{
+	/* Apply all changes in the order in which they were recorded: */
+	for(std::vector<Change>::iterator cIt=changes.begin();cIt!=changes.end();++cIt)
+		{
+		switch(cIt->type)
+			{
+			case Append:
+				container.append(cIt->object);
+				break;
+			
+			case InsertAfter:
+				container.insertAfter(cIt->pred,cIt->object);
+				break;
+			
+			case Remove:
+				container.remove(cIt->object);
+				break;
+			
+			case Update:
+				container.update(cIt->object);
+				break;
+			}
+		}
+	
+	changes.clear();
+	}
@@ -0,0 +1,73 @@
+/***********************************************************************
+DeferredContainer - Class for sketch object containers that record
+changes made to them and apply them to another container later.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef DEFERREDCONTAINER_INCLUDED
+#define DEFERREDCONTAINER_INCLUDED
+
+#include <vector>
+
+#include "SketchObjectContainer.h"
+
+class DeferredContainer:public SketchObjectContainer
+	{
+	/* Embedded classes: */
+	private:
+	enum ChangeType // Enumerated type for recorded changes
+		{
+		Append,InsertAfter,Remove,Update
+		};
+	
+	struct Change // Structure describing a recorded change
+		{
+		/* Elements: */
+		public:
+		ChangeType type; // Type of the change
+		SketchObject* object; // The appended, inserted, removed, or updated object
+		SketchObject* pred; // Predecessor of an inserted object
+		
+		/* Constructors and destructors: */
+		Change(ChangeType sType,SketchObject* sObject,SketchObject* sPred)
+			:type(sType),object(sObject),pred(sPred)
+			{
+			}
+		};
+	
+	/* Elements: */
+	std::vector<Change> changes; // List of recorded changes in the order they were made
+	
+	/* Methods from SketchObjectContainer: */
+	public:
+	virtual void append(SketchObject* newObject);
+	virtual void insertAfter(SketchObject* pred,SketchObject* newObject);
+	virtual void remove(SketchObject* object);
+	virtual void update(SketchObject* object);
+	
+	/* New methods: */
+	bool empty(void) const // Returns true if no changes were recorded
+		{
+		return changes.empty();
+		}
+	void commit(SketchObjectContainer& container); // Applies all recorded changes to the given container in order and clears the list of recorded changes
+	};
+
+#endif
@@ -22,13 +22,16 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include "EraseTool.h"
 
+#include <vector>
 #include <GL/gl.h>
 #include <GL/GLColorTemplates.h>
 #include <GL/GLVertexTemplates.h>
 #include <Vrui/Vrui.h>
 #include <Vrui/ToolManager.h>
 
+#include "Stats.h"
 #include "RenderState.h"
+#include "SketchJournal.h"
 
 /*********************************************
 Static elements of class SketchPad::EraseTool:
@@ -60,6 +63,9 @@ SketchPad::EraseTool::EraseTool(const Vrui::ToolFactory* factory,const Vrui::Too
 
 SketchPad::EraseTool::~EraseTool(void)
 	{
+	/* Finish an erasing stroke that is still in progress: */
+	if(isActive())
+		application->settings.endEdit();
 	}
 
 const Vrui::ToolFactory* SketchPad::EraseTool::getFactory(void) const
@@ -69,6 +75,9 @@ const Vrui::ToolFactory* SketchPad::EraseTool::getFactory(void) const
 
 void SketchPad::EraseTool::buttonCallback(int buttonSlotIndex,Vrui::InputDevice::ButtonCallbackData* cbData)
 	{
+	/* Measure the time spent erasing: */
+	SKETCHPAD_STATS_TIMER(EraseTime);
+	
 	if(cbData->newButtonState)
 		{
 		/* Start dragging: */
@@ -77,6 +86,9 @@ void SketchPad::EraseTool::buttonCallback(int buttonSlotIndex,Vrui::InputDevice:
 		
 		/* Initialize the eraser capsule: */
 		eraser=Capsule(lastPos,lastPos,Scalar(Vrui::getPointPickDistance())*Scalar(2));
+		
+		/* Undo everything erased during the stroke as a single edit: */
+		application->settings.beginEdit();
 		}
 	else
 		{
@@ -86,16 +98,24 @@ void SketchPad::EraseTool::buttonCallback(int buttonSlotIndex,Vrui::InputDevice:
 			/* Erase the object picked by the tool: */
 			SketchObject::PickResult pickResult=application->settings.pick(lastPos);
 			if(pickResult.isValid())
+				{
+				if(application->journal!=0)
+					application->journal->removeObject(pickResult.pickedObject);
 				application->settings.remove(pickResult.pickedObject);
+				}
 			}
 		
 		/* Stop dragging: */
+		application->settings.endEdit();
 		buttonUp(lastPos);
 		}
 	}
 
 void SketchPad::EraseTool::frame(void)
 	{
+	/* Measure the time spent erasing: */
+	SKETCHPAD_STATS_TIMER(EraseTime);
+	
 	if(isActive())
 		{
 		/* Transform the tool position to navigational coordinates: */
@@ -111,20 +131,11 @@ void SketchPad::EraseTool::frame(void)
 			eraser=Capsule(lastPos,pos,Scalar(Vrui::getPointPickDistance())*Scalar(2));
 			
 			/* Rub out all sketch objects parts inside the eraser capsule: */
-			SketchObjectList::iterator soIt=application->settings.getSketchObjects().begin();
-			while(soIt!=application->settings.getSketchObjects().end())
-				{
-				/* Get an iterator to the next object: */
-				SketchObjectList::iterator nextIt=soIt;
-				++nextIt;
-				
-				/* Erase from the object if its bounding box intersects the capsule: */
-				if(eraser.doesIntersect(soIt->getBoundingBox()))
-					soIt->rubout(eraser,application->settings);
-				
-				/* Go to the next object, even if the current one was deleted or split: */
-				soIt=nextIt;
-				}
+			std::vector<SketchObject*> objects;
+			application->settings.findErasedObjects(eraser,objects);
+			if(application->journal!=0)
+				application->journal->rubout(eraser,objects);
+			application->settings.rubout(eraser,objects);
 			
 			lastPos=pos;
 			}
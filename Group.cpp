@@ -23,16 +23,40 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include "Group.h"
 
 #include <Misc/SizedTypes.h>
+#include <Math/Math.h>
 #include <IO/File.h>
 
 #include "Capsule.h"
 #include "SketchObjectCreator.h"
+#include "RenderState.h"
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+inline Scalar sqrDist(const Box& box,const Point& p) // Returns the squared distance from the given point to the given box
+	{
+	Scalar result(0);
+	for(int i=0;i<3;++i)
+		{
+		if(p[i]<box.min[i])
+			result+=Math::sqr(box.min[i]-p[i]);
+		else if(p[i]>box.max[i])
+			result+=Math::sqr(p[i]-box.max[i]);
+		}
+	return result;
+	}
+
+}
 
 /******************************
 Static elements of class Group:
 ******************************/
 
 unsigned int Group::typeCode=0;
+ObjectPool Group::pool(sizeof(Group));
 
 /**********************
 Methods of class Group:
@@ -44,21 +68,240 @@ void Group::initClass(unsigned int newTypeCode)
 	typeCode=newTypeCode;
 	}
 
+void Group::updateMemberBounds(void)
+	{
+	if(!memberBoundsValid)
+		{
+		chunks.clear();
+		memberBounds.clear();
+		
+		/* Split the group members into chunks and calculate the bounding box of each chunk: */
+		memberBounds.push_back(std::vector<Box>());
+		for(SketchObjectList::iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
+			{
+			if(chunks.empty()||chunks.back().size()==numChunkMembers)
+				{
+				chunks.push_back(std::vector<SketchObject*>());
+				chunks.back().reserve(numChunkMembers);
+				memberBounds.back().push_back(Box::empty);
+				}
+			chunks.back().push_back(&*soIt);
+			memberBounds.back().back().addBox(soIt->getBoundingBox());
+			}
+		
+		/* Merge pairs of boxes until there is a single root box: */
+		while(memberBounds.back().size()>1)
+			{
+			const std::vector<Box>& below=memberBounds.back();
+			std::vector<Box> level;
+			for(size_t i=0;i<below.size();i+=2)
+				{
+				Box box=below[i];
+				if(i+1<below.size())
+					box.addBox(below[i+1]);
+				level.push_back(box);
+				}
+			memberBounds.push_back(level);
+			}
+		
+		memberBoundsValid=true;
+		}
+	}
+
+void Group::updateNodeBox(unsigned int level,size_t index)
+	{
+	Box& box=memberBounds[level][index];
+	box=Box::empty;
+	if(level>0)
+		{
+		/* Merge the node's children's boxes: */
+		const std::vector<Box>& below=memberBounds[level-1];
+		box.addBox(below[index*2]);
+		if(index*2+1<below.size())
+			box.addBox(below[index*2+1]);
+		}
+	else
+		{
+		/* Merge the chunk's members' boxes: */
+		const std::vector<SketchObject*>& chunk=chunks[index];
+		for(std::vector<SketchObject*>::const_iterator cIt=chunk.begin();cIt!=chunk.end();++cIt)
+			box.addBox((*cIt)->getBoundingBox());
+		}
+	}
+
+bool Group::pickChunks(SketchObject::PickResult& result,unsigned int level,size_t index)
+	{
+	/* Bail out if the node's box is outside the pick sphere: */
+	if(sqrDist(memberBounds[level][index],result.center)>=result.radius2)
+		return false;
+	
+	bool picked=false;
+	if(level>0)
+		{
+		/* Pick the node's children in list order: */
+		const std::vector<Box>& below=memberBounds[level-1];
+		picked=pickChunks(result,level-1,index*2)||picked;
+		if(index*2+1<below.size())
+			picked=pickChunks(result,level-1,index*2+1)||picked;
+		}
+	else
+		{
+		/* Pick all members of the chunk whose bounding boxes are close to the pick sphere: */
+		std::vector<SketchObject*>& chunk=chunks[index];
+		for(std::vector<SketchObject*>::iterator cIt=chunk.begin();cIt!=chunk.end();++cIt)
+			if(sqrDist((*cIt)->getBoundingBox(),result.center)<result.radius2)
+				picked=(*cIt)->pick(result)||picked;
+		}
+	
+	return picked;
+	}
+
+bool Group::isErased(const Capsule& eraser,unsigned int level,size_t index)
+	{
+	/* Bail out if the node's box misses the eraser: */
+	if(!eraser.doesIntersect(memberBounds[level][index]))
+		return false;
+	
+	if(level>0)
+		{
+		/* Check the node's children: */
+		const std::vector<Box>& below=memberBounds[level-1];
+		if(isErased(eraser,level-1,index*2))
+			return true;
+		return index*2+1<below.size()&&isErased(eraser,level-1,index*2+1);
+		}
+	else
+		{
+		/* Check all members of the chunk whose bounding boxes touch the eraser: */
+		std::vector<SketchObject*>& chunk=chunks[index];
+		for(std::vector<SketchObject*>::iterator cIt=chunk.begin();cIt!=chunk.end();++cIt)
+			if(eraser.doesIntersect((*cIt)->getBoundingBox())&&(*cIt)->isErased(eraser))
+				return true;
+		
+		return false;
+		}
+	}
+
+bool Group::ruboutChunks(const Capsule& eraser,unsigned int level,size_t index)
+	{
+	/* Bail out if the node's box misses the eraser: */
+	if(!eraser.doesIntersect(memberBounds[level][index]))
+		return false;
+	
+	bool changed=false;
+	if(level>0)
+		{
+		/* Rub out the node's children: */
+		const std::vector<Box>& below=memberBounds[level-1];
+		changed=ruboutChunks(eraser,level-1,index*2)||changed;
+		if(index*2+1<below.size())
+			changed=ruboutChunks(eraser,level-1,index*2+1)||changed;
+		}
+	else
+		{
+		/* Rub out all members of the chunk whose bounding boxes touch the eraser, working on a copy as members remove themselves or insert their remains into the chunk: */
+		ruboutChunk=&chunks[index];
+		membersChanged=false;
+		std::vector<SketchObject*> members=chunks[index];
+		for(std::vector<SketchObject*>::iterator mIt=members.begin();mIt!=members.end();++mIt)
+			if(eraser.doesIntersect((*mIt)->getBoundingBox()))
+				(*mIt)->rubout(eraser,*this);
+		changed=membersChanged;
+		ruboutChunk=0;
+		}
+	
+	/* Re-calculate the node's box if anything below it changed: */
+	if(changed)
+		updateNodeBox(level,index);
+	
+	return changed;
+	}
+
+void Group::drawChunks(unsigned int level,size_t index,bool highlight,Scalar cycle,RenderState& renderState) const
+	{
+	/* Bail out if the node's box, extended by half the group's maximum line width, is outside the view box: */
+	if(!renderState.isVisible(memberBounds[level][index],maxLineWidth*Scalar(0.5)))
+		return;
+	
+	if(level>0)
+		{
+		/* Draw the node's children in list order: */
+		const std::vector<Box>& below=memberBounds[level-1];
+		drawChunks(level-1,index*2,highlight,cycle,renderState);
+		if(index*2+1<below.size())
+			drawChunks(level-1,index*2+1,highlight,cycle,renderState);
+		}
+	else
+		{
+		/* Draw all potentially visible members of the chunk: */
+		const std::vector<SketchObject*>& chunk=chunks[index];
+		for(std::vector<SketchObject*>::const_iterator cIt=chunk.begin();cIt!=chunk.end();++cIt)
+			if(renderState.isVisible((*cIt)->getBoundingBox(),(*cIt)->getMaxLineWidth()*Scalar(0.5)))
+				{
+				if(highlight)
+					(*cIt)->glRenderActionHighlight(cycle,renderState);
+				else
+					(*cIt)->glRenderAction(renderState);
+				}
+		}
+	}
+
+Group::Group(void)
+	:maxLineWidth(0),
+	 memberBoundsValid(false),ruboutChunk(0),membersChanged(false)
+	{
+	}
+
 void Group::deinitClass(void)
 	{
 	}
 
+void* Group::operator new(size_t size)
+	{
+	/* Allocate from the pool unless the object is of a larger derived class: */
+	if(size==sizeof(Group))
+		return pool.allocate();
+	else
+		return ::operator new(size);
+	}
+
+void Group::operator delete(void* object,size_t size)
+	{
+	if(size==sizeof(Group))
+		pool.release(object);
+	else
+		::operator delete(object);
+	}
+
 unsigned int Group::getTypeCode(void) const
 	{
 	return typeCode;
 	}
 
+Scalar Group::getMaxLineWidth(void) const
+	{
+	return maxLineWidth;
+	}
+
+size_t Group::getMemorySize(void) const
+	{
+	/* Account for the group and all its members: */
+	size_t result=sizeof(Group);
+	for(SketchObjectList::const_iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
+		result+=soIt->getMemorySize();
+	
+	return result;
+	}
+
 bool Group::pick(SketchObject::PickResult& result)
 	{
-	/* Pick all members of the group: */
-	bool childPicked=false;
-	for(SketchObjectList::iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
-		childPicked=soIt->pick(result)||childPicked;
+	/* Bail out if the pick sphere misses the group's bounding box: */
+	if(sqrDist(boundingBox,result.center)>=result.radius2)
+		return false;
+	
+	/* Pick all members of the group in chunks close to the pick sphere: */
+	updateMemberBounds();
+	bool childPicked=!memberBounds.back().empty()&&pickChunks(result,memberBounds.size()-1,0);
 	
 	/* Set the group as the picked object if one of the members was picked: */
 	if(childPicked)
@@ -81,9 +324,13 @@ SketchObject* Group::clone(void) const
 
 void Group::applySettings(const SketchSettings& settings)
 	{
-	/* Apply settings to all members of the group: */
+	/* Apply settings to all members of the group and re-calculate the maximum line width: */
+	maxLineWidth=Scalar(0);
 	for(SketchObjectList::iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
+		{
 		soIt->applySettings(settings);
+		maxLineWidth=Math::max(maxLineWidth,soIt->getMaxLineWidth());
+		}
 	}
 
 void Group::transform(const Transformation& transform)
@@ -95,6 +342,10 @@ void Group::transform(const Transformation& transform)
 		soIt->transform(transform);
 		boundingBox.addBox(soIt->getBoundingBox());
 		}
+	
+	/* Re-calculate the member bounding box hierarchy: */
+	memberBoundsValid=false;
+	updateMemberBounds();
 	}
 
 void Group::snapToGrid(Scalar gridSize)
@@ -106,26 +357,33 @@ void Group::snapToGrid(Scalar gridSize)
 		soIt->snapToGrid(gridSize);
 		boundingBox.addBox(soIt->getBoundingBox());
 		}
+	
+	/* Re-calculate the member bounding box hierarchy: */
+	memberBoundsValid=false;
+	updateMemberBounds();
+	}
+
+bool Group::isErased(const Capsule& eraser)
+	{
+	/* Bail out if the eraser misses the group: */
+	if(!eraser.doesIntersect(boundingBox))
+		return false;
+	
+	/* Check all members of the group in chunks whose bounding boxes touch the eraser capsule: */
+	updateMemberBounds();
+	return !memberBounds.back().empty()&&isErased(eraser,memberBounds.size()-1,0);
 	}
 
 void Group::rubout(const Capsule& eraser,SketchObjectContainer& container)
 	{
-	#if 0
+	/* Bail out if the eraser misses the group: */
+	if(!eraser.doesIntersect(boundingBox))
+		return;
 	
-	/* Rub out all members of the group whose bounding boxes touch the eraser capsule: */
-	SketchObjectList::iterator soIt=sketchObjects.begin();
-	while(soIt!=sketchObjects.end())
-		{
-		/* Get an iterator to the next object: */
-		SketchObjectList::iterator nextIt=soIt;
-		++nextIt;
-		
-		if(eraser.doesIntersect(soIt->getBoundingBox()))
-			soIt->rubout(eraser,*this);
-		
-		/* Go to the next object: */
-		soIt=nextIt;
-		}
+	/* Rub out all members of the group in chunks whose bounding boxes touch the eraser capsule: */
+	updateMemberBounds();
+	if(memberBounds.back().empty()||!ruboutChunks(eraser,memberBounds.size()-1,0))
+		return;
 	
 	/* Check if the group became empty: */
 	if(sketchObjects.empty())
@@ -135,19 +393,16 @@ void Group::rubout(const Capsule& eraser,SketchObjectContainer& container)
 		}
 	else
 		{
-		/* Re-calculate the group's bounding box: */
-		boundingBox=Box::empty;
-		for(SketchObjectList::iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
-			boundingBox.addBox(soIt->getBoundingBox());
+		/* Take the group's bounding box from the updated root of the bounding box hierarchy and notify the container that the group changed: */
+		boundingBox=memberBounds.back().front();
+		container.update(this);
 		}
-	
-	#endif
 	}
 
 void Group::write(IO::File& file,const SketchObjectCreator& creator) const
 	{
 	/* Write the number of group members: */
-	file.write<Misc::UInt16>(sketchObjects.size());
+	file.write<Misc::UInt32>(sketchObjects.size());
 	
 	/* Write all members of the group: */
 	for(SketchObjectList::const_iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
@@ -159,38 +414,69 @@ void Group::write(IO::File& file,const SketchObjectCreator& creator) const
 
 void Group::read(IO::File& file,SketchObjectCreator& creator)
 	{
-	/* Read the number of group members: */
-	size_t numMembers=file.read<Misc::UInt16>();
+	/* Read the number of group members; version 1 files use 16-bit member counts: */
+	size_t numMembers=creator.getFileVersion()>=2?size_t(file.read<Misc::UInt32>()):size_t(file.read<Misc::UInt16>());
 	
-	/* Read all members of the group and calculate a new bounding box: */
+	/* Read all members of the group and calculate a new bounding box and maximum line width: */
 	SketchObjectList newSketchObjects;
 	Box newBoundingBox=Box::empty;
+	Scalar newMaxLineWidth(0);
 	for(size_t i=0;i<numMembers;++i)
 		{
-		/* Read the new member: */
+		/* Read the new member and skip it if it is of an unknown type: */
 		SketchObject* newMember=creator.readObject(file);
+		if(newMember==0)
+			continue;
 		
-		/* Add the new member to the list and update the bounding box: */
+		/* Add the new member to the list and update the bounding box and maximum line width: */
 		newSketchObjects.push_back(newMember);
 		newBoundingBox.addBox(newMember->getBoundingBox());
+		newMaxLineWidth=Math::max(newMaxLineWidth,newMember->getMaxLineWidth());
 		}
 	
 	/* Install the new bounding box and member list: */
 	boundingBox=newBoundingBox;
+	maxLineWidth=newMaxLineWidth;
 	sketchObjects.clear();
 	newSketchObjects.transfer(sketchObjects);
+	memberBoundsValid=false;
+	}
+
+void Group::writeSVG(std::string& svg) const
+	{
+	/* Write all members of the group inside an SVG group: */
+	svg.append("<g>\n");
+	for(SketchObjectList::const_iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
+		soIt->writeSVG(svg);
+	svg.append("</g>\n");
+	}
+
+void Group::finishRead(void)
+	{
+	/* Finish reading all members of the group: */
+	for(SketchObjectList::iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
+		soIt->finishRead();
+	
+	/* Build the member bounding box hierarchy for culling: */
+	updateMemberBounds();
 	}
 
 void Group::glRenderAction(RenderState& renderState) const
 	{
-	/* Draw all members of the group: */
-	drawObjects(renderState);
+	/* Draw all members of the group, using the member bounding box hierarchy for culling if it is valid: */
+	if(!memberBoundsValid)
+		drawObjects(renderState);
+	else if(!memberBounds.back().empty())
+		drawChunks(memberBounds.size()-1,0,false,Scalar(0),renderState);
 	}
 
 void Group::glRenderActionHighlight(Scalar cycle,RenderState& renderState) const
 	{
-	/* Highlight all members of the group: */
-	drawObjectsHighlight(cycle,renderState);
+	/* Highlight all members of the group, using the member bounding box hierarchy for culling if it is valid: */
+	if(!memberBoundsValid)
+		drawObjectsHighlight(cycle,renderState);
+	else if(!memberBounds.back().empty())
+		drawChunks(memberBounds.size()-1,0,true,cycle,renderState);
 	}
 
 void Group::append(SketchObject* newObject)
@@ -198,8 +484,12 @@ void Group::append(SketchObject* newObject)
 	/* Call base class method: */
 	SketchObjectContainer::append(newObject);
 	
-	/* Add the new object to the bounding box: */
+	/* Add the new object to the bounding box and maximum line width: */
 	boundingBox.addBox(newObject->getBoundingBox());
+	maxLineWidth=Math::max(maxLineWidth,newObject->getMaxLineWidth());
+	
+	/* Invalidate the member bounding box hierarchy: */
+	memberBoundsValid=false;
 	}
 
 void Group::insertAfter(SketchObject* pred,SketchObject* newObject)
@@ -207,8 +497,55 @@ void Group::insertAfter(SketchObject* pred,SketchObject* newObject)
 	/* Call base class method: */
 	SketchObjectContainer::insertAfter(pred,newObject);
 	
-	/* Add the new object to the bounding box: */
+	/* Add the new object to the bounding box and maximum line width: */
 	boundingBox.addBox(newObject->getBoundingBox());
+	maxLineWidth=Math::max(maxLineWidth,newObject->getMaxLineWidth());
+	
+	if(ruboutChunk!=0)
+		{
+		/* Insert the remains of a rubbed-out member into its chunk after the member: */
+		std::vector<SketchObject*>::iterator cIt;
+		for(cIt=ruboutChunk->begin();cIt!=ruboutChunk->end()&&*cIt!=pred;++cIt)
+			;
+		if(cIt!=ruboutChunk->end())
+			++cIt;
+		ruboutChunk->insert(cIt,newObject);
+		}
+	else
+		{
+		/* Invalidate the member bounding box hierarchy: */
+		memberBoundsValid=false;
+		}
+	membersChanged=true;
+	}
+
+void Group::remove(SketchObject* object)
+	{
+	if(ruboutChunk!=0)
+		{
+		/* Remove a rubbed-out member from its chunk: */
+		for(std::vector<SketchObject*>::iterator cIt=ruboutChunk->begin();cIt!=ruboutChunk->end();++cIt)
+			if(*cIt==object)
+				{
+				ruboutChunk->erase(cIt);
+				break;
+				}
+		}
+	else
+		{
+		/* Invalidate the member bounding box hierarchy: */
+		memberBoundsValid=false;
+		}
+	membersChanged=true;
+	
+	/* Call base class method: */
+	SketchObjectContainer::remove(object);
+	}
+
+void Group::update(SketchObject* object)
+	{
+	/* Remember that a member changed; the bounding box hierarchy is updated after rubbing out: */
+	membersChanged=true;
 	}
 
 void Group::transferMembers(SketchObjectList& receiver)
@@ -216,4 +553,6 @@ void Group::transferMembers(SketchObjectList& receiver)
 	/* Transfer the list of sketch objects and reset the bounding box to empty: */
 	sketchObjects.transfer(receiver);
 	boundingBox=Box::empty;
+	maxLineWidth=Scalar(0);
+	memberBoundsValid=false;
 	}
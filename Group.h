@@ -23,9 +23,11 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef GROUP_INCLUDED
 #define GROUP_INCLUDED
 
+#include <stddef.h>
 #include <vector>
 
 #include "SketchObject.h"
+#include "ObjectPool.h"
 #include "SketchObjectContainer.h"
 
 class Group:public SketchObject,public SketchObjectContainer
@@ -35,28 +37,56 @@ class Group:public SketchObject,public SketchObjectContainer
 	/* Elements: */
 	private:
 	static unsigned int typeCode; // The group class's type code
+	static ObjectPool pool; // Pool of memory slots for group objects
+	
+	static const size_t numChunkMembers=16; // Number of group members per bounding box chunk when the bounding box hierarchy is built
+	
+	Scalar maxLineWidth; // Largest line width of any member of the group
+	std::vector<std::vector<SketchObject*> > chunks; // Group members split into chunks of consecutive members in list order
+	std::vector<std::vector<Box> > memberBounds; // Hierarchy of bounding boxes of group members; level 0 has one box per chunk of members, and each higher level merges pairs of boxes from the level below
+	bool memberBoundsValid; // Flag whether the member chunks and their bounding box hierarchy match the group's current members
+	std::vector<SketchObject*>* ruboutChunk; // Chunk whose members are currently being rubbed out, or null
+	bool membersChanged; // Flag whether any member notified the group of a change while being rubbed out
+	
+	/* Private methods: */
+	void updateMemberBounds(void); // Builds the member chunks and their bounding box hierarchy if they are invalid
+	void updateNodeBox(unsigned int level,size_t index); // Re-calculates the box of the given node of the bounding box hierarchy from the boxes below it
+	bool pickChunks(PickResult& result,unsigned int level,size_t index); // Picks the members of all chunks below the given node of the bounding box hierarchy
+	bool isErased(const Capsule& eraser,unsigned int level,size_t index); // Returns false if all members of all chunks below the given node of the bounding box hierarchy are guaranteed to be unchanged by the given eraser
+	bool ruboutChunks(const Capsule& eraser,unsigned int level,size_t index); // Rubs out the members of all chunks below the given node of the bounding box hierarchy; returns true if any members changed, were removed, or left remains
+	void drawChunks(unsigned int level,size_t index,bool highlight,Scalar cycle,RenderState& renderState) const; // Draws or highlights the potentially visible members of all chunks below the given node of the bounding box hierarchy in order
 	
 	/* Constructors and destructors: */
 	public:
 	static void initClass(unsigned int newTypeCode); // Initializes the group object class and assigns a unique type code
+	Group(void); // Creates an empty group
 	static void deinitClass(void); // De-initializes the group object class
+	static void* operator new(size_t size); // Allocates memory for a new group from the group pool
+	static void operator delete(void* object,size_t size); // Returns a destroyed group's memory to the group pool
 	
 	/* Methods from class SketchObject: */
 	virtual unsigned int getTypeCode(void) const;
+	virtual Scalar getMaxLineWidth(void) const;
+	virtual size_t getMemorySize(void) const;
 	virtual bool pick(PickResult& result);
 	virtual SketchObject* clone(void) const;
 	virtual void applySettings(const SketchSettings& settings);
 	virtual void transform(const Transformation& transform);
 	virtual void snapToGrid(Scalar gridSize);
+	virtual bool isErased(const Capsule& eraser);
 	virtual void rubout(const Capsule& eraser,SketchObjectContainer& container);
 	virtual void write(IO::File& file,const SketchObjectCreator& creator) const;
 	virtual void read(IO::File& file,SketchObjectCreator& creator);
+	virtual void writeSVG(std::string& svg) const;
+	virtual void finishRead(void);
 	virtual void glRenderAction(RenderState& renderState) const;
 	virtual void glRenderActionHighlight(Scalar cycle,RenderState& renderState) const;
 	
 	/* Methods from class SketchObjectContainer: */
 	virtual void append(SketchObject* newObject);
 	virtual void insertAfter(SketchObject* pred,SketchObject* newObject);
+	virtual void remove(SketchObject* object);
+	virtual void update(SketchObject* object);
 	
 	/* New methods: */
 	void transferMembers(SketchObjectList& receiver); // Appends all group members to the given list and clears the group
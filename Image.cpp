@@ -22,19 +22,70 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include "Image.h"
 
+#include <string.h>
+#include <stdio.h>
+#include <vector>
 #include <Misc/SizedTypes.h>
 #include <Misc/StandardMarshallers.h>
+#include <Misc/StdError.h>
+#include <IO/File.h>
 #include <Geometry/GeometryMarshallers.h>
 #include <GL/gl.h>
 #include <GL/GLColorTemplates.h>
-#include <GL/Extensions/GLARBTextureRectangle.h>
 #include <GL/GLGeometryWrappers.h>
 #include <GL/GLTransformationWrappers.h>
-#include <Images/ReadImageFile.h>
 
 #include "RenderState.h"
 #include "SketchSettings.h"
 #include "ImageRenderer.h"
+#include "SketchObjectCreator.h"
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+const char* getMimeType(const std::vector<char>& data) // Returns the MIME type of the given image file contents based on their signature
+	{
+	if(data.size()>=8&&memcmp(&data.front(),"\x89PNG\r\n\x1a\n",8)==0)
+		return "image/png";
+	if(data.size()>=3&&memcmp(&data.front(),"\xff\xd8\xff",3)==0)
+		return "image/jpeg";
+	if(data.size()>=4&&(memcmp(&data.front(),"II*\0",4)==0||memcmp(&data.front(),"MM\0*",4)==0))
+		return "image/tiff";
+	if(data.size()>=2&&data[0]=='P'&&data[1]>='1'&&data[1]<='6')
+		return "image/x-portable-anymap";
+	return "application/octet-stream";
+	}
+
+void appendBase64(std::string& string,const std::vector<char>& data) // Appends the base64 encoding of the given data to the given string
+	{
+	static const char digits[]="ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	string.reserve(string.size()+(data.size()+2)/3*4);
+	size_t i;
+	for(i=0;i+3<=data.size();i+=3)
+		{
+		unsigned int bits=((unsigned int)(Misc::UInt8(data[i]))<<16)|((unsigned int)(Misc::UInt8(data[i+1]))<<8)|(unsigned int)(Misc::UInt8(data[i+2]));
+		string.push_back(digits[(bits>>18)&0x3fU]);
+		string.push_back(digits[(bits>>12)&0x3fU]);
+		string.push_back(digits[(bits>>6)&0x3fU]);
+		string.push_back(digits[bits&0x3fU]);
+		}
+	if(i<data.size())
+		{
+		/* Pad the final incomplete group of bytes: */
+		unsigned int bits=(unsigned int)(Misc::UInt8(data[i]))<<16;
+		if(i+1<data.size())
+			bits|=(unsigned int)(Misc::UInt8(data[i+1]))<<8;
+		string.push_back(digits[(bits>>18)&0x3fU]);
+		string.push_back(digits[(bits>>12)&0x3fU]);
+		string.push_back(i+1<data.size()?digits[(bits>>6)&0x3fU]:'=');
+		string.push_back('=');
+		}
+	}
+
+}
 
 /******************************
 Static elements of class Image:
@@ -42,6 +93,7 @@ Static elements of class Image:
 
 unsigned int Image::typeCode=0;
 ImageRenderer* Image::renderer=0;
+ObjectPool Image::pool(sizeof(Image),16);
 
 /**********************
 Methods of class Image:
@@ -57,19 +109,11 @@ void Image::initClass(unsigned int newTypeCode)
 	}
 
 Image::Image(void)
-	:imageKey(~0x0U)
 	{
-	/* Reference the in-memory image file: */
-	imageFile.ref();
 	}
 
 Image::~Image(void)
 	{
-	/* Destroy the image texture: */
-	renderer->getTextureSet().deleteTexture(imageKey);
-	
-	/* Unreference the in-memory image file: */
-	imageFile.unref();
 	}
 
 void Image::deinitClass(void)
@@ -79,23 +123,67 @@ void Image::deinitClass(void)
 	renderer=0;
 	}
 
+void* Image::operator new(size_t size)
+	{
+	/* Allocate from the pool unless the object is of a larger derived class: */
+	if(size==sizeof(Image))
+		return pool.allocate();
+	else
+		return ::operator new(size);
+	}
+
+void Image::operator delete(void* object,size_t size)
+	{
+	if(size==sizeof(Image))
+		pool.release(object);
+	else
+		::operator delete(object);
+	}
+
+void Image::readImageFile(IO::File& file,size_t imageFileSize)
+	{
+	/* Read the source image file: */
+	std::vector<char> data(imageFileSize);
+	if(imageFileSize>0)
+		file.read(&data.front(),imageFileSize);
+	
+	/* Find an identical stored image, or load the image and build its pyramid, which happens in the background when loading sketch files: */
+	storedImage=ImageStore::insert(imageFileName,data);
+	}
+
 unsigned int Image::getTypeCode(void) const
 	{
 	return typeCode;
 	}
 
+Scalar Image::getMaxLineWidth(void) const
+	{
+	/* Images are not drawn with lines: */
+	return Scalar(0);
+	}
+
+size_t Image::getMemorySize(void) const
+	{
+	size_t result=sizeof(Image);
+	
+	/* Account for the image's source file unless other images share it; the decoded pyramid is not counted: */
+	if(!storedImage->isShared())
+		result+=storedImage->getData().size();
+	
+	return result;
+	}
+
 bool Image::pick(SketchObject::PickResult& result)
 	{
 	bool picked=false;
 	
 	/* Calculate the image's corner points and pick them: */
 	Point corners[4];
-	const Images::BaseImage& image=renderer->getTextureSet().getTexture(imageKey).getImage();
 	for(int i=0;i<4;++i)
 		{
 		/* Calculate the corner point in image space: */
 		for(int j=0;j<2;++j)
-			corners[i][j]=Scalar((i&(1<<j))!=0?image.getSize(j):0);
+			corners[i][j]=Scalar((i&(1<<j))!=0?getPyramid().getSize(j):0);
 		corners[i][2]=Scalar(0);
 		
 		/* Transform the corner point to sketch space: */
@@ -115,7 +203,7 @@ bool Image::pick(SketchObject::PickResult& result)
 	Point imgCenter=imageTransform.inverseTransform(result.center);
 	bool centerInside=true;
 	for(int i=0;i<2&&centerInside;++i)
-		centerInside=Scalar(0)<=imgCenter[i]&&imgCenter[i]<Scalar(image.getSize(i));
+		centerInside=Scalar(0)<=imgCenter[i]&&imgCenter[i]<Scalar(getPyramid().getSize(i));
 	if(centerInside)
 		picked=result.update(this,2,Scalar(0),result.center)||picked;
 	
@@ -127,22 +215,14 @@ SketchObject* Image::clone(void) const
 	/* Create a new Image object: */
 	Image* result=new Image;
 	
-	/* Copy the image's source image file: */
+	/* Share this image's stored source file and pyramid, which also shares its uploaded tiles: */
 	result->imageFileName=imageFileName;
-	imageFile.writeToSink(result->imageFile);
+	result->storedImage=storedImage;
 	
 	/* Copy this image's bounding box and transformation: */
 	result->boundingBox=boundingBox;
 	result->imageTransform=imageTransform;
 	
-	/* Clone this image's image data: */
-	Images::TextureSet& textureSet=renderer->getTextureSet();
-	const Images::TextureSet::Texture& texture=textureSet.getTexture(imageKey);
-	Images::TextureSet::Texture& resultTexture=textureSet.addTexture(texture.getImage(),texture.getTarget(),texture.getInternalFormat());
-	resultTexture.setWrapModes(texture.getWrapModes()[0],texture.getWrapModes()[1]);
-	resultTexture.setFilterModes(texture.getFilterModes()[0],texture.getFilterModes()[1]);
-	result->imageKey=resultTexture.getKey();
-	
 	return result;
 	}
 
@@ -156,13 +236,11 @@ void Image::transform(const Transformation& transform)
 	/* Pre-multiply the current image transformation and update the bounding box: */
 	imageTransform.leftMultiply(transform);
 	imageTransform.renormalize();
-	Images::TextureSet& textureSet=renderer->getTextureSet();
-	const Images::BaseImage& image=textureSet.getTexture(imageKey).getImage();
 	boundingBox=Box::empty;
 	boundingBox.addPoint(imageTransform.transform(Point(0,0,0)));
-	boundingBox.addPoint(imageTransform.transform(Point(image.getWidth(),0,0)));
-	boundingBox.addPoint(imageTransform.transform(Point(image.getWidth(),image.getHeight(),0)));
-	boundingBox.addPoint(imageTransform.transform(Point(0,image.getHeight(),0)));
+	boundingBox.addPoint(imageTransform.transform(Point(getPyramid().getSize(0),0,0)));
+	boundingBox.addPoint(imageTransform.transform(Point(getPyramid().getSize(0),getPyramid().getSize(1),0)));
+	boundingBox.addPoint(imageTransform.transform(Point(0,getPyramid().getSize(1),0)));
 	}
 
 void Image::snapToGrid(Scalar gridSize)
@@ -170,6 +248,12 @@ void Image::snapToGrid(Scalar gridSize)
 	/* Doesn't do anything */
 	}
 
+bool Image::isErased(const Capsule& eraser)
+	{
+	/* Images can not be erased: */
+	return false;
+	}
+
 void Image::rubout(const Capsule& eraser,SketchObjectContainer& container)
 	{
 	/* Doesn't do anything */
@@ -180,10 +264,19 @@ void Image::write(IO::File& file,const SketchObjectCreator& creator) const
 	/* Write the image file name: */
 	Misc::Marshaller<std::string>::write(imageFileName,file);
 	
-	/* Write the source image file: */
-	size_t imageFileSize=imageFile.getDataSize();
-	file.write<Misc::UInt32>(imageFileSize);
-	imageFile.writeToSink(file);
+	/* Write the source image file unless it was already written to the same sketch file, in which case write the index of the earlier copy: */
+	unsigned int imageIndex=0;
+	bool writeData=creator.writeImageData(storedImage.getPointer(),imageIndex);
+	file.write<Misc::UInt8>(writeData?1U:0U);
+	if(writeData)
+		{
+		const std::vector<char>& data=storedImage->getData();
+		file.write<Misc::UInt32>(data.size());
+		if(!data.empty())
+			file.write(&data.front(),data.size());
+		}
+	else
+		file.write<Misc::UInt32>(imageIndex);
 	
 	/* Write the image transformation: */
 	Misc::Marshaller<Transformation>::write(imageTransform,file);
@@ -194,24 +287,44 @@ void Image::read(IO::File& file,SketchObjectCreator& creator)
 	/* Read the image file name: */
 	imageFileName=Misc::Marshaller<std::string>::read(file);
 	
-	/* Read the source image file: */
-	size_t imageFileSize=file.read<Misc::UInt32>();
-	while(imageFileSize>0)
+	if(creator.getFileVersion()>=5)
 		{
-		void* readBuffer;
-		size_t readSize=file.readInBuffer(readBuffer,imageFileSize);
-		imageFile.writeRaw(readBuffer,readSize);
-		imageFileSize-=readSize;
+		/* Read the source image file if it was not already written to the same sketch file: */
+		if(file.read<Misc::UInt8>()!=0)
+			{
+			readImageFile(file,file.read<Misc::UInt32>());
+			creator.addReadImage(storedImage);
+			}
+		else
+			{
+			/* Retrieve the stored image by its index among the images read earlier from the same sketch file: */
+			storedImage=creator.getReadImage(file.read<Misc::UInt32>());
+			if(storedImage==0)
+				throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Image %s refers to missing image data",imageFileName.c_str());
+			}
+		}
+	else if(creator.getFileVersion()>=3)
+		{
+		/* Read the source image file's hash value and the source image file if it was not already written to the same sketch file: */
+		Misc::UInt64 imageHash=file.read<Misc::UInt64>();
+		if(file.read<Misc::UInt8>()!=0)
+			{
+			readImageFile(file,file.read<Misc::UInt32>());
+			creator.addReadImage(storedImage);
+			}
+		else
+			{
+			/* Find the stored image among the images read earlier from the same sketch file: */
+			storedImage=creator.findReadImage(imageHash);
+			if(storedImage==0)
+				throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Image %s refers to missing image data",imageFileName.c_str());
+			}
+		}
+	else
+		{
+		/* Read the source image file: */
+		readImageFile(file,file.read<Misc::UInt32>());
 		}
-	imageFile.flush();
-	
-	/* Load the image from the memory buffer: */
-	Images::BaseImage image=Images::readGenericImageFile(imageFile,Images::getImageFileFormat(imageFileName.c_str()));
-	
-	/* Add the image to the texture set: */
-	Images::TextureSet& textureSet=renderer->getTextureSet();
-	imageKey=textureSet.addTexture(image,GL_TEXTURE_RECTANGLE_ARB,image.getInternalFormat()).getKey();
-	textureSet.getTexture(imageKey).setFilterModes(GL_LINEAR,GL_LINEAR);
 	
 	/* Read the image transformation: */
 	imageTransform=Misc::Marshaller<Transformation>::read(file);
@@ -219,9 +332,30 @@ void Image::read(IO::File& file,SketchObjectCreator& creator)
 	/* Calculate the image bounding box: */
 	boundingBox=Box::empty;
 	boundingBox.addPoint(imageTransform.transform(Point(0,0,0)));
-	boundingBox.addPoint(imageTransform.transform(Point(image.getWidth(),0,0)));
-	boundingBox.addPoint(imageTransform.transform(Point(image.getWidth(),image.getHeight(),0)));
-	boundingBox.addPoint(imageTransform.transform(Point(0,image.getHeight(),0)));
+	boundingBox.addPoint(imageTransform.transform(Point(getPyramid().getSize(0),0,0)));
+	boundingBox.addPoint(imageTransform.transform(Point(getPyramid().getSize(0),getPyramid().getSize(1),0)));
+	boundingBox.addPoint(imageTransform.transform(Point(0,getPyramid().getSize(1),0)));
+	}
+
+void Image::writeSVG(std::string& svg) const
+	{
+	/* Map SVG's top-down image rows onto the image's pixel space, and the pixel space into the sketching plane: */
+	unsigned int width=getPyramid().getSize(0);
+	unsigned int height=getPyramid().getSize(1);
+	Point o=imageTransform.transform(Point(0,height,0));
+	Point x=imageTransform.transform(Point(1,height,0));
+	Point y=imageTransform.transform(Point(0,Scalar(height)-Scalar(1),0));
+	char buffer[256];
+	snprintf(buffer,sizeof(buffer),"<image width=\"%u\" height=\"%u\" preserveAspectRatio=\"none\" transform=\"matrix(%.7g %.7g %.7g %.7g %.7g %.7g)\"",width,height,double(x[0]-o[0]),double(x[1]-o[1]),double(y[0]-o[0]),double(y[1]-o[1]),double(o[0]),double(o[1]));
+	svg.append(buffer);
+	
+	/* Embed the source image file: */
+	const std::vector<char>& data=storedImage->getData();
+	svg.append(" xlink:href=\"data:");
+	svg.append(getMimeType(data));
+	svg.append(";base64,");
+	appendBase64(svg,data);
+	svg.append("\"/>\n");
 	}
 
 void Image::glRenderAction(RenderState& renderState) const
@@ -229,32 +363,14 @@ void Image::glRenderAction(RenderState& renderState) const
 	/* Select the image renderer: */
 	renderState.setRenderer(renderer);
 	
-	/* Retrieve the texture set's OpenGL state: */
-	Images::TextureSet::GLState* glState=renderer->getTextureSet().getGLState(renderState.contextData);
-	
-	/* Bind the image texture and enable its texture target: */
-	const Images::TextureSet::GLState::Texture& texture=glState->bindTexture(imageKey);
+	/* Replace fragment colors with texture colors: */
 	glTexEnvi(GL_TEXTURE_ENV,GL_TEXTURE_ENV_MODE,GL_REPLACE);
 	
-	/* Draw the image: */
+	/* Draw the image's visible tiles: */
 	glPushMatrix();
 	glMultMatrix(imageTransform);
-	
-	const Images::BaseImage& image=texture.getImage();
-	const GLfloat* texMin=texture.getTexCoordMin();
-	const GLfloat* texMax=texture.getTexCoordMax();
 	glColor4f(1.0f,1.0f,1.0f,1.0f);
-	glBegin(GL_QUADS);
-	glTexCoord2f(texMin[0],texMin[1]);
-	glVertex2i(0,0);
-	glTexCoord2f(texMax[0],texMin[1]);
-	glVertex2i(image.getSize(0),0);
-	glTexCoord2f(texMax[0],texMax[1]);
-	glVertex2i(image.getSize(0),image.getSize(1));
-	glTexCoord2f(texMin[0],texMax[1]);
-	glVertex2i(0,image.getSize(1));
-	glEnd();
-	
+	renderer->draw(getPyramid(),imageTransform,renderState);
 	glPopMatrix();
 	}
 
@@ -263,17 +379,13 @@ void Image::glRenderActionHighlight(Scalar cycle,RenderState& renderState) const
 	/* Select the image renderer: */
 	renderState.setRenderer(renderer);
 	
-	/* Retrieve the texture set's OpenGL state: */
-	Images::TextureSet::GLState* glState=renderer->getTextureSet().getGLState(renderState.contextData);
-	
 	/* Calculate a highlight color: */
 	GLfloat highlight[4];
 	for(int i=0;i<3;++i)
 		highlight[i]=cycle>=Scalar(0)?1.0f:0.0f;
 	highlight[3]=float(Math::abs(cycle));
 	
-	/* Bind the image texture and enable its texture target: */
-	const Images::TextureSet::GLState::Texture& texture=glState->bindTexture(imageKey);
+	/* Blend texture colors with the highlight color: */
 	glTexEnvi(GL_TEXTURE_ENV,GL_TEXTURE_ENV_MODE,GL_COMBINE);
 	glTexEnvi(GL_TEXTURE_ENV,GL_COMBINE_RGB,GL_INTERPOLATE);
 	glTexEnvi(GL_TEXTURE_ENV,GL_SOURCE0_RGB,GL_CONSTANT);
@@ -281,24 +393,10 @@ void Image::glRenderActionHighlight(Scalar cycle,RenderState& renderState) const
 	glTexEnvi(GL_TEXTURE_ENV,GL_SOURCE2_ALPHA,GL_CONSTANT);
 	glTexEnvfv(GL_TEXTURE_ENV,GL_TEXTURE_ENV_COLOR,highlight);
 	
-	/* Draw the image: */
+	/* Draw the image's visible tiles: */
 	glPushMatrix();
 	glMultMatrix(imageTransform);
-	
-	const Images::BaseImage& image=texture.getImage();
-	const GLfloat* texMin=texture.getTexCoordMin();
-	const GLfloat* texMax=texture.getTexCoordMax();
-	glBegin(GL_QUADS);
-	glTexCoord2f(texMin[0],texMin[1]);
-	glVertex2i(0,0);
-	glTexCoord2f(texMax[0],texMin[1]);
-	glVertex2i(image.getSize(0),0);
-	glTexCoord2f(texMax[0],texMax[1]);
-	glVertex2i(image.getSize(0),image.getSize(1));
-	glTexCoord2f(texMin[0],texMax[1]);
-	glVertex2i(0,image.getSize(1));
-	glEnd();
-	
+	renderer->draw(getPyramid(),imageTransform,renderState);
 	glPopMatrix();
 	}
 
@@ -306,31 +404,19 @@ void Image::glRenderActionHighlight(Scalar cycle,RenderState& renderState) const
 Methods of class ImageFactory:
 *****************************/
 
-ImageFactory::ImageFactory(SketchSettings& sSettings,const char* imageFileName,IO::File& imageFile)
+ImageFactory::ImageFactory(SketchSettings& sSettings,const std::string& imageFileName,const ImageStore::EntryPtr& storedImage)
 	:SketchObjectFactory(sSettings),
 	 next(new Image),
 	 current(0),
 	 orientation(Transformation::Rotation::identity)
 	{
-	/* Read the (compressed) image file into the next image's memory buffer: */
+	/* Share the stored image, which was decoded in the background: */
 	next->imageFileName=imageFileName;
-	void* readBuffer;
-	size_t readSize;
-	while((readSize=imageFile.readInBuffer(readBuffer))!=0)
-		next->imageFile.writeRaw(readBuffer,readSize);
-	next->imageFile.flush();
-	
-	/* Load the image from the memory buffer: */
-	Images::BaseImage nextImage=Images::readGenericImageFile(next->imageFile,Images::getImageFileFormat(next->imageFileName.c_str()));
-	
-	/* Add the image to the texture set: */
-	Images::TextureSet& textureSet=Image::renderer->getTextureSet();
-	next->imageKey=textureSet.addTexture(nextImage,GL_TEXTURE_RECTANGLE_ARB,GL_RGB8).getKey();
-	textureSet.getTexture(next->imageKey).setFilterModes(GL_LINEAR,GL_LINEAR);
+	next->storedImage=storedImage;
 	
 	/* Get the image size: */
 	for(int i=0;i<2;++i)
-		size[i]=Scalar(nextImage.getSize(i));
+		size[i]=Scalar(next->getPyramid().getSize(i));
 	}
 
 ImageFactory::~ImageFactory(void)
@@ -23,12 +23,13 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef IMAGE_INCLUDED
 #define IMAGE_INCLUDED
 
+#include <stddef.h>
 #include <string>
-#include <IO/VariableMemoryFile.h>
-#include <Images/TextureSet.h>
 
 #include "SketchGeometry.h"
 #include "SketchObject.h"
+#include "ObjectPool.h"
+#include "ImageStore.h"
 
 /* Forward declarations: */
 class ImageRenderer;
@@ -41,28 +42,41 @@ class Image:public SketchObject
 	/* Elements: */
 	static unsigned int typeCode; // The image class's type code
 	static ImageRenderer* renderer; // A renderer to render images
+	static ObjectPool pool; // Pool of memory slots for image objects
 	std::string imageFileName; // Original name of the image file
-	IO::VariableMemoryFile imageFile; // In-memory file containing the (compressed) image data
-	Images::TextureSet::Key imageKey; // Key to retrieve image's image data
+	ImageStore::EntryPtr storedImage; // The image's source file and decoded pyramid, shared between all images with identical contents
 	Transformation imageTransform; // Transformation from image's pixel space into sketch environment
 	
+	/* Private methods: */
+	const ImagePyramid& getPyramid(void) const // Returns the pyramid of the decoded image
+		{
+		return *storedImage->getPyramid();
+		}
+	void readImageFile(IO::File& file,size_t imageFileSize); // Reads the given number of bytes of the image's source file from the given file and stores the image
+	
 	/* Constructors and destructors: */
 	static void initClass(unsigned int newTypeCode); // Initializes the image object class and assigns a unique type code
 	Image(void); // Creates an empty image
 	virtual ~Image(void); // Destroys the image
 	static void deinitClass(void); // De-initializes the image object class
+	static void* operator new(size_t size); // Allocates memory for a new image from the image pool
+	static void operator delete(void* object,size_t size); // Returns a destroyed image's memory to the image pool
 	
 	/* Methods from SketchObject: */
 	public:
 	virtual unsigned int getTypeCode(void) const;
+	virtual Scalar getMaxLineWidth(void) const;
+	virtual size_t getMemorySize(void) const;
 	virtual bool pick(PickResult& result);
 	virtual SketchObject* clone(void) const;
 	virtual void applySettings(const SketchSettings& settings);
 	virtual void transform(const Transformation& transform);
 	virtual void snapToGrid(Scalar gridSize);
+	virtual bool isErased(const Capsule& eraser);
 	virtual void rubout(const Capsule& eraser,SketchObjectContainer& container);
 	virtual void write(IO::File& file,const SketchObjectCreator& creator) const;
 	virtual void read(IO::File& file,SketchObjectCreator& creator);
+	virtual void writeSVG(std::string& svg) const;
 	virtual void glRenderAction(RenderState& renderState) const;
 	virtual void glRenderActionHighlight(Scalar cycle,RenderState& renderState) const;
 	};
@@ -79,7 +93,7 @@ class ImageFactory:public SketchObjectFactory
 	
 	/* Constructors and destructors: */
 	public:
-	ImageFactory(SketchSettings& sSettings,const char* imageFileName,IO::File& imageFile);
+	ImageFactory(SketchSettings& sSettings,const std::string& imageFileName,const ImageStore::EntryPtr& storedImage); // Creates a factory for images showing the given stored image, which was loaded from the image file of the given name
 	virtual ~ImageFactory(void);
 	
 	/* Methods from SketchObjectFactory: */
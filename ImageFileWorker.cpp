@@ -0,0 +1,94 @@
+/***********************************************************************
+ImageFileWorker - Class to read and decode image files and build their
+pyramids in a background thread while the main thread keeps rendering.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "ImageFileWorker.h"
+
+#include <vector>
+#include <stdexcept>
+#include <Vrui/Vrui.h>
+
+/********************************
+Methods of class ImageFileWorker:
+********************************/
+
+void* ImageFileWorker::workerThreadMethod(void)
+	{
+	std::string newError;
+	try
+		{
+		/* Read the (compressed) image file into a memory buffer: */
+		std::vector<char> data;
+		void* readBuffer;
+		size_t readSize;
+		while((readSize=file->readInBuffer(readBuffer))!=0)
+			data.insert(data.end(),static_cast<char*>(readBuffer),static_cast<char*>(readBuffer)+readSize);
+		
+		/* Find an identical stored image, or decode the image and build its pyramid: */
+		storedImage=ImageStore::insert(fileName,data);
+		}
+	catch(const std::runtime_error& err)
+		{
+		newError=err.what();
+		}
+	
+	/* Close the file: */
+	file=0;
+	
+	/* Mark the operation as finished: */
+	{
+	Threads::Mutex::Lock stateLock(stateMutex);
+	finished=true;
+	error=newError;
+	}
+	
+	/* Wake up the main thread to pick up the result: */
+	Vrui::requestUpdate();
+	
+	return 0;
+	}
+
+ImageFileWorker::ImageFileWorker(const std::string& sFileName,IO::FilePtr sFile)
+	:fileName(sFileName),file(sFile),
+	 finished(false)
+	{
+	/* Start the worker thread: */
+	workerThread.start(this,&ImageFileWorker::workerThreadMethod);
+	}
+
+ImageFileWorker::~ImageFileWorker(void)
+	{
+	/* Wait for the worker thread to finish: */
+	finish();
+	}
+
+bool ImageFileWorker::isFinished(void) const
+	{
+	Threads::Mutex::Lock stateLock(stateMutex);
+	return finished;
+	}
+
+void ImageFileWorker::finish(void)
+	{
+	if(!workerThread.isJoined())
+		workerThread.join();
+	}
@@ -0,0 +1,71 @@
+/***********************************************************************
+ImageFileWorker - Class to read and decode image files and build their
+pyramids in a background thread while the main thread keeps rendering.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef IMAGEFILEWORKER_INCLUDED
+#define IMAGEFILEWORKER_INCLUDED
+
+#include <string>
+#include <Threads/Mutex.h>
+#include <Threads/Thread.h>
+#include <IO/File.h>
+
+#include "ImageStore.h"
+
+class ImageFileWorker
+	{
+	/* Elements: */
+	private:
+	std::string fileName; // Name of the image file for error messages and new image objects
+	IO::FilePtr file; // The image file being read; released by the worker thread when done
+	ImageStore::EntryPtr storedImage; // The stored image holding the image file's contents and decoded pyramid
+	Threads::Thread workerThread; // Thread reading and decoding the image file
+	mutable Threads::Mutex stateMutex; // Mutex protecting the worker's completion state
+	bool finished; // Flag if the worker thread finished its operation
+	std::string error; // Error message if the operation failed; empty on success
+	
+	/* Private methods: */
+	void* workerThreadMethod(void); // Method reading and decoding the image file in the worker thread
+	
+	/* Constructors and destructors: */
+	public:
+	ImageFileWorker(const std::string& sFileName,IO::FilePtr sFile); // Starts loading the given image file
+	~ImageFileWorker(void); // Waits for the worker thread to finish and destroys the worker
+	
+	/* Methods: */
+	const std::string& getFileName(void) const // Returns the name of the image file
+		{
+		return fileName;
+		}
+	bool isFinished(void) const; // Returns true if the worker thread finished its operation
+	void finish(void); // Waits for the worker thread to finish its operation
+	const std::string& getError(void) const // Returns the error message of a failed operation, or an empty string; only valid after finish()
+		{
+		return error;
+		}
+	const ImageStore::EntryPtr& getStoredImage(void) const // Returns the stored image; only valid after finish() if there was no error
+		{
+		return storedImage;
+		}
+	};
+
+#endif
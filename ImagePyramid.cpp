@@ -0,0 +1,88 @@
+/***********************************************************************
+ImagePyramid - Class to represent an image as a pyramid of successively
+downsampled levels that are split into tiles for rendering.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "ImagePyramid.h"
+
+/*************************************
+Static elements of class ImagePyramid:
+*************************************/
+
+Threads::Atomic<unsigned int> ImagePyramid::nextId(0);
+
+/*****************************
+Methods of class ImagePyramid:
+*****************************/
+
+ImagePyramid::ImagePyramid(const Images::BaseImage& sBase)
+	:id(nextId.postAdd(1)),
+	 base(sBase),
+	 pixelSize(base.getNumChannels()*base.getChannelSize())
+	{
+	/* Add the full-resolution image as the pyramid's base level: */
+	Level baseLevel;
+	for(int i=0;i<2;++i)
+		baseLevel.size[i]=base.getSize(i);
+	baseLevel.pixels=static_cast<const GLubyte*>(base.getPixels());
+	levels.push_back(baseLevel);
+	
+	/* Only downsample images with 8-bit channels: */
+	if(base.getScalarType()!=GL_UNSIGNED_BYTE||base.getChannelSize()!=1)
+		return;
+	
+	/* Calculate the sizes of all downsampled levels until a level fits into a single tile: */
+	size_t totalSize=0;
+	while(levels.back().size[0]>tileSize||levels.back().size[1]>tileSize)
+		{
+		Level level;
+		for(int i=0;i<2;++i)
+			level.size[i]=(levels.back().size[i]+1U)/2U;
+		level.pixels=0;
+		totalSize+=size_t(level.size[0])*size_t(level.size[1])*pixelSize;
+		levels.push_back(level);
+		}
+	if(levels.size()==1)
+		return;
+	
+	/* Downsample each level from the previous one with a 2x2 box filter: */
+	levelPixels.resize(totalSize);
+	GLubyte* lPtr=&levelPixels.front();
+	for(std::vector<Level>::iterator lIt=levels.begin()+1;lIt!=levels.end();++lIt)
+		{
+		const Level& source=lIt[-1];
+		lIt->pixels=lPtr;
+		size_t sourceStride=size_t(source.size[0])*pixelSize;
+		for(unsigned int y=0;y<lIt->size[1];++y)
+			{
+			/* Duplicate the last row or column of odd-sized source levels: */
+			const GLubyte* row0=source.pixels+size_t(y*2U)*sourceStride;
+			const GLubyte* row1=y*2U+1U<source.size[1]?row0+sourceStride:row0;
+			for(unsigned int x=0;x<lIt->size[0];++x)
+				{
+				size_t x0=size_t(x*2U)*pixelSize;
+				size_t x1=x*2U+1U<source.size[0]?x0+pixelSize:x0;
+				for(size_t c=0;c<pixelSize;++c,++lPtr)
+					*lPtr=GLubyte(((unsigned int)(row0[x0+c])+(unsigned int)(row0[x1+c])+(unsigned int)(row1[x0+c])+(unsigned int)(row1[x1+c])+2U)/4U);
+				}
+			}
+		}
+	}
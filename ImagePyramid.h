@@ -0,0 +1,98 @@
+/***********************************************************************
+ImagePyramid - Class to represent an image as a pyramid of successively
+downsampled levels that are split into tiles for rendering.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef IMAGEPYRAMID_INCLUDED
+#define IMAGEPYRAMID_INCLUDED
+
+#include <stddef.h>
+#include <vector>
+#include <Misc/RefCounted.h>
+#include <Misc/Autopointer.h>
+#include <Threads/Atomic.h>
+#include <GL/gl.h>
+#include <Images/BaseImage.h>
+
+class ImagePyramid:public Misc::RefCounted
+	{
+	/* Embedded classes: */
+	public:
+	struct Level // Structure representing one level of an image pyramid
+		{
+		/* Elements: */
+		public:
+		unsigned int size[2]; // Width and height of the level in pixels
+		const GLubyte* pixels; // Pointer to the level's pixels, stored row by row from the bottom without padding
+		};
+	
+	/* Elements: */
+	static const unsigned int tileSize=512; // Width and height of the tiles into which pyramid levels are split for rendering, in pixels
+	private:
+	static Threads::Atomic<unsigned int> nextId; // Identifier assigned to the next created image pyramid
+	unsigned int id; // Unique identifier of this image pyramid, shared by all images showing it
+	Images::BaseImage base; // The full-resolution image at the base of the pyramid
+	size_t pixelSize; // Size of a pixel in bytes
+	std::vector<Level> levels; // Pyramid levels from the full-resolution base to the coarsest level that fits into a single tile
+	std::vector<GLubyte> levelPixels; // Pixels of all downsampled levels
+	
+	/* Constructors and destructors: */
+	public:
+	ImagePyramid(const Images::BaseImage& sBase); // Creates a pyramid for the given image; only images with 8-bit channels are downsampled
+	private:
+	ImagePyramid(const ImagePyramid& source); // Prohibit copy constructor
+	ImagePyramid& operator=(const ImagePyramid& source); // Prohibit assignment operator
+	
+	/* Methods: */
+	public:
+	unsigned int getId(void) const // Returns the pyramid's unique identifier
+		{
+		return id;
+		}
+	const Images::BaseImage& getBase(void) const // Returns the full-resolution image
+		{
+		return base;
+		}
+	unsigned int getSize(int dimension) const // Returns the width or height of the full-resolution image in pixels
+		{
+		return levels[0].size[dimension];
+		}
+	size_t getPixelSize(void) const // Returns the size of a pixel in bytes
+		{
+		return pixelSize;
+		}
+	unsigned int getNumLevels(void) const // Returns the number of pyramid levels
+		{
+		return levels.size();
+		}
+	const Level& getLevel(unsigned int level) const // Returns the given pyramid level; level 0 is the full-resolution image
+		{
+		return levels[level];
+		}
+	unsigned int getNumTiles(unsigned int level,int dimension) const // Returns the number of tiles covering the given pyramid level along the given dimension
+		{
+		return (levels[level].size[dimension]+tileSize-1)/tileSize;
+		}
+	};
+
+typedef Misc::Autopointer<ImagePyramid> ImagePyramidPtr; // Type for pointers to reference-counted image pyramids
+
+#endif
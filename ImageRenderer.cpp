@@ -1,5 +1,5 @@
 /***********************************************************************
-ImageRenderer - Class to render images using 2D textures.
+ImageRenderer - Class to render images as pyramids of tiled 2D textures.
 Copyright (c) 2016-2025 Oliver Kreylos
 
 This file is part of the SketchPad vector drawing package.
@@ -20,9 +20,254 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 02111-1307 USA
 ***********************************************************************/
 
+
 #include "ImageRenderer.h"
 
+#include <Misc/HashTable.h>
+#include <Math/Math.h>
 #include <GL/gl.h>
+#include <GL/GLObject.h>
+#include <GL/GLContextData.h>
+#include <Vrui/Vrui.h>
+
+#include "RenderState.h"
+#include "ImagePyramid.h"
+
+/*********************************************
+Declaration of struct ImageRenderer::DataItem:
+*********************************************/
+
+struct ImageRenderer::DataItem:public GLObject::DataItem
+	{
+	/* Embedded classes: */
+	public:
+	struct TileKey // Structure identifying a tile of an image pyramid level
+		{
+		/* Elements: */
+		public:
+		unsigned int imageId; // Unique identifier of the image pyramid
+		unsigned int level; // Index of the pyramid level
+		unsigned int tile[2]; // Column and row of the tile in the pyramid level
+		
+		/* Constructors and destructors: */
+		TileKey(void)
+			:imageId(0),level(0)
+			{
+			tile[0]=tile[1]=0;
+			}
+		TileKey(unsigned int sImageId,unsigned int sLevel,unsigned int sTileX,unsigned int sTileY)
+			:imageId(sImageId),level(sLevel)
+			{
+			tile[0]=sTileX;
+			tile[1]=sTileY;
+			}
+		
+		/* Methods: */
+		bool operator==(const TileKey& other) const
+			{
+			return imageId==other.imageId&&level==other.level&&tile[0]==other.tile[0]&&tile[1]==other.tile[1];
+			}
+		bool operator!=(const TileKey& other) const
+			{
+			return imageId!=other.imageId||level!=other.level||tile[0]!=other.tile[0]||tile[1]!=other.tile[1];
+			}
+		static size_t hash(const TileKey& source,size_t tableSize) // Hash function for tile keys
+			{
+			return ((size_t(source.imageId)*31U+size_t(source.level))*4099U+size_t(source.tile[0])*257U+size_t(source.tile[1]))%tableSize;
+			}
+		};
+	
+	struct Tile // Structure representing a tile uploaded into a texture
+		{
+		/* Elements: */
+		public:
+		GLuint textureId; // ID of the texture object holding the tile
+		size_t memorySize; // Size of the texture image in bytes
+		unsigned int lastUsed; // Index of the frame during which the tile was last drawn
+		unsigned int origin[2]; // Position of the texture's lower-left pixel in the pyramid level, including a one-pixel border shared with adjacent tiles
+		unsigned int size[2]; // Width and height of the texture in pixels, including borders
+		};
+	
+	typedef Misc::HashTable<TileKey,Tile,TileKey> TileMap; // Type for hash tables mapping tile keys to uploaded tiles
+	
+	static const unsigned int maxNumUploads=8; // Maximum number of tiles uploaded per frame, to prevent hitches when zooming into large images
+	
+	/* Elements: */
+	TileMap tiles; // Map of uploaded tiles
+	size_t tileMemorySize; // Amount of texture memory currently occupied by uploaded tiles in bytes
+	double frameTime; // Application time of the current frame
+	unsigned int frameIndex; // Index of the current frame
+	unsigned int numUploads; // Number of tiles uploaded during the current frame
+	Scalar pixelSize; // Size of a display pixel in model coordinate units in the current rendering pass
+	
+	/* Constructors and destructors: */
+	DataItem(void);
+	virtual ~DataItem(void);
+	
+	/* Methods: */
+	void evict(size_t newMemorySize); // Deletes least recently used tiles that were not drawn during the current frame until a tile of the given size fits into texture memory
+	bool prepareTile(const ImagePyramid& pyramid,const TileKey& key,bool force); // Ensures that the given tile is uploaded; returns false if the tile could not be uploaded during the current frame unless forced
+	void drawTile(const ImagePyramid& pyramid,const TileKey& key); // Draws the given tile in the image pyramid's base pixel space if it is uploaded
+	};
+
+/*****************************************
+Methods of struct ImageRenderer::DataItem:
+*****************************************/
+
+ImageRenderer::DataItem::DataItem(void)
+	:tiles(101),
+	 tileMemorySize(0),
+	 frameTime(-1.0),frameIndex(0),numUploads(0),
+	 pixelSize(0)
+	{
+	}
+
+ImageRenderer::DataItem::~DataItem(void)
+	{
+	/* Delete all tile textures: */
+	for(TileMap::Iterator tIt=tiles.begin();!tIt.isFinished();++tIt)
+		glDeleteTextures(1,&tIt->getDest().textureId);
+	}
+
+void ImageRenderer::DataItem::evict(size_t newMemorySize)
+	{
+	while(tileMemorySize+newMemorySize>maxTileMemorySize)
+		{
+		/* Find the least recently used tile: */
+		TileKey lruKey;
+		unsigned int lruFrame=frameIndex;
+		for(TileMap::Iterator tIt=tiles.begin();!tIt.isFinished();++tIt)
+			if(lruFrame>tIt->getDest().lastUsed)
+				{
+				lruKey=tIt->getSource();
+				lruFrame=tIt->getDest().lastUsed;
+				}
+		
+		/* Bail out if all tiles are visible during the current frame: */
+		if(lruFrame==frameIndex)
+			break;
+		
+		/* Delete the tile: */
+		Tile& tile=tiles.getEntry(lruKey);
+		glDeleteTextures(1,&tile.textureId);
+		tileMemorySize-=tile.memorySize;
+		tiles.removeEntry(lruKey);
+		}
+	}
+
+bool ImageRenderer::DataItem::prepareTile(const ImagePyramid& pyramid,const ImageRenderer::DataItem::TileKey& key,bool force)
+	{
+	/* Check if the tile is already uploaded: */
+	TileMap::Iterator tIt=tiles.findEntry(key);
+	if(!tIt.isFinished())
+		{
+		tIt->getDest().lastUsed=frameIndex;
+		return true;
+		}
+	
+	/* Bail out if the upload budget for the current frame is exhausted: */
+	if(!force&&numUploads>=maxNumUploads)
+		return false;
+	
+	/* Calculate the tile's texture region, with a one-pixel border to blend seamlessly with adjacent tiles: */
+	const ImagePyramid::Level& level=pyramid.getLevel(key.level);
+	Tile tile;
+	for(int i=0;i<2;++i)
+		{
+		unsigned int min=key.tile[i]*ImagePyramid::tileSize;
+		unsigned int max=Math::min(min+ImagePyramid::tileSize+1U,level.size[i]);
+		tile.origin[i]=min>0U?min-1U:0U;
+		tile.size[i]=max-tile.origin[i];
+		}
+	tile.memorySize=size_t(tile.size[0])*size_t(tile.size[1])*pyramid.getPixelSize();
+	tile.lastUsed=frameIndex;
+	
+	/* Make room for the tile: */
+	evict(tile.memorySize);
+	
+	/* Select the tile's internal texture format: */
+	const Images::BaseImage& base=pyramid.getBase();
+	GLint internalFormat=base.getInternalFormat();
+	if(compressTiles&&base.getFormat()==GL_RGB)
+		internalFormat=GL_COMPRESSED_RGB;
+	else if(compressTiles&&base.getFormat()==GL_RGBA)
+		internalFormat=GL_COMPRESSED_RGBA;
+	
+	/* Upload the tile directly from the pyramid level: */
+	glGenTextures(1,&tile.textureId);
+	glBindTexture(GL_TEXTURE_2D,tile.textureId);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAX_LEVEL,0);
+	glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH,level.size[0]);
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS,tile.origin[0]);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS,tile.origin[1]);
+	glTexImage2D(GL_TEXTURE_2D,0,internalFormat,tile.size[0],tile.size[1],0,base.getFormat(),base.getScalarType(),level.pixels);
+	glPopClientAttrib();
+	
+	if(internalFormat!=base.getInternalFormat())
+		{
+		/* Query the tile's actual size if the driver compressed it: */
+		GLint compressed=GL_FALSE;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D,0,GL_TEXTURE_COMPRESSED,&compressed);
+		if(compressed)
+			{
+			GLint compressedSize=0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D,0,GL_TEXTURE_COMPRESSED_IMAGE_SIZE,&compressedSize);
+			tile.memorySize=size_t(compressedSize);
+			}
+		}
+	
+	/* Store the tile: */
+	tiles.setEntry(TileMap::Entry(key,tile));
+	tileMemorySize+=tile.memorySize;
+	++numUploads;
+	
+	return true;
+	}
+
+void ImageRenderer::DataItem::drawTile(const ImagePyramid& pyramid,const ImageRenderer::DataItem::TileKey& key)
+	{
+	TileMap::Iterator tIt=tiles.findEntry(key);
+	if(tIt.isFinished())
+		return;
+	const Tile& tile=tIt->getDest();
+	
+	/* Calculate the tile's extent in the pyramid level and the scale factors from the level to the base pixel space: */
+	const ImagePyramid::Level& level=pyramid.getLevel(key.level);
+	GLfloat min[2],max[2],scale[2];
+	for(int i=0;i<2;++i)
+		{
+		min[i]=GLfloat(key.tile[i]*ImagePyramid::tileSize);
+		max[i]=GLfloat(Math::min((key.tile[i]+1U)*ImagePyramid::tileSize,level.size[i]));
+		scale[i]=GLfloat(pyramid.getSize(i))/GLfloat(level.size[i]);
+		}
+	
+	/* Convert the tile's extent to texture coordinates: */
+	GLfloat texMin[2],texMax[2];
+	for(int i=0;i<2;++i)
+		{
+		texMin[i]=(min[i]-GLfloat(tile.origin[i]))/GLfloat(tile.size[i]);
+		texMax[i]=(max[i]-GLfloat(tile.origin[i]))/GLfloat(tile.size[i]);
+		}
+	
+	/* Draw the tile: */
+	glBindTexture(GL_TEXTURE_2D,tile.textureId);
+	glBegin(GL_QUADS);
+	glTexCoord2f(texMin[0],texMin[1]);
+	glVertex2f(min[0]*scale[0],min[1]*scale[1]);
+	glTexCoord2f(texMax[0],texMin[1]);
+	glVertex2f(max[0]*scale[0],min[1]*scale[1]);
+	glTexCoord2f(texMax[0],texMax[1]);
+	glVertex2f(max[0]*scale[0],max[1]*scale[1]);
+	glTexCoord2f(texMin[0],texMax[1]);
+	glVertex2f(min[0]*scale[0],max[1]*scale[1]);
+	glEnd();
+	}
 
 /**************************************
 Static elements of class ImageRenderer:
@@ -30,6 +275,8 @@ Static elements of class ImageRenderer:
 
 ImageRenderer* ImageRenderer::theRenderer=0;
 Threads::Atomic<unsigned int> ImageRenderer::refCount(0);
+size_t ImageRenderer::maxTileMemorySize=size_t(256)<<20;
+bool ImageRenderer::compressTiles=false;
 
 /******************************
 Methods of class ImageRenderer:
@@ -37,21 +284,38 @@ Methods of class ImageRenderer:
 
 void ImageRenderer::initContext(GLContextData& contextData) const
 	{
+	/* Create a context data item and associate it with this object: */
+	DataItem* dataItem=new DataItem;
+	contextData.addDataItem(this,dataItem);
 	}
 
-GLObject::DataItem* ImageRenderer::activate(GLContextData& contextData) const
+GLObject::DataItem* ImageRenderer::activate(RenderState& renderState) const
 	{
+	/* Retrieve the context data item: */
+	DataItem* dataItem=renderState.contextData.retrieveDataItem<DataItem>(this);
+	
+	/* Start a new frame if this is the first rendering pass at the current application time: */
+	if(dataItem->frameTime!=Vrui::getApplicationTime())
+		{
+		dataItem->frameTime=Vrui::getApplicationTime();
+		++dataItem->frameIndex;
+		dataItem->numUploads=0;
+		}
+	
+	/* Retrieve the render pass's pixel size in model coordinate units to select pyramid levels: */
+	dataItem->pixelSize=renderState.getPixelSize();
+	
 	/* Set up OpenGL state: */
 	glPushAttrib(GL_ENABLE_BIT|GL_TEXTURE_BIT);
-	glEnable(GL_TEXTURE_RECTANGLE_ARB);
+	glEnable(GL_TEXTURE_2D);
 	
-	return 0;
+	return dataItem;
 	}
 
 void ImageRenderer::deactivate(GLObject::DataItem* dataItem) const
 	{
 	/* Reset OpenGL state: */
-	glBindTexture(GL_TEXTURE_RECTANGLE_ARB,0);
+	glBindTexture(GL_TEXTURE_2D,0);
 	glPopAttrib();
 	}
 
@@ -73,3 +337,94 @@ void ImageRenderer::release(void)
 		theRenderer=0;
 		}
 	}
+
+void ImageRenderer::setMaxTileMemorySize(size_t newMaxTileMemorySize)
+	{
+	maxTileMemorySize=newMaxTileMemorySize;
+	}
+
+void ImageRenderer::setCompressTiles(bool newCompressTiles)
+	{
+	compressTiles=newCompressTiles;
+	}
+
+void ImageRenderer::draw(const ImagePyramid& pyramid,const Transformation& transform,RenderState& renderState) const
+	{
+	/* Retrieve the data item: */
+	DataItem* dataItem=static_cast<DataItem*>(renderState.getDataItem());
+	
+	/* Select the coarsest pyramid level whose pixels are not larger than display pixels: */
+	unsigned int level=0;
+	Scalar levelPixelSize=transform.getScaling();
+	while(level+1<pyramid.getNumLevels()&&levelPixelSize*Scalar(2)<=dataItem->pixelSize)
+		{
+		++level;
+		levelPixelSize*=Scalar(2);
+		}
+	
+	/* Find the range of tiles covering the visible part of the image: */
+	const ImagePyramid::Level& l=pyramid.getLevel(level);
+	unsigned int tileMin[2],tileMax[2];
+	for(int i=0;i<2;++i)
+		{
+		tileMin[i]=0;
+		tileMax[i]=pyramid.getNumTiles(level,i);
+		}
+	if(renderState.isCulling())
+		{
+		/* Transform the view box into the pyramid level's pixel space: */
+		const Box& viewBox=renderState.getViewBox();
+		Scalar min[2],max[2];
+		for(int corner=0;corner<4;++corner)
+			{
+			Point p=transform.inverseTransform(Point((corner&0x1)?viewBox.max[0]:viewBox.min[0],(corner&0x2)?viewBox.max[1]:viewBox.min[1],Scalar(0)));
+			for(int i=0;i<2;++i)
+				{
+				Scalar pl=p[i]*Scalar(l.size[i])/Scalar(pyramid.getSize(i));
+				if(corner==0||min[i]>pl)
+					min[i]=pl;
+				if(corner==0||max[i]<pl)
+					max[i]=pl;
+				}
+			}
+		
+		/* Limit the tile range to the transformed view box: */
+		for(int i=0;i<2;++i)
+			{
+			Scalar tMin=Math::floor(min[i]/Scalar(ImagePyramid::tileSize));
+			Scalar tMax=Math::floor(max[i]/Scalar(ImagePyramid::tileSize))+Scalar(1);
+			if(tMin>Scalar(tileMin[i]))
+				tileMin[i]=Math::min((unsigned int)(tMin),tileMax[i]);
+			if(tMax<Scalar(tileMax[i]))
+				tileMax[i]=tMax>Scalar(0)?(unsigned int)(tMax):0U;
+			}
+		}
+	
+	/* Upload visible tiles that are not yet resident, within the current frame's budget: */
+	bool complete=true;
+	for(unsigned int y=tileMin[1];y<tileMax[1];++y)
+		for(unsigned int x=tileMin[0];x<tileMax[0];++x)
+			if(!dataItem->prepareTile(pyramid,DataItem::TileKey(pyramid.getId(),level,x,y),false))
+				complete=false;
+	
+	if(!complete)
+		{
+		/* Draw the coarsest level underneath the missing tiles if it fits into a single tile: */
+		unsigned int coarsest=pyramid.getNumLevels()-1;
+		if(coarsest!=level&&pyramid.getNumTiles(coarsest,0)==1U&&pyramid.getNumTiles(coarsest,1)==1U)
+			{
+			DataItem::TileKey key(pyramid.getId(),coarsest,0,0);
+			dataItem->prepareTile(pyramid,key,true);
+			dataItem->drawTile(pyramid,key);
+			}
+		
+		/* Upload the remaining tiles during the next frames: */
+		renderState.setIncomplete();
+		Vrui::requestUpdate();
+		}
+	
+	/* Draw all resident visible tiles: */
+	for(unsigned int y=tileMin[1];y<tileMax[1];++y)
+		for(unsigned int x=tileMin[0];x<tileMax[0];++x)
+			dataItem->drawTile(pyramid,DataItem::TileKey(pyramid.getId(),level,x,y));
+	}
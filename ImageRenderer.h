@@ -1,5 +1,5 @@
 /***********************************************************************
-ImageRenderer - Class to render images using 2D textures.
+ImageRenderer - Class to render images as pyramids of tiled 2D textures.
 Copyright (c) 2016-2025 Oliver Kreylos
 
 This file is part of the SketchPad vector drawing package.
@@ -23,34 +23,42 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef IMAGERENDERER_INCLUDED
 #define IMAGERENDERER_INCLUDED
 
+#include <stddef.h>
 #include <Threads/Atomic.h>
-#include <Images/TextureSet.h>
 
+#include "SketchGeometry.h"
 #include "Renderer.h"
 
+/* Forward declarations: */
+class ImagePyramid;
+class RenderState;
+
 class ImageRenderer:public Renderer
 	{
-	/* Elements: */
+	/* Embedded classes: */
 	private:
+	struct DataItem; // Forward declaration of per-context data structure
+	
+	/* Elements: */
 	static ImageRenderer* theRenderer; // Singleton image rendering object
 	static Threads::Atomic<unsigned int> refCount; // Number of references to the singleton image rendering object
-	Images::TextureSet textureSet; // Texture set managing all current images
+	static size_t maxTileMemorySize; // Amount of texture memory in bytes that image tiles may occupy in each OpenGL context, unless more tiles are visible at once
+	static bool compressTiles; // Flag whether image tiles are stored in compressed texture formats chosen by the OpenGL driver
 	
 	/* Methods from class GLObject: */
 	virtual void initContext(GLContextData& contextData) const;
 	
 	/* Methods from class Renderer: */
 	public:
-	virtual GLObject::DataItem* activate(GLContextData& contextData) const;
+	virtual GLObject::DataItem* activate(RenderState& renderState) const;
 	virtual void deactivate(GLObject::DataItem* dataItem) const;
 	
 	/* New methods: */
 	static ImageRenderer* acquire(void); // Acquires a reference to the singleton rendering object
 	static void release(void); // Releases a reference to the singleton rendering object
-	Images::TextureSet& getTextureSet(void) // Returns the texture set
-		{
-		return textureSet;
-		}
+	static void setMaxTileMemorySize(size_t newMaxTileMemorySize); // Sets the amount of texture memory in bytes that image tiles may occupy in each OpenGL context
+	static void setCompressTiles(bool newCompressTiles); // Sets whether image tiles are stored in compressed texture formats; only affects tiles uploaded afterwards
+	void draw(const ImagePyramid& pyramid,const Transformation& transform,RenderState& renderState) const; // Draws the visible tiles of the given image pyramid, transformed from pixel space into the sketching environment, at the pyramid level matching the current display resolution
 	};
 
 #endif
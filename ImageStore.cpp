@@ -0,0 +1,147 @@
+/***********************************************************************
+ImageStore - Class to share the source files and decoded pyramids of
+images with identical contents between all image objects.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "ImageStore.h"
+
+#include <string.h>
+#include <IO/VariableMemoryFile.h>
+#include <Images/ReadImageFile.h>
+
+/*********************************
+Methods of class ImageStore::Entry:
+*********************************/
+
+ImageStore::Entry::Entry(Misc::UInt64 sHash,std::vector<char>& sData,ImagePyramidPtr sPyramid)
+	:refCount(0),hash(sHash),pyramid(sPyramid),registered(false)
+	{
+	data.swap(sData);
+	}
+
+void ImageStore::Entry::ref(void)
+	{
+	Threads::Mutex::Lock storeLock(mutex);
+	++refCount;
+	}
+
+void ImageStore::Entry::unref(void)
+	{
+	{
+	Threads::Mutex::Lock storeLock(mutex);
+	if(--refCount!=0)
+		return;
+	
+	/* Remove the stored image from the store so that it can no longer be found: */
+	if(registered)
+		entries.erase(hash);
+	}
+	
+	delete this;
+	}
+
+bool ImageStore::Entry::isShared(void) const
+	{
+	Threads::Mutex::Lock storeLock(mutex);
+	return refCount>1;
+	}
+
+/***********************************
+Static elements of class ImageStore:
+***********************************/
+
+Threads::Mutex ImageStore::mutex;
+ImageStore::EntryMap ImageStore::entries;
+
+/***************************
+Methods of class ImageStore:
+***************************/
+
+Misc::UInt64 ImageStore::hash(const std::vector<char>& data)
+	{
+	/* Calculate a 64-bit FNV-1a hash of the file contents: */
+	Misc::UInt64 result=0xcbf29ce484222325ULL;
+	for(std::vector<char>::const_iterator dIt=data.begin();dIt!=data.end();++dIt)
+		{
+		result^=Misc::UInt64((unsigned char)(*dIt));
+		result*=0x100000001b3ULL;
+		}
+	return result;
+	}
+
+ImageStore::EntryPtr ImageStore::adopt(ImageStore::Entry* entry)
+	{
+	/* Reference the stored image and remove the reference taken while holding the lock: */
+	EntryPtr result(entry);
+	entry->unref();
+	return result;
+	}
+
+ImageStore::EntryPtr ImageStore::insert(const std::string& imageFileName,std::vector<char>& data)
+	{
+	Misc::UInt64 dataHash=hash(data);
+	
+	/* Return an already stored image with identical contents: */
+	Entry* entry=0;
+	{
+	Threads::Mutex::Lock storeLock(mutex);
+	EntryMap::iterator eIt=entries.find(dataHash);
+	if(eIt!=entries.end()&&eIt->second->data==data)
+		{
+		entry=eIt->second;
+		++entry->refCount;
+		}
+	}
+	if(entry!=0)
+		return adopt(entry);
+	
+	/* Decode the image and build its pyramid without holding the lock, which happens in the background when loading sketch files: */
+	IO::VariableMemoryFile imageFile;
+	imageFile.ref();
+	if(!data.empty())
+		imageFile.writeRaw(&data.front(),data.size());
+	imageFile.flush();
+	ImagePyramidPtr pyramid=new ImagePyramid(Images::readGenericImageFile(imageFile,Images::getImageFileFormat(imageFileName.c_str())));
+	imageFile.unref();
+	
+	{
+	Threads::Mutex::Lock storeLock(mutex);
+	EntryMap::iterator eIt=entries.find(dataHash);
+	if(eIt!=entries.end()&&eIt->second->data==data)
+		{
+		/* Use the same image stored by another thread in the meantime: */
+		entry=eIt->second;
+		}
+	else
+		{
+		entry=new Entry(dataHash,data,pyramid);
+		if(eIt==entries.end())
+			{
+			/* Make the new image findable; an image whose hash value collides with another stored image's is shared only by cloning: */
+			entries[dataHash]=entry;
+			entry->registered=true;
+			}
+		}
+	++entry->refCount;
+	}
+	
+	return adopt(entry);
+	}
@@ -0,0 +1,94 @@
+/***********************************************************************
+ImageStore - Class to share the source files and decoded pyramids of
+images with identical contents between all image objects.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef IMAGESTORE_INCLUDED
+#define IMAGESTORE_INCLUDED
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <Misc/SizedTypes.h>
+#include <Misc/Autopointer.h>
+#include <Threads/Mutex.h>
+
+#include "ImagePyramid.h"
+
+class ImageStore
+	{
+	/* Embedded classes: */
+	public:
+	class Entry // Class for stored images; reference counted under the store's mutex
+		{
+		friend class ImageStore;
+		
+		/* Elements: */
+		private:
+		unsigned int refCount; // Number of references to the stored image
+		Misc::UInt64 hash; // Hash value of the image file's contents
+		std::vector<char> data; // Contents of the (compressed) image file
+		ImagePyramidPtr pyramid; // Pyramid of the decoded image
+		bool registered; // Flag whether the stored image can be found by its hash value
+		
+		/* Constructors and destructors: */
+		Entry(Misc::UInt64 sHash,std::vector<char>& sData,ImagePyramidPtr sPyramid); // Creates a stored image from the given file contents, which are swapped out, and decoded pyramid
+		Entry(const Entry& source); // Prohibit copy constructor
+		Entry& operator=(const Entry& source); // Prohibit assignment operator
+		
+		/* Methods: */
+		public:
+		void ref(void); // Adds a reference to the stored image
+		void unref(void); // Removes a reference from the stored image and destroys it when the last reference is removed
+		bool isShared(void) const; // Returns true if the stored image is referenced more than once
+		Misc::UInt64 getHash(void) const // Returns the hash value of the image file's contents
+			{
+			return hash;
+			}
+		const std::vector<char>& getData(void) const // Returns the contents of the (compressed) image file
+			{
+			return data;
+			}
+		const ImagePyramidPtr& getPyramid(void) const // Returns the pyramid of the decoded image
+			{
+			return pyramid;
+			}
+		};
+	
+	typedef Misc::Autopointer<Entry> EntryPtr; // Type for pointers to stored images
+	
+	/* Elements: */
+	private:
+	typedef std::map<Misc::UInt64,Entry*> EntryMap; // Type for maps from hash values to stored images
+	static Threads::Mutex mutex; // Mutex serializing access to the store from the main thread and background loaders
+	static EntryMap entries; // Map of stored images that are referenced by at least one image object
+	
+	/* Private methods: */
+	static EntryPtr adopt(Entry* entry); // Returns a pointer to the given stored image, which was referenced while holding the store's mutex, and removes that reference
+	
+	/* Methods: */
+	public:
+	static Misc::UInt64 hash(const std::vector<char>& data); // Returns the hash value of the given image file contents
+	static EntryPtr insert(const std::string& imageFileName,std::vector<char>& data); // Returns the stored image with the given file contents, which are swapped out; decodes and stores the image if it is not stored yet
+	};
+
+#endif
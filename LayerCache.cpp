@@ -0,0 +1,382 @@
+/***********************************************************************
+LayerCache - Class to cache the image of all sketch objects in each
+OpenGL context and redraw only the parts that changed.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "LayerCache.h"
+
+#include <vector>
+#include <Math/Math.h>
+#include <GL/gl.h>
+#include <GL/GLContextData.h>
+#include <GL/GLExtensionManager.h>
+#include <GL/GLTransformationWrappers.h>
+#include <GL/Extensions/GLEXTFramebufferObject.h>
+#include <Vrui/Vrui.h>
+#include <Vrui/DisplayState.h>
+
+#include "Stats.h"
+#include "RenderState.h"
+#include "SketchSettings.h"
+
+/******************************************
+Declaration of struct LayerCache::DataItem:
+******************************************/
+
+struct LayerCache::DataItem:public GLObject::DataItem
+	{
+	/* Embedded classes: */
+	public:
+	struct Layer // Structure for the cached image of all sketch objects as seen by one eye of one window
+		{
+		/* Elements: */
+		public:
+		const Vrui::VRWindow* window; // Window rendering the image
+		int eyeIndex; // Index of the eye for which the image is rendered
+		int size[2]; // Size of the window's viewport during the most recent frame
+		Vrui::PTransform pmv; // Projection and navigational modelview matrix during the most recent frame
+		GLuint textureId; // ID of the texture object holding the cached image
+		GLuint framebufferId; // ID of the framebuffer object rendering into the texture object
+		int textureSize[2]; // Size of the texture image
+		bool valid; // Flag whether the cached image shows all sketch objects as seen during the most recent frame
+		unsigned int version; // Version number of the spatial index of all sketch objects at the time the cached image was drawn
+		};
+	
+	/* Elements: */
+	bool supported; // Flag whether the OpenGL context supports rendering into textures
+	PFNGLBLENDFUNCSEPARATEPROC glBlendFuncSeparateProc; // Function to set separate blending functions for color and alpha
+	std::vector<Layer> layers; // List of cached images for all windows and eyes rendered in this context
+	
+	/* Constructors and destructors: */
+	DataItem(void);
+	virtual ~DataItem(void);
+	
+	/* Methods: */
+	Layer& getLayer(const Vrui::VRWindow* window,int eyeIndex); // Returns the cached image for the given window and eye, creating an empty image if none exists yet
+	bool prepareLayer(Layer& layer); // Ensures that the given cached image has a texture of the current viewport size; returns false if it could not be created
+	};
+
+/**************************************
+Methods of struct LayerCache::DataItem:
+**************************************/
+
+LayerCache::DataItem::DataItem(void)
+	:supported(GLEXTFramebufferObject::isSupported()),
+	 glBlendFuncSeparateProc(0)
+	{
+	if(supported)
+		{
+		/* Initialize the required extension and functions: */
+		GLEXTFramebufferObject::initExtension();
+		glBlendFuncSeparateProc=GLExtensionManager::getFunction<PFNGLBLENDFUNCSEPARATEPROC>("glBlendFuncSeparate");
+		supported=glBlendFuncSeparateProc!=0;
+		}
+	}
+
+LayerCache::DataItem::~DataItem(void)
+	{
+	/* Delete all framebuffer and texture objects: */
+	for(std::vector<Layer>::iterator lIt=layers.begin();lIt!=layers.end();++lIt)
+		{
+		if(lIt->framebufferId!=0)
+			glDeleteFramebuffersEXT(1,&lIt->framebufferId);
+		if(lIt->textureId!=0)
+			glDeleteTextures(1,&lIt->textureId);
+		}
+	}
+
+LayerCache::DataItem::Layer& LayerCache::DataItem::getLayer(const Vrui::VRWindow* window,int eyeIndex)
+	{
+	/* Find an existing cached image: */
+	for(std::vector<Layer>::iterator lIt=layers.begin();lIt!=layers.end();++lIt)
+		if(lIt->window==window&&lIt->eyeIndex==eyeIndex)
+			return *lIt;
+	
+	/* Create an empty cached image: */
+	Layer newLayer;
+	newLayer.window=window;
+	newLayer.eyeIndex=eyeIndex;
+	for(int i=0;i<2;++i)
+		{
+		newLayer.size[i]=0;
+		newLayer.textureSize[i]=0;
+		}
+	newLayer.textureId=0;
+	newLayer.framebufferId=0;
+	newLayer.valid=false;
+	newLayer.version=0;
+	layers.push_back(newLayer);
+	
+	return layers.back();
+	}
+
+bool LayerCache::DataItem::prepareLayer(LayerCache::DataItem::Layer& layer)
+	{
+	/* Bail out if the texture already has the current viewport size: */
+	if(layer.textureSize[0]==layer.size[0]&&layer.textureSize[1]==layer.size[1])
+		return true;
+	
+	/* Create the texture and framebuffer objects on first use: */
+	if(layer.textureId==0)
+		glGenTextures(1,&layer.textureId);
+	if(layer.framebufferId==0)
+		glGenFramebuffersEXT(1,&layer.framebufferId);
+	
+	/* Allocate the texture image; the image is drawn and read at matching pixel positions, so there is no need for filtering: */
+	glBindTexture(GL_TEXTURE_2D,layer.textureId);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAX_LEVEL,0);
+	glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA8,layer.size[0],layer.size[1],0,GL_RGBA,GL_UNSIGNED_BYTE,0);
+	glBindTexture(GL_TEXTURE_2D,0);
+	for(int i=0;i<2;++i)
+		layer.textureSize[i]=layer.size[i];
+	
+	/* Attach the texture to the framebuffer, and restore the current framebuffer binding: */
+	GLint currentFramebufferId;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT,&currentFramebufferId);
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,layer.framebufferId);
+	glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT,GL_COLOR_ATTACHMENT0_EXT,GL_TEXTURE_2D,layer.textureId,0);
+	bool result=glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT)==GL_FRAMEBUFFER_COMPLETE_EXT;
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,currentFramebufferId);
+	
+	return result;
+	}
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+bool getRedrawRegion(const Vrui::PTransform& pmv,const int size[2],const Box& changedBox,int region[4],Box& regionBox)
+	{
+	/* Project the changed box into the viewport: */
+	double min[2],max[2];
+	for(int corner=0;corner<4;++corner)
+		{
+		Vrui::PTransform::HVector p=pmv.transform(Vrui::PTransform::HVector((corner&0x1)?changedBox.max[0]:changedBox.min[0],(corner&0x2)?changedBox.max[1]:changedBox.min[1],0,1));
+		
+		/* Bail out if the corner is behind the eye: */
+		if(p[3]<=Vrui::Scalar(0))
+			return false;
+		
+		for(int i=0;i<2;++i)
+			{
+			double pp=(double(p[i]/p[3])+1.0)*0.5*double(size[i]);
+			if(corner==0||min[i]>pp)
+				min[i]=pp;
+			if(corner==0||max[i]<pp)
+				max[i]=pp;
+			}
+		}
+	
+	/* Round the projected box outwards to whole pixels, with a margin for antialiased edges, and clip it against the viewport: */
+	for(int i=0;i<2;++i)
+		{
+		double rMin=Math::max(Math::floor(min[i])-2.0,0.0);
+		double rMax=Math::min(Math::ceil(max[i])+2.0,double(size[i]));
+		if(rMin>=rMax)
+			{
+			/* The changed box is outside the viewport; nothing needs to be redrawn: */
+			region[2]=region[3]=0;
+			return true;
+			}
+		region[i]=int(rMin);
+		region[2+i]=int(rMax)-region[i];
+		}
+	
+	/* Project the region's corners back onto the sketching plane to find all objects that touch the redrawn pixels: */
+	regionBox=Box::empty;
+	for(int corner=0;corner<4;++corner)
+		{
+		Vrui::Scalar clip[2];
+		for(int i=0;i<2;++i)
+			clip[i]=Vrui::Scalar(region[i]+((corner&(0x1<<i))?region[2+i]:0))*Vrui::Scalar(2)/Vrui::Scalar(size[i])-Vrui::Scalar(1);
+		Vrui::Point p0=pmv.inverseTransform(Vrui::PTransform::HVector(clip[0],clip[1],-1,1)).toPoint();
+		Vrui::Point p1=pmv.inverseTransform(Vrui::PTransform::HVector(clip[0],clip[1],1,1)).toPoint();
+		
+		/* Bail out if the corner's view ray does not hit the sketching plane between the near and far planes: */
+		if(p0[2]==p1[2])
+			return false;
+		Vrui::Scalar w1=(Vrui::Scalar(0)-p0[2])/(p1[2]-p0[2]);
+		if(w1<Vrui::Scalar(0)||w1>Vrui::Scalar(1))
+			return false;
+		Vrui::Scalar w0=Vrui::Scalar(1)-w1;
+		regionBox.addPoint(Point(p0[0]*w0+p1[0]*w1,p0[1]*w0+p1[1]*w1,0));
+		}
+	
+	return true;
+	}
+
+}
+
+/***************************
+Methods of class LayerCache:
+***************************/
+
+LayerCache::LayerCache(void)
+	:enabled(true)
+	{
+	}
+
+void LayerCache::initContext(GLContextData& contextData) const
+	{
+	/* Create a context data item and associate it with this object: */
+	DataItem* dataItem=new DataItem;
+	contextData.addDataItem(this,dataItem);
+	}
+
+void LayerCache::setEnabled(bool newEnabled)
+	{
+	enabled=newEnabled;
+	}
+
+void LayerCache::draw(const SketchSettings& settings,const Box& viewBox,RenderState& renderState) const
+	{
+	/* Retrieve the context data item: */
+	DataItem* dataItem=renderState.contextData.retrieveDataItem<DataItem>(this);
+	
+	/* Draw directly if caching is disabled or unsupported, or if the sketching plane is not visible: */
+	if(!enabled||!dataItem->supported||viewBox.min[0]>viewBox.max[0]||viewBox.min[1]>viewBox.max[1])
+		{
+		settings.drawSketchObjects(viewBox,renderState);
+		return;
+		}
+	
+	/* Get the cached image for the current window and eye: */
+	const Vrui::DisplayState& ds=Vrui::getDisplayState(renderState.contextData);
+	DataItem::Layer& layer=dataItem->getLayer(ds.window,ds.eyeIndex);
+	
+	/* Check if the view changed since the previous frame: */
+	Vrui::PTransform pmv=ds.projection;
+	pmv*=Vrui::PTransform(ds.modelviewNavigational);
+	bool viewChanged=layer.size[0]!=ds.viewport.size[0]||layer.size[1]!=ds.viewport.size[1];
+	for(int i=0;i<4&&!viewChanged;++i)
+		for(int j=0;j<4&&!viewChanged;++j)
+			viewChanged=layer.pmv.getMatrix()(i,j)!=pmv.getMatrix()(i,j);
+	if(viewChanged)
+		{
+		/* Remember the new view and draw directly while the view keeps changing: */
+		for(int i=0;i<2;++i)
+			layer.size[i]=ds.viewport.size[i];
+		layer.pmv=pmv;
+		layer.valid=false;
+		settings.drawSketchObjects(viewBox,renderState);
+		return;
+		}
+	
+	/* Find the region of the cached image that needs to be redrawn: */
+	bool redrawAll=!layer.valid;
+	Box changedBox;
+	if(!redrawAll&&!settings.getIndex().getChanges(layer.version,changedBox))
+		redrawAll=true;
+	int region[4]={0,0,0,0};
+	Box regionBox=viewBox;
+	if(!redrawAll&&changedBox.min[0]<=changedBox.max[0]&&changedBox.min[1]<=changedBox.max[1])
+		redrawAll=!getRedrawRegion(pmv,layer.size,changedBox,region,regionBox);
+	if(redrawAll)
+		{
+		region[2]=layer.size[0];
+		region[3]=layer.size[1];
+		regionBox=viewBox;
+		}
+	
+	/* Finish any pending batched rendering before changing OpenGL state: */
+	renderState.setRenderer(0);
+	
+	if(region[2]>0&&region[3]>0)
+		{
+		/* Create or resize the cached image: */
+		if(!dataItem->prepareLayer(layer))
+			{
+			/* Disable caching in this context and draw directly: */
+			dataItem->supported=false;
+			settings.drawSketchObjects(viewBox,renderState);
+			return;
+			}
+		
+		/* Redirect rendering into the cached image and restrict it to the redrawn region: */
+		GLint currentFramebufferId;
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT,&currentFramebufferId);
+		glPushAttrib(GL_COLOR_BUFFER_BIT|GL_ENABLE_BIT|GL_SCISSOR_BIT|GL_VIEWPORT_BIT);
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,layer.framebufferId);
+		glViewport(0,0,layer.size[0],layer.size[1]);
+		glEnable(GL_SCISSOR_TEST);
+		glScissor(region[0],region[1],region[2],region[3]);
+		glDisable(GL_DEPTH_TEST);
+		
+		/* Clear the region to transparent and accumulate premultiplied colors, so that the cached image can later be blended over the background: */
+		glClearColor(0.0f,0.0f,0.0f,0.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		dataItem->glBlendFuncSeparateProc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA,GL_ONE,GL_ONE_MINUS_SRC_ALPHA);
+		
+		{
+		/* Draw all sketch objects touching the region with a separate render state: */
+		RenderState layerState(renderState.contextData);
+		settings.drawSketchObjects(regionBox,layerState);
+		layerState.setRenderer(0);
+		
+		/* Redraw the entire image during the next frame if some objects were not drawn at their final appearance: */
+		layer.valid=layerState.isComplete();
+		}
+		
+		/* Return to the current framebuffer: */
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,currentFramebufferId);
+		glPopAttrib();
+		
+		SKETCHPAD_STATS_COUNT(LayerRedrawPixels,(unsigned int)(region[2])*(unsigned int)(region[3]));
+		}
+	layer.version=settings.getIndex().getVersion();
+	
+	/* Blend the cached image over the visible part of the sketching plane, using the projected sketching plane position as texture coordinates: */
+	glPushAttrib(GL_COLOR_BUFFER_BIT|GL_ENABLE_BIT|GL_TEXTURE_BIT);
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D,layer.textureId);
+	glTexEnvi(GL_TEXTURE_ENV,GL_TEXTURE_ENV_MODE,GL_REPLACE);
+	glBlendFunc(GL_ONE,GL_ONE_MINUS_SRC_ALPHA);
+	
+	glMatrixMode(GL_TEXTURE);
+	glPushMatrix();
+	glLoadIdentity();
+	glTranslated(0.5,0.5,0.0);
+	glScaled(0.5,0.5,1.0);
+	glMultMatrix(pmv);
+	
+	glBegin(GL_QUADS);
+	glTexCoord4d(viewBox.min[0],viewBox.min[1],0.0,1.0);
+	glVertex3d(viewBox.min[0],viewBox.min[1],0.0);
+	glTexCoord4d(viewBox.max[0],viewBox.min[1],0.0,1.0);
+	glVertex3d(viewBox.max[0],viewBox.min[1],0.0);
+	glTexCoord4d(viewBox.max[0],viewBox.max[1],0.0,1.0);
+	glVertex3d(viewBox.max[0],viewBox.max[1],0.0);
+	glTexCoord4d(viewBox.min[0],viewBox.max[1],0.0,1.0);
+	glVertex3d(viewBox.min[0],viewBox.max[1],0.0);
+	glEnd();
+	
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	
+	glBindTexture(GL_TEXTURE_2D,0);
+	glPopAttrib();
+	}
@@ -0,0 +1,61 @@
+/***********************************************************************
+LayerCache - Class to cache the image of all sketch objects in each
+OpenGL context and redraw only the parts that changed.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef LAYERCACHE_INCLUDED
+#define LAYERCACHE_INCLUDED
+
+#include <GL/gl.h>
+#include <GL/GLObject.h>
+
+#include "SketchGeometry.h"
+
+/* Forward declarations: */
+class RenderState;
+class SketchSettings;
+
+class LayerCache:public GLObject
+	{
+	/* Embedded classes: */
+	private:
+	struct DataItem; // Forward declaration of per-context data structure
+	
+	/* Elements: */
+	bool enabled; // Flag whether sketch objects are drawn through the cache
+	
+	/* Constructors and destructors: */
+	public:
+	LayerCache(void); // Creates an enabled layer cache
+	
+	/* Methods from class GLObject: */
+	virtual void initContext(GLContextData& contextData) const;
+	
+	/* New methods: */
+	bool isEnabled(void) const // Returns true if sketch objects are drawn through the cache
+		{
+		return enabled;
+		}
+	void setEnabled(bool newEnabled); // Enables or disables the cache
+	void draw(const SketchSettings& settings,const Box& viewBox,RenderState& renderState) const; // Draws all sketch objects inside the given view bounding box, redrawing only those parts of the cached image that changed since the previous frame
+	};
+
+#endif
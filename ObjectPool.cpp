@@ -0,0 +1,171 @@
+/***********************************************************************
+ObjectPool - Class to allocate fixed-size memory slots for objects of a
+single class from contiguous slabs, with free-list reuse.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "ObjectPool.h"
+
+#include <stdlib.h>
+#include <new>
+
+/***************************
+Methods of class ObjectPool:
+***************************/
+
+void ObjectPool::link(ObjectPool::Slab*& list,ObjectPool::Slab* slab)
+	{
+	slab->pred=0;
+	slab->succ=list;
+	if(list!=0)
+		list->pred=slab;
+	list=slab;
+	}
+
+void ObjectPool::unlink(ObjectPool::Slab*& list,ObjectPool::Slab* slab)
+	{
+	if(slab->pred!=0)
+		slab->pred->succ=slab->succ;
+	else
+		list=slab->succ;
+	if(slab->succ!=0)
+		slab->succ->pred=slab->pred;
+	}
+
+ObjectPool::Slab* ObjectPool::addSlab(void)
+	{
+	/* Allocate a new slab aligned to its size: */
+	void* slabMemory=0;
+	if(posix_memalign(&slabMemory,slabSize,slabSize)!=0)
+		throw std::bad_alloc();
+	Slab* slab=static_cast<Slab*>(slabMemory);
+	slab->pred=slab->succ=0;
+	slab->numUsedSlots=0;
+	
+	/* Add the slab's slots to the slab's free list in order, so that consecutive allocations are adjacent in memory: */
+	char* slots=static_cast<char*>(slabMemory)+slotOffset;
+	slab->freeSlots=0;
+	for(size_t i=numSlabSlots;i>0;--i)
+		{
+		FreeSlot* slot=reinterpret_cast<FreeSlot*>(slots+(i-1)*slotSize);
+		slot->succ=slab->freeSlots;
+		slab->freeSlots=slot;
+		}
+	
+	return slab;
+	}
+
+void ObjectPool::freeSlabs(ObjectPool::Slab* list)
+	{
+	while(list!=0)
+		{
+		Slab* succ=list->succ;
+		free(list);
+		list=succ;
+		}
+	}
+
+ObjectPool::ObjectPool(size_t sObjectSize,size_t sNumSlabSlots)
+	:slotSize((sObjectSize+15)&~size_t(15)),
+	 slotOffset((sizeof(Slab)+15)&~size_t(15)),
+	 partialSlabs(0),fullSlabs(0),emptySlab(0),
+	 numAllocatedSlots(0)
+	{
+	if(slotSize<sizeof(FreeSlot))
+		slotSize=sizeof(FreeSlot);
+	
+	/* Round the slab size up to the next power of two, and fill any extra room with additional slots: */
+	size_t minSlabSize=slotOffset+slotSize*sNumSlabSlots;
+	for(slabSize=4096;slabSize<minSlabSize;slabSize<<=1)
+		;
+	numSlabSlots=(slabSize-slotOffset)/slotSize;
+	}
+
+ObjectPool::~ObjectPool(void)
+	{
+	/* Release all slabs: */
+	freeSlabs(partialSlabs);
+	freeSlabs(fullSlabs);
+	if(emptySlab!=0)
+		free(emptySlab);
+	}
+
+void* ObjectPool::allocate(void)
+	{
+	Threads::Spinlock::Lock lock(mutex);
+	
+	/* Take the kept empty slab or allocate a new one if there are no partially used slabs: */
+	if(partialSlabs==0)
+		{
+		Slab* slab=emptySlab;
+		emptySlab=0;
+		if(slab==0)
+			slab=addSlab();
+		link(partialSlabs,slab);
+		}
+	
+	/* Take the first unused slot of the first partially used slab: */
+	Slab* slab=partialSlabs;
+	FreeSlot* result=slab->freeSlots;
+	slab->freeSlots=result->succ;
+	++slab->numUsedSlots;
+	++numAllocatedSlots;
+	
+	/* Move the slab to the full list if it has no more unused slots: */
+	if(slab->freeSlots==0)
+		{
+		unlink(partialSlabs,slab);
+		link(fullSlabs,slab);
+		}
+	
+	return result;
+	}
+
+void ObjectPool::release(void* slot)
+	{
+	Threads::Spinlock::Lock lock(mutex);
+	
+	/* Find the slot's slab from the slot's address: */
+	Slab* slab=reinterpret_cast<Slab*>(reinterpret_cast<size_t>(slot)&~(slabSize-1));
+	
+	/* Move the slab back to the partial list if it was full, so that its unused slot is reused first: */
+	if(slab->freeSlots==0)
+		{
+		unlink(fullSlabs,slab);
+		link(partialSlabs,slab);
+		}
+	
+	/* Prepend the slot to the slab's free list: */
+	FreeSlot* freeSlot=static_cast<FreeSlot*>(slot);
+	freeSlot->succ=slab->freeSlots;
+	slab->freeSlots=freeSlot;
+	--slab->numUsedSlots;
+	--numAllocatedSlots;
+	
+	if(slab->numUsedSlots==0)
+		{
+		/* Keep the now-empty slab if no other empty slab is kept, and release it otherwise: */
+		unlink(partialSlabs,slab);
+		if(emptySlab==0)
+			emptySlab=slab;
+		else
+			free(slab);
+		}
+	}
@@ -0,0 +1,82 @@
+/***********************************************************************
+ObjectPool - Class to allocate fixed-size memory slots for objects of a
+single class from contiguous slabs, with free-list reuse.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef OBJECTPOOL_INCLUDED
+#define OBJECTPOOL_INCLUDED
+
+#include <stddef.h>
+#include <Threads/Spinlock.h>
+
+class ObjectPool
+	{
+	/* Embedded classes: */
+	private:
+	struct FreeSlot // Structure for unused slots
+		{
+		/* Elements: */
+		public:
+		FreeSlot* succ; // Pointer to the next unused slot in the same slab
+		};
+	
+	struct Slab // Structure for slab headers, stored at the beginning of each slab
+		{
+		/* Elements: */
+		public:
+		Slab* pred; // Pointer to the previous slab in the same slab list
+		Slab* succ; // Pointer to the next slab in the same slab list
+		FreeSlot* freeSlots; // Linked list of unused slots in this slab
+		size_t numUsedSlots; // Number of slots in this slab currently in use
+		};
+	
+	/* Elements: */
+	size_t slotSize; // Size of each slot in bytes, rounded up for alignment
+	size_t slabSize; // Size of each slab in bytes; a power of two, and slabs are aligned to their size to find a slot's slab
+	size_t slotOffset; // Offset of the first slot from the beginning of its slab, leaving room for the slab header
+	size_t numSlabSlots; // Number of slots in each slab
+	Threads::Spinlock mutex; // Mutex serializing access to the pool from the main thread and background loaders
+	Slab* partialSlabs; // List of slabs with used and unused slots, from which slots are allocated first
+	Slab* fullSlabs; // List of slabs without unused slots
+	Slab* emptySlab; // A slab without used slots kept to avoid releasing and re-allocating slabs repeatedly, or null
+	size_t numAllocatedSlots; // Number of slots currently in use
+	
+	/* Private methods: */
+	static void link(Slab*& list,Slab* slab); // Prepends the given slab to the given slab list
+	static void unlink(Slab*& list,Slab* slab); // Removes the given slab from the given slab list
+	Slab* addSlab(void); // Allocates a new slab and adds its slots to the slab's free list
+	void freeSlabs(Slab* list); // Releases all slabs in the given slab list
+	
+	/* Constructors and destructors: */
+	public:
+	ObjectPool(size_t sObjectSize,size_t sNumSlabSlots=256); // Creates an empty pool for objects of the given size, allocating at least the given number of slots in each slab
+	~ObjectPool(void); // Releases all slabs
+	
+	/* Methods: */
+	size_t getNumAllocatedSlots(void) const // Returns the number of slots currently in use
+		{
+		return numAllocatedSlots;
+		}
+	void* allocate(void); // Returns an unused slot, preferring slabs that already contain used slots
+	void release(void* slot); // Returns the given slot to the pool; releases the slot's slab if it became empty and another empty slab is already kept
+	};
+
+#endif
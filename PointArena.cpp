@@ -0,0 +1,77 @@
+/***********************************************************************
+PointArena - Shared arena allocating curve point storage in power-of-two
+size classes from large slabs, with per-class free-list reuse, and an
+STL allocator drawing from it.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "PointArena.h"
+
+#include "ObjectPool.h"
+
+/***********************************
+Static elements of class PointArena:
+***********************************/
+
+Threads::Spinlock PointArena::mutex;
+ObjectPool* PointArena::pools[PointArena::numSizeClasses]={0};
+
+/***************************
+Methods of class PointArena:
+***************************/
+
+ObjectPool& PointArena::getPool(unsigned int sizeClass)
+	{
+	Threads::Spinlock::Lock lock(mutex);
+	
+	/* Create the size class's pool on first use, with as many chunks per slab as fit into one slab including the slab header: */
+	if(pools[sizeClass]==0)
+		{
+		unsigned int chunkSizeLog=sizeClass+minSizeClassLog;
+		pools[sizeClass]=new ObjectPool(size_t(1)<<chunkSizeLog,(slabSize>>chunkSizeLog)-1);
+		}
+	
+	return *pools[sizeClass];
+	}
+
+void* PointArena::allocate(size_t size)
+	{
+	/* Pass requests that are too large to the system allocator: */
+	unsigned int sizeClass=getSizeClass(size);
+	if(sizeClass>=numSizeClasses)
+		return ::operator new(size);
+	
+	/* Allocate a chunk from the size class's pool: */
+	return getPool(sizeClass).allocate();
+	}
+
+void PointArena::release(void* chunk,size_t size)
+	{
+	/* Return chunks that are too large to the system allocator: */
+	unsigned int sizeClass=getSizeClass(size);
+	if(sizeClass>=numSizeClasses)
+		{
+		::operator delete(chunk);
+		return;
+		}
+	
+	/* Return the chunk to the size class's pool: */
+	getPool(sizeClass).release(chunk);
+	}
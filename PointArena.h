@@ -0,0 +1,138 @@
+/***********************************************************************
+PointArena - Shared arena allocating curve point storage in power-of-two
+size classes from large slabs, with per-class free-list reuse, and an
+STL allocator drawing from it.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef POINTARENA_INCLUDED
+#define POINTARENA_INCLUDED
+
+#include <stddef.h>
+#include <new>
+#include <vector>
+#include <Threads/Spinlock.h>
+
+#include "SketchGeometry.h"
+
+/* Forward declarations: */
+class ObjectPool;
+
+class PointArena
+	{
+	/* Elements: */
+	private:
+	static const unsigned int minSizeClassLog=6; // Binary logarithm of the smallest chunk size, 64 bytes
+	static const unsigned int numSizeClasses=13; // Number of size classes; the largest chunk size is 256 KB, and larger requests bypass the arena
+	static const size_t slabSize=size_t(1)<<20; // Size of slabs from which chunks are carved
+	static Threads::Spinlock mutex; // Mutex serializing creation of the per-size class pools
+	static ObjectPool* pools[numSizeClasses]; // Pools of chunks for each size class, each carving chunks of a single size from its own slabs; created on first use
+	
+	/* Private methods: */
+	static unsigned int getSizeClass(size_t size) // Returns the size class for the given chunk size, or numSizeClasses if it is too large
+		{
+		unsigned int sizeClass=0;
+		while(sizeClass<numSizeClasses&&(size_t(1)<<(sizeClass+minSizeClassLog))<size)
+			++sizeClass;
+		return sizeClass;
+		}
+	static ObjectPool& getPool(unsigned int sizeClass); // Returns the pool for the given size class
+	
+	/* Methods: */
+	public:
+	static void* allocate(size_t size); // Allocates a chunk of at least the given size in bytes
+	static void release(void* chunk,size_t size); // Returns a chunk of the given requested size to the arena
+	};
+
+template <class ValueParam>
+class PointAllocator // STL allocator drawing memory from the point arena
+	{
+	/* Embedded classes: */
+	public:
+	typedef ValueParam value_type;
+	typedef ValueParam* pointer;
+	typedef const ValueParam* const_pointer;
+	typedef ValueParam& reference;
+	typedef const ValueParam& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+	
+	template <class OtherValueParam>
+	struct rebind
+		{
+		typedef PointAllocator<OtherValueParam> other;
+		};
+	
+	/* Constructors and destructors: */
+	PointAllocator(void)
+		{
+		}
+	template <class OtherValueParam>
+	PointAllocator(const PointAllocator<OtherValueParam>&)
+		{
+		}
+	
+	/* Methods: */
+	pointer address(reference value) const
+		{
+		return &value;
+		}
+	const_pointer address(const_reference value) const
+		{
+		return &value;
+		}
+	pointer allocate(size_type numElements,const void* hint=0)
+		{
+		return numElements!=0?static_cast<pointer>(PointArena::allocate(numElements*sizeof(ValueParam))):0;
+		}
+	void deallocate(pointer elements,size_type numElements)
+		{
+		if(elements!=0)
+			PointArena::release(elements,numElements*sizeof(ValueParam));
+		}
+	size_type max_size(void) const
+		{
+		return size_type(-1)/sizeof(ValueParam);
+		}
+	void construct(pointer element,const_reference value)
+		{
+		new(static_cast<void*>(element)) ValueParam(value);
+		}
+	void destroy(pointer element)
+		{
+		element->~ValueParam();
+		}
+	};
+
+template <class ValueParam1,class ValueParam2>
+inline bool operator==(const PointAllocator<ValueParam1>&,const PointAllocator<ValueParam2>&)
+	{
+	return true;
+	}
+
+template <class ValueParam1,class ValueParam2>
+inline bool operator!=(const PointAllocator<ValueParam1>&,const PointAllocator<ValueParam2>&)
+	{
+	return false;
+	}
+
+typedef std::vector<Point,PointAllocator<Point> > PointList; // Type for lists of curve points stored in the point arena
+
+#endif
@@ -24,13 +24,19 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include "PolylineRenderer.h"
 
 #include <stddef.h>
+#include <string.h>
+#include <utility>
+#include <map>
+#include <Misc/SizedTypes.h>
 #include <Misc/StandardHashFunction.h>
 #include <Misc/HashTable.h>
+#include <Math/Math.h>
 #include <Geometry/OrthogonalTransformation.h>
 #include <GL/gl.h>
 #include <GL/GLColorTemplates.h>
 #include <GL/GLContext.h>
 #include <GL/GLContextData.h>
+#include <GL/GLExtensionManager.h>
 #include <GL/Extensions/GLARBVertexBufferObject.h>
 #include <GL/Extensions/GLARBCopyBuffer.h>
 #include <GL/Extensions/GLARBShaderObjects.h>
@@ -39,11 +45,34 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <GL/Extensions/GLARBFragmentShader.h>
 #include <GL/GLGeometryWrappers.h>
 #include <Vrui/Vrui.h>
-#include <Vrui/VRScreen.h>
-#include <Vrui/VRWindow.h>
-#include <Vrui/DisplayState.h>
 
 #include "Config.h"
+#include "Stats.h"
+#include "ChunkAllocator.h"
+#include "RenderState.h"
+#include "ProgramCache.h"
+
+/* Tokens for buffer mapping, buffer storage, and sync objects, in case the OpenGL headers predate them: */
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#define GL_MAP_INVALIDATE_RANGE_BIT 0x0004
+#define GL_MAP_UNSYNCHRONIZED_BIT 0x0020
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_ALREADY_SIGNALED 0x911A
+#define GL_TIMEOUT_EXPIRED 0x911B
+#define GL_CONDITION_SATISFIED 0x911C
+#define GL_WAIT_FAILED 0x911D
+#endif
 
 /************************************************
 Declaration of struct PolylineRenderer::DataItem:
@@ -53,38 +82,44 @@ struct PolylineRenderer::DataItem:public GLObject::DataItem
 	{
 	/* Embedded classes: */
 	public:
-	struct Vertex // Structure representing a polyline vertex in GPU memory
+	struct Vertex // Structure representing a polyline vertex in GPU memory; sketches live in the (x,y) plane, so only x and y are stored
 		{
 		/* Elements: */
 		public:
-		Vector normal; // Halfway vector between adjacent polyline segments, uploaded to shader as normal vector
-		Point position; // Vertex position
+		GLfloat position[2]; // Vertex position
+		GLshort normal[2]; // Half the halfway vector between adjacent polyline segments as normalized 16-bit integers, uploaded to shader as generic vertex attribute
+		Color color; // Polyline color, uploaded to shader as vertex color
+		GLfloat lineWidth; // Polyline width, uploaded to shader as texture coordinate
+		
+		/* Methods: */
+		void set(const Vector& sNormal,const Point& sPosition,const Color& sColor,Scalar sLineWidth) // Sets all vertex components
+			{
+			for(int i=0;i<2;++i)
+				{
+				position[i]=GLfloat(sPosition[i]);
+				
+				/* Halfway vectors between unit vectors have lengths of at most two: */
+				normal[i]=GLshort(Math::floor(Math::clamp(sNormal[i]*Scalar(0.5),Scalar(-1),Scalar(1))*Scalar(32767)+Scalar(0.5)));
+				}
+			color=sColor;
+			lineWidth=GLfloat(sLineWidth);
+			}
 		};
 	
 	struct MemoryBlock // Structure representing a memory block in GPU memory
 		{
 		/* Embedded classes: */
 		public:
-		struct FreeChunk // Structure representing an unused chunk of memory inside a memory block
-			{
-			/* Elements: */
-			public:
-			size_t offset,size; // Offset and size of free chunk, in units of vertices
-			
-			/* Constructors and destructors: */
-			FreeChunk(size_t sOffset,size_t sSize)
-				:offset(sOffset),size(sSize)
-				{
-				}
-			};
+		typedef std::map<size_t,const void*> ItemMap; // Type for maps from offsets of cached polylines to their cache IDs
 		
 		/* Elements: */
 		public:
+		unsigned int index; // Index of this memory block in the chunk allocator
 		GLuint bufferId; // ID of the OpenGL buffer backing this memory block
-		std::vector<FreeChunk> freeChunks; // List of unused chunks of memory, sorted by increasing offset
+		ItemMap items; // Map of cached polylines stored in this memory block, sorted by increasing offset
 		
 		/* Constructors and destructors: */
-		MemoryBlock(size_t numVertices); // Creates a memory block holding the given number of polyline vertices
+		MemoryBlock(unsigned int sIndex,size_t numVertices); // Creates a memory block holding the given number of polyline vertices
 		private:
 		MemoryBlock(const MemoryBlock& source);
 		MemoryBlock& operator=(const MemoryBlock& source);
@@ -98,57 +133,174 @@ struct PolylineRenderer::DataItem:public GLObject::DataItem
 		public:
 		MemoryBlock* memoryBlock; // Pointer to memory block containing the polyline's vertex data
 		size_t offset,size; // Offset and size of memory chunk allocated to the polyline, in units of vertices
+		size_t numVertices; // Number of polyline vertices stored at the beginning of the memory chunk
+		size_t numFinal; // Number of stored vertices of a polyline being drawn that will not change anymore
 		unsigned int version; // Version number of polyline in the cache
+		unsigned int lodTier; // Level-of-detail tier of the polyline stored in the cache
+		Vector translation; // Translation of the polyline at the time its vertices were uploaded
+		Color color; // Polyline color stored in the cached vertices
+		Scalar lineWidth; // Polyline width stored in the cached vertices
 		
 		/* Constructors and destructors: */
 		CacheItem(MemoryBlock* sMemoryBlock,size_t sOffset,size_t sSize)
-			:memoryBlock(sMemoryBlock),offset(sOffset),size(sSize),version(0)
+			:memoryBlock(sMemoryBlock),offset(sOffset),size(sSize),
+			 numVertices(sSize),numFinal(0),version(0),lodTier(0),translation(Vector::zero),
+			 color(0,0,0),lineWidth(0)
+			{
+			}
+		
+		/* Methods: */
+		bool matches(const Color& otherColor,Scalar otherLineWidth) const // Returns true if the cached vertices store the given color and line width
 			{
+			return color[0]==otherColor[0]&&color[1]==otherColor[1]&&color[2]==otherColor[2]&&color[3]==otherColor[3]&&lineWidth==otherLineWidth;
 			}
 		};
 	
 	typedef Misc::HashTable<const void*,CacheItem> CacheMap; // Type for hash tables mapping cache IDs to cached polylines
+	typedef void (APIENTRY *PFNGLMULTIDRAWARRAYSPROC)(GLenum mode,const GLint* first,const GLsizei* count,GLsizei drawcount); // Type for pointers to the OpenGL 1.4 glMultiDrawArrays function
+	typedef void* (APIENTRY *PFNGLMAPBUFFERRANGEPROC)(GLenum target,ptrdiff_t offset,ptrdiff_t length,GLbitfield access); // Type for pointers to the OpenGL 3.0 glMapBufferRange function
+	typedef void (APIENTRY *PFNGLBUFFERSTORAGEPROC)(GLenum target,ptrdiff_t size,const void* data,GLbitfield flags); // Type for pointers to the OpenGL 4.4 glBufferStorage function
+	typedef void* (APIENTRY *PFNGLFENCESYNCPROC)(GLenum condition,GLbitfield flags); // Type for pointers to the OpenGL 3.2 glFenceSync function
+	typedef GLenum (APIENTRY *PFNGLCLIENTWAITSYNCPROC)(void* sync,GLbitfield flags,Misc::UInt64 timeout); // Type for pointers to the OpenGL 3.2 glClientWaitSync function
+	typedef void (APIENTRY *PFNGLDELETESYNCPROC)(void* sync); // Type for pointers to the OpenGL 3.2 glDeleteSync function
+	typedef void (APIENTRY *PFNGLVERTEXATTRIBDIVISORPROC)(GLuint index,GLuint divisor); // Type for pointers to the OpenGL 3.3 glVertexAttribDivisor function
+	typedef void (APIENTRY *PFNGLDRAWARRAYSINSTANCEDPROC)(GLenum mode,GLint first,GLsizei count,GLsizei instancecount); // Type for pointers to the OpenGL 3.1 glDrawArraysInstanced function
+	typedef void (APIENTRY *PFNGLMULTIDRAWARRAYSINDIRECTPROC)(GLenum mode,const void* indirect,GLsizei drawcount,GLsizei stride); // Type for pointers to the OpenGL 4.3 glMultiDrawArraysIndirect function
+	
+	struct DrawCommand // Structure for indirect draw commands drawing the segments of cached polylines as instanced quad strips
+		{
+		/* Elements: */
+		public:
+		GLuint count; // Number of vertices per quad strip, always 8
+		GLuint instanceCount; // Number of line segments in the polyline
+		GLuint first; // Index of the first quad strip vertex, always 0
+		GLuint baseInstance; // Offset of the polyline's first vertex in its memory block
+		};
+	
+	static const GLuint normalAttribute=1; // Index of the generic vertex attribute holding polyline vertices' halfway vectors
+	static const GLuint endPositionAttribute=2; // Index of the per-instance vertex attribute holding line segments' end points
+	static const GLuint endNormalAttribute=3; // Index of the per-instance vertex attribute holding halfway vectors at line segments' end points
+	static const GLuint colorAttribute=4; // Index of the per-instance vertex attribute holding line segments' colors
+	static const GLuint lineWidthAttribute=5; // Index of the per-instance vertex attribute holding line segments' widths
+	static const GLuint numInstancedAttributes=6; // Number of per-instance vertex attributes, starting from index 0 holding line segments' start points
+	static const unsigned int numStagingSegments=3; // Number of staging buffer segments, filled in turn once per frame
+	static const size_t stagingSegmentSize=1U<<16; // Number of vertices per staging buffer segment
 	
 	/* Elements: */
 	public:
-	std::vector<MemoryBlock*> memoryBlocks; // List of memory blocks managed by this renderer
+	ChunkAllocator allocator; // Allocator managing free memory in all memory blocks, in units of vertices
+	std::vector<MemoryBlock*> memoryBlocks; // List of memory blocks managed by this renderer, indexed by allocator block index; null for unused slots
 	CacheMap cacheMap; // Map of cached polylines
 	GLuint currentBufferId; // ID of currently bound buffer object
 	bool haveCoreGeometryShaders; // Flag whether the OpenGL context supports core feature geometry shaders
+	bool instancedLines; // Flag whether line segments are expanded into quad strips by drawing one instance per segment instead of by a geometry shader
+	PFNGLMULTIDRAWARRAYSPROC glMultiDrawArraysProc; // Pointer to the glMultiDrawArrays function, or null if the OpenGL context does not support it
+	PFNGLMAPBUFFERRANGEPROC glMapBufferRangeProc; // Pointer to the glMapBufferRange function, or null if the OpenGL context does not support staged uploads
+	PFNGLFENCESYNCPROC glFenceSyncProc; // Pointer to the glFenceSync function
+	PFNGLCLIENTWAITSYNCPROC glClientWaitSyncProc; // Pointer to the glClientWaitSync function
+	PFNGLDELETESYNCPROC glDeleteSyncProc; // Pointer to the glDeleteSync function
+	PFNGLVERTEXATTRIBDIVISORPROC glVertexAttribDivisorProc; // Pointer to the glVertexAttribDivisor function, or null if line segments are not instanced
+	PFNGLDRAWARRAYSINSTANCEDPROC glDrawArraysInstancedProc; // Pointer to the glDrawArraysInstanced function
+	PFNGLMULTIDRAWARRAYSINDIRECTPROC glMultiDrawArraysIndirectProc; // Pointer to the glMultiDrawArraysIndirect function
+	GLuint indirectBufferId; // ID of the buffer holding indirect draw commands for instanced line segments, or 0
+	std::vector<DrawCommand> batchCommands; // Indirect draw commands for the pending cached polylines
+	GLuint stagingBufferId; // ID of the ring buffer staging vertex uploads, or 0 if uploads write into memory blocks directly
+	Vertex* stagingMemory; // Persistent mapping of the staging buffer, or null if staging ranges are mapped for each upload
+	unsigned int stagingSegment; // Index of the staging buffer segment currently being filled
+	size_t stagingHead; // Offset of the next unused vertex in the staging buffer
+	size_t stagingNumReserved; // Number of vertices in the current staging reservation
+	void* stagingFences[numStagingSegments]; // Fences signaling that the GPU finished reading each staging buffer segment, or null
+	bool stagingReady; // Flag if the GPU is known to have finished reading the current staging buffer segment
+	bool stagingBusy; // Flag if the GPU was still reading the current staging buffer segment when it was polled during the current frame
+	bool stagingFailed; // Flag if waiting for a staging buffer fence failed; uploads no longer use the staging buffer
 	GLhandleARB lineShader; // GLSL shader to render anti-aliased lines
-	GLint uniforms[2]; // Locations of the line rendering shader's uniform variables
-	Color currentColor; // Color currently uploaded into the line rendering shader
-	Scalar currentLineWidth; // Line width currently uploaded into the line rendering shader
+	GLint uniforms[3]; // Locations of the line rendering shader's uniform variables
+	Scalar lodTolerance; // Largest polyline simplification error that is invisible in the current rendering pass, in model space units
+	Vector vertexTranslation; // Translation currently applied to polyline vertices by the line rendering shader
+	std::vector<GLint> batchFirsts; // Offsets of cached polylines in the currently bound memory block that are waiting to be drawn
+	std::vector<GLsizei> batchCounts; // Sizes of cached polylines in the currently bound memory block that are waiting to be drawn
+	const void* uploadCacheId; // Cache ID of the cache item whose vertices are currently being uploaded
 	CacheItem* uploadItem; // Pointer to a cache item whose vertices are currently being uploaded into the item's memory chunk
 	DataItem::Vertex* uploadPtr; // Position in the upload memory chunk where the next vertex will be uploaded
 	DataItem::Vertex* uploadEnd; // Pointer after the end of the allocated memory chunk
 	size_t uploadNumVertices; // Number of polyline vertices already uploaded
+	Vertex* uploadStagingStart; // Start of the staging reservation receiving the vertices currently being uploaded, or null if they are written into the memory chunk directly
+	size_t uploadNumCommitted; // Number of staged vertices already copied into the memory chunk
+	std::vector<Vertex> uploadBuffer; // Staging buffer for incremental uploads of polylines being drawn
+	Threads::Spinlock dropQueueMutex; // Mutex serializing additions to the drop queue from the main thread and parallel rubout workers
+	std::vector<const void*> dropQueue; // List of deleted items that need to be dropped from this context's cache during its next rendering pass
+	std::vector<const void*> dropItems; // List of deleted items being dropped during the current rendering pass
 	Point uploadP0; // The previously uploaded polyline vertex
 	Vector uploadV0; // Direction vector between the two previously uploaded polyline vertices
+	#if SKETCHPAD_CONFIG_STATS
+	Stats::LocalCounters stats; // Counters accumulated during the current render pass
+	#endif
 	
 	/* Constructors and destructors: */
 	DataItem(GLContextData& contextData);
 	virtual ~DataItem(void);
 	
-	CacheItem allocate(size_t size); // Allocates a memory chunk of the given size
-	CacheItem allocateLargest(size_t minSize); // Allocates the largest memory chunk of the given minimum size
+	MemoryBlock* addMemoryBlock(size_t minNumVertices); // Creates a new memory block holding at least the given number of vertices
+	CacheItem allocate(const void* cacheId,size_t size); // Allocates a memory chunk of the given size for the polyline of the given cache ID
+	CacheItem allocateLargest(const void* cacheId,size_t minSize); // Allocates the largest memory chunk of the given minimum size for the polyline of the given cache ID
 	void release(const CacheItem& cacheItem); // Releases an allocated memory chunk
+	void trim(CacheItem& cacheItem); // Releases the part of the given cached polyline's memory chunk that is not occupied by vertices
+	void copy(const MemoryBlock* sourceBlock,size_t sourceOffset,const MemoryBlock* destBlock,size_t destOffset,size_t numVertices); // Copies vertices between memory chunks in GPU memory
+	void move(const void* cacheId,CacheItem& cacheItem,const ChunkAllocator::Chunk& chunk); // Moves the given cached polyline into the given newly-allocated chunk
+	void compact(size_t maxNumVertices); // Moves at most the given number of vertices to reduce fragmentation and release empty memory blocks
+	void setVertexPointers(const GLubyte* base); // Sets up vertex array pointers for vertices starting at the given address in the currently bound buffer, or in client memory if no buffer is bound
+	void bindMemoryBlock(const MemoryBlock* memoryBlock); // Binds the given memory block's buffer and sets up vertex array pointers; flushes pending draws first if the block changes
+	void setVertexTranslation(const Vector& newVertexTranslation); // Sets the translation applied to polyline vertices by the line rendering shader; flushes pending draws first if the translation changes
+	void advanceStaging(void); // Fences the current staging buffer segment and moves on to the next one
+	bool pollStaging(void); // Returns true if the GPU finished reading the current staging buffer segment, without waiting for it
+	Vertex* reserveStaging(size_t minNumVertices,size_t maxNumVertices); // Returns room for at least the given minimum and at most the given maximum number of vertices in the staging buffer, and stores the reserved size in stagingNumReserved; returns null if uploads are not staged or the GPU is still reading the staging buffer
+	void commitStaging(size_t numVertices,const MemoryBlock* destBlock,size_t destOffset); // Copies the given number of vertices from the start of the current staging reservation into the given memory block and ends the reservation
+	void continueStagedUpload(void); // Commits the vertices staged for the polyline being uploaded when the staging reservation is full, growing the polyline's memory chunk if needed, and reserves more room
+	void queue(const CacheItem& cacheItem) // Adds the given cached polyline to the list of pending draws
+		{
+		batchFirsts.push_back(GLint(cacheItem.offset));
+		batchCounts.push_back(GLsizei(cacheItem.numVertices));
+		}
+	void flush(void); // Draws all pending cached polylines in one call
+	void drawSingle(const CacheItem& cacheItem,const Color& color,Scalar lineWidth); // Draws the given cached polyline immediately with the given color and line width, overriding the values stored in its vertices
+	void drawInstanced(const Polyline& polyline,const Color& color,Scalar lineWidth); // Draws the given uncached polyline from client memory as instanced line segments
+	static void writeVertices(const Polyline& polyline,const Color& color,Scalar lineWidth,Vertex* vPtr); // Writes the cached vertices of the given polyline, at least two, to the given array
+	};
+
+/******************************************************
+Declaration of struct PolylineRenderer::SharedVertices:
+******************************************************/
+
+struct PolylineRenderer::SharedVertices
+	{
+	/* Elements: */
+	public:
+	double frameTime; // Application time of the frame during which the vertices were computed
+	unsigned int version; // Version number of the polyline whose vertices are stored
+	Vector translation; // Translation of the polyline at the time its vertices were computed
+	Color color; // Polyline color stored in the vertices
+	Scalar lineWidth; // Polyline width stored in the vertices
+	std::vector<DataItem::Vertex> vertices; // The polyline's vertices
+	
+	/* Methods: */
+	bool matches(double otherFrameTime,unsigned int otherVersion,const Color& otherColor,Scalar otherLineWidth) const // Returns true if the stored vertices were computed during the given frame from the given polyline version and store the given color and line width
+		{
+		return frameTime==otherFrameTime&&version==otherVersion&&color[0]==otherColor[0]&&color[1]==otherColor[1]&&color[2]==otherColor[2]&&color[3]==otherColor[3]&&lineWidth==otherLineWidth;
+		}
 	};
 
 /*********************************************************
 Methods of struct PolylineRenderer::DataItem::MemoryBlock:
 *********************************************************/
 
-PolylineRenderer::DataItem::MemoryBlock::MemoryBlock(size_t numVertices)
-	:bufferId(0)
+PolylineRenderer::DataItem::MemoryBlock::MemoryBlock(unsigned int sIndex,size_t numVertices)
+	:index(sIndex),bufferId(0)
 	{
-	/* Create the memory block buffer: */
+	/* Create the memory block buffer without disturbing the current vertex buffer binding: */
 	glGenBuffersARB(1,&bufferId);
-	glBindBufferARB(GL_ARRAY_BUFFER_ARB,bufferId);
-	glBufferDataARB(GL_ARRAY_BUFFER_ARB,numVertices*sizeof(Vertex),0,GL_STATIC_DRAW_ARB);
-	
-	/* Initialize the list of unused chunks: */
-	freeChunks.push_back(FreeChunk(0,numVertices));
+	glBindBufferARB(GL_COPY_WRITE_BUFFER,bufferId);
+	glBufferDataARB(GL_COPY_WRITE_BUFFER,numVertices*sizeof(Vertex),0,GL_STATIC_DRAW_ARB);
+	glBindBufferARB(GL_COPY_WRITE_BUFFER,0);
 	}
 
 PolylineRenderer::DataItem::MemoryBlock::~MemoryBlock(void)
@@ -166,10 +318,26 @@ PolylineRenderer::DataItem::DataItem(GLContextData& contextData)
 	:cacheMap(17),
 	 currentBufferId(0U),
 	 haveCoreGeometryShaders(contextData.getContext().isVersionLargerEqual(3,2)),
+	 instancedLines(contextData.getContext().isVersionLargerEqual(4,3)),
+	 glMultiDrawArraysProc(0),
+	 glMapBufferRangeProc(0),glFenceSyncProc(0),glClientWaitSyncProc(0),glDeleteSyncProc(0),
+	 glVertexAttribDivisorProc(0),glDrawArraysInstancedProc(0),glMultiDrawArraysIndirectProc(0),
+	 indirectBufferId(0),
+	 stagingBufferId(0),stagingMemory(0),stagingSegment(0),stagingHead(0),stagingNumReserved(0),
+	 stagingReady(true),stagingBusy(false),stagingFailed(false),
 	 lineShader(0),
-	 currentColor(0,0,0),currentLineWidth(0),
-	 uploadItem(0),uploadPtr(0),uploadEnd(0)
+	 lodTolerance(0),
+	 vertexTranslation(Vector::zero),
+	 uploadCacheId(0),uploadItem(0),uploadPtr(0),uploadEnd(0),
+	 uploadStagingStart(0),uploadNumCommitted(0)
 	{
+	/* Register this OpenGL context to receive dropped cache IDs: */
+	{
+	Threads::Spinlock::Lock contextsLock(contextsMutex);
+	contexts.push_back(this);
+	numContexts.preAdd(1);
+	}
+	
 	/* Initialize required OpenGL extensions: */
 	GLARBVertexBufferObject::initExtension();
 	GLARBCopyBuffer::initExtension();
@@ -179,11 +347,53 @@ PolylineRenderer::DataItem::DataItem(GLContextData& contextData)
 		GLARBGeometryShader4::initExtension();
 	GLARBFragmentShader::initExtension();
 	
-	/* Create the first memory block: */
-	memoryBlocks.push_back(new MemoryBlock(1U<<20)); // 1M vertices per block
+	/* Retrieve the multi-draw entry point if the context supports OpenGL 1.4: */
+	if(contextData.getContext().isVersionLargerEqual(1,4))
+		glMultiDrawArraysProc=GLExtensionManager::getFunction<PFNGLMULTIDRAWARRAYSPROC>("glMultiDrawArrays");
 	
-	/* Protect the newly-created buffer: */
-	glBindBufferARB(GL_ARRAY_BUFFER_ARB,0);
+	for(unsigned int i=0;i<numStagingSegments;++i)
+		stagingFences[i]=0;
+	if(contextData.getContext().isVersionLargerEqual(3,2))
+		{
+		/* Retrieve the entry points to map buffer ranges and to fence staging buffer segments: */
+		glMapBufferRangeProc=GLExtensionManager::getFunction<PFNGLMAPBUFFERRANGEPROC>("glMapBufferRange");
+		glFenceSyncProc=GLExtensionManager::getFunction<PFNGLFENCESYNCPROC>("glFenceSync");
+		glClientWaitSyncProc=GLExtensionManager::getFunction<PFNGLCLIENTWAITSYNCPROC>("glClientWaitSync");
+		glDeleteSyncProc=GLExtensionManager::getFunction<PFNGLDELETESYNCPROC>("glDeleteSync");
+		
+		/* Create a staging buffer holding all staging segments without disturbing the current vertex buffer binding: */
+		size_t stagingSize=numStagingSegments*stagingSegmentSize*sizeof(Vertex);
+		glGenBuffersARB(1,&stagingBufferId);
+		glBindBufferARB(GL_COPY_WRITE_BUFFER,stagingBufferId);
+		if(contextData.getContext().isVersionLargerEqual(4,4))
+			{
+			/* Create immutable storage and map it persistently: */
+			PFNGLBUFFERSTORAGEPROC glBufferStorageProc=GLExtensionManager::getFunction<PFNGLBUFFERSTORAGEPROC>("glBufferStorage");
+			GLbitfield flags=GL_MAP_WRITE_BIT|GL_MAP_PERSISTENT_BIT|GL_MAP_COHERENT_BIT;
+			glBufferStorageProc(GL_COPY_WRITE_BUFFER,stagingSize,0,flags);
+			stagingMemory=static_cast<Vertex*>(glMapBufferRangeProc(GL_COPY_WRITE_BUFFER,0,stagingSize,flags));
+			}
+		else
+			{
+			/* Create mutable storage whose ranges are mapped for each upload: */
+			glBufferDataARB(GL_COPY_WRITE_BUFFER,stagingSize,0,GL_STREAM_DRAW_ARB);
+			}
+		glBindBufferARB(GL_COPY_WRITE_BUFFER,0);
+		}
+	
+	if(instancedLines)
+		{
+		/* Retrieve the entry points to draw instanced line segments from indirect draw commands: */
+		glVertexAttribDivisorProc=GLExtensionManager::getFunction<PFNGLVERTEXATTRIBDIVISORPROC>("glVertexAttribDivisor");
+		glDrawArraysInstancedProc=GLExtensionManager::getFunction<PFNGLDRAWARRAYSINSTANCEDPROC>("glDrawArraysInstanced");
+		glMultiDrawArraysIndirectProc=GLExtensionManager::getFunction<PFNGLMULTIDRAWARRAYSINDIRECTPROC>("glMultiDrawArraysIndirect");
+		
+		/* Create the indirect draw command buffer: */
+		glGenBuffersARB(1,&indirectBufferId);
+		}
+	
+	/* Create the first memory block: */
+	addMemoryBlock(0);
 	
 	/* Create the line rendering shader: */
 	lineShader=glCreateProgramObjectARB();
@@ -195,140 +405,527 @@ PolylineRenderer::DataItem::~DataItem(void)
 	for(std::vector<MemoryBlock*>::iterator mbIt=memoryBlocks.begin();mbIt!=memoryBlocks.end();++mbIt)
 		delete *mbIt;
 	
+	/* Delete the indirect draw command buffer: */
+	if(indirectBufferId!=0U)
+		glDeleteBuffersARB(1,&indirectBufferId);
+	
+	/* Delete the staging buffer, which also unmaps it, and all pending staging fences: */
+	if(stagingBufferId!=0U)
+		glDeleteBuffersARB(1,&stagingBufferId);
+	for(unsigned int i=0;i<numStagingSegments;++i)
+		if(stagingFences[i]!=0)
+			glDeleteSyncProc(stagingFences[i]);
+	
 	/* Destroy the line rendering shader: */
 	glDeleteObjectARB(lineShader);
+	
+	/* Unregister this OpenGL context: */
+	{
+	Threads::Spinlock::Lock contextsLock(contextsMutex);
+	for(std::vector<DataItem*>::iterator cIt=contexts.begin();cIt!=contexts.end();++cIt)
+		if(*cIt==this)
+			{
+			*cIt=contexts.back();
+			contexts.pop_back();
+			break;
+			}
+	numContexts.preSub(1);
+	}
+	}
+
+PolylineRenderer::DataItem::MemoryBlock* PolylineRenderer::DataItem::addMemoryBlock(size_t minNumVertices)
+	{
+	/* Add a new block to the chunk allocator, with 1M vertices per block unless a larger polyline needs a block of its own: */
+	size_t numVertices=Misc::max(size_t(1U<<20),minNumVertices);
+	unsigned int index=allocator.addBlock(numVertices);
+	
+	/* Create the memory block and store it in the allocator's block slot: */
+	if(memoryBlocks.size()<=index)
+		memoryBlocks.resize(index+1,0);
+	memoryBlocks[index]=new MemoryBlock(index,numVertices);
+	
+	return memoryBlocks[index];
+	}
+
+PolylineRenderer::DataItem::CacheItem PolylineRenderer::DataItem::allocate(const void* cacheId,size_t size)
+	{
+	/* Find the free memory chunk with the smallest overhead: */
+	ChunkAllocator::Chunk chunk;
+	if(!allocator.allocate(size,chunk))
+		{
+		/* Create a new memory block large enough for the polyline and allocate from it: */
+		addMemoryBlock(size);
+		allocator.allocate(size,chunk);
+		}
+	
+	/* Associate the allocated chunk with the polyline: */
+	MemoryBlock* memoryBlock=memoryBlocks[chunk.block];
+	memoryBlock->items[chunk.offset]=cacheId;
+	
+	return CacheItem(memoryBlock,chunk.offset,chunk.size);
+	}
+
+PolylineRenderer::DataItem::CacheItem PolylineRenderer::DataItem::allocateLargest(const void* cacheId,size_t minSize)
+	{
+	/* Take the largest free memory chunk: */
+	ChunkAllocator::Chunk chunk;
+	if(!allocator.allocateLargest(minSize,chunk))
+		{
+		/* Create a new memory block large enough for the polyline and take its entire free chunk: */
+		addMemoryBlock(minSize);
+		allocator.allocateLargest(minSize,chunk);
+		}
+	
+	/* Associate the allocated chunk with the polyline: */
+	MemoryBlock* memoryBlock=memoryBlocks[chunk.block];
+	memoryBlock->items[chunk.offset]=cacheId;
+	
+	return CacheItem(memoryBlock,chunk.offset,chunk.size);
+	}
+
+void PolylineRenderer::DataItem::release(const PolylineRenderer::DataItem::CacheItem& cacheItem)
+	{
+	/* Return the memory chunk to the allocator: */
+	allocator.release(ChunkAllocator::Chunk(cacheItem.memoryBlock->index,cacheItem.offset,cacheItem.size));
+	
+	/* Remove the chunk's association with its polyline; does nothing if the chunk is the unused tail of a polyline's chunk: */
+	cacheItem.memoryBlock->items.erase(cacheItem.offset);
 	}
 
-PolylineRenderer::DataItem::CacheItem PolylineRenderer::DataItem::allocate(size_t size)
+void PolylineRenderer::DataItem::trim(PolylineRenderer::DataItem::CacheItem& cacheItem)
 	{
-	/* Find a free memory chunk that either fits the request exactly or has the smallest overhead: */
-	std::vector<MemoryBlock*>::iterator bestMbIt;
-	std::vector<MemoryBlock::FreeChunk>::iterator bestFcIt;
-	size_t bestSize=~size_t(0);
+	if(cacheItem.numVertices<cacheItem.size)
+		{
+		/* Release the unused part of the memory chunk: */
+		CacheItem unusedItem=cacheItem;
+		unusedItem.offset+=cacheItem.numVertices;
+		unusedItem.size-=cacheItem.numVertices;
+		release(unusedItem);
+		cacheItem.size=cacheItem.numVertices;
+		}
+	}
+
+void PolylineRenderer::DataItem::copy(const PolylineRenderer::DataItem::MemoryBlock* sourceBlock,size_t sourceOffset,const PolylineRenderer::DataItem::MemoryBlock* destBlock,size_t destOffset,size_t numVertices)
+	{
+	/* Copy using the dedicated copy buffer bindings to leave the vertex buffer binding alone: */
+	glBindBufferARB(GL_COPY_READ_BUFFER,sourceBlock->bufferId);
+	glBindBufferARB(GL_COPY_WRITE_BUFFER,destBlock->bufferId);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER,GL_COPY_WRITE_BUFFER,sourceOffset*sizeof(Vertex),destOffset*sizeof(Vertex),numVertices*sizeof(Vertex));
+	glBindBufferARB(GL_COPY_READ_BUFFER,0);
+	glBindBufferARB(GL_COPY_WRITE_BUFFER,0);
+	}
+
+void PolylineRenderer::DataItem::move(const void* cacheId,PolylineRenderer::DataItem::CacheItem& cacheItem,const ChunkAllocator::Chunk& chunk)
+	{
+	/* Copy the polyline's vertices into the new chunk: */
+	MemoryBlock* newMemoryBlock=memoryBlocks[chunk.block];
+	copy(cacheItem.memoryBlock,cacheItem.offset,newMemoryBlock,chunk.offset,cacheItem.numVertices);
+	
+	/* Release the polyline's old chunk and install the new one: */
+	release(cacheItem);
+	cacheItem.memoryBlock=newMemoryBlock;
+	cacheItem.offset=chunk.offset;
+	newMemoryBlock->items[chunk.offset]=cacheId;
+	}
+
+void PolylineRenderer::DataItem::compact(size_t maxNumVertices)
+	{
+	size_t numVertices=0;
+	
+	/* Find the least-used memory block: */
+	unsigned int numBlocks=0;
+	MemoryBlock* source=0;
+	size_t sourceUsed=~size_t(0);
 	for(std::vector<MemoryBlock*>::iterator mbIt=memoryBlocks.begin();mbIt!=memoryBlocks.end();++mbIt)
+		if(*mbIt!=0)
+			{
+			++numBlocks;
+			size_t used=allocator.getBlockSize((*mbIt)->index)-allocator.getFreeSize((*mbIt)->index);
+			if(sourceUsed>used)
+				{
+				source=*mbIt;
+				sourceUsed=used;
+				}
+			}
+	
+	/* Evacuate the least-used memory block if the other blocks have enough room to hold its polylines: */
+	if(numBlocks>1&&allocator.getTotalFreeSize()-allocator.getFreeSize(source->index)>=sourceUsed)
 		{
-		for(std::vector<MemoryBlock::FreeChunk>::iterator fcIt=(*mbIt)->freeChunks.begin();fcIt!=(*mbIt)->freeChunks.end();++fcIt)
+		while(!source->items.empty()&&numVertices<maxNumVertices)
+			{
+			/* Move the block's first polyline into the best-fitting chunk in another block: */
+			const void* cacheId=source->items.begin()->second;
+			CacheItem& cacheItem=cacheMap.findEntry(cacheId)->getDest();
+			ChunkAllocator::Chunk chunk;
+			if(!allocator.allocate(cacheItem.size,chunk,source->index))
+				break;
+			move(cacheId,cacheItem,chunk);
+			numVertices+=chunk.size;
+			}
+		
+		if(source->items.empty())
 			{
-			if(fcIt->size>=size&&bestSize>fcIt->size)
+			/* Delete the now-empty memory block: */
+			if(currentBufferId==source->bufferId)
+				currentBufferId=0U;
+			allocator.removeBlock(source->index);
+			memoryBlocks[source->index]=0;
+			delete source;
+			}
+		}
+	
+	/* Move polylines from the ends of fragmented memory blocks into gaps further down: */
+	for(std::vector<MemoryBlock*>::iterator mbIt=memoryBlocks.begin();mbIt!=memoryBlocks.end()&&numVertices<maxNumVertices;++mbIt)
+		if(*mbIt!=0)
+			{
+			MemoryBlock* mb=*mbIt;
+			while(allocator.getNumFreeChunks(mb->index)>1&&!mb->items.empty()&&numVertices<maxNumVertices)
 				{
-				/* Tentatively take this chunk: */
-				bestMbIt=mbIt;
-				bestFcIt=fcIt;
-				bestSize=fcIt->size;
-				
-				/* Stop looking if the chunk fits the request exactly: */
-				if(bestSize==size)
-					goto chunkFound;
+				/* Move the block's last polyline into the first gap below it that can hold it: */
+				MemoryBlock::ItemMap::iterator iIt=mb->items.end();
+				--iIt;
+				const void* cacheId=iIt->second;
+				CacheItem& cacheItem=cacheMap.findEntry(cacheId)->getDest();
+				ChunkAllocator::Chunk chunk;
+				if(!allocator.allocateBelow(mb->index,cacheItem.size,cacheItem.offset,chunk))
+					break;
+				move(cacheId,cacheItem,chunk);
+				numVertices+=chunk.size;
 				}
 			}
+	}
+
+void PolylineRenderer::DataItem::setVertexPointers(const GLubyte* base)
+	{
+	if(instancedLines)
+		{
+		/* Fetch each line segment's start and end vertices, i.e., the instance's vertex and the one following it, as per-instance attributes: */
+		const GLubyte* next=base+sizeof(Vertex);
+		glVertexAttribPointerARB(0,2,GL_FLOAT,GL_FALSE,sizeof(Vertex),base+offsetof(Vertex,position));
+		glVertexAttribPointerARB(normalAttribute,2,GL_SHORT,GL_TRUE,sizeof(Vertex),base+offsetof(Vertex,normal));
+		glVertexAttribPointerARB(endPositionAttribute,2,GL_FLOAT,GL_FALSE,sizeof(Vertex),next+offsetof(Vertex,position));
+		glVertexAttribPointerARB(endNormalAttribute,2,GL_SHORT,GL_TRUE,sizeof(Vertex),next+offsetof(Vertex,normal));
+		glVertexAttribPointerARB(colorAttribute,4,GL_UNSIGNED_BYTE,GL_TRUE,sizeof(Vertex),base+offsetof(Vertex,color));
+		glVertexAttribPointerARB(lineWidthAttribute,1,GL_FLOAT,GL_FALSE,sizeof(Vertex),base+offsetof(Vertex,lineWidth));
+		}
+	else
+		{
+		glVertexAttribPointerARB(normalAttribute,2,GL_SHORT,GL_TRUE,sizeof(Vertex),base+offsetof(Vertex,normal));
+		glVertexPointer(2,GL_FLOAT,sizeof(Vertex),base+offsetof(Vertex,position));
+		glColorPointer(4,GL_UNSIGNED_BYTE,sizeof(Vertex),base+offsetof(Vertex,color));
+		glTexCoordPointer(1,GL_FLOAT,sizeof(Vertex),base+offsetof(Vertex,lineWidth));
+		}
+	}
+
+void PolylineRenderer::DataItem::bindMemoryBlock(const PolylineRenderer::DataItem::MemoryBlock* memoryBlock)
+	{
+	/* Check if the memory block is not already bound: */
+	if(currentBufferId!=memoryBlock->bufferId)
+		{
+		/* Draw all pending polylines from the previously bound memory block: */
+		flush();
+		
+		/* Bind the memory block: */
+		currentBufferId=memoryBlock->bufferId;
+		glBindBufferARB(GL_ARRAY_BUFFER_ARB,currentBufferId);
+		
+		/* Reset the vertex pointers into the new memory block: */
+		setVertexPointers(static_cast<const GLubyte*>(0));
 		}
+	}
+
+void PolylineRenderer::DataItem::setVertexTranslation(const Vector& newVertexTranslation)
+	{
+	if(vertexTranslation!=newVertexTranslation)
+		{
+		/* Draw all pending polylines with the previous translation: */
+		flush();
+		
+		/* Upload the new translation: */
+		vertexTranslation=newVertexTranslation;
+		glUniform3fARB(uniforms[2],vertexTranslation[0],vertexTranslation[1],vertexTranslation[2]);
+		}
+	}
+
+void PolylineRenderer::DataItem::advanceStaging(void)
+	{
+	/* Fence the current segment so that it is not overwritten before the GPU copied out of it: */
+	stagingFences[stagingSegment]=glFenceSyncProc(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
 	
-	/* Check if no chunk was found: */
-	if(bestSize==~size_t(0))
+	/* Go to the next segment, which the GPU might still be reading: */
+	stagingSegment=(stagingSegment+1)%numStagingSegments;
+	stagingHead=stagingSegment*stagingSegmentSize;
+	stagingReady=false;
+	}
+
+bool PolylineRenderer::DataItem::pollStaging(void)
+	{
+	/* A segment that was never fenced is free: */
+	void*& fence=stagingFences[stagingSegment];
+	if(fence==0)
+		return true;
+	
+	/* Check the segment's fence without waiting for the GPU, which would stall the frame: */
+	switch(glClientWaitSyncProc(fence,GL_SYNC_FLUSH_COMMANDS_BIT,Misc::UInt64(0)))
 		{
-		/* Create a new memory block: */
-		memoryBlocks.push_back(new MemoryBlock(1U<<20)); // 1M vertices per block
+		case GL_ALREADY_SIGNALED:
+		case GL_CONDITION_SATISFIED:
+			glDeleteSyncProc(fence);
+			fence=0;
+			return true;
+		
+		case GL_WAIT_FAILED:
+			/* The fence can not tell when the GPU is done with the segment; never write into the staging buffer again: */
+			stagingFailed=true;
+			return false;
 		
-		/* Take the new block's free chunk: */
-		bestMbIt=memoryBlocks.end()-1;
-		bestFcIt=(*bestMbIt)->freeChunks.begin();
-		bestSize=bestFcIt->size;
+		default: // GL_TIMEOUT_EXPIRED
+			return false;
+		}
+	}
+
+PolylineRenderer::DataItem::Vertex* PolylineRenderer::DataItem::reserveStaging(size_t minNumVertices,size_t maxNumVertices)
+	{
+	/* Bail out if uploads are not staged, or if the request can never fit: */
+	if(stagingBufferId==0U||stagingFailed||minNumVertices>stagingSegmentSize)
+		return 0;
+	
+	/* Start the next segment if the current one does not have enough room left: */
+	size_t segmentEnd=(stagingSegment+1)*stagingSegmentSize;
+	if(segmentEnd-stagingHead<minNumVertices)
+		{
+		advanceStaging();
+		segmentEnd=stagingHead+stagingSegmentSize;
+		}
+	
+	/* Upload directly into memory blocks for the rest of the frame if the GPU is still reading the segment: */
+	if(!stagingReady)
+		{
+		if(stagingBusy||!pollStaging())
+			{
+			stagingBusy=true;
+			return 0;
+			}
+		stagingReady=true;
 		}
 	
-	chunkFound:
+	stagingNumReserved=Misc::min(segmentEnd-stagingHead,maxNumVertices);
 	
-	/* Allocate from the found chunk: */
-	CacheItem result(*bestMbIt,bestFcIt->offset,size);
-	if(bestSize>size)
+	if(stagingMemory!=0)
 		{
-		/* Reduce the size of the found chunk: */
-		bestFcIt->offset+=size;
-		bestFcIt->size-=size;
+		/* Write directly into the persistently-mapped staging buffer: */
+		return stagingMemory+stagingHead;
 		}
 	else
 		{
-		/* Remove the found chunk from the free chunk list: */
-		(*bestMbIt)->freeChunks.erase(bestFcIt);
+		/* Map the reserved range without waiting for the GPU, as fences protect it from pending copies: */
+		glBindBufferARB(GL_COPY_READ_BUFFER,stagingBufferId);
+		void* result=glMapBufferRangeProc(GL_COPY_READ_BUFFER,stagingHead*sizeof(Vertex),stagingNumReserved*sizeof(Vertex),GL_MAP_WRITE_BIT|GL_MAP_INVALIDATE_RANGE_BIT|GL_MAP_UNSYNCHRONIZED_BIT);
+		glBindBufferARB(GL_COPY_READ_BUFFER,0);
+		return static_cast<Vertex*>(result);
 		}
+	}
+
+void PolylineRenderer::DataItem::commitStaging(size_t numVertices,const PolylineRenderer::DataItem::MemoryBlock* destBlock,size_t destOffset)
+	{
+	/* Unmap the reserved range if it was mapped for this upload: */
+	glBindBufferARB(GL_COPY_READ_BUFFER,stagingBufferId);
+	if(stagingMemory==0)
+		glUnmapBufferARB(GL_COPY_READ_BUFFER);
 	
-	return result;
+	if(numVertices>0)
+		{
+		/* Copy the staged vertices into place using the dedicated copy buffer bindings: */
+		glBindBufferARB(GL_COPY_WRITE_BUFFER,destBlock->bufferId);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER,GL_COPY_WRITE_BUFFER,stagingHead*sizeof(Vertex),destOffset*sizeof(Vertex),numVertices*sizeof(Vertex));
+		glBindBufferARB(GL_COPY_WRITE_BUFFER,0);
+		}
+	glBindBufferARB(GL_COPY_READ_BUFFER,0);
+	
+	/* End the reservation: */
+	stagingHead+=numVertices;
+	stagingNumReserved=0;
 	}
 
-PolylineRenderer::DataItem::CacheItem PolylineRenderer::DataItem::allocateLargest(size_t minSize)
+void PolylineRenderer::DataItem::continueStagedUpload(void)
 	{
-	/* Find the largest free memory chunk: */
-	std::vector<MemoryBlock*>::iterator bestMbIt;
-	std::vector<MemoryBlock::FreeChunk>::iterator bestFcIt;
-	size_t bestSize=0U;
-	for(std::vector<MemoryBlock*>::iterator mbIt=memoryBlocks.begin();mbIt!=memoryBlocks.end();++mbIt)
+	size_t numStaged=size_t(uploadPtr-uploadStagingStart);
+	if(uploadNumCommitted+numStaged==uploadItem->size)
 		{
-		for(std::vector<MemoryBlock::FreeChunk>::iterator fcIt=(*mbIt)->freeChunks.begin();fcIt!=(*mbIt)->freeChunks.end();++fcIt)
+		/* Allocate another memory chunk: */
+		CacheItem newItem=allocateLargest(uploadCacheId,((uploadNumCommitted+numStaged)*4U)/3U+1U); // Geometric growth to achieve O(N) upload time
+		newItem.version=uploadItem->version;
+		newItem.color=uploadItem->color;
+		newItem.lineWidth=uploadItem->lineWidth;
+		
+		/* Copy the already-committed vertices from the current into the new memory chunk; the staged ones go straight into the new chunk: */
+		if(uploadNumCommitted>0)
+			copy(uploadItem->memoryBlock,uploadItem->offset,newItem.memoryBlock,newItem.offset,uploadNumCommitted);
+		
+		/* Bind the polyline's new memory block: */
+		bindMemoryBlock(newItem.memoryBlock);
+		
+		/* Release the current memory chunk and install the new one: */
+		release(*uploadItem);
+		*uploadItem=newItem;
+		}
+	
+	/* Copy the staged vertices into the memory chunk: */
+	commitStaging(numStaged,uploadItem->memoryBlock,uploadItem->offset+uploadNumCommitted);
+	uploadNumCommitted+=numStaged;
+	
+	/* Reserve more room in the staging buffer: */
+	size_t numRemaining=uploadItem->size-uploadNumCommitted;
+	uploadStagingStart=reserveStaging(Misc::min(numRemaining,size_t(256)),numRemaining);
+	if(uploadStagingStart!=0)
+		{
+		uploadPtr=uploadStagingStart;
+		uploadEnd=uploadPtr+stagingNumReserved;
+		}
+	else
+		{
+		/* Write the remaining vertices directly into the memory chunk, which is bound, while the GPU is still reading the staging buffer: */
+		uploadPtr=static_cast<Vertex*>(glMapBufferARB(GL_ARRAY_BUFFER_ARB,GL_WRITE_ONLY));
+		uploadPtr+=uploadItem->offset+uploadNumCommitted;
+		uploadEnd=uploadPtr+numRemaining;
+		}
+	}
+
+void PolylineRenderer::DataItem::flush(void)
+	{
+	if(!batchFirsts.empty())
+		{
+		if(instancedLines)
 			{
-			if(bestSize<fcIt->size)
+			/* Create one indirect draw command per pending polyline, drawing one quad strip instance per line segment: */
+			batchCommands.resize(batchFirsts.size());
+			for(size_t i=0;i<batchFirsts.size();++i)
 				{
-				/* Tentatively take this chunk: */
-				bestMbIt=mbIt;
-				bestFcIt=fcIt;
-				bestSize=fcIt->size;
+				DrawCommand& dc=batchCommands[i];
+				dc.count=8U;
+				dc.instanceCount=GLuint(batchCounts[i]-1); // Polylines use at least two vertices
+				dc.first=0U;
+				dc.baseInstance=GLuint(batchFirsts[i]);
 				}
+			
+			/* Draw all pending polylines as instanced line segments: */
+			glBindBufferARB(GL_DRAW_INDIRECT_BUFFER,indirectBufferId);
+			glBufferDataARB(GL_DRAW_INDIRECT_BUFFER,batchCommands.size()*sizeof(DrawCommand),&batchCommands.front(),GL_STREAM_DRAW_ARB);
+			glMultiDrawArraysIndirectProc(GL_TRIANGLE_STRIP,0,GLsizei(batchCommands.size()),0);
+			glBindBufferARB(GL_DRAW_INDIRECT_BUFFER,0);
+			SKETCHPAD_STATS_LOCAL_COUNT(stats,PolylineDrawCalls,1U);
 			}
+		
+		/* Draw all pending polylines as line strips: */
+		else if(glMultiDrawArraysProc!=0)
+			{
+			glMultiDrawArraysProc(GL_LINE_STRIP,&batchFirsts.front(),&batchCounts.front(),GLsizei(batchFirsts.size()));
+			SKETCHPAD_STATS_LOCAL_COUNT(stats,PolylineDrawCalls,1U);
+			}
+		else
+			{
+			for(size_t i=0;i<batchFirsts.size();++i)
+				glDrawArrays(GL_LINE_STRIP,batchFirsts[i],batchCounts[i]);
+			SKETCHPAD_STATS_LOCAL_COUNT(stats,PolylineDrawCalls,(unsigned int)(batchFirsts.size()));
+			}
+		
+		/* Clear the list of pending polylines: */
+		batchFirsts.clear();
+		batchCounts.clear();
 		}
+	}
+
+void PolylineRenderer::DataItem::drawSingle(const PolylineRenderer::DataItem::CacheItem& cacheItem,const Color& color,Scalar lineWidth)
+	{
+	/* Draw all pending polylines first to retain drawing order: */
+	flush();
 	
-	/* Check if no appropriate chunk was found: */
-	if(bestSize<minSize)
+	if(instancedLines)
 		{
-		/* Create a new memory block: */
-		memoryBlocks.push_back(new MemoryBlock(1U<<20)); // 1M vertices per block
+		/* Replace the polyline's stored color and line width with the given ones: */
+		glDisableVertexAttribArrayARB(colorAttribute);
+		glDisableVertexAttribArrayARB(lineWidthAttribute);
+		glVertexAttrib4NubARB(colorAttribute,color[0],color[1],color[2],color[3]);
+		glVertexAttrib1fARB(lineWidthAttribute,GLfloat(lineWidth));
+		
+		/* Draw the polyline as instanced line segments: */
+		queue(cacheItem);
+		flush();
 		
-		/* Take the new block's free chunk: */
-		bestMbIt=memoryBlocks.end()-1;
-		bestFcIt=(*bestMbIt)->freeChunks.begin();
-		bestSize=bestFcIt->size;
+		/* Return to per-segment colors and line widths: */
+		glEnableVertexAttribArrayARB(colorAttribute);
+		glEnableVertexAttribArrayARB(lineWidthAttribute);
+		}
+	else
+		{
+		/* Replace the polyline's stored color and line width with the given ones: */
+		glDisableClientState(GL_COLOR_ARRAY);
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glColor(color);
+		glTexCoord1f(GLfloat(lineWidth));
+		
+		/* Draw the polyline as a line strip: */
+		glDrawArrays(GL_LINE_STRIP,cacheItem.offset,cacheItem.numVertices);
+		SKETCHPAD_STATS_LOCAL_COUNT(stats,PolylineDrawCalls,1U);
+		
+		/* Return to per-vertex colors and line widths: */
+		glEnableClientState(GL_COLOR_ARRAY);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 		}
-	
-	/* Allocate the entire found chunk: */
-	CacheItem result(*bestMbIt,bestFcIt->offset,bestSize);
-	
-	/* Remove the found chunk from the free chunk list: */
-	(*bestMbIt)->freeChunks.erase(bestFcIt);
-	
-	return result;
 	}
 
-void PolylineRenderer::DataItem::release(const PolylineRenderer::DataItem::CacheItem& cacheItem)
+void PolylineRenderer::DataItem::drawInstanced(const PolylineRenderer::Polyline& polyline,const Color& color,Scalar lineWidth)
 	{
-	/* Find the appropriate slot in the memory block's free chunk list: */
-	std::vector<MemoryBlock::FreeChunk>& freeChunks=cacheItem.memoryBlock->freeChunks;
-	std::vector<MemoryBlock::FreeChunk>::iterator fcIt;
-	for(fcIt=freeChunks.begin();fcIt!=freeChunks.end()&&fcIt->offset<cacheItem.offset;++fcIt)
-		;
+	/* Calculate the polyline's vertices; polylines use at least two vertices: */
+	size_t numVertices=Misc::max(polyline.size(),size_t(2));
+	uploadBuffer.resize(numVertices);
+	writeVertices(polyline,color,lineWidth,&uploadBuffer.front());
 	
-	/* Check if the new free chunk can be merged with the free chunks to the left and/or right of it: */
-	bool mergeLeft=fcIt!=freeChunks.begin()&&fcIt[-1].offset+fcIt[-1].size==cacheItem.offset;
-	bool mergeRight=fcIt!=freeChunks.end()&&fcIt->offset==cacheItem.offset+cacheItem.size;
-	if(mergeLeft&&mergeRight)
+	/* Draw the polyline's line segments from client memory: */
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB,0U);
+	currentBufferId=0U;
+	setVertexPointers(reinterpret_cast<const GLubyte*>(&uploadBuffer.front()));
+	glDrawArraysInstancedProc(GL_TRIANGLE_STRIP,0,8,GLsizei(numVertices-1));
+	SKETCHPAD_STATS_LOCAL_COUNT(stats,PolylineDrawCalls,1U);
+	}
+
+void PolylineRenderer::DataItem::writeVertices(const PolylineRenderer::Polyline& polyline,const Color& color,Scalar lineWidth,PolylineRenderer::DataItem::Vertex* vPtr)
+	{
+	if(polyline.size()>2)
 		{
-		/* Increase the size of the free chunk to the left: */
-		fcIt[-1].size+=cacheItem.size+fcIt->size;
+		/* Write a line strip: */
+		Polyline::const_iterator p0It=polyline.begin();
+		vPtr->set(Vector::zero,*p0It,color,lineWidth);
+		++vPtr;
 		
-		/* Remove the free chunk to the right: */
-		freeChunks.erase(fcIt);
-		}
-	else if(mergeLeft)
-		{
-		/* Increase the size of the free chunk to the left: */
-		fcIt[-1].size+=cacheItem.size;
+		Polyline::const_iterator p1It=p0It+1;
+		Vector v0=*p1It-*p0It;
+		v0.normalize();
+		for(p0It=p1It,++p1It;p1It!=polyline.end();p0It=p1It,++p1It)
+			{
+			/* Calculate the separating normal vector between the two adjacent line segments: */
+			Vector v1=*p1It-*p0It;
+			v1.normalize();
+			vPtr->set(v0*v1>=Scalar(0)?v0+v1:Vector::zero,*p0It,color,lineWidth);
+			++vPtr;
+			
+			/* Go to the next line segment: */
+			v0=v1;
+			}
+		
+		vPtr->set(Vector::zero,*p0It,color,lineWidth);
 		}
-	else if(mergeRight)
+	else if(polyline.size()==2)
 		{
-		/* Increase the size of the free chunk to the right: */
-		fcIt->offset-=cacheItem.size;
-		fcIt->size+=cacheItem.size;
+		/* Write a single line segment: */
+		vPtr[0].set(Vector::zero,polyline[0],color,lineWidth);
+		vPtr[1].set(Vector::zero,polyline[1],color,lineWidth);
 		}
 	else
 		{
-		/* Insert a new free chunk into the list: */
-		freeChunks.insert(fcIt,MemoryBlock::FreeChunk(cacheItem.offset,cacheItem.size));
+		/* Write a line segment with identical end points: */
+		vPtr[0].set(Vector::zero,polyline[0],color,lineWidth);
+		vPtr[1].set(Vector::zero,polyline[0],color,lineWidth);
 		}
 	}
 
@@ -338,18 +935,71 @@ Static elements of class PolylineRenderer:
 
 PolylineRenderer* PolylineRenderer::theRenderer=0;
 Threads::Atomic<unsigned int> PolylineRenderer::refCount(0);
+Threads::Spinlock PolylineRenderer::contextsMutex;
+std::vector<PolylineRenderer::DataItem*> PolylineRenderer::contexts;
+Threads::Atomic<unsigned int> PolylineRenderer::numContexts(0);
+bool PolylineRenderer::headless=false;
+
+/*******************************************
+Methods of class PolylineRenderer::CacheKey:
+*******************************************/
+
+PolylineRenderer::CacheKey::~CacheKey(void)
+	{
+	/* Drop the shared cached vertices: */
+	if(theRenderer!=0)
+		theRenderer->drop(this);
+	}
 
 /*********************************
 Methods of class PolylineRenderer:
 *********************************/
 
+void PolylineRenderer::dropSharedVertices(const void* cacheId,bool staleOnly)
+	{
+	Threads::Mutex::Lock sharedVerticesLock(sharedVerticesMutex);
+	
+	/* Release stale shared vertices only from the first OpenGL context to start a new frame: */
+	double frameTime=staleOnly?Vrui::getApplicationTime():0.0;
+	if(staleOnly)
+		{
+		if(sharedVerticesExpiryTime==frameTime)
+			return;
+		sharedVerticesExpiryTime=frameTime;
+		}
+	
+	/* Collect the matching shared vertices first, as removing entries invalidates iterators: */
+	std::vector<SharedVertexKey> keys;
+	for(SharedVertexMap::Iterator svIt=sharedVertices.begin();!svIt.isFinished();++svIt)
+		if((cacheId==0||svIt->getSource().cacheId==cacheId)&&(!staleOnly||svIt->getDest()->frameTime!=frameTime))
+			keys.push_back(svIt->getSource());
+	
+	/* Release the collected shared vertices: */
+	for(std::vector<SharedVertexKey>::iterator kIt=keys.begin();kIt!=keys.end();++kIt)
+		{
+		SharedVertexMap::Iterator svIt=sharedVertices.findEntry(*kIt);
+		delete svIt->getDest();
+		sharedVertices.removeEntry(svIt);
+		}
+	}
+
 void PolylineRenderer::cleanCache(Vrui::PreRenderingCallbackData* cbData)
 	{
+	/* Release shared vertices computed during earlier frames, which all OpenGL contexts that rendered those frames had the chance to copy; only the first context to render this frame scans for them: */
+	if(numContexts.get()>1)
+		dropSharedVertices(0,true);
+	
 	/* Retrieve the context data item: */
 	DataItem* dataItem=cbData->contextData.retrieveDataItem<DataItem>(this);
 	
-	/* Process the drop list: */
-	for(std::vector<const void*>::const_iterator dlIt=dropList.begin();dlIt!=dropList.end();++dlIt)
+	/* Take over the context's drop queue, so that other threads can keep dropping items while it is processed: */
+	{
+	Threads::Spinlock::Lock dropQueueLock(dataItem->dropQueueMutex);
+	std::swap(dataItem->dropQueue,dataItem->dropItems);
+	}
+	
+	/* Process the dropped items: */
+	for(std::vector<const void*>::const_iterator dlIt=dataItem->dropItems.begin();dlIt!=dataItem->dropItems.end();++dlIt)
 		{
 		DataItem::CacheMap::Iterator cmIt=dataItem->cacheMap.findEntry(*dlIt);
 		if(!cmIt.isFinished())
@@ -361,27 +1011,39 @@ void PolylineRenderer::cleanCache(Vrui::PreRenderingCallbackData* cbData)
 			dataItem->cacheMap.removeEntry(cmIt);
 			}
 		}
-	}
-
-void PolylineRenderer::clearDropList(Misc::CallbackData*)
-	{
-	/* Clear the drop list: */
-	dropList.clear();
+	dataItem->dropItems.clear();
+	
+	/* Incrementally compact the cache, copying at most 64K vertices per frame: */
+	dataItem->compact(1U<<16);
+	
+	/* Fence the staging buffer segment filled during the previous frame, and poll a busy segment again during this frame: */
+	if(dataItem->stagingBufferId!=0U&&dataItem->stagingHead!=dataItem->stagingSegment*DataItem::stagingSegmentSize)
+		dataItem->advanceStaging();
+	dataItem->stagingBusy=false;
 	}
 
 PolylineRenderer::PolylineRenderer(void)
-	:scaleFactor(1)
+	:scaleFactor(1),
+	 sharedVertices(17),sharedVerticesExpiryTime(-1.0)
 	{
-	/* Install callbacks with the Vrui kernel: */
-	Vrui::getPreRenderingCallbacks().add(this,&PolylineRenderer::cleanCache);
-	Vrui::getPostRenderingCallbacks().add(this,&PolylineRenderer::clearDropList);
+	if(!headless)
+		{
+		/* Install callbacks with the Vrui kernel: */
+		Vrui::getPreRenderingCallbacks().add(this,&PolylineRenderer::cleanCache);
+		}
 	}
 
 PolylineRenderer::~PolylineRenderer(void)
 	{
-	/* Remove callbacks from the Vrui kernel: */
-	Vrui::getPreRenderingCallbacks().remove(this,&PolylineRenderer::cleanCache);
-	Vrui::getPostRenderingCallbacks().remove(this,&PolylineRenderer::clearDropList);
+	if(!headless)
+		{
+		/* Remove callbacks from the Vrui kernel: */
+		Vrui::getPreRenderingCallbacks().remove(this,&PolylineRenderer::cleanCache);
+		}
+	
+	/* Delete all shared vertices: */
+	for(SharedVertexMap::Iterator svIt=sharedVertices.begin();!svIt.isFinished();++svIt)
+		delete svIt->getDest();
 	}
 
 void PolylineRenderer::initContext(GLContextData& contextData) const
@@ -390,64 +1052,110 @@ void PolylineRenderer::initContext(GLContextData& contextData) const
 	DataItem* dataItem=new DataItem(contextData);
 	contextData.addDataItem(this,dataItem);
 	
-	/* Create the polyline rendering shader: */
-	GLhandleARB vertexShader=glCompileVertexShaderFromFile(SKETCHPAD_SHADERDIR "/CurveRenderer.vs");
-	glAttachObjectARB(dataItem->lineShader,vertexShader);
-	glDeleteObjectARB(vertexShader);
-	
-	GLhandleARB geometryShader=0;
-	if(dataItem->haveCoreGeometryShaders)
-		{
-		/* Create a core OpenGL geometry shader: */
-		geometryShader=glCompileARBGeometryShader4FromFile(SKETCHPAD_SHADERDIR "/CurveRendererCore.gs");
-		}
+	/* Select the shaders making up the polyline rendering shader: */
+	const char* vertexShaderName=SKETCHPAD_SHADERDIR "/CurveRenderer.vs";
+	const char* geometryShaderName=0;
+	const char* fragmentShaderName=SKETCHPAD_SHADERDIR "/CurveRenderer.fs";
+	if(dataItem->instancedLines)
+		vertexShaderName=SKETCHPAD_SHADERDIR "/CurveRendererInstanced.vs";
+	else if(dataItem->haveCoreGeometryShaders)
+		geometryShaderName=SKETCHPAD_SHADERDIR "/CurveRendererCore.gs";
 	else
+		geometryShaderName=SKETCHPAD_SHADERDIR "/CurveRendererARB.gs";
+	
+	/* Install a cached binary of the polyline rendering shader if there is one: */
+	ProgramCache programCache(contextData.getContext(),dataItem->lineShader);
+	programCache.addSource(vertexShaderName);
+	if(geometryShaderName!=0)
+		programCache.addSource(geometryShaderName);
+	programCache.addSource(fragmentShaderName);
+	if(!programCache.load())
 		{
-		/* Create an ARB geometry shader: */
-		geometryShader=glCompileARBGeometryShader4FromFile(SKETCHPAD_SHADERDIR "/CurveRendererARB.gs");
+		/* Create the polyline rendering shader from source: */
+		GLhandleARB vertexShader=glCompileVertexShaderFromFile(vertexShaderName);
+		glAttachObjectARB(dataItem->lineShader,vertexShader);
+		glDeleteObjectARB(vertexShader);
+		
+		if(dataItem->instancedLines)
+			{
+			/* Bind the attributes of the vertex shader expanding each line segment instance into a quad strip: */
+			glBindAttribLocationARB(dataItem->lineShader,0,"segmentStart");
+			glBindAttribLocationARB(dataItem->lineShader,DataItem::normalAttribute,"segmentStartNormal");
+			glBindAttribLocationARB(dataItem->lineShader,DataItem::endPositionAttribute,"segmentEnd");
+			glBindAttribLocationARB(dataItem->lineShader,DataItem::endNormalAttribute,"segmentEndNormal");
+			glBindAttribLocationARB(dataItem->lineShader,DataItem::colorAttribute,"segmentColor");
+			glBindAttribLocationARB(dataItem->lineShader,DataItem::lineWidthAttribute,"segmentLineWidth");
+			}
+		else
+			{
+			/* Create a core OpenGL or ARB geometry shader: */
+			GLhandleARB geometryShader=glCompileARBGeometryShader4FromFile(geometryShaderName);
+			if(!dataItem->haveCoreGeometryShaders)
+				{
+				glProgramParameteriARB(dataItem->lineShader,GL_GEOMETRY_INPUT_TYPE_ARB,GL_LINES);
+				glProgramParameteriARB(dataItem->lineShader,GL_GEOMETRY_OUTPUT_TYPE_ARB,GL_TRIANGLE_STRIP);
+				glProgramParameteriARB(dataItem->lineShader,GL_GEOMETRY_VERTICES_OUT_ARB,8);
+				}
+			glAttachObjectARB(dataItem->lineShader,geometryShader);
+			glDeleteObjectARB(geometryShader);
+			
+			glBindAttribLocationARB(dataItem->lineShader,DataItem::normalAttribute,"vertexNormal");
+			}
+		
+		GLhandleARB fragmentShader=glCompileFragmentShaderFromFile(fragmentShaderName);
+		glAttachObjectARB(dataItem->lineShader,fragmentShader);
+		glDeleteObjectARB(fragmentShader);
 		
-		glProgramParameteriARB(dataItem->lineShader,GL_GEOMETRY_INPUT_TYPE_ARB,GL_LINES);
-		glProgramParameteriARB(dataItem->lineShader,GL_GEOMETRY_OUTPUT_TYPE_ARB,GL_TRIANGLE_STRIP);
-		glProgramParameteriARB(dataItem->lineShader,GL_GEOMETRY_VERTICES_OUT_ARB,8);
+		/* Link the shader and cache its binary for other contexts and future runs: */
+		programCache.prepareLink();
+		glLinkAndTestShader(dataItem->lineShader);
+		programCache.store();
 		}
-	glAttachObjectARB(dataItem->lineShader,geometryShader);
-	glDeleteObjectARB(geometryShader);
-	
-	GLhandleARB fragmentShader=glCompileFragmentShaderFromFile(SKETCHPAD_SHADERDIR "/CurveRenderer.fs");
-	glAttachObjectARB(dataItem->lineShader,fragmentShader);
-	glDeleteObjectARB(fragmentShader);
-	
-	glLinkAndTestShader(dataItem->lineShader);
-	dataItem->uniforms[0]=glGetUniformLocationARB(dataItem->lineShader,"lineWidth");
+	dataItem->uniforms[0]=glGetUniformLocationARB(dataItem->lineShader,"lineWidthScale");
 	dataItem->uniforms[1]=glGetUniformLocationARB(dataItem->lineShader,"pixelSize");
+	dataItem->uniforms[2]=glGetUniformLocationARB(dataItem->lineShader,"vertexTranslation");
 	}
 
-GLObject::DataItem* PolylineRenderer::activate(GLContextData& contextData) const
+GLObject::DataItem* PolylineRenderer::activate(RenderState& renderState) const
 	{
 	/* Retrieve the context data item: */
-	DataItem* dataItem=contextData.retrieveDataItem<DataItem>(this);
+	DataItem* dataItem=renderState.contextData.retrieveDataItem<DataItem>(this);
 	
 	/* Enable vertex array rendering: */
-	glEnableClientState(GL_NORMAL_ARRAY);
-	glEnableClientState(GL_VERTEX_ARRAY);
+	if(dataItem->instancedLines)
+		{
+		/* Advance all vertex attributes once per line segment instance: */
+		for(GLuint i=0;i<DataItem::numInstancedAttributes;++i)
+			{
+			glEnableVertexAttribArrayARB(i);
+			dataItem->glVertexAttribDivisorProc(i,1);
+			}
+		}
+	else
+		{
+		glEnableVertexAttribArrayARB(DataItem::normalAttribute);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glEnableClientState(GL_COLOR_ARRAY);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		}
 	
 	/* Activate the line rendering shader: */
 	glUseProgramObjectARB(dataItem->lineShader);
 	
-	/* Upload the current line width: */
-	glUniform1fARB(dataItem->uniforms[0],dataItem->currentLineWidth*scaleFactor);
-	
-	/* Calculate this display's pixel size in model coordinate units: */
-	const Vrui::DisplayState& ds=Vrui::getDisplayState(contextData);
-	const Vrui::Scalar* panRect=ds.window->getPanRect();
-	Vrui::Scalar pw=ds.screen->getWidth()*(panRect[1]-panRect[0])/Vrui::Scalar(ds.viewport.size[0]);
-	Vrui::Scalar ph=ds.screen->getHeight()*(panRect[3]-panRect[2])/Vrui::Scalar(ds.viewport.size[1]);
-	Vrui::Scalar pixelSize=Math::sqrt(pw*ph);
-	pixelSize*=Vrui::getInverseNavigationTransformation().getScaling();
+	/* Upload the scale factor from line widths to model space units: */
+	glUniform1fARB(dataItem->uniforms[0],scaleFactor);
 	
-	/* Upload the pixel size: */
+	/* Upload the render pass's pixel size in model coordinate units: */
+	Scalar pixelSize=renderState.getPixelSize();
 	glUniform1fARB(dataItem->uniforms[1],float(pixelSize));
 	
+	/* Allow simplified polylines that deviate from the originals by up to half a pixel: */
+	dataItem->lodTolerance=pixelSize*Scalar(0.5);
+	
+	/* Start without translating polyline vertices: */
+	dataItem->vertexTranslation=Vector::zero;
+	glUniform3fARB(dataItem->uniforms[2],0.0f,0.0f,0.0f);
+	
 	/* Return the context data item: */
 	return dataItem;
 	}
@@ -457,6 +1165,14 @@ void PolylineRenderer::deactivate(GLObject::DataItem* dataItem) const
 	/* Retrieve the data item: */
 	DataItem* myDataItem=static_cast<DataItem*>(dataItem);
 	
+	/* Draw all pending polylines: */
+	myDataItem->flush();
+	
+	#if SKETCHPAD_CONFIG_STATS
+	/* Publish the render pass's counters: */
+	myDataItem->stats.publish();
+	#endif
+	
 	/* Disable the line rendering shader: */
 	glUseProgramObjectARB(0);
 	
@@ -466,8 +1182,22 @@ void PolylineRenderer::deactivate(GLObject::DataItem* dataItem) const
 	myDataItem->currentBufferId=0U;
 	
 	/* Disable vertex array rendering: */
-	glDisableClientState(GL_NORMAL_ARRAY);
-	glDisableClientState(GL_VERTEX_ARRAY);
+	if(myDataItem->instancedLines)
+		{
+		/* Return all vertex attributes to per-vertex rendering: */
+		for(GLuint i=0;i<DataItem::numInstancedAttributes;++i)
+			{
+			myDataItem->glVertexAttribDivisorProc(i,0);
+			glDisableVertexAttribArrayARB(i);
+			}
+		}
+	else
+		{
+		glDisableVertexAttribArrayARB(DataItem::normalAttribute);
+		glDisableClientState(GL_VERTEX_ARRAY);
+		glDisableClientState(GL_COLOR_ARRAY);
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		}
 	}
 
 PolylineRenderer* PolylineRenderer::acquire(void)
@@ -489,31 +1219,161 @@ void PolylineRenderer::release(void)
 		}
 	}
 
+void PolylineRenderer::setHeadless(bool newHeadless)
+	{
+	headless=newHeadless;
+	}
+
 void PolylineRenderer::setScaleFactor(Scalar newScaleFactor)
 	{
 	scaleFactor=newScaleFactor;
 	}
 
+void PolylineRenderer::simplify(const PolylineRenderer::Polyline& polyline,Scalar tolerance,PolylineRenderer::Polyline& result)
+	{
+	result.clear();
+	size_t numPoints=polyline.size();
+	if(numPoints<=2)
+		{
+		/* Polylines with fewer than three points can not be simplified: */
+		result=polyline;
+		return;
+		}
+	
+	/* Keep the polyline's end points: */
+	std::vector<bool> keep(numPoints,false);
+	keep[0]=true;
+	keep[numPoints-1]=true;
+	
+	/* Recursively split the polyline at the points farthest away from the segments connecting the current split points, using an explicit stack: */
+	Scalar tolerance2=Math::sqr(tolerance);
+	std::vector<std::pair<size_t,size_t> > ranges;
+	ranges.push_back(std::make_pair(size_t(0),numPoints-1));
+	while(!ranges.empty())
+		{
+		size_t first=ranges.back().first;
+		size_t last=ranges.back().second;
+		ranges.pop_back();
+		
+		/* Find the interior point farthest away from the segment connecting the range's end points: */
+		const Point& p0=polyline[first];
+		Vector d=polyline[last]-p0;
+		Scalar dLen2=d.sqr();
+		Scalar maxDist2(0);
+		size_t maxIndex=first;
+		for(size_t i=first+1;i<last;++i)
+			{
+			Vector v=polyline[i]-p0;
+			Scalar t=v*d;
+			Scalar dist2;
+			if(t<=Scalar(0)||dLen2==Scalar(0))
+				dist2=v.sqr();
+			else if(t>=dLen2)
+				dist2=Geometry::sqrDist(polyline[i],polyline[last]);
+			else
+				dist2=v.sqr()-t*t/dLen2;
+			if(maxDist2<dist2)
+				{
+				maxDist2=dist2;
+				maxIndex=i;
+				}
+			}
+		
+		/* Split the range at the farthest point if it is outside the tolerance: */
+		if(maxDist2>tolerance2)
+			{
+			keep[maxIndex]=true;
+			if(maxIndex-first>1)
+				ranges.push_back(std::make_pair(first,maxIndex));
+			if(last-maxIndex>1)
+				ranges.push_back(std::make_pair(maxIndex,last));
+			}
+		}
+	
+	/* Collect all kept points: */
+	for(size_t i=0;i<numPoints;++i)
+		if(keep[i])
+			result.push_back(polyline[i]);
+	}
+
+void PolylineRenderer::createLodTiers(const PolylineRenderer::Polyline& polyline,PolylineRenderer::LodTierList& lodTiers)
+	{
+	lodTiers.clear();
+	
+	/* Don't bother simplifying short polylines: */
+	if(polyline.size()<32)
+		return;
+	
+	/* Calculate the polyline's extent: */
+	Box box=Box::empty;
+	for(Polyline::const_iterator pIt=polyline.begin();pIt!=polyline.end();++pIt)
+		box.addPoint(*pIt);
+	Scalar size=Geometry::dist(box.min,box.max);
+	
+	/* Create tiers of geometrically increasing tolerance by simplifying the previous tier, until the polyline degenerates into a single segment: */
+	const Polyline* prev=&polyline;
+	Scalar prevTolerance(0);
+	for(Scalar tolerance=size/Scalar(4096);prev->size()>2&&tolerance<size;tolerance*=Scalar(4))
+		{
+		Polyline simplified;
+		simplify(*prev,tolerance,simplified);
+		
+		/* Only keep tiers that reduce the number of vertices substantially: */
+		if(simplified.size()*4U<=prev->size()*3U)
+			{
+			/* Simplification errors accumulate from tier to tier: */
+			lodTiers.push_back(LodTier());
+			lodTiers.back().tolerance=prevTolerance+tolerance;
+			std::swap(lodTiers.back().polyline,simplified);
+			prev=&lodTiers.back().polyline;
+			prevTolerance=lodTiers.back().tolerance;
+			}
+		}
+	}
+
+const PolylineRenderer::Polyline& PolylineRenderer::selectLodTier(const PolylineRenderer::Polyline& polyline,const PolylineRenderer::LodTierList& lodTiers,unsigned int& lodTier,GLObject::DataItem* dataItem) const
+	{
+	/* Retrieve the data item: */
+	DataItem* myDataItem=static_cast<DataItem*>(dataItem);
+	
+	/* Find the coarsest tier whose simplification error is invisible in the current rendering pass: */
+	const Polyline* result=&polyline;
+	lodTier=0;
+	for(LodTierList::const_iterator ltIt=lodTiers.begin();ltIt!=lodTiers.end()&&ltIt->tolerance<=myDataItem->lodTolerance;++ltIt)
+		{
+		result=&ltIt->polyline;
+		++lodTier;
+		}
+	
+	return *result;
+	}
+
 void PolylineRenderer::draw(const PolylineRenderer::Polyline& polyline,const Color& color,Scalar lineWidth,GLObject::DataItem* dataItem) const
 	{
 	/* Retrieve the data item: */
 	DataItem* myDataItem=static_cast<DataItem*>(dataItem);
 	
-	/* Update the line width if necessary: */
-	if(myDataItem->currentLineWidth!=lineWidth)
+	/* Draw all pending polylines first to retain drawing order: */
+	myDataItem->flush();
+	myDataItem->setVertexTranslation(Vector::zero);
+	
+	if(myDataItem->instancedLines)
 		{
-		myDataItem->currentLineWidth=lineWidth;
-		glUniform1fARB(myDataItem->uniforms[0],myDataItem->currentLineWidth*scaleFactor);
+		/* Draw the polyline as instanced line segments, as the line rendering shader does not accept line primitives: */
+		myDataItem->drawInstanced(polyline,color,lineWidth);
+		return;
 		}
 	
 	/* Draw the polyline: */
+	SKETCHPAD_STATS_LOCAL_COUNT(myDataItem->stats,PolylineDrawCalls,1U);
 	glColor(color);
+	glTexCoord1f(GLfloat(lineWidth));
 	if(polyline.size()>2)
 		{
 		/* Draw the polyline as a line strip: */
 		glBegin(GL_LINE_STRIP);
 		Polyline::const_iterator p0It=polyline.begin();
-		glNormal3f(0.0f,0.0f,0.0f);
+		glVertexAttrib2fARB(DataItem::normalAttribute,0.0f,0.0f);
 		glVertex(*p0It);
 		
 		Polyline::const_iterator p1It=p0It+1;
@@ -525,16 +1385,16 @@ void PolylineRenderer::draw(const PolylineRenderer::Polyline& polyline,const Col
 			Vector v1=*p1It-*p0It;
 			v1.normalize();
 			if(v0*v1>=Scalar(0))
-				glNormal(v0+v1);
+				glVertexAttrib2fARB(DataItem::normalAttribute,(v0[0]+v1[0])*0.5f,(v0[1]+v1[1])*0.5f);
 			else
-				glNormal3f(0.0f,0.0f,0.0f);
+				glVertexAttrib2fARB(DataItem::normalAttribute,0.0f,0.0f);
 			glVertex(*p0It);
 			
 			/* Go to the next line segment: */
 			v0=v1;
 			}
 		
-		glNormal3f(0.0f,0.0f,0.0f);
+		glVertexAttrib2fARB(DataItem::normalAttribute,0.0f,0.0f);
 		glVertex(*p0It);
 		glEnd();
 		}
@@ -542,7 +1402,7 @@ void PolylineRenderer::draw(const PolylineRenderer::Polyline& polyline,const Col
 		{
 		/* Draw a single line segment: */
 		glBegin(GL_LINES);
-		glNormal3f(0.0f,0.0f,0.0f);
+		glVertexAttrib2fARB(DataItem::normalAttribute,0.0f,0.0f);
 		glVertex(polyline[0]);
 		glVertex(polyline[1]);
 		glEnd();
@@ -551,14 +1411,14 @@ void PolylineRenderer::draw(const PolylineRenderer::Polyline& polyline,const Col
 		{
 		/* Draw a single point as a line with identical end points: */
 		glBegin(GL_LINES);
-		glNormal3f(0.0f,0.0f,0.0f);
+		glVertexAttrib2fARB(DataItem::normalAttribute,0.0f,0.0f);
 		glVertex(polyline[0]);
 		glVertex(polyline[0]);
 		glEnd();
 		}
 	}
 
-void PolylineRenderer::draw(const void* cacheId,unsigned int version,const PolylineRenderer::Polyline& polyline,const Color& color,Scalar lineWidth,GLObject::DataItem* dataItem) const
+void PolylineRenderer::draw(const void* cacheId,unsigned int version,unsigned int lodTier,const PolylineRenderer::Polyline& polyline,const Vector& translation,const Color& color,Scalar lineWidth,GLObject::DataItem* dataItem) const
 	{
 	/* Retrieve the data item: */
 	DataItem* myDataItem=static_cast<DataItem*>(dataItem);
@@ -569,111 +1429,130 @@ void PolylineRenderer::draw(const void* cacheId,unsigned int version,const Polyl
 	if(cmIt.isFinished())
 		{
 		/* Find a memory chunk to hold the polyline's vertices: */
-		DataItem::CacheItem cacheItem=myDataItem->allocate(Misc::max(polyline.size(),size_t(2))); // Polylines use at least two vertices
+		DataItem::CacheItem cacheItem=myDataItem->allocate(cacheId,Misc::max(polyline.size(),size_t(2))); // Polylines use at least two vertices
 		
 		/* Add the polyline to the cache: */
 		cacheItem.version=version;
+		cacheItem.lodTier=lodTier;
 		cmIt=myDataItem->cacheMap.setAndFindEntry(DataItem::CacheMap::Entry(cacheId,cacheItem));
 		
 		/* Upload the polyline's vertices later: */
 		uploadPolyline=true;
 		}
-	else if(cmIt->getDest().version!=version)
+	else if(cmIt->getDest().version!=version||cmIt->getDest().lodTier!=lodTier)
 		{
 		/* Assign a different memory chunk to hold the polyline's vertices: */
 		myDataItem->release(cmIt->getDest());
-		cmIt->getDest()=myDataItem->allocate(Misc::max(polyline.size(),size_t(2))); // Polylines use at least two vertices
+		cmIt->getDest()=myDataItem->allocate(cacheId,Misc::max(polyline.size(),size_t(2))); // Polylines use at least two vertices
 		
-		/* Update the cache item's version number: */
+		/* Update the cache item's version number and level-of-detail tier: */
 		cmIt->getDest().version=version;
+		cmIt->getDest().lodTier=lodTier;
 		
 		/* Upload the polyline's vertices later: */
 		uploadPolyline=true;
 		}
+	DataItem::CacheItem& cacheItem=cmIt->getDest();
 	
-	/* Check if the polyline's vertices are in a different memory block: */
-	if(myDataItem->currentBufferId!=cmIt->getDest().memoryBlock->bufferId)
-		{
-		/* Bind the polyline's memory block: */
-		myDataItem->currentBufferId=cmIt->getDest().memoryBlock->bufferId;
-		glBindBufferARB(GL_ARRAY_BUFFER_ARB,myDataItem->currentBufferId);
-		
-		/* Reset the vertex pointers into the new memory block: */
-		glNormalPointer(GL_FLOAT,sizeof(DataItem::Vertex),static_cast<const GLfloat*>(0)+0);
-		glVertexPointer(3,GL_FLOAT,sizeof(DataItem::Vertex),static_cast<const GLfloat*>(0)+3);
-		}
+	/* Release spare room left over from a polyline that was drawn incrementally: */
+	if(!uploadPolyline)
+		myDataItem->trim(cacheItem);
+	
+	/* Bind the memory block containing the polyline's vertices: */
+	myDataItem->bindMemoryBlock(cacheItem.memoryBlock);
 	
 	/* Upload the polyline's vertices to the assigned memory chunk if necessary: */
 	if(uploadPolyline)
 		{
-		DataItem::Vertex* vPtr=static_cast<DataItem::Vertex*>(glMapBufferARB(GL_ARRAY_BUFFER_ARB,GL_WRITE_ONLY));
-		vPtr+=cmIt->getDest().offset;
-		if(polyline.size()>2)
+		/* Store the polyline's color, line width, and current translation with its vertices: */
+		cacheItem.color=color;
+		cacheItem.lineWidth=lineWidth;
+		cacheItem.translation=translation;
+		
+		/* Write the vertices into the staging buffer if possible, or directly into the memory block otherwise: */
+		DataItem::Vertex* vPtr=myDataItem->reserveStaging(cacheItem.numVertices,cacheItem.numVertices);
+		bool staged=vPtr!=0;
+		if(!staged)
 			{
-			/* Draw a line strip: */
-			Polyline::const_iterator p0It=polyline.begin();
-			vPtr->normal=Vector::zero;
-			vPtr->position=*p0It;
-			++vPtr;
-			
-			Polyline::const_iterator p1It=p0It+1;
-			Vector v0=*p1It-*p0It;
-			v0.normalize();
-			for(p0It=p1It,++p1It;p1It!=polyline.end();p0It=p1It,++p1It)
+			vPtr=static_cast<DataItem::Vertex*>(glMapBufferARB(GL_ARRAY_BUFFER_ARB,GL_WRITE_ONLY));
+			vPtr+=cacheItem.offset;
+			}
+		if(numContexts.get()>1)
+			{
+			/* Copy the polyline's vertices if another OpenGL context already computed them during the current frame: */
+			SharedVertexKey key(cacheId,lodTier);
+			double frameTime=Vrui::getApplicationTime();
+			bool copied=false;
+			{
+			Threads::Mutex::Lock sharedVerticesLock(sharedVerticesMutex);
+			SharedVertexMap::Iterator svIt=sharedVertices.findEntry(key);
+			if(!svIt.isFinished()&&svIt->getDest()->matches(frameTime,version,color,lineWidth)&&svIt->getDest()->vertices.size()==cacheItem.numVertices)
 				{
-				/* Calculate the separating normal vector between the two adjacent line segments: */
-				Vector v1=*p1It-*p0It;
-				v1.normalize();
-				if(v0*v1>=Scalar(0))
-					vPtr->normal=(v0+v1);
-				else
-					vPtr->normal=Vector::zero;
-				vPtr->position=*p0It;
-				++vPtr;
+				memcpy(vPtr,&svIt->getDest()->vertices.front(),cacheItem.numVertices*sizeof(DataItem::Vertex));
 				
-				/* Go to the next line segment: */
-				v0=v1;
+				/* The copied vertices are offset by the translation at the time they were computed: */
+				cacheItem.translation=svIt->getDest()->translation;
+				copied=true;
 				}
-			
-			vPtr->normal=Vector::zero;
-			vPtr->position=*p0It;
-			++vPtr;
 			}
-		else if(polyline.size()==2)
-			{
-			/* Draw a single line segment: */
-			vPtr->normal=Vector::zero;
-			vPtr->position=polyline[0];
-			++vPtr;
-			vPtr->normal=Vector::zero;
-			vPtr->position=polyline[1];
-			++vPtr;
+			
+			if(copied)
+				SKETCHPAD_STATS_LOCAL_COUNT(myDataItem->stats,PolylineSharedVertexCopies,1U);
+			else
+				{
+				/* Compute the polyline's vertices without holding the lock, and copy them into the vertex buffer: */
+				SharedVertices* sv=new SharedVertices;
+				sv->frameTime=frameTime;
+				sv->version=version;
+				sv->translation=translation;
+				sv->color=color;
+				sv->lineWidth=lineWidth;
+				sv->vertices.resize(cacheItem.numVertices);
+				DataItem::writeVertices(polyline,color,lineWidth,&sv->vertices.front());
+				memcpy(vPtr,&sv->vertices.front(),cacheItem.numVertices*sizeof(DataItem::Vertex));
+				
+				/* Share the vertices with the other contexts unless another context shared matching vertices in the meantime: */
+				{
+				Threads::Mutex::Lock sharedVerticesLock(sharedVerticesMutex);
+				SharedVertexMap::Iterator svIt=sharedVertices.findEntry(key);
+				if(svIt.isFinished())
+					{
+					sharedVertices.setEntry(SharedVertexMap::Entry(key,sv));
+					sv=0;
+					}
+				else if(!svIt->getDest()->matches(frameTime,version,color,lineWidth))
+					std::swap(svIt->getDest(),sv);
+				}
+				delete sv;
+				}
 			}
 		else
 			{
-			/* Draw a line segment with identical end points: */
-			vPtr->normal=Vector::zero;
-			vPtr->position=polyline[0];
-			++vPtr;
-			vPtr->normal=Vector::zero;
-			vPtr->position=polyline[0];
-			++vPtr;
+			/* Compute the polyline's vertices directly into the vertex buffer: */
+			DataItem::writeVertices(polyline,color,lineWidth,vPtr);
 			}
-		glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+		if(staged)
+			myDataItem->commitStaging(cacheItem.numVertices,cacheItem.memoryBlock,cacheItem.offset);
+		else
+			glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+		SKETCHPAD_STATS_LOCAL_COUNT(myDataItem->stats,PolylineCacheMisses,1U);
+		SKETCHPAD_STATS_LOCAL_COUNT(myDataItem->stats,PolylineUploadBytes,(unsigned int)(cacheItem.numVertices*sizeof(DataItem::Vertex)));
 		}
 	
-	/* Update the line width if necessary: */
-	if(myDataItem->currentLineWidth!=lineWidth)
+	/* Move the cached vertices by the translation the polyline underwent since they were uploaded: */
+	myDataItem->setVertexTranslation(translation-cacheItem.translation);
+	
+	/* Check if the polyline is drawn with the color and line width stored in its vertices: */
+	if(cacheItem.matches(color,lineWidth))
 		{
-		myDataItem->currentLineWidth=lineWidth;
-		glUniform1fARB(myDataItem->uniforms[0],myDataItem->currentLineWidth*scaleFactor);
+		/* Draw the polyline together with all other pending polylines from the same memory block: */
+		myDataItem->queue(cacheItem);
+		}
+	else
+		{
+		/* Draw the polyline immediately with the given color and line width: */
+		myDataItem->drawSingle(cacheItem,color,lineWidth);
 		}
-	
-	/* Set the color: */
-	glColor(color);
-	
-	/* Draw the polyline as a line strip: */
-	glDrawArrays(GL_LINE_STRIP,cmIt->getDest().offset,cmIt->getDest().size);
 	}
 
 bool PolylineRenderer::draw(const void* cacheId,unsigned int version,const Color& color,Scalar lineWidth,GLObject::DataItem* dataItem) const
@@ -687,7 +1566,7 @@ bool PolylineRenderer::draw(const void* cacheId,unsigned int version,const Color
 	if(cmIt.isFinished())
 		{
 		/* Find the largest available memory chunk to hold the polyline's vertices: */
-		DataItem::CacheItem cacheItem=myDataItem->allocateLargest(2U); // Every polyline has at least two vertices
+		DataItem::CacheItem cacheItem=myDataItem->allocateLargest(cacheId,2U); // Every polyline has at least two vertices
 		
 		/* Add the polyline to the cache: */
 		cacheItem.version=version;
@@ -702,7 +1581,7 @@ bool PolylineRenderer::draw(const void* cacheId,unsigned int version,const Color
 		myDataItem->release(cmIt->getDest());
 		
 		/* Find the largest available memory chunk to hold the polyline's vertices: */
-		cmIt->getDest()=myDataItem->allocateLargest(2U); // Every polyline has at least two vertices
+		cmIt->getDest()=myDataItem->allocateLargest(cacheId,2U); // Every polyline has at least two vertices
 		
 		/* Update the cache item's version number: */
 		cmIt->getDest().version=version;
@@ -710,45 +1589,52 @@ bool PolylineRenderer::draw(const void* cacheId,unsigned int version,const Color
 		/* Upload the polyline's vertices later: */
 		uploadPolyline=true;
 		}
+	DataItem::CacheItem& cacheItem=cmIt->getDest();
 	
-	/* Check if the polyline's vertices are in a different memory block: */
-	if(myDataItem->currentBufferId!=cmIt->getDest().memoryBlock->bufferId)
-		{
-		/* Bind the polyline's memory block: */
-		myDataItem->currentBufferId=cmIt->getDest().memoryBlock->bufferId;
-		glBindBufferARB(GL_ARRAY_BUFFER_ARB,myDataItem->currentBufferId);
-		
-		/* Reset the vertex pointers into the new memory block: */
-		glNormalPointer(GL_FLOAT,sizeof(DataItem::Vertex),static_cast<const GLfloat*>(0)+0);
-		glVertexPointer(3,GL_FLOAT,sizeof(DataItem::Vertex),static_cast<const GLfloat*>(0)+3);
-		}
-	
-	/* Update the line width if necessary: */
-	if(myDataItem->currentLineWidth!=lineWidth)
-		{
-		myDataItem->currentLineWidth=lineWidth;
-		glUniform1fARB(myDataItem->uniforms[0],myDataItem->currentLineWidth*scaleFactor);
-		}
+	/* Release spare room left over from a polyline that was drawn incrementally: */
+	if(!uploadPolyline)
+		myDataItem->trim(cacheItem);
 	
-	/* Set the color: */
-	glColor(color);
+	/* Bind the memory block containing the polyline's vertices and draw them where they were uploaded: */
+	myDataItem->bindMemoryBlock(cacheItem.memoryBlock);
+	myDataItem->setVertexTranslation(Vector::zero);
 	
 	if(uploadPolyline)
 		{
+		/* Store the polyline's color and line width with its vertices: */
+		cacheItem.color=color;
+		cacheItem.lineWidth=lineWidth;
+		
 		/* Mark the cache item for upload: */
-		myDataItem->uploadItem=&cmIt->getDest();
+		myDataItem->uploadCacheId=cacheId;
+		myDataItem->uploadItem=&cacheItem;
 		
-		/* Prepare the allocated memory chunk for polyline vertex upload: */
-		myDataItem->uploadPtr=static_cast<DataItem::Vertex*>(glMapBufferARB(GL_ARRAY_BUFFER_ARB,GL_WRITE_ONLY));
-		myDataItem->uploadPtr+=myDataItem->uploadItem->offset;
-		myDataItem->uploadEnd=myDataItem->uploadPtr+myDataItem->uploadItem->size;
+		/* Stage the polyline's vertices if possible, or prepare the allocated memory chunk for polyline vertex upload otherwise: */
+		myDataItem->uploadStagingStart=myDataItem->reserveStaging(Misc::min(cacheItem.size,size_t(256)),cacheItem.size);
+		if(myDataItem->uploadStagingStart!=0)
+			{
+			myDataItem->uploadPtr=myDataItem->uploadStagingStart;
+			myDataItem->uploadEnd=myDataItem->uploadPtr+myDataItem->stagingNumReserved;
+			}
+		else
+			{
+			myDataItem->uploadPtr=static_cast<DataItem::Vertex*>(glMapBufferARB(GL_ARRAY_BUFFER_ARB,GL_WRITE_ONLY));
+			myDataItem->uploadPtr+=myDataItem->uploadItem->offset;
+			myDataItem->uploadEnd=myDataItem->uploadPtr+myDataItem->uploadItem->size;
+			}
 		
 		myDataItem->uploadNumVertices=0U;
+		myDataItem->uploadNumCommitted=0U;
+		}
+	else if(cacheItem.matches(color,lineWidth))
+		{
+		/* Draw the polyline together with all other pending polylines from the same memory block: */
+		myDataItem->queue(cacheItem);
 		}
 	else
 		{
-		/* Draw the polyline as a line strip: */
-		glDrawArrays(GL_LINE_STRIP,cmIt->getDest().offset,cmIt->getDest().size);
+		/* Draw the polyline immediately with the given color and line width: */
+		myDataItem->drawSingle(cacheItem,color,lineWidth);
 		}
 	
 	return uploadPolyline;
@@ -758,6 +1644,8 @@ void PolylineRenderer::addVertex(const Point& vertex,GLObject::DataItem* dataIte
 	{
 	/* Retrieve the data item: */
 	DataItem* myDataItem=static_cast<DataItem*>(dataItem);
+	const Color& color=myDataItem->uploadItem->color;
+	Scalar lineWidth=myDataItem->uploadItem->lineWidth;
 	
 	if(myDataItem->uploadNumVertices>=2U)
 		{
@@ -765,11 +1653,7 @@ void PolylineRenderer::addVertex(const Point& vertex,GLObject::DataItem* dataIte
 		Vector v1=(vertex-myDataItem->uploadP0).normalize();
 		
 		/* Upload the previous vertex: */
-		if(v1*myDataItem->uploadV0>=Scalar(0))
-			myDataItem->uploadPtr->normal=myDataItem->uploadV0+v1;
-		else
-			myDataItem->uploadPtr->normal=Vector::zero;
-		myDataItem->uploadPtr->position=myDataItem->uploadP0;
+		myDataItem->uploadPtr->set(v1*myDataItem->uploadV0>=Scalar(0)?myDataItem->uploadV0+v1:Vector::zero,myDataItem->uploadP0,color,lineWidth);
 		++myDataItem->uploadPtr;
 		
 		/* Remember the next vertex and direction vector: */
@@ -784,8 +1668,7 @@ void PolylineRenderer::addVertex(const Point& vertex,GLObject::DataItem* dataIte
 			myDataItem->uploadV0=(vertex-myDataItem->uploadP0).normalize();
 			
 			/* Upload the first vertex: */
-			myDataItem->uploadPtr->normal=Vector::zero;
-			myDataItem->uploadPtr->position=myDataItem->uploadP0;
+			myDataItem->uploadPtr->set(Vector::zero,myDataItem->uploadP0,color,lineWidth);
 			++myDataItem->uploadPtr;
 			}
 		
@@ -794,28 +1677,30 @@ void PolylineRenderer::addVertex(const Point& vertex,GLObject::DataItem* dataIte
 		}
 	++myDataItem->uploadNumVertices;
 	
+	/* Check if there is no more room in the staging reservation: */
+	if(myDataItem->uploadStagingStart!=0&&myDataItem->uploadPtr==myDataItem->uploadEnd)
+		{
+		/* Copy the staged vertices into place and continue staging: */
+		myDataItem->continueStagedUpload();
+		}
+	
 	/* Check if there is no more room in the allocated memory chunk: */
-	if(myDataItem->uploadPtr==myDataItem->uploadEnd)
+	else if(myDataItem->uploadPtr==myDataItem->uploadEnd)
 		{
 		/* Allocate another memory chunk: */
-		DataItem::CacheItem newItem=myDataItem->allocateLargest((myDataItem->uploadNumVertices*4U)/3U+1U); // Geometric growth to achieve O(N) upload time
+		DataItem::CacheItem newItem=myDataItem->allocateLargest(myDataItem->uploadCacheId,(myDataItem->uploadNumVertices*4U)/3U+1U); // Geometric growth to achieve O(N) upload time
 		newItem.version=myDataItem->uploadItem->version;
+		newItem.color=color;
+		newItem.lineWidth=lineWidth;
 		
 		/* Copy already-uploaded vertices from the current into the new memory chunk: */
 		glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
 		glBindBufferARB(GL_COPY_WRITE_BUFFER,newItem.memoryBlock->bufferId);
 		glCopyBufferSubData(GL_ARRAY_BUFFER_ARB,GL_COPY_WRITE_BUFFER,myDataItem->uploadItem->offset*sizeof(DataItem::Vertex),newItem.offset*sizeof(DataItem::Vertex),myDataItem->uploadItem->size*sizeof(DataItem::Vertex));
 		glBindBufferARB(GL_COPY_WRITE_BUFFER,0);
-		if(myDataItem->currentBufferId!=newItem.memoryBlock->bufferId)
-			{
-			/* Bind the polyline's new memory block: */
-			myDataItem->currentBufferId=newItem.memoryBlock->bufferId;
-			glBindBufferARB(GL_ARRAY_BUFFER_ARB,myDataItem->currentBufferId);
-			
-			/* Reset the vertex pointers into the new memory block: */
-			glNormalPointer(GL_FLOAT,sizeof(DataItem::Vertex),static_cast<const GLfloat*>(0)+0);
-			glVertexPointer(3,GL_FLOAT,sizeof(DataItem::Vertex),static_cast<const GLfloat*>(0)+3);
-			}
+		
+		/* Bind the polyline's new memory block: */
+		myDataItem->bindMemoryBlock(newItem.memoryBlock);
 		
 		/* Release the current memory chunk and install the new one: */
 		myDataItem->release(*myDataItem->uploadItem);
@@ -832,35 +1717,147 @@ void PolylineRenderer::finish(GLObject::DataItem* dataItem) const
 	DataItem* myDataItem=static_cast<DataItem*>(dataItem);
 	
 	/* Upload the final vertex: */
-	myDataItem->uploadPtr->normal=Vector::zero;
-	myDataItem->uploadPtr->position=myDataItem->uploadP0;
+	myDataItem->uploadPtr->set(Vector::zero,myDataItem->uploadP0,myDataItem->uploadItem->color,myDataItem->uploadItem->lineWidth);
 	++myDataItem->uploadPtr;
 	
-	/* Finalize the allocated memory chunk: */
-	glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
-	
-	/* Check if there is leftover space in the allocated memory chunk: */
-	size_t leftoverSpace=size_t(myDataItem->uploadEnd-myDataItem->uploadPtr);
-	if(leftoverSpace!=0U)
+	if(myDataItem->uploadStagingStart!=0)
 		{
-		/* Release the unused part of the allocated memory chunk: */
-		DataItem::CacheItem unusedItem=*myDataItem->uploadItem;
-		myDataItem->uploadItem->size-=leftoverSpace;
-		unusedItem.offset+=myDataItem->uploadItem->size;
-		unusedItem.size=leftoverSpace;
-		myDataItem->release(unusedItem);
+		/* Copy the remaining staged vertices into the allocated memory chunk: */
+		size_t numStaged=size_t(myDataItem->uploadPtr-myDataItem->uploadStagingStart);
+		myDataItem->commitStaging(numStaged,myDataItem->uploadItem->memoryBlock,myDataItem->uploadItem->offset+myDataItem->uploadNumCommitted);
+		myDataItem->uploadItem->numVertices=myDataItem->uploadNumCommitted+numStaged;
+		}
+	else
+		{
+		/* Finalize the allocated memory chunk: */
+		glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
+		myDataItem->uploadItem->numVertices=myDataItem->uploadItem->size-size_t(myDataItem->uploadEnd-myDataItem->uploadPtr);
 		}
 	
-	/* Draw the polyline as a line strip: */
-	glDrawArrays(GL_LINE_STRIP,myDataItem->uploadItem->offset,myDataItem->uploadItem->size);
+	/* Release any leftover space in the allocated memory chunk: */
+	SKETCHPAD_STATS_LOCAL_COUNT(myDataItem->stats,PolylineCacheMisses,1U);
+	SKETCHPAD_STATS_LOCAL_COUNT(myDataItem->stats,PolylineUploadBytes,(unsigned int)(myDataItem->uploadItem->numVertices*sizeof(DataItem::Vertex)));
+	myDataItem->trim(*myDataItem->uploadItem);
+	
+	/* Draw the polyline together with all other pending polylines from the same memory block: */
+	myDataItem->queue(*myDataItem->uploadItem);
 	
 	/* Reset upload state: */
+	myDataItem->uploadCacheId=0;
 	myDataItem->uploadItem=0;
 	myDataItem->uploadEnd=myDataItem->uploadPtr=0;
+	myDataItem->uploadStagingStart=0;
+	}
+
+void PolylineRenderer::drawLive(const void* cacheId,unsigned int version,const PolylineRenderer::Polyline& polyline,size_t numFixed,const Color& color,Scalar lineWidth,GLObject::DataItem* dataItem) const
+	{
+	/* Retrieve the data item: */
+	DataItem* myDataItem=static_cast<DataItem*>(dataItem);
+	size_t numVertices=Misc::max(polyline.size(),size_t(2)); // Polylines use at least two vertices
+	
+	/* Find the polyline in the cache: */
+	DataItem::CacheMap::Iterator cmIt=myDataItem->cacheMap.findEntry(cacheId);
+	if(cmIt.isFinished())
+		{
+		/* Allocate a memory chunk with room for the polyline to grow: */
+		DataItem::CacheItem cacheItem=myDataItem->allocate(cacheId,Misc::max(numVertices*2U,size_t(256)));
+		cacheItem.numVertices=0;
+		cacheItem.version=version-1U; // Force an upload
+		cacheItem.color=color;
+		cacheItem.lineWidth=lineWidth;
+		cmIt=myDataItem->cacheMap.setAndFindEntry(DataItem::CacheMap::Entry(cacheId,cacheItem));
+		}
+	DataItem::CacheItem& cacheItem=cmIt->getDest();
+	
+	/* Check if the polyline changed since it was last uploaded: */
+	if(cacheItem.version!=version||!cacheItem.matches(color,lineWidth))
+		{
+		/* Re-upload all vertices if the line color or width changed, otherwise only those that were not yet final: */
+		size_t first=cacheItem.matches(color,lineWidth)?Misc::min(cacheItem.numFinal,numVertices):0;
+		cacheItem.color=color;
+		cacheItem.lineWidth=lineWidth;
+		
+		/* Move the polyline to a larger memory chunk if it outgrew its current one: */
+		if(numVertices>cacheItem.size)
+			{
+			/* Allocate a chunk twice the required size to achieve O(N) total upload time: */
+			DataItem::CacheItem newItem=myDataItem->allocate(cacheId,numVertices*2U);
+			
+			/* Copy the final vertices from the old chunk: */
+			if(first>0)
+				myDataItem->copy(cacheItem.memoryBlock,cacheItem.offset,newItem.memoryBlock,newItem.offset,first);
+			
+			/* Release the old chunk and install the new one: */
+			myDataItem->release(cacheItem);
+			cacheItem.memoryBlock=newItem.memoryBlock;
+			cacheItem.offset=newItem.offset;
+			cacheItem.size=newItem.size;
+			}
+		
+		/* Bind the memory block containing the polyline's vertices: */
+		myDataItem->bindMemoryBlock(cacheItem.memoryBlock);
+		
+		/* Calculate the vertices that changed: */
+		std::vector<DataItem::Vertex>& buffer=myDataItem->uploadBuffer;
+		buffer.resize(numVertices-first);
+		if(polyline.size()>2)
+			{
+			for(size_t i=first;i<numVertices;++i)
+				{
+				Vector normal=Vector::zero;
+				if(i>0&&i<numVertices-1)
+					{
+					/* Calculate the separating normal vector between the two adjacent line segments: */
+					Vector v0=polyline[i]-polyline[i-1];
+					v0.normalize();
+					Vector v1=polyline[i+1]-polyline[i];
+					v1.normalize();
+					if(v0*v1>=Scalar(0))
+						normal=v0+v1;
+					}
+				buffer[i-first].set(normal,polyline[i],color,lineWidth);
+				}
+			}
+		else
+			{
+			/* Store a single line segment, or a line segment with identical end points: */
+			for(size_t i=first;i<numVertices;++i)
+				buffer[i-first].set(Vector::zero,polyline[Misc::min(i,polyline.size()-1)],color,lineWidth);
+			}
+		
+		/* Upload the changed vertices: */
+		glBufferSubDataARB(GL_ARRAY_BUFFER_ARB,(cacheItem.offset+first)*sizeof(DataItem::Vertex),buffer.size()*sizeof(DataItem::Vertex),&buffer.front());
+		SKETCHPAD_STATS_LOCAL_COUNT(myDataItem->stats,PolylineCacheMisses,1U);
+		SKETCHPAD_STATS_LOCAL_COUNT(myDataItem->stats,PolylineUploadBytes,(unsigned int)(buffer.size()*sizeof(DataItem::Vertex)));
+		
+		/* Remember which vertices will not change anymore; the last fixed vertex's normal depends on the tentative tail: */
+		cacheItem.numVertices=numVertices;
+		cacheItem.numFinal=numFixed>1?Misc::min(numFixed-1,numVertices):0;
+		cacheItem.version=version;
+		}
+	else
+		{
+		/* Bind the memory block containing the polyline's vertices: */
+		myDataItem->bindMemoryBlock(cacheItem.memoryBlock);
+		}
+	
+	/* Draw the polyline together with all other pending polylines from the same memory block: */
+	myDataItem->setVertexTranslation(Vector::zero);
+	myDataItem->queue(cacheItem);
 	}
 
 void PolylineRenderer::drop(const void* cacheId)
 	{
-	/* Add the item to the drop list: */
-	dropList.push_back(cacheId);
+	/* Add the item to the drop queues of all OpenGL contexts, which process them independently during their next rendering passes: */
+	{
+	Threads::Spinlock::Lock contextsLock(contextsMutex);
+	for(std::vector<DataItem*>::iterator cIt=contexts.begin();cIt!=contexts.end();++cIt)
+		{
+		Threads::Spinlock::Lock dropQueueLock((*cIt)->dropQueueMutex);
+		(*cIt)->dropQueue.push_back(cacheId);
+		}
+	}
+	
+	/* Release any vertices computed for the item's level-of-detail tiers, as the item's cache ID might be reused: */
+	dropSharedVertices(cacheId,false);
 	}
@@ -24,31 +24,121 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef POLYLINERENDERER_INCLUDED
 #define POLYLINERENDERER_INCLUDED
 
+#include <stddef.h>
 #include <vector>
 #include <Threads/Atomic.h>
+#include <Threads/Spinlock.h>
+#include <Threads/Mutex.h>
+#include <Misc/Autopointer.h>
+#include <Misc/StandardHashFunction.h>
+#include <Misc/HashTable.h>
 #include <Vrui/Vrui.h>
 
 #include "SketchGeometry.h"
+#include "PointArena.h"
 #include "Renderer.h"
 
 class PolylineRenderer:public Renderer
 	{
 	/* Embedded classes: */
 	public:
-	typedef std::vector<Point> Polyline; // Type for polylines defined by lists of points
+	typedef PointList Polyline; // Type for polylines defined by lists of points
+	
+	struct LodTier // Structure for a simplified version of a polyline used when rendering at coarse scales
+		{
+		/* Elements: */
+		public:
+		Scalar tolerance; // Maximum distance between the simplified and the original polyline in model space units
+		Polyline polyline; // The simplified polyline
+		};
+	
+	typedef std::vector<LodTier> LodTierList; // Type for lists of level-of-detail tiers of a polyline, in order of increasing tolerance
+	
+	class CacheKey // Class for reference-counted cache IDs shared by polylines with identical cached vertices, such as cloned curves; drops the cached vertices when the last reference is released
+		{
+		/* Elements: */
+		private:
+		Threads::Atomic<unsigned int> refCount; // Number of polylines sharing the cache ID
+		
+		/* Constructors and destructors: */
+		public:
+		CacheKey(void)
+			:refCount(0)
+			{
+			}
+		private:
+		CacheKey(const CacheKey& source); // Prohibit copy constructor
+		CacheKey& operator=(const CacheKey& source); // Prohibit assignment operator
+		public:
+		~CacheKey(void); // Drops the cached vertices from all OpenGL contexts
+		
+		/* Methods: */
+		void ref(void) // Adds a reference to the cache ID
+			{
+			refCount.preAdd(1);
+			}
+		void unref(void) // Removes a reference from the cache ID and destroys it when the last reference is removed
+			{
+			if(refCount.preSub(1)==0)
+				delete this;
+			}
+		bool isShared(void) const // Returns true if more than one polyline shares the cache ID
+			{
+			return refCount.get()>1;
+			}
+		};
+	
+	typedef Misc::Autopointer<CacheKey> CacheKeyPtr; // Type for pointers to shared cache IDs
 	
 	private:
 	struct DataItem; // Forward declaration of per-context data structure
+	struct SharedVertices; // Forward declaration of structure holding polyline vertices computed once for all OpenGL contexts
+	
+	struct SharedVertexKey // Structure identifying one level-of-detail tier of a cached polyline
+		{
+		/* Elements: */
+		public:
+		const void* cacheId; // Cache ID of the polyline
+		unsigned int lodTier; // Level-of-detail tier of the polyline
+		
+		/* Constructors and destructors: */
+		SharedVertexKey(const void* sCacheId,unsigned int sLodTier)
+			:cacheId(sCacheId),lodTier(sLodTier)
+			{
+			}
+		
+		/* Methods: */
+		bool operator==(const SharedVertexKey& other) const
+			{
+			return cacheId==other.cacheId&&lodTier==other.lodTier;
+			}
+		bool operator!=(const SharedVertexKey& other) const
+			{
+			return cacheId!=other.cacheId||lodTier!=other.lodTier;
+			}
+		static size_t hash(const SharedVertexKey& source,size_t tableSize) // Hash function for hash tables keyed by level-of-detail tiers of cached polylines
+			{
+			return (size_t(source.cacheId)+size_t(source.lodTier)*size_t(31))%tableSize;
+			}
+		};
+	
+	typedef Misc::HashTable<SharedVertexKey,SharedVertices*,SharedVertexKey> SharedVertexMap; // Type for hash tables mapping level-of-detail tiers of cached polylines to shared polyline vertices
 	
 	/* Elements: */
 	static PolylineRenderer* theRenderer; // Singleton polyline rendering object
 	static Threads::Atomic<unsigned int> refCount; // Number of references to the singleton polyline rendering object
-	Scalar scaleFactor; // Scale factor from line widths to model space units
-	std::vector<const void*> dropList; // List of deleted items that need to be dropped from the cache during this rendering cycle
+	static Threads::Spinlock contextsMutex; // Mutex serializing access to the list of per-context data items from rendering threads and parallel workers
+	static std::vector<DataItem*> contexts; // List of the per-context data items of all OpenGL contexts caching polyline vertices
+	static Threads::Atomic<unsigned int> numContexts; // Number of OpenGL contexts caching polyline vertices
+	static bool headless; // Flag whether the renderer is used outside of a running Vrui application, e.g., by benchmarks
+	Scalar scaleFactor; // Scale factor from line widths to model space units; only changed outside of rendering
+	mutable Threads::Mutex sharedVerticesMutex; // Mutex serializing access to the shared polyline vertices from rendering threads and parallel workers
+	mutable SharedVertexMap sharedVertices; // Map of polyline vertices computed by one OpenGL context during the current frame for other contexts to copy
+	double sharedVerticesExpiryTime; // Application time of the frame during which shared vertices computed during earlier frames were last released
 	
 	/* Private methods: */
-	void cleanCache(Vrui::PreRenderingCallbackData* cbData); // Removes all items in the current drop list from the cache
-	void clearDropList(Misc::CallbackData* cbData); // Clears the drop list after a rendering cycle
+	void dropSharedVertices(const void* cacheId,bool staleOnly); // Releases the shared vertices of all level-of-detail tiers of the given polyline, or of all polylines if null; only releases vertices computed during earlier frames, once per frame, if staleOnly is true
+	void cleanCache(Vrui::PreRenderingCallbackData* cbData); // Removes all items in the context's drop queue from the context's cache
 	
 	/* Constructors and destructors: */
 	public:
@@ -59,19 +149,24 @@ class PolylineRenderer:public Renderer
 	virtual void initContext(GLContextData& contextData) const;
 	
 	/* Methods from class Renderer: */
-	GLObject::DataItem* activate(GLContextData& contextData) const;
+	GLObject::DataItem* activate(RenderState& renderState) const;
 	void deactivate(GLObject::DataItem* dataItem) const;
 	
 	/* New methods: */
 	static PolylineRenderer* acquire(void); // Acquires a reference to the singleton rendering object
 	static void release(void); // Releases a reference to the singleton rendering object
+	static void setHeadless(bool newHeadless); // Sets whether the renderer is used without a running Vrui application and without OpenGL contexts; must be called before the first reference is acquired
 	void setScaleFactor(Scalar newScaleFactor); // Updates the scale factor from line widths to model space units
+	static void simplify(const Polyline& polyline,Scalar tolerance,Polyline& result); // Simplifies the given polyline using the Douglas-Peucker algorithm with the given tolerance in model space units
+	static void createLodTiers(const Polyline& polyline,LodTierList& lodTiers); // Replaces the given list with level-of-detail tiers of the given polyline; short polylines do not get any tiers
+	const Polyline& selectLodTier(const Polyline& polyline,const LodTierList& lodTiers,unsigned int& lodTier,GLObject::DataItem* dataItem) const; // Returns the coarsest tier of the given polyline that is indistinguishable from the full polyline in the current rendering pass, and its index in lodTier; tier 0 is the full polyline
 	void draw(const Polyline& polyline,const Color& color,Scalar lineWidth,GLObject::DataItem* dataItem) const; // Renders the given polyline with the given color and line width
-	void draw(const void* cacheId,unsigned int version,const Polyline& polyline,const Color& color,Scalar lineWidth,GLObject::DataItem* dataItem) const; // Caches the given polyline and renders it with the given color and line width
+	void draw(const void* cacheId,unsigned int version,unsigned int lodTier,const Polyline& polyline,const Vector& translation,const Color& color,Scalar lineWidth,GLObject::DataItem* dataItem) const; // Caches the given level-of-detail tier of a polyline and renders it with the given color and line width; translation is the accumulated translation of the polyline, which moves cached vertices on the GPU instead of uploading them again; drawing of cached polylines is deferred and batched per memory block until the renderer is deactivated
 	bool draw(const void* cacheId,unsigned int version,const Color& color,Scalar lineWidth,GLObject::DataItem* dataItem) const; // Renders an already cached polyline or prepares to upload polyline vertices one at a time; returns true if vertices need to be uploaded
 	void addVertex(const Point& vertex,GLObject::DataItem* dataItem) const; // Uploads an additional vertex to the polyline being uploaded
 	void finish(GLObject::DataItem* dataItem) const; // Finishes uploading and draws the polyline being uploaded
-	void drop(const void* cacheId); // Marks the given item to be dropped from the cache during the next rendering cycle
+	void drawLive(const void* cacheId,unsigned int version,const Polyline& polyline,size_t numFixed,const Color& color,Scalar lineWidth,GLObject::DataItem* dataItem) const; // Caches and renders a polyline that is still being drawn, whose first numFixed points will not change anymore; only uploads changed vertices, and hands the cached polyline over to the regular cached draw method
+	void drop(const void* cacheId); // Queues the given item to be dropped from the caches of all OpenGL contexts during their next rendering passes
 	};
 
 #endif
@@ -0,0 +1,282 @@
+/***********************************************************************
+ProgramCache - Class to cache linked GLSL shader programs as
+driver-specific program binaries, in memory for all OpenGL contexts and
+on disk across runs.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "ProgramCache.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <stdexcept>
+#include <IO/File.h>
+#include <IO/OpenFile.h>
+#include <GL/GLContext.h>
+#include <GL/GLExtensionManager.h>
+
+/* Tokens for program binaries, in case the OpenGL headers predate them: */
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+std::string getCacheDirectory(void) // Returns the name of the per-user program cache directory, creating it if needed, or an empty string if there is none
+	{
+	/* Use an explicitly configured directory, where the empty string disables the disk cache: */
+	const char* cacheDir=getenv("SKETCHPAD_PROGRAMCACHE");
+	if(cacheDir!=0)
+		{
+		if(cacheDir[0]!='\0'&&mkdir(cacheDir,0777)!=0&&errno!=EEXIST)
+			return std::string();
+		return cacheDir;
+		}
+	
+	/* Otherwise use the user's XDG cache directory: */
+	std::string result;
+	const char* xdgCacheDir=getenv("XDG_CACHE_HOME");
+	const char* homeDir=getenv("HOME");
+	if(xdgCacheDir!=0&&xdgCacheDir[0]!='\0')
+		result=xdgCacheDir;
+	else if(homeDir!=0&&homeDir[0]!='\0')
+		{
+		result=homeDir;
+		result.append("/.cache");
+		}
+	else
+		return std::string();
+	if(mkdir(result.c_str(),0777)!=0&&errno!=EEXIST)
+		return std::string();
+	result.append("/SketchPad");
+	if(mkdir(result.c_str(),0777)!=0&&errno!=EEXIST)
+		return std::string();
+	
+	return result;
+	}
+
+}
+
+/*************************************
+Static elements of class ProgramCache:
+*************************************/
+
+const char* ProgramCache::fileHeader="SketchPadProgram v1.0\n";
+Threads::Mutex ProgramCache::binariesMutex;
+ProgramCache::BinaryMap ProgramCache::binaries;
+
+/*****************************
+Methods of class ProgramCache:
+*****************************/
+
+void ProgramCache::addData(const void* data,size_t dataSize)
+	{
+	/* Continue the 64-bit FNV-1a hash of all data added so far: */
+	const unsigned char* dPtr=static_cast<const unsigned char*>(data);
+	for(size_t i=0;i<dataSize;++i,++dPtr)
+		{
+		key^=Misc::UInt64(*dPtr);
+		key*=0x100000001b3ULL;
+		}
+	}
+
+bool ProgramCache::install(const ProgramCache::Binary& binary)
+	{
+	/* Hand the binary to the driver, which rejects binaries from different drivers or hardware: */
+	glProgramBinaryProc(program,binary.format,&binary.data.front(),GLsizei(binary.data.size()));
+	GLint linkStatus=GL_FALSE;
+	glGetProgramivProc(program,GL_LINK_STATUS,&linkStatus);
+	return linkStatus==GL_TRUE;
+	}
+
+ProgramCache::ProgramCache(GLContext& context,GLhandleARB sProgram)
+	:program(sProgram),
+	 glGetProgramivProc(0),glProgramParameteriProc(0),glGetProgramBinaryProc(0),glProgramBinaryProc(0),
+	 key(0xcbf29ce484222325ULL)
+	{
+	/* Bail out if the context does not support program binaries: */
+	if(!context.isVersionLargerEqual(4,1)&&!GLExtensionManager::isExtensionSupported("GL_ARB_get_program_binary"))
+		return;
+	
+	/* Retrieve the entry points to retrieve and install program binaries: */
+	glGetProgramivProc=GLExtensionManager::getFunction<PFNGLGETPROGRAMIVPROC>("glGetProgramiv");
+	glProgramParameteriProc=GLExtensionManager::getFunction<PFNGLPROGRAMPARAMETERIPROC>("glProgramParameteri");
+	glGetProgramBinaryProc=GLExtensionManager::getFunction<PFNGLGETPROGRAMBINARYPROC>("glGetProgramBinary");
+	glProgramBinaryProc=GLExtensionManager::getFunction<PFNGLPROGRAMBINARYPROC>("glProgramBinary");
+	
+	/* Start the program's key with the identification of the driver, which generates the binaries: */
+	for(int i=0;i<3;++i)
+		{
+		static const GLenum names[3]={GL_VENDOR,GL_RENDERER,GL_VERSION};
+		const char* string=reinterpret_cast<const char*>(glGetString(names[i]));
+		if(string!=0)
+			addData(string,strlen(string)+1);
+		}
+	}
+
+void ProgramCache::addSource(const char* shaderFileName)
+	{
+	if(glGetProgramivProc==0)
+		return;
+	
+	try
+		{
+		/* Add the shader source file's contents to the program's key: */
+		IO::FilePtr shaderFile=IO::openFile(shaderFileName);
+		char buffer[4096];
+		size_t readSize;
+		while((readSize=shaderFile->readUpTo(buffer,sizeof(buffer)))!=0)
+			addData(buffer,readSize);
+		addData("",1);
+		}
+	catch(const std::runtime_error&)
+		{
+		/* Disable caching; compiling the shader from source will report the error: */
+		glGetProgramivProc=0;
+		}
+	}
+
+bool ProgramCache::load(void)
+	{
+	if(glGetProgramivProc==0)
+		return false;
+	
+	/* Name the program's binary file after its key: */
+	std::string cacheDir=getCacheDirectory();
+	if(!cacheDir.empty())
+		{
+		char name[64];
+		snprintf(name,sizeof(name),"/%016llx.program",(unsigned long long)(key));
+		fileName=cacheDir;
+		fileName.append(name);
+		}
+	
+	/* Install a binary created by another OpenGL context of this process: */
+	{
+	Threads::Mutex::Lock binariesLock(binariesMutex);
+	BinaryMap::iterator bIt=binaries.find(key);
+	if(bIt!=binaries.end())
+		return install(bIt->second);
+	}
+	
+	/* Read a binary stored by a previous run: */
+	if(fileName.empty()||access(fileName.c_str(),R_OK)!=0)
+		return false;
+	Binary binary;
+	try
+		{
+		IO::FilePtr file=IO::openFile(fileName.c_str());
+		file->setEndianness(Misc::LittleEndian);
+		size_t headerLength=strlen(fileHeader);
+		char header[32];
+		file->read(header,headerLength);
+		if(memcmp(header,fileHeader,headerLength)!=0||file->read<Misc::UInt64>()!=key)
+			return false;
+		binary.format=file->read<Misc::UInt32>();
+		binary.data.resize(file->read<Misc::UInt32>());
+		if(binary.data.empty())
+			return false;
+		file->read(&binary.data.front(),binary.data.size());
+		}
+	catch(const std::runtime_error&)
+		{
+		/* Fall back to compiling the program from source: */
+		return false;
+		}
+	
+	/* Install the binary and share it with other OpenGL contexts if the driver accepted it: */
+	if(!install(binary))
+		return false;
+	Threads::Mutex::Lock binariesLock(binariesMutex);
+	binaries[key]=binary;
+	return true;
+	}
+
+void ProgramCache::prepareLink(void)
+	{
+	if(glGetProgramivProc!=0)
+		glProgramParameteriProc(program,GL_PROGRAM_BINARY_RETRIEVABLE_HINT,GL_TRUE);
+	}
+
+void ProgramCache::store(void)
+	{
+	if(glGetProgramivProc==0)
+		return;
+	
+	/* Retrieve the linked program's binary: */
+	GLint binaryLength=0;
+	glGetProgramivProc(program,GL_PROGRAM_BINARY_LENGTH,&binaryLength);
+	if(binaryLength<=0)
+		return;
+	Binary binary;
+	binary.data.resize(binaryLength);
+	GLsizei length=0;
+	glGetProgramBinaryProc(program,binaryLength,&length,&binary.format,&binary.data.front());
+	if(length<=0)
+		return;
+	binary.data.resize(length);
+	
+	/* Share the binary with other OpenGL contexts: */
+	{
+	Threads::Mutex::Lock binariesLock(binariesMutex);
+	binaries[key]=binary;
+	}
+	
+	if(!fileName.empty())
+		{
+		/* Write the binary under a temporary name unique to this host and process and then move it into place, so that concurrent writers never leave a partial file: */
+		char hostName[256];
+		if(gethostname(hostName,sizeof(hostName))!=0)
+			hostName[0]='\0';
+		hostName[sizeof(hostName)-1]='\0';
+		char suffix[300];
+		snprintf(suffix,sizeof(suffix),".%s.%d.tmp",hostName,int(getpid()));
+		std::string tempFileName=fileName;
+		tempFileName.append(suffix);
+		try
+			{
+			{
+			IO::FilePtr file=IO::openFile(tempFileName.c_str(),IO::File::WriteOnly);
+			file->setEndianness(Misc::LittleEndian);
+			file->write(fileHeader,strlen(fileHeader));
+			file->write<Misc::UInt64>(key);
+			file->write<Misc::UInt32>(binary.format);
+			file->write<Misc::UInt32>(binary.data.size());
+			file->write(&binary.data.front(),binary.data.size());
+			}
+			if(rename(tempFileName.c_str(),fileName.c_str())!=0)
+				unlink(tempFileName.c_str());
+			}
+		catch(const std::runtime_error&)
+			{
+			/* The disk cache is only an optimization; ignore the error: */
+			unlink(tempFileName.c_str());
+			}
+		}
+	}
@@ -0,0 +1,80 @@
+/***********************************************************************
+ProgramCache - Class to cache linked GLSL shader programs as
+driver-specific program binaries, in memory for all OpenGL contexts and
+on disk across runs.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef PROGRAMCACHE_INCLUDED
+#define PROGRAMCACHE_INCLUDED
+
+#include <string>
+#include <vector>
+#include <map>
+#include <Misc/SizedTypes.h>
+#include <Threads/Mutex.h>
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+/* Forward declarations: */
+class GLContext;
+
+class ProgramCache
+	{
+	/* Embedded classes: */
+	private:
+	struct Binary // Structure for linked program binaries
+		{
+		/* Elements: */
+		public:
+		GLenum format; // Driver-specific format of the program binary
+		std::vector<char> data; // The program binary
+		};
+	
+	typedef std::map<Misc::UInt64,Binary> BinaryMap; // Type for maps from program keys to program binaries
+	
+	/* Elements: */
+	static const char* fileHeader; // Header string identifying program binary files
+	static Threads::Mutex binariesMutex; // Mutex serializing access to the in-memory cache from the rendering threads of all OpenGL contexts
+	static BinaryMap binaries; // Map of program binaries loaded or created by this process
+	GLhandleARB program; // The cached program object
+	PFNGLGETPROGRAMIVPROC glGetProgramivProc; // Entry point to query program state, or null if program binaries are not supported
+	PFNGLPROGRAMPARAMETERIPROC glProgramParameteriProc;
+	PFNGLGETPROGRAMBINARYPROC glGetProgramBinaryProc;
+	PFNGLPROGRAMBINARYPROC glProgramBinaryProc;
+	Misc::UInt64 key; // Hash value of the driver identification and all shader sources of the program
+	std::string fileName; // Name of the program's binary file in the cache directory, or empty if there is no cache directory
+	
+	/* Private methods: */
+	void addData(const void* data,size_t dataSize); // Adds the given data to the program's key
+	bool install(const Binary& binary); // Installs the given program binary; returns true if the driver accepted it
+	
+	/* Constructors and destructors: */
+	public:
+	ProgramCache(GLContext& context,GLhandleARB sProgram); // Prepares caching the given unlinked program object in the given current OpenGL context
+	
+	/* Methods: */
+	void addSource(const char* shaderFileName); // Adds the contents of the given shader source file, which will be attached to the program, to the program's key
+	bool load(void); // Installs a cached binary for the program; returns true if the program is linked, or false if it must be compiled and linked from source
+	void prepareLink(void); // Asks the driver to keep the program's binary; must be called before linking the program from source
+	void store(void); // Stores the binary of the program after it was linked from source
+	};
+
+#endif
@@ -22,13 +22,29 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include "RenderState.h"
 
+#include <Math/Math.h>
+#include <Vrui/Vrui.h>
+#include <Vrui/VRScreen.h>
+#include <Vrui/VRWindow.h>
+#include <Vrui/DisplayState.h>
+
 /****************************
 Methods of class RenderState:
 ****************************/
 
 RenderState::RenderState(GLContextData& sContextData)
 	:contextData(sContextData),
-	 activeRenderer(0),activeDataItem(0)
+	 activeRenderer(0),activeDataItem(0),
+	 cull(false),viewBox(Box::full),pixelSize(0),
+	 complete(true)
+	{
+	}
+
+RenderState::RenderState(GLContextData& sContextData,Scalar sPixelSize)
+	:contextData(sContextData),
+	 activeRenderer(0),activeDataItem(0),
+	 cull(false),viewBox(Box::full),pixelSize(sPixelSize),
+	 complete(true)
 	{
 	}
 
@@ -49,11 +65,35 @@ bool RenderState::setRenderer(const Renderer* newRenderer)
 			activeRenderer->deactivate(activeDataItem);
 		activeDataItem=0;
 		
+		/* Count the renderer change: */
+		SKETCHPAD_STATS_LOCAL_COUNT(stats,RendererChanges,1U);
+		
 		/* Set and activate the new renderer: */
 		activeRenderer=newRenderer;
 		if(activeRenderer!=0)
-			activeDataItem=activeRenderer->activate(contextData);
+			activeDataItem=activeRenderer->activate(*this);
 		}
 	
 	return result;
 	}
+
+void RenderState::setViewBox(const Box& newViewBox)
+	{
+	cull=true;
+	viewBox=newViewBox;
+	}
+
+Scalar RenderState::getPixelSize(void)
+	{
+	if(pixelSize==Scalar(0))
+		{
+		/* Calculate this display's pixel size in navigational coordinate units: */
+		const Vrui::DisplayState& ds=Vrui::getDisplayState(contextData);
+		const Vrui::Scalar* panRect=ds.window->getPanRect();
+		Vrui::Scalar pw=ds.screen->getWidth()*(panRect[1]-panRect[0])/Vrui::Scalar(ds.viewport.size[0]);
+		Vrui::Scalar ph=ds.screen->getHeight()*(panRect[3]-panRect[2])/Vrui::Scalar(ds.viewport.size[1]);
+		pixelSize=Scalar(Math::sqrt(pw*ph)*Vrui::getInverseNavigationTransformation().getScaling());
+		}
+	
+	return pixelSize;
+	}
@@ -23,7 +23,9 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef RENDERSTATE_INCLUDED
 #define RENDERSTATE_INCLUDED
 
+#include "SketchGeometry.h"
 #include "Renderer.h"
+#include "Stats.h"
 
 /* Forward declarations: */
 class GLContextData;
@@ -36,10 +38,18 @@ class RenderState
 	private:
 	const Renderer* activeRenderer; // The currently active sketch object renderer
 	GLObject::DataItem* activeDataItem; // The per-context state of the currently active renderer
+	bool cull; // Flag whether sketch objects are culled against the view box
+	Box viewBox; // Bounding box of the visible part of the sketching plane in navigational coordinates
+	Scalar pixelSize; // Size of a pixel in navigational coordinate units in this render pass, or zero if not yet calculated from the current display state
+	bool complete; // Flag whether all sketch objects drawn so far were drawn at their final appearance
+	#if SKETCHPAD_CONFIG_STATS
+	mutable Stats::LocalCounters stats; // Counters accumulated during this render pass and published when the render state is destroyed
+	#endif
 	
 	/* Constructors and destructors: */
 	public:
-	RenderState(GLContextData& sContextData);
+	RenderState(GLContextData& sContextData); // Creates a render state for the current display state of the given OpenGL context
+	RenderState(GLContextData& sContextData,Scalar sPixelSize); // Creates a render state for an offscreen render pass using the given pixel size in navigational coordinate units
 	~RenderState(void);
 	
 	/* Methods: */
@@ -52,6 +62,32 @@ class RenderState
 		{
 		return activeDataItem;
 		}
+	bool isCulling(void) const // Returns true if sketch objects are culled against the view box
+		{
+		return cull;
+		}
+	const Box& getViewBox(void) const // Returns the current view box
+		{
+		return viewBox;
+		}
+	void setViewBox(const Box& newViewBox); // Culls sketch objects against the given view box from now on
+	Scalar getPixelSize(void); // Returns the size of a pixel in navigational coordinate units in this render pass
+	bool isComplete(void) const // Returns true if all sketch objects drawn so far were drawn at their final appearance
+		{
+		return complete;
+		}
+	void setIncomplete(void) // Notifies the render state that a sketch object was drawn provisionally and will look different during a later frame
+		{
+		complete=false;
+		}
+	bool isVisible(const Box& box,Scalar margin) const // Returns true if the given box, extended by the given margin, overlaps the view box in the sketching plane
+		{
+		bool result=!cull||(box.min[0]-margin<=viewBox.max[0]&&box.max[0]+margin>=viewBox.min[0]&&box.min[1]-margin<=viewBox.max[1]&&box.max[1]+margin>=viewBox.min[1]);
+		#if SKETCHPAD_CONFIG_STATS
+		stats.add(result?Stats::VisibleObjects:Stats::CulledObjects,1U);
+		#endif
+		return result;
+		}
 	};
 
 #endif
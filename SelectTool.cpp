@@ -28,7 +28,9 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Vrui/Vrui.h>
 #include <Vrui/ToolManager.h>
 
+#include "Stats.h"
 #include "RenderState.h"
+#include "SketchJournal.h"
 
 /**********************************************
 Static elements of class SketchPad::SelectTool:
@@ -70,6 +72,9 @@ const Vrui::ToolFactory* SketchPad::SelectTool::getFactory(void) const
 
 void SketchPad::SelectTool::buttonCallback(int buttonSlotIndex,Vrui::InputDevice::ButtonCallbackData* cbData)
 	{
+	/* Measure the time spent selecting: */
+	SKETCHPAD_STATS_TIMER(SelectTime);
+	
 	/* Transform the tool position to navigational coordinates: */
 	Point pos=Point(Vrui::getInverseNavigationTransformation().transform(getButtonDevicePosition(0)));
 	
@@ -95,6 +100,8 @@ void SketchPad::SelectTool::buttonCallback(int buttonSlotIndex,Vrui::InputDevice
 			if(hasMoved())
 				{
 				/* Move the selected objects to their new position: */
+				if(application->journal!=0)
+					application->journal->transformSelection(Transformation::translate(dragTrans));
 				application->settings.transformSelectedObjects(Transformation::translate(dragTrans));
 				}
 			else
@@ -129,6 +136,9 @@ void SketchPad::SelectTool::buttonCallback(int buttonSlotIndex,Vrui::InputDevice
 
 void SketchPad::SelectTool::frame(void)
 	{
+	/* Measure the time spent selecting: */
+	SKETCHPAD_STATS_TIMER(SelectTime);
+	
 	if(isActive())
 		{
 		/* Transform the tool position to navigational coordinates: */
@@ -0,0 +1,947 @@
+/***********************************************************************
+SketchBoard - Class to page the sketch objects of an effectively
+unbounded board in and out of memory as square tiles stored in a
+directory, keeping only the tiles around the viewed region resident.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "SketchBoard.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <Misc/StdError.h>
+#include <Misc/MessageLogger.h>
+#include <IO/OpenFile.h>
+#include <Cluster/MulticastPipe.h>
+#include <Math/Math.h>
+#include <Vrui/Vrui.h>
+
+#include "SketchObject.h"
+#include "SketchObjectIndex.h"
+#include "SketchSettings.h"
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+bool overlaps(const Box& box1,const Box& box2) // Returns true if the projections of the given boxes into the sketching plane overlap
+	{
+	return box1.min[0]<=box2.max[0]&&box1.max[0]>=box2.min[0]&&box1.min[1]<=box2.max[1]&&box1.max[1]>=box2.min[1];
+	}
+
+}
+
+/************************************
+Static elements of class SketchBoard:
+************************************/
+
+const char* SketchBoard::indexHeader="SketchPadBoard v1.0\n";
+const char* SketchBoard::tileHeader="SketchPadTile v1.0\n";
+const double SketchBoard::writeBackInterval=10.0;
+
+/****************************
+Methods of class SketchBoard:
+****************************/
+
+std::string SketchBoard::getFileName(const char* name) const
+	{
+	std::string result=directoryName;
+	result.push_back('/');
+	result.append(name);
+	return result;
+	}
+
+std::string SketchBoard::getTileFileName(const SketchBoard::Tile& tile) const
+	{
+	char name[64];
+	snprintf(name,sizeof(name),"Tile_%d_%d.tile",tile.cell[0],tile.cell[1]);
+	return getFileName(name);
+	}
+
+void SketchBoard::getCell(const SketchObject* object,int cell[2]) const
+	{
+	const Box& box=object->getBoundingBox();
+	for(int i=0;i<2;++i)
+		cell[i]=int(Math::floor((box.min[i]+box.max[i])*Scalar(0.5)/tileSize));
+	}
+
+Box SketchBoard::getCellBox(const SketchBoard::Tile& tile) const
+	{
+	return Box(Point(Scalar(tile.cell[0])*tileSize,Scalar(tile.cell[1])*tileSize,Scalar(0)),Point(Scalar(tile.cell[0]+1)*tileSize,Scalar(tile.cell[1]+1)*tileSize,Scalar(0)));
+	}
+
+SketchBoard::Tile* SketchBoard::getTile(int column,int row,bool create)
+	{
+	/* Return an existing tile: */
+	Misc::UInt64 tileKey=getTileKey(column,row);
+	TileMap::iterator tIt=tiles.find(tileKey);
+	if(tIt!=tiles.end())
+		return tIt->second;
+	if(!create)
+		return 0;
+	
+	/* Create a new tile without a file: */
+	Tile* tile=new Tile(column,row);
+	tiles.insert(tIt,TileMap::value_type(tileKey,tile));
+	return tile;
+	}
+
+void SketchBoard::markDirty(const SketchObject* object)
+	{
+	int cell[2];
+	getCell(object,cell);
+	Tile* tile=getTile(cell[0],cell[1],true);
+	
+	/* A tile without a file has nothing to load and is trivially resident: */
+	if(tile->dataSize==0)
+		tile->resident=true;
+	tile->dirty=true;
+	}
+
+void SketchBoard::readIndex(void)
+	{
+	/* Open the index file and check its header: */
+	IO::FilePtr indexFile=IO::openFile(getFileName("Board.index").c_str());
+	indexFile->setEndianness(Misc::LittleEndian);
+	size_t headerLength=strlen(indexHeader);
+	char header[32];
+	indexFile->read(header,headerLength);
+	if(memcmp(header,indexHeader,headerLength)!=0)
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Unrecognized board index header");
+	
+	/* Read the board's layout: */
+	tileSize=indexFile->read<Misc::Float32>();
+	if(!(tileSize>Scalar(0)))
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Invalid board tile size");
+	maxKey=indexFile->read<Misc::UInt64>();
+	
+	/* Read all non-empty tiles: */
+	unsigned int numTiles=indexFile->read<Misc::UInt32>();
+	for(unsigned int i=0;i<numTiles;++i)
+		{
+		int column=indexFile->read<Misc::SInt32>();
+		int row=indexFile->read<Misc::SInt32>();
+		Tile* tile=getTile(column,row,true);
+		Scalar extent[4];
+		for(int j=0;j<4;++j)
+			extent[j]=indexFile->read<Misc::Float32>();
+		tile->extent=Box(Point(extent[0],extent[1],Scalar(0)),Point(extent[2],extent[3],Scalar(0)));
+		tile->numObjects=indexFile->read<Misc::UInt32>();
+		tile->dataSize=indexFile->read<Misc::UInt32>();
+		}
+	}
+
+void SketchBoard::readTile(SketchBoard::Job& job,SketchObjectCreator& tileCreator)
+	{
+	/* Parse the tile file from memory: */
+	IO::VariableMemoryFile tileFile;
+	tileFile.setEndianness(Misc::LittleEndian);
+	if(!job.raw.empty())
+		tileFile.writeRaw(&job.raw.front(),job.raw.size());
+	tileFile.flush();
+	
+	/* Check the tile file's header: */
+	size_t headerLength=strlen(tileHeader);
+	char header[32];
+	tileFile.read(header,headerLength);
+	if(memcmp(header,tileHeader,headerLength)!=0)
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Unrecognized tile file header");
+	
+	/* Check the number of sketch objects against the board index before trusting it, treating mismatching tiles as damaged: */
+	unsigned int numKeys=tileFile.read<Misc::UInt32>();
+	if(numKeys!=job.numObjects)
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Tile file contains %u sketch objects instead of %u",numKeys,job.numObjects);
+	
+	/* Read the drawing order keys followed by the sketch objects, which are stored as a sketch file: */
+	job.keys.resize(numKeys);
+	if(!job.keys.empty())
+		tileFile.read(&job.keys.front(),job.keys.size());
+	tileCreator.readFile(tileFile,job.objects);
+	if(job.objects.size()!=job.keys.size())
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Mismatching number of sketch objects in tile file");
+	}
+
+void* SketchBoard::jobThreadMethod(void)
+	{
+	while(true)
+		{
+		/* Wait for the next job, and terminate once all jobs are done after a shutdown request: */
+		Job* job;
+		{
+		Threads::MutexCond::Lock jobLock(jobCond);
+		while(jobs.empty()&&!shutdown)
+			jobCond.wait(jobLock);
+		if(jobs.empty())
+			break;
+		job=jobs.front();
+		jobs.pop_front();
+		}
+		
+		try
+			{
+			switch(job->type)
+				{
+				case LoadTile:
+					{
+					/* Read the tile file's raw contents, which might have changed size since the index was written: */
+					IO::FilePtr file=IO::openFile(job->fileName.c_str());
+					size_t dataSize=0;
+					while(true)
+						{
+						if(job->raw.size()<dataSize+4096)
+							job->raw.resize(dataSize+4096);
+						size_t readSize=file->readUpTo(&job->raw[dataSize],job->raw.size()-dataSize);
+						if(readSize==0)
+							break;
+						dataSize+=readSize;
+						}
+					job->raw.resize(dataSize);
+					
+					/* Read the tile's sketch objects: */
+					readTile(*job,jobCreator);
+					break;
+					}
+				
+				case SaveFile:
+					{
+					/* Write the file under a temporary name and then replace the old file, so that the board never contains partial files: */
+					std::string tempFileName=job->fileName;
+					tempFileName.append(".tmp");
+					{
+					IO::FilePtr file=IO::openFile(tempFileName.c_str(),IO::File::WriteOnly);
+					job->data.writeToSink(*file);
+					file->flush();
+					}
+					if(rename(tempFileName.c_str(),job->fileName.c_str())!=0)
+						throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Could not replace file %s",job->fileName.c_str());
+					break;
+					}
+				
+				case RemoveFile:
+					unlink(job->fileName.c_str());
+					break;
+				}
+			}
+		catch(const std::runtime_error& err)
+			{
+			job->error=err.what();
+			}
+		
+		/* Hand the finished job back to the main thread, which might be waiting for it during shutdown: */
+		{
+		Threads::MutexCond::Lock jobLock(jobCond);
+		finishedJobs.push_back(job);
+		jobCond.broadcast();
+		}
+		Vrui::requestUpdate();
+		}
+	
+	return 0;
+	}
+
+void SketchBoard::submitJob(SketchBoard::Job* job)
+	{
+	Threads::MutexCond::Lock jobLock(jobCond);
+	jobs.push_back(job);
+	jobCond.signal();
+	}
+
+void SketchBoard::loadTile(Misc::UInt64 tileKey,SketchBoard::Tile& tile)
+	{
+	Job* job=new Job(LoadTile,getTileFileName(tile));
+	job->tileKey=tileKey;
+	job->numObjects=tile.numObjects;
+	job->raw.reserve(tile.dataSize);
+	tile.loading=true;
+	submitJob(job);
+	}
+
+void SketchBoard::trackChanges(void)
+	{
+	/* Bail out if no sketch objects changed: */
+	const SketchObjectIndex& index=settings.getIndex();
+	if(index.getVersion()==indexVersion)
+		return;
+	
+	std::vector<SketchObject*> objects;
+	Box changedBox;
+	if(index.getChanges(indexVersion,changedBox))
+		{
+		/* Mark all resident tiles overlapping the changes dirty, as sketch objects might have left them: */
+		for(TileMap::iterator tIt=tiles.begin();tIt!=tiles.end();++tIt)
+			if(tIt->second->resident&&overlaps(getCellBox(*tIt->second),changedBox))
+				tIt->second->dirty=true;
+		
+		/* Find all sketch objects affected by the changes: */
+		index.find(changedBox,objects);
+		}
+	else
+		{
+		/* The changes are no longer known; mark all resident tiles dirty and check all sketch objects: */
+		for(TileMap::iterator tIt=tiles.begin();tIt!=tiles.end();++tIt)
+			if(tIt->second->resident)
+				tIt->second->dirty=true;
+		SketchObjectList& sketchObjects=settings.getSketchObjects();
+		for(SketchObjectList::iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
+			objects.push_back(&*soIt);
+		}
+	
+	/* Mark the tiles now containing the affected sketch objects dirty, which merges objects moved into paged-out tiles once those are paged in: */
+	for(std::vector<SketchObject*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+		markDirty(*oIt);
+	
+	indexVersion=index.getVersion();
+	}
+
+void SketchBoard::assignKeys(void)
+	{
+	/* Collect all resident sketch objects in list order with their current drawing order keys, or 0 if they have none: */
+	SketchObjectList& sketchObjects=settings.getSketchObjects();
+	std::vector<SketchObject*> objects;
+	std::vector<Misc::UInt64> keys;
+	objects.reserve(sketchObjects.size());
+	keys.reserve(sketchObjects.size());
+	for(SketchObjectList::iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
+		{
+		objects.push_back(&*soIt);
+		KeyMap::Iterator kIt=objectKeys.findEntry(&*soIt);
+		keys.push_back(!kIt.isFinished()?kIt->getDest():Misc::UInt64(0));
+		}
+	size_t numObjects=objects.size();
+	
+	/* Find the longest run of sketch objects whose keys increase in list order, which keep their keys: */
+	const size_t none=~size_t(0);
+	std::vector<size_t> tails; // Index of the object ending the increasing run of each length that has the smallest last key
+	std::vector<size_t> preds(numObjects,none); // Index of each object's predecessor in the increasing run ending with it
+	for(size_t i=0;i<numObjects;++i)
+		if(keys[i]!=0)
+			{
+			/* Find the shortest run whose last key is not smaller than the object's key: */
+			size_t l0=0;
+			size_t l1=tails.size();
+			while(l0<l1)
+				{
+				size_t mid=(l0+l1)>>1;
+				if(keys[tails[mid]]<keys[i])
+					l0=mid+1;
+				else
+					l1=mid;
+				}
+			
+			/* Extend the next-shorter run by the object: */
+			if(l0>0)
+				preds[i]=tails[l0-1];
+			if(l0==tails.size())
+				tails.push_back(i);
+			else
+				tails[l0]=i;
+			}
+	std::vector<bool> keep(numObjects,false);
+	for(size_t i=!tails.empty()?tails.back():none;i!=none;i=preds[i])
+		keep[i]=true;
+	
+	/* Spread new keys evenly between the kept keys around each run of other sketch objects: */
+	Misc::UInt64 lowKey=0;
+	size_t runStart=0;
+	for(size_t i=0;i<=numObjects;++i)
+		if(i==numObjects||keep[i])
+			{
+			if(i>runStart)
+				{
+				Misc::UInt64 step;
+				if(i<numObjects)
+					step=(keys[i]-lowKey)/Misc::UInt64(i-runStart+1);
+				else
+					{
+					/* Place the sketch objects behind all others on the board, including paged-out ones: */
+					if(lowKey<maxKey)
+						lowKey=maxKey;
+					step=keyGap;
+					}
+				
+				/* Once the keys between two kept sketch objects are exhausted, the order relative to paged-out objects becomes approximate: */
+				if(step==0)
+					step=1;
+				
+				for(size_t j=runStart;j<i;++j)
+					{
+					/* Mark the tile of a sketch object whose key changes dirty, so that its new key is written back: */
+					if(keys[j]!=0)
+						markDirty(objects[j]);
+					keys[j]=lowKey+step*Misc::UInt64(j-runStart+1);
+					}
+				}
+			
+			if(i<numObjects)
+				{
+				lowKey=keys[i];
+				runStart=i+1;
+				}
+			}
+	
+	/* Rebuild the key maps: */
+	objectKeys.clear();
+	keyOrder.clear();
+	for(size_t i=0;i<numObjects;++i)
+		{
+		objectKeys.setEntry(KeyMap::Entry(objects[i],keys[i]));
+		keyOrder[keys[i]]=objects[i];
+		if(maxKey<keys[i])
+			maxKey=keys[i];
+		}
+	}
+
+void SketchBoard::getTileObjects(const SketchBoard::Tile& tile,std::vector<SketchObject*>& objects) const
+	{
+	/* Find all sketch objects overlapping the tile's cell and keep those whose bounding box centers lie inside it: */
+	std::vector<SketchObject*> candidates;
+	settings.getIndex().find(getCellBox(tile),candidates);
+	for(std::vector<SketchObject*>::iterator cIt=candidates.begin();cIt!=candidates.end();++cIt)
+		{
+		int cell[2];
+		getCell(*cIt,cell);
+		if(cell[0]==tile.cell[0]&&cell[1]==tile.cell[1])
+			objects.push_back(*cIt);
+		}
+	
+	/* Sort the sketch objects into list order: */
+	SketchObjectList::sort(objects);
+	}
+
+void SketchBoard::installTile(SketchBoard::Tile& tile,SketchBoard::Job& job)
+	{
+	/* Insert each sketch object in front of the first resident sketch object with a larger key; the tile's objects are in key order: */
+	size_t tileMemorySize=0;
+	std::vector<Misc::UInt64>::const_iterator kIt=job.keys.begin();
+	while(!job.objects.empty())
+		{
+		SketchObject* object=job.objects.unlink(job.objects.begin());
+		object->finishRead();
+		KeyOrder::iterator succIt=keyOrder.upper_bound(*kIt);
+		settings.pageIn(object,succIt!=keyOrder.end()?succIt->second:0);
+		objectKeys.setEntry(KeyMap::Entry(object,*kIt));
+		keyOrder.insert(succIt,KeyOrder::value_type(*kIt,object));
+		if(maxKey<*kIt)
+			maxKey=*kIt;
+		tileMemorySize+=object->getMemorySize();
+		++kIt;
+		}
+	
+	/* Mark the tile as resident: */
+	tile.resident=true;
+	tile.loading=false;
+	tile.memorySize+=tileMemorySize;
+	memorySize+=tileMemorySize;
+	}
+
+void SketchBoard::writeTile(SketchBoard::Tile& tile,const std::vector<SketchObject*>& objects)
+	{
+	if(!objects.empty())
+		{
+		/* Write the drawing order keys of the tile's sketch objects followed by the objects themselves as a sketch file: */
+		Job* job=new Job(SaveFile,getTileFileName(tile));
+		job->data.setEndianness(Misc::LittleEndian);
+		job->data.write(tileHeader,strlen(tileHeader));
+		job->data.write<Misc::UInt32>(objects.size());
+		tile.extent=Box::empty;
+		for(std::vector<SketchObject*>::const_iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+			{
+			KeyMap::Iterator kIt=objectKeys.findEntry(*oIt);
+			job->data.write<Misc::UInt64>(!kIt.isFinished()?kIt->getDest():Misc::UInt64(0));
+			
+			/* Add the sketch object's drawn extent to the tile's extent: */
+			const Box& box=(*oIt)->getBoundingBox();
+			Scalar width=(*oIt)->getMaxLineWidth()*Scalar(0.5);
+			Vector margin(width,width,Scalar(0));
+			tile.extent.addPoint(box.min-margin);
+			tile.extent.addPoint(box.max+margin);
+			}
+		creator.writeFile(objects,job->data,pointEncoding);
+		job->data.flush();
+		tile.numObjects=objects.size();
+		tile.dataSize=job->data.getDataSize();
+		submitJob(job);
+		}
+	else
+		{
+		/* Remove the file of a tile that became empty: */
+		if(tile.dataSize!=0)
+			submitJob(new Job(RemoveFile,getTileFileName(tile)));
+		tile.extent=Box::empty;
+		tile.numObjects=0;
+		tile.dataSize=0;
+		}
+	
+	/* Update the tile's memory size: */
+	size_t tileMemorySize=0;
+	for(std::vector<SketchObject*>::const_iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+		tileMemorySize+=(*oIt)->getMemorySize();
+	memorySize=memorySize-tile.memorySize+tileMemorySize;
+	tile.memorySize=tileMemorySize;
+	
+	tile.dirty=false;
+	indexDirty=true;
+	}
+
+void SketchBoard::recoverTile(SketchBoard::Tile& tile)
+	{
+	std::vector<SketchObject*> objects;
+	getTileObjects(tile,objects);
+	if(objects.empty())
+		return;
+	
+	/* Find a file name that does not overwrite sketch objects recovered earlier: */
+	std::string fileName;
+	for(unsigned int i=0;fileName.empty()||access(fileName.c_str(),F_OK)==0;++i)
+		{
+		char name[64];
+		snprintf(name,sizeof(name),"Recovered_%d_%d_%u.sketch",tile.cell[0],tile.cell[1],i);
+		fileName=getFileName(name);
+		}
+	
+	/* Write the sketch objects as a regular sketch file that can be loaded and merged back by hand: */
+	Job* job=new Job(SaveFile,fileName);
+	job->data.setEndianness(Misc::LittleEndian);
+	creator.writeFile(objects,job->data,pointEncoding);
+	job->data.flush();
+	submitJob(job);
+	
+	Misc::formattedUserError("Board: Saved %u sketch objects that could not be merged into an unreadable tile to file %s",(unsigned int)(objects.size()),fileName.c_str());
+	tile.dirty=false;
+	}
+
+bool SketchBoard::evictTile(SketchBoard::Tile& tile)
+	{
+	std::vector<SketchObject*> objects;
+	getTileObjects(tile,objects);
+	
+	if(master)
+		{
+		/* Keep tiles containing selected sketch objects, which are likely being edited, or sketch objects that undo or redo would refer to: */
+		for(std::vector<SketchObject*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+			if(settings.isSelected(*oIt)||settings.isInHistory(*oIt))
+				return false;
+		
+		/* Write back the tile if it changed: */
+		if(tile.dirty)
+			writeTile(tile,objects);
+		}
+	
+	/* Forget the sketch objects' drawing order keys: */
+	for(std::vector<SketchObject*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+		{
+		KeyMap::Iterator kIt=objectKeys.findEntry(*oIt);
+		if(!kIt.isFinished())
+			{
+			KeyOrder::iterator koIt=keyOrder.find(kIt->getDest());
+			if(koIt!=keyOrder.end()&&koIt->second==*oIt)
+				keyOrder.erase(koIt);
+			objectKeys.removeEntry(kIt);
+			}
+		}
+	
+	/* Remove the sketch objects: */
+	settings.pageOut(objects);
+	memorySize-=tile.memorySize;
+	tile.memorySize=0;
+	tile.resident=false;
+	
+	return true;
+	}
+
+void SketchBoard::writeIndex(void)
+	{
+	/* Write the board's layout: */
+	Job* job=new Job(SaveFile,getFileName("Board.index"));
+	job->data.setEndianness(Misc::LittleEndian);
+	job->data.write(indexHeader,strlen(indexHeader));
+	job->data.write<Misc::Float32>(tileSize);
+	job->data.write<Misc::UInt64>(maxKey);
+	
+	/* Write all tiles that have files: */
+	unsigned int numTiles=0;
+	for(TileMap::iterator tIt=tiles.begin();tIt!=tiles.end();++tIt)
+		if(tIt->second->dataSize!=0)
+			++numTiles;
+	job->data.write<Misc::UInt32>(numTiles);
+	for(TileMap::iterator tIt=tiles.begin();tIt!=tiles.end();++tIt)
+		{
+		const Tile* tile=tIt->second;
+		if(tile->dataSize!=0)
+			{
+			job->data.write<Misc::SInt32>(tile->cell[0]);
+			job->data.write<Misc::SInt32>(tile->cell[1]);
+			job->data.write<Misc::Float32>(tile->extent.min[0]);
+			job->data.write<Misc::Float32>(tile->extent.min[1]);
+			job->data.write<Misc::Float32>(tile->extent.max[0]);
+			job->data.write<Misc::Float32>(tile->extent.max[1]);
+			job->data.write<Misc::UInt32>(tile->numObjects);
+			job->data.write<Misc::UInt32>(tile->dataSize);
+			}
+		}
+	job->data.flush();
+	
+	/* Write the index after all tile files queued before it: */
+	submitJob(job);
+	indexDirty=false;
+	}
+
+void SketchBoard::writeBack(void)
+	{
+	for(TileMap::iterator tIt=tiles.begin();tIt!=tiles.end();)
+		{
+		/* Write back the tile if it is resident and changed: */
+		Tile* tile=tIt->second;
+		if(tile->resident&&tile->dirty)
+			{
+			std::vector<SketchObject*> objects;
+			getTileObjects(*tile,objects);
+			writeTile(*tile,objects);
+			}
+		
+		/* Forget resident tiles that are empty: */
+		if(tile->resident&&tile->dataSize==0)
+			{
+			delete tile;
+			tiles.erase(tIt++);
+			}
+		else
+			++tIt;
+		}
+	
+	/* Write the index if any tile files changed: */
+	if(indexDirty)
+		writeIndex();
+	}
+
+SketchBoard::SketchBoard(const std::string& sDirectoryName,Scalar sTileSize,size_t sMaxMemorySize,SketchObjectCreator& sCreator,SketchSettings& sSettings,SketchObjectCreator::PointEncoding sPointEncoding)
+	:directoryName(sDirectoryName),creator(sCreator),settings(sSettings),pointEncoding(sPointEncoding),
+	 master(Vrui::isHeadNode()),
+	 tileSize(sTileSize),maxMemorySize(sMaxMemorySize),
+	 memorySize(0),objectKeys(1021),maxKey(0),
+	 indexVersion(settings.getIndex().getVersion()),indexDirty(false),lastWriteTime(0.0),
+	 shutdown(false)
+	{
+	std::string error;
+	if(master)
+		{
+		try
+			{
+			if(access(getFileName("Board.index").c_str(),F_OK)==0)
+				{
+				/* Read the existing board's index: */
+				readIndex();
+				}
+			else
+				{
+				/* Create a new empty board: */
+				if(!(tileSize>Scalar(0)))
+					throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Invalid board tile size");
+				if(mkdir(directoryName.c_str(),0777)!=0&&errno!=EEXIST)
+					throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Could not create board directory %s",directoryName.c_str());
+				indexDirty=true;
+				}
+			}
+		catch(const std::runtime_error& err)
+			{
+			error=err.what();
+			}
+		}
+	
+	/* Send the outcome and the board's tile size to all render nodes in a cluster: */
+	Cluster::MulticastPipe* pipe=Vrui::getMainPipe();
+	if(pipe!=0)
+		{
+		if(master)
+			{
+			pipe->write<Misc::UInt8>(error.empty()?1U:0U);
+			pipe->write<Misc::Float32>(tileSize);
+			pipe->flush();
+			}
+		else
+			{
+			if(pipe->read<Misc::UInt8>()==0U)
+				error="Head node could not open the board";
+			tileSize=pipe->read<Misc::Float32>();
+			}
+		}
+	if(!error.empty())
+		{
+		/* Destroy all tiles read so far and signal an error: */
+		for(TileMap::iterator tIt=tiles.begin();tIt!=tiles.end();++tIt)
+			delete tIt->second;
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Could not open board %s due to exception %s",directoryName.c_str(),error.c_str());
+		}
+	
+	/* Start the background file thread: */
+	if(master)
+		jobThread.start(this,&SketchBoard::jobThreadMethod);
+	}
+
+SketchBoard::~SketchBoard(void)
+	{
+	if(master)
+		{
+		/* Find the tiles that received sketch objects while they were paged out, and load all of them that are not already loading: */
+		trackChanges();
+		unsigned int numLoading=0;
+		for(TileMap::iterator tIt=tiles.begin();tIt!=tiles.end();++tIt)
+			{
+			Tile* tile=tIt->second;
+			if(tile->dirty&&!tile->resident&&!tile->loading&&!tile->broken)
+				loadTile(tIt->first,*tile);
+			if(tile->loading)
+				++numLoading;
+			}
+		
+		/* Wait for all pending tile loads: */
+		std::vector<Job*> loaded;
+		while(numLoading>0)
+			{
+			std::vector<Job*> finished;
+			{
+			Threads::MutexCond::Lock jobLock(jobCond);
+			while(finishedJobs.empty())
+				jobCond.wait(jobLock);
+			finished.swap(finishedJobs);
+			}
+			
+			for(std::vector<Job*>::iterator jIt=finished.begin();jIt!=finished.end();++jIt)
+				{
+				Job* job=*jIt;
+				if(job->type==LoadTile)
+					{
+					--numLoading;
+					Tile* tile=tiles[job->tileKey];
+					if(job->error.empty()&&tile->dirty)
+						{
+						/* Keep the tile to merge it with the sketch objects moved into it: */
+						loaded.push_back(job);
+						continue;
+						}
+					tile->loading=false;
+					if(!job->error.empty())
+						{
+						Misc::formattedUserError("Board: Could not read file %s due to exception %s",job->fileName.c_str(),job->error.c_str());
+						tile->broken=true;
+						}
+					}
+				else if(!job->error.empty())
+					Misc::formattedUserError("Board: Could not write file %s due to exception %s",job->fileName.c_str(),job->error.c_str());
+				delete job;
+				}
+			}
+		
+		/* Install the loaded tiles: */
+		assignKeys();
+		for(std::vector<Job*>::iterator jIt=loaded.begin();jIt!=loaded.end();++jIt)
+			{
+			installTile(*tiles[(*jIt)->tileKey],**jIt);
+			delete *jIt;
+			}
+		
+		/* Write back all changed tiles, and save sketch objects that could not be merged into broken tiles elsewhere: */
+		writeBack();
+		for(TileMap::iterator tIt=tiles.begin();tIt!=tiles.end();++tIt)
+			if(tIt->second->dirty&&tIt->second->broken)
+				recoverTile(*tIt->second);
+		
+		/* Wait for the background thread to finish all pending file operations: */
+		{
+		Threads::MutexCond::Lock jobLock(jobCond);
+		shutdown=true;
+		jobCond.signal();
+		}
+		jobThread.join();
+		
+		/* Report failed operations and destroy all remaining finished jobs, including loaded unchanged tiles: */
+		for(std::vector<Job*>::iterator jIt=finishedJobs.begin();jIt!=finishedJobs.end();++jIt)
+			{
+			if(!(*jIt)->error.empty()&&(*jIt)->type!=LoadTile)
+				Misc::formattedUserError("Board: Could not write file %s due to exception %s",(*jIt)->fileName.c_str(),(*jIt)->error.c_str());
+			delete *jIt;
+			}
+		}
+	
+	/* Destroy all tiles: */
+	for(TileMap::iterator tIt=tiles.begin();tIt!=tiles.end();++tIt)
+		delete tIt->second;
+	}
+
+void SketchBoard::frame(const Box& region,double applicationTime)
+	{
+	Cluster::MulticastPipe* pipe=Vrui::getMainPipe();
+	if(master)
+		{
+		/* Mark the tiles affected by all edits since the last frame dirty: */
+		trackChanges();
+		
+		/* Pick up all finished file operations: */
+		std::vector<Job*> finished;
+		{
+		Threads::MutexCond::Lock jobLock(jobCond);
+		finished.swap(finishedJobs);
+		}
+		std::vector<Job*> loaded;
+		for(std::vector<Job*>::iterator jIt=finished.begin();jIt!=finished.end();++jIt)
+			{
+			Job* job=*jIt;
+			if(!job->error.empty())
+				{
+				/* Show an error message and never touch a tile whose file could not be read again: */
+				Misc::formattedUserError("Board: Could not %s file %s due to exception %s",job->type==LoadTile?"read":"write",job->fileName.c_str(),job->error.c_str());
+				if(job->type==LoadTile)
+					{
+					Tile* tile=tiles[job->tileKey];
+					tile->loading=false;
+					tile->broken=true;
+					}
+				delete job;
+				}
+			else if(job->type==LoadTile)
+				loaded.push_back(job);
+			else
+				delete job;
+			}
+		
+		/* Request all tiles that overlap the region, or that must be merged with sketch objects moved into them: */
+		for(TileMap::iterator tIt=tiles.begin();tIt!=tiles.end();++tIt)
+			{
+			Tile* tile=tIt->second;
+			if(overlaps(tile->extent,region)||overlaps(getCellBox(*tile),region)||(tile->dirty&&!tile->resident))
+				{
+				tile->lastUseTime=applicationTime;
+				if(!tile->resident&&!tile->loading&&!tile->broken)
+					{
+					/* Load the tile's file in the background: */
+					loadTile(tIt->first,*tile);
+					}
+				}
+			}
+		
+		/* Collect the resident tiles not needed in this frame as candidates for paging out, least recently needed first: */
+		std::vector<std::pair<double,Misc::UInt64> > candidates;
+		for(TileMap::iterator tIt=tiles.begin();tIt!=tiles.end();++tIt)
+			if(tIt->second->resident&&tIt->second->lastUseTime<applicationTime)
+				candidates.push_back(std::make_pair(tIt->second->lastUseTime,tIt->first));
+		std::sort(candidates.begin(),candidates.end());
+		
+		/* Assign drawing order keys to new sketch objects if any tiles might be installed or written in this frame: */
+		bool writeBackDue=applicationTime>=lastWriteTime+writeBackInterval;
+		bool assign=!loaded.empty()||writeBackDue||(memorySize>maxMemorySize&&!candidates.empty());
+		if(assign)
+			assignKeys();
+		
+		/* Install all loaded tiles: */
+		for(std::vector<Job*>::iterator jIt=loaded.begin();jIt!=loaded.end();++jIt)
+			installTile(*tiles[(*jIt)->tileKey],**jIt);
+		
+		/* Page out the least recently needed tiles until the resident tiles fit into the memory budget: */
+		std::vector<Misc::UInt64> evicted;
+		for(std::vector<std::pair<double,Misc::UInt64> >::iterator cIt=candidates.begin();cIt!=candidates.end()&&memorySize>maxMemorySize;++cIt)
+			{
+			TileMap::iterator tIt=tiles.find(cIt->second);
+			if(evictTile(*tIt->second))
+				{
+				evicted.push_back(cIt->second);
+				
+				/* Forget tiles that became empty: */
+				if(tIt->second->dataSize==0)
+					{
+					delete tIt->second;
+					tiles.erase(tIt);
+					}
+				}
+			}
+		
+		/* Periodically write back all changed tiles: */
+		if(writeBackDue)
+			{
+			writeBack();
+			lastWriteTime=applicationTime;
+			}
+		
+		if(pipe!=0)
+			{
+			/* Forward this frame's paging decisions and the loaded tile files to all render nodes: */
+			pipe->write<Misc::UInt8>(assign?1U:0U);
+			pipe->write<Misc::UInt32>(loaded.size());
+			for(std::vector<Job*>::iterator jIt=loaded.begin();jIt!=loaded.end();++jIt)
+				{
+				pipe->write<Misc::UInt64>((*jIt)->tileKey);
+				pipe->write<Misc::UInt32>((*jIt)->numObjects);
+				pipe->write<Misc::UInt32>((*jIt)->raw.size());
+				if(!(*jIt)->raw.empty())
+					pipe->write(&(*jIt)->raw.front(),(*jIt)->raw.size());
+				}
+			pipe->write<Misc::UInt32>(evicted.size());
+			for(std::vector<Misc::UInt64>::iterator eIt=evicted.begin();eIt!=evicted.end();++eIt)
+				pipe->write<Misc::UInt64>(*eIt);
+			pipe->flush();
+			}
+		
+		for(std::vector<Job*>::iterator jIt=loaded.begin();jIt!=loaded.end();++jIt)
+			delete *jIt;
+		
+		/* Ignore the changes made by paging tiles in and out: */
+		indexVersion=settings.getIndex().getVersion();
+		}
+	else if(pipe!=0)
+		{
+		/* Follow the head node's paging decisions: */
+		if(pipe->read<Misc::UInt8>()!=0U)
+			assignKeys();
+		
+		unsigned int numLoaded=pipe->read<Misc::UInt32>();
+		for(unsigned int i=0;i<numLoaded;++i)
+			{
+			/* Receive a tile file read by the head node and install its sketch objects: */
+			Misc::UInt64 tileKey=pipe->read<Misc::UInt64>();
+			Job job(LoadTile,std::string());
+			job.numObjects=pipe->read<Misc::UInt32>();
+			job.raw.resize(pipe->read<Misc::UInt32>());
+			if(!job.raw.empty())
+				pipe->read(&job.raw.front(),job.raw.size());
+			readTile(job,creator);
+			installTile(*getTile(int(Misc::SInt32(tileKey>>32)),int(Misc::SInt32(tileKey&0xffffffffU)),true),job);
+			}
+		
+		unsigned int numEvicted=pipe->read<Misc::UInt32>();
+		for(unsigned int i=0;i<numEvicted;++i)
+			{
+			/* Page out the tile's sketch objects by cell, as render nodes never see the tiles the head node creates when sketch objects are drawn into empty cells: */
+			Misc::UInt64 tileKey=pipe->read<Misc::UInt64>();
+			Tile* tile=getTile(int(Misc::SInt32(tileKey>>32)),int(Misc::SInt32(tileKey&0xffffffffU)),true);
+			evictTile(*tile);
+			
+			/* Render nodes only keep tiles while they are resident: */
+			delete tile;
+			tiles.erase(tileKey);
+			}
+		}
+	}
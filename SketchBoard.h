@@ -0,0 +1,185 @@
+/***********************************************************************
+SketchBoard - Class to page the sketch objects of an effectively
+unbounded board in and out of memory as square tiles stored in a
+directory, keeping only the tiles around the viewed region resident.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef SKETCHBOARD_INCLUDED
+#define SKETCHBOARD_INCLUDED
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <Misc/SizedTypes.h>
+#include <Misc/HashTable.h>
+#include <Threads/MutexCond.h>
+#include <Threads/Thread.h>
+#include <IO/VariableMemoryFile.h>
+
+#include "SketchGeometry.h"
+#include "SketchObjectList.h"
+#include "SketchObjectCreator.h"
+
+/* Forward declarations: */
+class SketchObject;
+class SketchSettings;
+
+class SketchBoard
+	{
+	/* Embedded classes: */
+	private:
+	struct Tile // Structure describing a square cell of the board and the sketch objects whose bounding box centers lie inside it
+		{
+		/* Elements: */
+		public:
+		int cell[2]; // Tile's column and row in the tile grid
+		Box extent; // Union of the drawn extents of the tile's sketch objects as of the last write-back
+		unsigned int numObjects; // Number of sketch objects in the tile's file
+		size_t dataSize; // Size of the tile's file in bytes, or 0 if the tile has no file
+		bool resident; // Flag if the contents of the tile's file are in the sketch object list
+		bool loading; // Flag if the tile's file is being loaded in the background
+		bool broken; // Flag if the tile's file could not be read; the tile is never paged in or written back
+		bool dirty; // Flag if the tile's sketch objects changed since they were last written
+		size_t memorySize; // Approximate memory used by the tile's sketch objects while resident
+		double lastUseTime; // Application time at which the tile was last needed
+		
+		/* Constructors and destructors: */
+		Tile(int column,int row)
+			:extent(Box::empty),numObjects(0),dataSize(0),
+			 resident(false),loading(false),broken(false),dirty(false),
+			 memorySize(0),lastUseTime(0.0)
+			{
+			cell[0]=column;
+			cell[1]=row;
+			}
+		};
+	
+	typedef std::map<Misc::UInt64,Tile*> TileMap; // Type for maps from packed cell indices to tiles
+	typedef Misc::HashTable<SketchObject*,Misc::UInt64> KeyMap; // Type for hash tables mapping resident sketch objects to their drawing order keys
+	typedef std::map<Misc::UInt64,SketchObject*> KeyOrder; // Type for maps from drawing order keys to resident sketch objects
+	
+	enum JobType // Enumerated type for file operations performed by the background thread
+		{
+		LoadTile,SaveFile,RemoveFile
+		};
+	
+	struct Job // Structure for file operations performed by the background thread
+		{
+		/* Elements: */
+		public:
+		JobType type; // The file operation
+		std::string fileName; // Name of the file to read, write, or remove
+		Misc::UInt64 tileKey; // Packed cell indices of the tile being loaded
+		unsigned int numObjects; // Number of sketch objects the board index lists for the tile being loaded
+		std::vector<char> raw; // Raw contents of the tile file being loaded, forwarded to all render nodes in a cluster; reserved to the expected size
+		IO::VariableMemoryFile data; // Contents of the file being written
+		SketchObjectList objects; // Sketch objects read from the tile file being loaded
+		std::vector<Misc::UInt64> keys; // Drawing order keys of the sketch objects read from the tile file being loaded
+		std::string error; // Error message if the operation failed; empty on success
+		
+		/* Constructors and destructors: */
+		Job(JobType sType,const std::string& sFileName)
+			:type(sType),fileName(sFileName),tileKey(0),numObjects(0)
+			{
+			}
+		};
+	
+	/* Elements: */
+	static const char* indexHeader; // Header string identifying board index files
+	static const char* tileHeader; // Header string identifying board tile files
+	static const Misc::UInt64 keyGap=Misc::UInt64(1)<<20; // Distance between the drawing order keys of sketch objects appended to the board
+	static const double writeBackInterval; // Minimum time between periodic write-backs of changed tiles in seconds
+	std::string directoryName; // Name of the directory containing the board's index and tile files
+	SketchObjectCreator& creator; // Object creator to read and write sketch objects in the main thread
+	SketchObjectCreator jobCreator; // Object creator to read sketch objects in the job thread
+	SketchSettings& settings; // Sketch settings containing the resident sketch objects
+	SketchObjectCreator::PointEncoding pointEncoding; // Encoding of curve points in tile files
+	bool master; // Flag if this instance accesses the board's files, i.e., is not a render node in a cluster
+	Scalar tileSize; // Edge length of the square tiles
+	size_t maxMemorySize; // Memory budget for resident tiles in bytes; tiles needed for the current region are kept resident regardless
+	TileMap tiles; // Map of all non-empty or resident tiles
+	size_t memorySize; // Approximate memory used by all resident tiles
+	KeyMap objectKeys; // Drawing order keys of all resident sketch objects that existed when keys were last assigned
+	KeyOrder keyOrder; // Resident sketch objects in order of their drawing order keys
+	Misc::UInt64 maxKey; // Largest drawing order key assigned on the board
+	unsigned int indexVersion; // Version number of the spatial index up to which changes to sketch objects were tracked
+	bool indexDirty; // Flag if the index file needs to be written
+	double lastWriteTime; // Application time at which dirty tiles were last written back
+	Threads::MutexCond jobCond; // Condition variable protecting the job queues and signaling new and finished jobs
+	std::deque<Job*> jobs; // Queue of pending file operations
+	std::vector<Job*> finishedJobs; // List of finished file operations whose results were not yet picked up
+	bool shutdown; // Flag telling the background thread to terminate once all pending jobs are done
+	Threads::Thread jobThread; // Thread performing file operations in the background
+	
+	/* Private methods: */
+	static Misc::UInt64 getTileKey(int column,int row) // Returns the packed cell indices of the given tile
+		{
+		return (Misc::UInt64(Misc::UInt32(column))<<32)|Misc::UInt64(Misc::UInt32(row));
+		}
+	std::string getFileName(const char* name) const; // Returns the name of the given file in the board's directory
+	std::string getTileFileName(const Tile& tile) const; // Returns the name of the given tile's file
+	void getCell(const SketchObject* object,int cell[2]) const; // Returns the tile grid cell containing the given sketch object's bounding box center
+	Box getCellBox(const Tile& tile) const; // Returns the given tile's cell in the sketching plane
+	Tile* getTile(int column,int row,bool create); // Returns the tile of the given cell, or null if there is none and the tile shall not be created
+	void markDirty(const SketchObject* object); // Marks the tile containing the given sketch object as dirty, creating it if it does not exist yet
+	void readIndex(void); // Reads the board's index file
+	static void readTile(Job& job,SketchObjectCreator& tileCreator); // Reads the sketch objects and their drawing order keys from the raw contents of a tile file using the given object creator; throws if the tile file does not contain the expected number of sketch objects
+	void* jobThreadMethod(void); // Method performing file operations in the background
+	void submitJob(Job* job); // Queues the given file operation for the background thread
+	void loadTile(Misc::UInt64 tileKey,Tile& tile); // Starts loading the given paged-out tile's file in the background
+	void trackChanges(void); // Marks the tiles affected by all changes to sketch objects since the last frame as dirty
+	void assignKeys(void); // Assigns drawing order keys to all resident sketch objects that lack consistent keys
+	void getTileObjects(const Tile& tile,std::vector<SketchObject*>& objects) const; // Returns the resident sketch objects belonging to the given tile in list order
+	void installTile(Tile& tile,Job& job); // Inserts the sketch objects read from the given tile's file into the sketch object list in drawing order
+	void writeTile(Tile& tile,const std::vector<SketchObject*>& objects); // Writes the given sketch objects of the given resident tile to its file in the background
+	void recoverTile(Tile& tile); // Writes the sketch objects moved into the given broken tile to a new sketch file in the board's directory
+	bool evictTile(Tile& tile); // Writes back and removes the given resident tile's sketch objects; returns false if the tile can not be evicted
+	void writeIndex(void); // Writes the board's index file in the background
+	void writeBack(void); // Writes back all changed resident tiles and the index file
+	
+	/* Constructors and destructors: */
+	public:
+	SketchBoard(const std::string& sDirectoryName,Scalar sTileSize,size_t sMaxMemorySize,SketchObjectCreator& sCreator,SketchSettings& sSettings,SketchObjectCreator::PointEncoding sPointEncoding); // Opens the board in the given directory, or creates an empty board with the given tile size if the directory contains none; in a cluster, only the head node accesses the board's files
+	private:
+	SketchBoard(const SketchBoard& source); // Prohibit copy constructor
+	SketchBoard& operator=(const SketchBoard& source); // Prohibit assignment operator
+	public:
+	~SketchBoard(void); // Merges sketch objects moved into paged-out tiles, writes back all changed tiles, and waits for all pending file operations; leaves the resident sketch objects in the sketch object list
+	
+	/* Methods: */
+	const std::string& getDirectoryName(void) const // Returns the name of the board's directory
+		{
+		return directoryName;
+		}
+	Scalar getTileSize(void) const // Returns the board's tile size
+		{
+		return tileSize;
+		}
+	size_t getMemorySize(void) const // Returns the approximate memory used by all resident tiles
+		{
+		return memorySize;
+		}
+	void frame(const Box& region,double applicationTime); // Pages in all tiles overlapping the given region in the sketching plane in the background, installs loaded tiles, pages out unneeded tiles exceeding the memory budget, and periodically writes back changed tiles; called once per frame on all nodes in a cluster
+	};
+
+#endif
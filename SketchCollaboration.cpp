@@ -0,0 +1,1189 @@
+/***********************************************************************
+SketchCollaboration - Class to share a sketch between SketchPad instances
+on separate machines by replicating their journaled edit operations
+over TCP.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "SketchCollaboration.h"
+
+#include <string.h>
+#include <utility>
+#include <stdexcept>
+#include <Misc/StdError.h>
+#include <Misc/MessageLogger.h>
+#include <Misc/StandardMarshallers.h>
+#include <IO/FixedMemoryFile.h>
+#include <Comm/ListeningTCPSocket.h>
+#include <Comm/TCPPipe.h>
+#include <Cluster/MulticastPipe.h>
+#include <Vrui/Vrui.h>
+
+#include "RenderState.h"
+#include "Curve.h"
+#include "SketchObjectCreator.h"
+#include "SketchSettings.h"
+#include "SketchJournal.h"
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+void writeData(IO::File& file,const std::vector<Misc::UInt8>& data) // Writes a block of payload data preceded by its size
+	{
+	file.write<Misc::UInt32>(Misc::UInt32(data.size()));
+	if(!data.empty())
+		file.write(&data.front(),data.size());
+	}
+
+void writeData(IO::File& file,IO::VariableMemoryFile& data) // Writes the contents of the given memory file preceded by their size
+	{
+	data.flush();
+	file.write<Misc::UInt32>(Misc::UInt32(data.getDataSize()));
+	data.writeToSink(file);
+	}
+
+void readData(IO::File& file,std::vector<Misc::UInt8>& data,size_t maxSize=~size_t(0)) // Reads a block of payload data preceded by its size; throws an exception if the size exceeds the given maximum
+	{
+	size_t size=file.read<Misc::UInt32>();
+	if(size>maxSize)
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Payload of %u bytes exceeds the protocol limit",(unsigned int)size);
+	data.resize(size);
+	if(!data.empty())
+		file.read(&data.front(),data.size());
+	}
+
+void copyData(const std::vector<Misc::UInt8>& data,IO::FixedMemoryFile& file) // Copies a block of payload data into a memory file of the same size to read it
+	{
+	if(!data.empty())
+		memcpy(file.getMemory(),&data.front(),data.size());
+	file.setEndianness(Misc::LittleEndian);
+	}
+
+void copyData(IO::VariableMemoryFile& file,std::vector<Misc::UInt8>& data) // Copies the contents of the given memory file into a block of payload data
+	{
+	file.flush();
+	data.resize(file.getDataSize());
+	if(!data.empty())
+		{
+		IO::FixedMemoryFile buffer(data.size());
+		file.writeToSink(buffer);
+		buffer.flush();
+		memcpy(&data.front(),buffer.getMemory(),data.size());
+		}
+	}
+
+void writeIds(IO::File& file,const std::vector<Misc::UInt64>& ids) // Writes a list of sketch object identifiers preceded by its size
+	{
+	file.write<Misc::UInt32>(Misc::UInt32(ids.size()));
+	if(!ids.empty())
+		file.write(&ids.front(),ids.size());
+	}
+
+void readIds(IO::File& file,std::vector<Misc::UInt64>& ids,size_t maxSize) // Reads a list of sketch object identifiers preceded by its size; throws an exception if the list's size in bytes exceeds the given maximum
+	{
+	size_t numIds=file.read<Misc::UInt32>();
+	if(numIds>maxSize/sizeof(Misc::UInt64))
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"List of %u identifiers exceeds the protocol limit",(unsigned int)numIds);
+	ids.resize(numIds);
+	if(!ids.empty())
+		file.read(&ids.front(),ids.size());
+	}
+
+bool intersect(const std::vector<Misc::UInt64>& ids0,const std::vector<Misc::UInt64>& ids1) // Returns true if the two given sorted lists of identifiers have any in common
+	{
+	std::vector<Misc::UInt64>::const_iterator i0It=ids0.begin();
+	std::vector<Misc::UInt64>::const_iterator i1It=ids1.begin();
+	while(i0It!=ids0.end()&&i1It!=ids1.end())
+		{
+		if(*i0It<*i1It)
+			++i0It;
+		else if(*i1It<*i0It)
+			++i1It;
+		else
+			return true;
+		}
+	return false;
+	}
+
+}
+
+/******************************************
+Methods of class SketchCollaboration::Peer:
+******************************************/
+
+SketchCollaboration::Peer::Peer(SketchCollaboration* sCollaboration,unsigned int sId,Comm::NetPipePtr sPipe)
+	:collaboration(sCollaboration),id(sId),pipe(sPipe),alive(true),
+	 outgoing(new IO::VariableMemoryFile),sending(new IO::VariableMemoryFile),
+	 numQueued(0),backlog(0),sendFailed(false)
+	{
+	pipe->setEndianness(Misc::LittleEndian);
+	}
+
+SketchCollaboration::Peer::~Peer(void)
+	{
+	/* Stop the receive and send threads: */
+	if(!receiveThread.isJoined())
+		{
+		receiveThread.cancel();
+		receiveThread.join();
+		}
+	if(!sendThread.isJoined())
+		{
+		sendThread.cancel();
+		sendThread.join();
+		}
+	
+	delete outgoing;
+	delete sending;
+	}
+
+void* SketchCollaboration::Peer::receiveThreadMethod(void)
+	{
+	Message message;
+	message.peerId=id;
+	try
+		{
+		/* Check the peer's protocol header: */
+		size_t headerLength=strlen(protocolHeader);
+		char header[64];
+		pipe->read(header,headerLength);
+		if(memcmp(header,protocolHeader,headerLength)!=0)
+			throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Peer uses an incompatible protocol");
+		
+		/* Queue messages for the main thread until the connection is closed: */
+		while(true)
+			{
+			collaboration->readMessage(*pipe,message);
+			collaboration->postMessage(message);
+			}
+		}
+	catch(const std::runtime_error& err)
+		{
+		/* Tell the main thread that the connection was closed: */
+		message.type=Disconnected;
+		message.data.assign(err.what(),err.what()+strlen(err.what()));
+		collaboration->postMessage(message);
+		}
+	
+	return 0;
+	}
+
+void* SketchCollaboration::Peer::sendThreadMethod(void)
+	{
+	while(true)
+		{
+		/* Wait for queued messages and take them over, so that the main thread can keep queueing messages while they are written: */
+		size_t numBytes;
+		{
+		Threads::Mutex::Lock sendLock(sendMutex);
+		while(numQueued==0)
+			sendCond.wait(sendMutex);
+		std::swap(outgoing,sending);
+		numBytes=numQueued;
+		numQueued=0;
+		}
+		
+		try
+			{
+			/* Write the messages to the peer: */
+			sending->writeToSink(*pipe);
+			pipe->flush();
+			}
+		catch(const std::runtime_error&)
+			{
+			/* Stop sending; the main thread will disconnect the peer: */
+			{
+			Threads::Mutex::Lock sendLock(sendMutex);
+			sendFailed=true;
+			}
+			Vrui::requestUpdate();
+			break;
+			}
+		sending->clear();
+		
+		{
+		Threads::Mutex::Lock sendLock(sendMutex);
+		backlog-=numBytes;
+		}
+		}
+	
+	return 0;
+	}
+
+void SketchCollaboration::Peer::start(void)
+	{
+	receiveThread.start(this,&SketchCollaboration::Peer::receiveThreadMethod);
+	sendThread.start(this,&SketchCollaboration::Peer::sendThreadMethod);
+	}
+
+/********************************************
+Static elements of class SketchCollaboration:
+********************************************/
+
+const char* SketchCollaboration::protocolHeader="SketchPadCollaboration v3.0\n";
+
+/************************************
+Methods of class SketchCollaboration:
+************************************/
+
+void SketchCollaboration::startNetworking(std::string& error)
+	{
+	/* Use the head node's outcome in a cluster: */
+	Cluster::MulticastPipe* pipe=Vrui::getMainPipe();
+	if(pipe!=0)
+		{
+		if(Vrui::isHeadNode())
+			{
+			Misc::Marshaller<std::string>::write(error,*pipe);
+			pipe->flush();
+			}
+		else
+			error=Misc::Marshaller<std::string>::read(*pipe);
+		}
+	
+	if(!error.empty())
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"%s",error.c_str());
+	}
+
+void SketchCollaboration::readMessage(IO::File& pipe,Message& message) const
+	{
+	message.type=MessageType(pipe.read<Misc::UInt8>());
+	message.seq=0;
+	message.originId=message.peerId;
+	message.batchId=0;
+	message.touchedIds.clear();
+	message.data.clear();
+	
+	if(host)
+		{
+		/* Read the rest of a message sent by a client: */
+		switch(message.type)
+			{
+			case Batch:
+				message.batchId=pipe.read<Misc::UInt32>();
+				message.seq=pipe.read<Misc::UInt32>();
+				readIds(pipe,message.touchedIds,maxMessageSize);
+				readData(pipe,message.data,maxMessageSize);
+				break;
+			
+			case Snapshot:
+			case LiveStrokes:
+				readData(pipe,message.data,maxMessageSize);
+				break;
+			
+			case Resync:
+				break;
+			
+			default:
+				throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Invalid message type %u from client",(unsigned int)message.type);
+			}
+		}
+	else
+		{
+		/* Read the rest of a message sent by the host: */
+		switch(message.type)
+			{
+			case Welcome:
+			case PeerLeft:
+				message.originId=pipe.read<Misc::UInt32>();
+				break;
+			
+			case Snapshot:
+				message.seq=pipe.read<Misc::UInt32>();
+				readData(pipe,message.data,maxMessageSize);
+				break;
+			
+			case Batch:
+				message.seq=pipe.read<Misc::UInt32>();
+				message.originId=pipe.read<Misc::UInt32>();
+				message.batchId=pipe.read<Misc::UInt32>();
+				readData(pipe,message.data,maxMessageSize);
+				break;
+			
+			case Reject:
+				message.batchId=pipe.read<Misc::UInt32>();
+				break;
+			
+			case LiveStrokes:
+				message.originId=pipe.read<Misc::UInt32>();
+				readData(pipe,message.data,maxMessageSize);
+				break;
+			
+			default:
+				throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Invalid message type %u from host",(unsigned int)message.type);
+			}
+		}
+	}
+
+void SketchCollaboration::postMessage(Message& message)
+	{
+	{
+	/* Append the message to the queue without copying its payload: */
+	Threads::Mutex::Lock incomingLock(incomingMutex);
+	std::vector<Misc::UInt64> touchedIds;
+	touchedIds.swap(message.touchedIds);
+	std::vector<Misc::UInt8> data;
+	data.swap(message.data);
+	incoming.push_back(message);
+	incoming.back().touchedIds.swap(touchedIds);
+	incoming.back().data.swap(data);
+	}
+	
+	/* Wake up the main thread to handle the message: */
+	Vrui::requestUpdate();
+	}
+
+void* SketchCollaboration::acceptThreadMethod(void)
+	{
+	while(true)
+		{
+		try
+			{
+			/* Wait for the next client to connect: */
+			Comm::NetPipePtr pipe=new Comm::TCPPipe(*listenSocket);
+			
+			{
+			Threads::Mutex::Lock incomingLock(incomingMutex);
+			newPipes.push_back(pipe);
+			}
+			
+			/* Wake up the main thread to welcome the new client: */
+			Vrui::requestUpdate();
+			}
+		catch(const std::runtime_error&)
+			{
+			/* Ignore failed connection attempts: */
+			}
+		}
+	
+	return 0;
+	}
+
+SketchCollaboration::Peer* SketchCollaboration::findPeer(unsigned int peerId)
+	{
+	for(std::vector<Peer*>::iterator pIt=peers.begin();pIt!=peers.end();++pIt)
+		if((*pIt)->id==peerId)
+			return *pIt;
+	return 0;
+	}
+
+void SketchCollaboration::send(Peer* peer,IO::VariableMemoryFile& message)
+	{
+	if(peer->alive)
+		{
+		message.flush();
+		size_t messageSize=message.getDataSize();
+		
+		Threads::Mutex::Lock sendLock(peer->sendMutex);
+		if(messageSize>maxMessageSize)
+			{
+			/* The peer would reject the message; stop sending to it, it will be disconnected at the end of the frame: */
+			Misc::formattedUserError("Collaboration: Disconnecting site %u, which can not receive a %u MB message",peer->id,(unsigned int)(messageSize>>20));
+			peer->alive=false;
+			}
+		else if(peer->backlog>0&&peer->backlog+messageSize>maxBacklog)
+			{
+			/* The peer does not keep up; stop sending to it, it will be disconnected at the end of the frame: */
+			Misc::formattedUserError("Collaboration: Disconnecting site %u, which fell %u MB behind",peer->id,(unsigned int)(peer->backlog>>20));
+			peer->alive=false;
+			}
+		else
+			{
+			/* Queue the message for the peer's send thread: */
+			message.writeToSink(*peer->outgoing);
+			peer->outgoing->flush();
+			peer->numQueued+=messageSize;
+			peer->backlog+=messageSize;
+			peer->sendCond.signal();
+			}
+		}
+	}
+
+void SketchCollaboration::broadcast(IO::VariableMemoryFile& message,const Peer* except)
+	{
+	for(std::vector<Peer*>::iterator pIt=peers.begin();pIt!=peers.end();++pIt)
+		if(*pIt!=except)
+			send(*pIt,message);
+	}
+
+void SketchCollaboration::writeSnapshot(IO::VariableMemoryFile& message)
+	{
+	/* Serialize all sketch objects in sketch file format, followed by their identifiers: */
+	IO::VariableMemoryFile snapshot;
+	snapshot.setEndianness(Misc::LittleEndian);
+	creator.writeFile(settings.getSketchObjects(),snapshot);
+	settings.writeObjectIds(snapshot);
+	writeData(message,snapshot);
+	}
+
+void SketchCollaboration::sendSnapshot(Peer* peer)
+	{
+	IO::VariableMemoryFile message;
+	message.setEndianness(Misc::LittleEndian);
+	message.write<Misc::UInt8>(Snapshot);
+	message.write<Misc::UInt32>(seq);
+	writeSnapshot(message);
+	send(peer,message);
+	}
+
+void SketchCollaboration::sendReject(Peer* peer,Misc::UInt32 batchId)
+	{
+	IO::VariableMemoryFile message;
+	message.setEndianness(Misc::LittleEndian);
+	message.write<Misc::UInt8>(Reject);
+	message.write<Misc::UInt32>(batchId);
+	send(peer,message);
+	}
+
+void SketchCollaboration::sequence(unsigned int originId,const std::vector<Misc::UInt64>* touchedIds)
+	{
+	/* Advance the sequence number and remember which sketch objects the update referred to, forgetting the oldest update: */
+	++seq;
+	if(sequencedUpdates.size()>=maxSequencedUpdates)
+		sequencedUpdates.erase(sequencedUpdates.begin());
+	sequencedUpdates.push_back(SequencedUpdate());
+	SequencedUpdate& su=sequencedUpdates.back();
+	su.seq=seq;
+	su.originId=originId;
+	su.snapshot=touchedIds==0;
+	if(touchedIds!=0)
+		su.touchedIds=*touchedIds;
+	}
+
+bool SketchCollaboration::isConflicting(unsigned int originId,Misc::UInt32 baseSeq,const std::vector<Misc::UInt64>& touchedIds) const
+	{
+	/* Assume a conflict if the host forgot some of the updates the batch is concurrent with: */
+	if(baseSeq<seq&&(sequencedUpdates.empty()||sequencedUpdates.front().seq>baseSeq+1))
+		return true;
+	
+	/* Check all updates from other sites that the originating site did not see when it made the batch: */
+	for(std::vector<SequencedUpdate>::const_iterator suIt=sequencedUpdates.begin();suIt!=sequencedUpdates.end();++suIt)
+		if(suIt->seq>baseSeq&&suIt->originId!=originId)
+			{
+			/* A batch conflicts with a replacement of all sketch objects, or with a batch referring to some of the same sketch objects: */
+			if(suIt->snapshot||intersect(suIt->touchedIds,touchedIds))
+				return true;
+			}
+	
+	return false;
+	}
+
+bool SketchCollaboration::commitUpdate(MessageType type,unsigned int originId,const std::vector<Misc::UInt8>& data)
+	{
+	/* Share the update with all other nodes in a cluster: */
+	Cluster::MulticastPipe* pipe=Vrui::getMainPipe();
+	if(pipe!=0)
+		{
+		pipe->write<Misc::UInt8>(type);
+		pipe->write<Misc::UInt32>(originId);
+		writeData(*pipe,data);
+		}
+	
+	return applyUpdate(type,originId,data);
+	}
+
+bool SketchCollaboration::applyUpdate(MessageType type,unsigned int originId,const std::vector<Misc::UInt8>& data)
+	{
+	try
+		{
+		switch(type)
+			{
+			case Welcome:
+				/* Create new sketch objects in the site's identifier namespace: */
+				settings.setSiteId(originId);
+				break;
+			
+			case Batch:
+				{
+				/* Apply the batch's records without logging their placements or recording them in the undo history, which are not this site's own, and append them to the autosave journal; changing sketch objects without recording discards the local edits that refer to them: */
+				IO::FixedMemoryFile file(data.size());
+				copyData(data,file);
+				std::vector<SketchSettings::Placement>* placementLog=settings.getPlacementLog();
+				settings.setPlacementLog(0);
+				settings.suspendHistory();
+				try
+					{
+					journal.replayRecords(file);
+					}
+				catch(const std::runtime_error&)
+					{
+					settings.resumeHistory();
+					settings.setPlacementLog(placementLog);
+					throw;
+					}
+				settings.resumeHistory();
+				settings.setPlacementLog(placementLog);
+				if(!data.empty())
+					journal.journalRecords(&data.front(),data.size());
+				break;
+				}
+			
+			case Reorder:
+				{
+				IO::FixedMemoryFile file(data.size());
+				copyData(data,file);
+				std::vector<SketchSettings::Placement> reorder(file.read<Misc::UInt32>());
+				for(std::vector<SketchSettings::Placement>::iterator rIt=reorder.begin();rIt!=reorder.end();++rIt)
+					{
+					rIt->objectId=file.read<Misc::UInt64>();
+					rIt->toFront=file.read<Misc::UInt8>()!=0U;
+					}
+				settings.repeatPlacements(reorder);
+				break;
+				}
+			
+			case Snapshot:
+				{
+				/* Replace all sketch objects with the snapshot's: */
+				IO::FixedMemoryFile file(data.size());
+				copyData(data,file);
+				journal.installSnapshot(file,Vrui::getApplicationTime());
+				break;
+				}
+			
+			case LiveStrokes:
+				{
+				IO::FixedMemoryFile file(data.size());
+				copyData(data,file);
+				unsigned int numStrokes=file.read<Misc::UInt32>();
+				for(unsigned int stroke=0;stroke<numStrokes;++stroke)
+					{
+					/* Find the stroke or start a new one: */
+					Misc::UInt32 strokeId=file.read<Misc::UInt32>();
+					std::vector<RemoteStroke>::iterator rsIt;
+					for(rsIt=remoteStrokes.begin();rsIt!=remoteStrokes.end()&&(rsIt->originId!=originId||rsIt->strokeId!=strokeId);++rsIt)
+						;
+					if(rsIt==remoteStrokes.end())
+						{
+						remoteStrokes.push_back(RemoteStroke());
+						rsIt=remoteStrokes.end()-1;
+						rsIt->originId=originId;
+						rsIt->strokeId=strokeId;
+						}
+					
+					/* Read the stroke's settings and append its new points: */
+					for(int i=0;i<4;++i)
+						rsIt->color[i]=file.read<Misc::UInt8>();
+					rsIt->lineWidth=file.read<Misc::Float32>();
+					bool finished=file.read<Misc::UInt8>()!=0U;
+					unsigned int numPoints=file.read<Misc::UInt32>();
+					for(unsigned int i=0;i<numPoints;++i)
+						{
+						Point p;
+						file.read(p.getComponents(),3);
+						rsIt->points.push_back(p);
+						}
+					
+					/* Drop a finished stroke; the finished sketch object arrived in a batch before: */
+					if(finished)
+						remoteStrokes.erase(rsIt);
+					}
+				break;
+				}
+			
+			case PeerLeft:
+			case Disconnected:
+				{
+				/* Drop all strokes that the departed collaborator, or all collaborators if the host was lost, were still drawing: */
+				std::vector<RemoteStroke>::iterator destIt=remoteStrokes.begin();
+				for(std::vector<RemoteStroke>::iterator rsIt=remoteStrokes.begin();rsIt!=remoteStrokes.end();++rsIt)
+					if(type==PeerLeft&&rsIt->originId!=originId)
+						{
+						if(destIt!=rsIt)
+							*destIt=*rsIt;
+						++destIt;
+						}
+				remoteStrokes.erase(destIt,remoteStrokes.end());
+				break;
+				}
+			
+			default:
+				break;
+			}
+		}
+	catch(const std::runtime_error& err)
+		{
+		Misc::formattedUserError("Collaboration: Could not apply update from site %u due to exception %s",originId,err.what());
+		return false;
+		}
+	
+	return true;
+	}
+
+void SketchCollaboration::repeatPendingPlacements(void)
+	{
+	/* Collect the placements of all unsequenced batches whose effects were applied locally, in order: */
+	IO::VariableMemoryFile reorder;
+	reorder.setEndianness(Misc::LittleEndian);
+	size_t numPlacements=0;
+	for(std::vector<PendingBatch>::iterator pbIt=pendingBatches.begin();pbIt!=pendingBatches.end();++pbIt)
+		if(!pbIt->lost)
+			numPlacements+=pbIt->placements.size();
+	if(numPlacements==0)
+		return;
+	reorder.write<Misc::UInt32>(Misc::UInt32(numPlacements));
+	for(std::vector<PendingBatch>::iterator pbIt=pendingBatches.begin();pbIt!=pendingBatches.end();++pbIt)
+		if(!pbIt->lost)
+			for(std::vector<SketchSettings::Placement>::iterator pIt=pbIt->placements.begin();pIt!=pbIt->placements.end();++pIt)
+				{
+				reorder.write<Misc::UInt64>(pIt->objectId);
+				reorder.write<Misc::UInt8>(pIt->toFront?1U:0U);
+				}
+	
+	/* Move the objects behind the objects placed by the other site's batch, as the host will apply the unsequenced batches after that one: */
+	std::vector<Misc::UInt8> data;
+	copyData(reorder,data);
+	commitUpdate(Reorder,siteId,data);
+	}
+
+void SketchCollaboration::sendLiveStrokes(void)
+	{
+	/* Collect the new points of all local strokes: */
+	IO::VariableMemoryFile strokes;
+	strokes.setEndianness(Misc::LittleEndian);
+	unsigned int numStrokes=0;
+	for(std::vector<LocalStroke>::iterator lsIt=localStrokes.begin();lsIt!=localStrokes.end();++lsIt)
+		if(!lsIt->newPoints.empty()||lsIt->finished)
+			++numStrokes;
+	if(numStrokes==0)
+		return;
+	strokes.write<Misc::UInt32>(numStrokes);
+	std::vector<LocalStroke>::iterator destIt=localStrokes.begin();
+	for(std::vector<LocalStroke>::iterator lsIt=localStrokes.begin();lsIt!=localStrokes.end();++lsIt)
+		{
+		if(!lsIt->newPoints.empty()||lsIt->finished)
+			{
+			strokes.write<Misc::UInt32>(lsIt->strokeId);
+			for(int i=0;i<4;++i)
+				strokes.write<Misc::UInt8>(lsIt->color[i]);
+			strokes.write<Misc::Float32>(lsIt->lineWidth);
+			strokes.write<Misc::UInt8>(lsIt->finished?1U:0U);
+			strokes.write<Misc::UInt32>(Misc::UInt32(lsIt->newPoints.size()));
+			for(PointList::iterator pIt=lsIt->newPoints.begin();pIt!=lsIt->newPoints.end();++pIt)
+				strokes.write(pIt->getComponents(),3);
+			lsIt->newPoints.clear();
+			}
+		
+		/* Keep the stroke if it is still being drawn: */
+		if(!lsIt->finished)
+			{
+			if(destIt!=lsIt)
+				*destIt=*lsIt;
+			++destIt;
+			}
+		}
+	localStrokes.erase(destIt,localStrokes.end());
+	
+	/* Send the strokes to the host, or to all clients tagged with this instance's site ID: */
+	IO::VariableMemoryFile message;
+	message.setEndianness(Misc::LittleEndian);
+	message.write<Misc::UInt8>(LiveStrokes);
+	if(host)
+		message.write<Misc::UInt32>(siteId);
+	writeData(message,strokes);
+	broadcast(message,0);
+	}
+
+void SketchCollaboration::processHostMessage(Message& message)
+	{
+	/* Ignore stale messages from clients that were already disconnected: */
+	Peer* peer=findPeer(message.peerId);
+	if(peer==0)
+		return;
+	
+	switch(message.type)
+		{
+		case Batch:
+			if(isConflicting(peer->id,message.seq,message.touchedIds))
+				{
+				/* The batch refers to sketch objects that concurrent edits the client did not see yet changed; reject it and send the current state: */
+				sendReject(peer,message.batchId);
+				sendSnapshot(peer);
+				}
+			else if(commitUpdate(Batch,peer->id,message.data))
+				{
+				/* Sequence the batch and send it to all clients, including the originator as an acknowledgment: */
+				sequence(peer->id,&message.touchedIds);
+				IO::VariableMemoryFile forward;
+				forward.setEndianness(Misc::LittleEndian);
+				forward.write<Misc::UInt8>(Batch);
+				forward.write<Misc::UInt32>(seq);
+				forward.write<Misc::UInt32>(peer->id);
+				forward.write<Misc::UInt32>(message.batchId);
+				writeData(forward,message.data);
+				broadcast(forward,0);
+				}
+			else
+				{
+				/* The batch failed halfway and left the sketch objects in a new state; all clients have to start over from it: */
+				sendReject(peer,message.batchId);
+				sequence(siteId,0);
+				for(std::vector<Peer*>::iterator pIt=peers.begin();pIt!=peers.end();++pIt)
+					sendSnapshot(*pIt);
+				}
+			break;
+		
+		case Snapshot:
+			if(commitUpdate(Snapshot,peer->id,message.data))
+				{
+				/* Sequence the snapshot and send it to all clients: */
+				sequence(peer->id,0);
+				for(std::vector<Peer*>::iterator pIt=peers.begin();pIt!=peers.end();++pIt)
+					sendSnapshot(*pIt);
+				}
+			else
+				{
+				/* Send the unchanged state back to the client: */
+				sendSnapshot(peer);
+				}
+			break;
+		
+		case Resync:
+			sendSnapshot(peer);
+			break;
+		
+		case LiveStrokes:
+			{
+			/* Show the client's strokes and forward them to all other clients: */
+			commitUpdate(LiveStrokes,peer->id,message.data);
+			IO::VariableMemoryFile forward;
+			forward.setEndianness(Misc::LittleEndian);
+			forward.write<Misc::UInt8>(LiveStrokes);
+			forward.write<Misc::UInt32>(peer->id);
+			writeData(forward,message.data);
+			broadcast(forward,peer);
+			break;
+			}
+		
+		case Disconnected:
+			disconnect(peer);
+			break;
+		
+		default:
+			break;
+		}
+	}
+
+void SketchCollaboration::processClientMessage(Message& message)
+	{
+	/* Ignore stale messages from a lost host: */
+	if(peers.empty())
+		return;
+	
+	bool resync=false;
+	switch(message.type)
+		{
+		case Welcome:
+			{
+			/* Create new sketch objects in the assigned site ID's namespace on all cluster nodes: */
+			siteId=message.originId;
+			std::vector<Misc::UInt8> noData;
+			commitUpdate(Welcome,siteId,noData);
+			break;
+			}
+		
+		case Snapshot:
+			if(commitUpdate(Snapshot,0,message.data))
+				{
+				/* The snapshot replaced the effects of all batches the host did not sequence yet: */
+				seq=message.seq;
+				resyncing=false;
+				joined=true;
+				for(std::vector<PendingBatch>::iterator pbIt=pendingBatches.begin();pbIt!=pendingBatches.end();++pbIt)
+					{
+					pbIt->lost=true;
+					pbIt->placements.clear();
+					}
+				}
+			else
+				resync=true;
+			break;
+		
+		case Batch:
+			if(message.originId==siteId)
+				{
+				/* The host sequenced one of this client's batches: */
+				bool lost=false;
+				if(!pendingBatches.empty()&&pendingBatches.front().batchId==message.batchId)
+					{
+					lost=pendingBatches.front().lost;
+					pendingBatches.erase(pendingBatches.begin());
+					}
+				
+				/* Apply the batch if a snapshot replaced its local effects, unless a pending snapshot will contain it, in front of the later unsequenced batches: */
+				if(!resyncing)
+					{
+					if(lost)
+						{
+						if(commitUpdate(Batch,message.originId,message.data))
+							repeatPendingPlacements();
+						else
+							resync=true;
+						}
+					seq=message.seq;
+					}
+				}
+			else if(!resyncing)
+				{
+				/* Apply another site's batch; the host will apply this client's unsequenced batches after it, or reject those referring to the same sketch objects: */
+				if(commitUpdate(Batch,message.originId,message.data))
+					repeatPendingPlacements();
+				else
+					resync=true;
+				seq=message.seq;
+				}
+			break;
+		
+		case Reject:
+			/* The host will follow up with a snapshot: */
+			if(!pendingBatches.empty()&&pendingBatches.front().batchId==message.batchId)
+				pendingBatches.erase(pendingBatches.begin());
+			resyncing=true;
+			break;
+		
+		case LiveStrokes:
+		case PeerLeft:
+			commitUpdate(message.type,message.originId,message.data);
+			break;
+		
+		case Disconnected:
+			disconnect(peers.front());
+			break;
+		
+		default:
+			break;
+		}
+	
+	if(resync&&!resyncing)
+		{
+		/* Discard all updates until the host sends the current state: */
+		IO::VariableMemoryFile request;
+		request.setEndianness(Misc::LittleEndian);
+		request.write<Misc::UInt8>(Resync);
+		send(peers.front(),request);
+		resyncing=true;
+		}
+	}
+
+void SketchCollaboration::disconnect(Peer* peer)
+	{
+	/* Stop the peer's threads and close the connection: */
+	unsigned int peerId=peer->id;
+	for(std::vector<Peer*>::iterator pIt=peers.begin();pIt!=peers.end();++pIt)
+		if(*pIt==peer)
+			{
+			peers.erase(pIt);
+			break;
+			}
+	delete peer;
+	
+	if(host)
+		{
+		/* Drop the client's strokes and tell all other clients to do the same: */
+		std::vector<Misc::UInt8> noData;
+		commitUpdate(PeerLeft,peerId,noData);
+		IO::VariableMemoryFile message;
+		message.setEndianness(Misc::LittleEndian);
+		message.write<Misc::UInt8>(PeerLeft);
+		message.write<Misc::UInt32>(peerId);
+		broadcast(message,0);
+		}
+	else
+		{
+		/* Continue working alone: */
+		Misc::formattedUserError("Collaboration: Lost connection to the host; continuing without collaboration");
+		std::vector<Misc::UInt8> noData;
+		commitUpdate(Disconnected,peerId,noData);
+		pendingBatches.clear();
+		settings.setPlacementLog(0);
+		placements.clear();
+		}
+	}
+
+SketchCollaboration::SketchCollaboration(int portId,SketchObjectCreator& sCreator,SketchSettings& sSettings,SketchJournal& sJournal)
+	:creator(sCreator),settings(sSettings),journal(sJournal),
+	 host(true),networked(Vrui::isHeadNode()),listenSocket(0),
+	 siteId(0),nextSiteId(1),
+	 seq(0),joined(true),nextBatchId(0),resyncing(false),nextStrokeId(0)
+	{
+	std::string error;
+	if(networked)
+		{
+		try
+			{
+			/* Listen for clients on the given port and accept them in the background: */
+			listenSocket=new Comm::ListeningTCPSocket(portId,5);
+			acceptThread.start(this,&SketchCollaboration::acceptThreadMethod);
+			}
+		catch(const std::runtime_error& err)
+			{
+			error=err.what();
+			}
+		}
+	startNetworking(error);
+	}
+
+SketchCollaboration::SketchCollaboration(const std::string& hostName,int portId,SketchObjectCreator& sCreator,SketchSettings& sSettings,SketchJournal& sJournal)
+	:creator(sCreator),settings(sSettings),journal(sJournal),
+	 host(false),networked(Vrui::isHeadNode()),listenSocket(0),
+	 siteId(0),nextSiteId(0),
+	 seq(0),joined(false),nextBatchId(0),resyncing(true),nextStrokeId(0)
+	{
+	std::string error;
+	if(networked)
+		{
+		try
+			{
+			/* Connect to the host and send the protocol header: */
+			Comm::NetPipePtr pipe=new Comm::TCPPipe(hostName.c_str(),portId);
+			pipe->setEndianness(Misc::LittleEndian);
+			pipe->write(protocolHeader,strlen(protocolHeader));
+			pipe->flush();
+			
+			/* Exchange messages with the host in the background; the host's snapshot will replace the current sketch objects: */
+			Peer* peer=new Peer(this,0,pipe);
+			peers.push_back(peer);
+			peer->start();
+			}
+		catch(const std::runtime_error& err)
+			{
+			error=err.what();
+			}
+		}
+	startNetworking(error);
+	
+	/* Log the placements made by local edits to repeat them behind other sites' batches: */
+	if(networked)
+		settings.setPlacementLog(&placements);
+	}
+
+SketchCollaboration::~SketchCollaboration(void)
+	{
+	if(listenSocket!=0)
+		{
+		/* Stop accepting clients: */
+		acceptThread.cancel();
+		acceptThread.join();
+		delete listenSocket;
+		}
+	
+	/* Close all connections: */
+	for(std::vector<Peer*>::iterator pIt=peers.begin();pIt!=peers.end();++pIt)
+		delete *pIt;
+	
+	/* Stop logging placements: */
+	if(settings.getPlacementLog()==&placements)
+		settings.setPlacementLog(0);
+	}
+
+void SketchCollaboration::addLivePoint(const void* toolId,const Point& pos)
+	{
+	if(!networked||(!host&&peers.empty()))
+		return;
+	
+	/* Find the tool's current stroke or start a new one: */
+	std::vector<LocalStroke>::iterator lsIt;
+	for(lsIt=localStrokes.begin();lsIt!=localStrokes.end()&&(lsIt->toolId!=toolId||lsIt->finished);++lsIt)
+		;
+	if(lsIt==localStrokes.end())
+		{
+		localStrokes.push_back(LocalStroke());
+		lsIt=localStrokes.end()-1;
+		lsIt->toolId=toolId;
+		lsIt->strokeId=nextStrokeId++;
+		lsIt->color=settings.getColor();
+		lsIt->lineWidth=settings.getLineWidth();
+		lsIt->finished=false;
+		}
+	
+	/* Add the point: */
+	lsIt->newPoints.push_back(pos);
+	}
+
+void SketchCollaboration::finishLiveStroke(const void* toolId)
+	{
+	for(std::vector<LocalStroke>::iterator lsIt=localStrokes.begin();lsIt!=localStrokes.end();++lsIt)
+		if(lsIt->toolId==toolId)
+			lsIt->finished=true;
+	}
+
+void SketchCollaboration::frame(void)
+	{
+	Cluster::MulticastPipe* pipe=Vrui::getMainPipe();
+	if(networked)
+		{
+		if(!host&&!peers.empty()&&!joined)
+			{
+			/* Discard edits made before the host's state replaces the current sketch objects: */
+			journal.flushRecords(0);
+			placements.clear();
+			}
+		else if(!peers.empty()||host)
+			{
+			/* Send the records of all edit operations made locally during this frame: */
+			unsigned int flags=journal.getRecordFlags();
+			std::vector<Misc::UInt64> touchedIds;
+			journal.getTouchedIds(touchedIds);
+			IO::VariableMemoryFile message;
+			message.setEndianness(Misc::LittleEndian);
+			if(flags&SketchJournal::NeedsSnapshot)
+				{
+				/* Other sites can not replay the records; send the resulting state instead: */
+				journal.flushRecords(0);
+				placements.clear();
+				if(host)
+					{
+					sequence(siteId,0);
+					for(std::vector<Peer*>::iterator pIt=peers.begin();pIt!=peers.end();++pIt)
+						sendSnapshot(*pIt);
+					}
+				else
+					{
+					message.write<Misc::UInt8>(Snapshot);
+					writeSnapshot(message);
+					send(peers.front(),message);
+					}
+				}
+			else
+				{
+				IO::VariableMemoryFile records;
+				records.setEndianness(Misc::LittleEndian);
+				journal.flushRecords(&records);
+				records.flush();
+				if(records.getDataSize()>0)
+					{
+					message.write<Misc::UInt8>(Batch);
+					if(host)
+						{
+						/* Sequence the batch and send it to all clients: */
+						sequence(siteId,&touchedIds);
+						message.write<Misc::UInt32>(seq);
+						message.write<Misc::UInt32>(siteId);
+						message.write<Misc::UInt32>(0);
+						}
+					else
+						{
+						/* Send the batch to the host and remember it and its placements until the host sequences it: */
+						pendingBatches.push_back(PendingBatch());
+						PendingBatch& pb=pendingBatches.back();
+						pb.batchId=nextBatchId++;
+						pb.lost=false;
+						pb.placements.swap(placements);
+						message.write<Misc::UInt32>(pb.batchId);
+						message.write<Misc::UInt32>(seq);
+						writeIds(message,touchedIds);
+						}
+					writeData(message,records);
+					broadcast(message,0);
+					}
+				placements.clear();
+				}
+			
+			/* Send the new points of all strokes still being drawn: */
+			sendLiveStrokes();
+			}
+		
+		/* Grab all received messages and new connections: */
+		std::vector<Message> messages;
+		std::vector<Comm::NetPipePtr> pipes;
+		{
+		Threads::Mutex::Lock incomingLock(incomingMutex);
+		messages.swap(incoming);
+		pipes.swap(newPipes);
+		}
+		
+		/* Handle all received messages in order: */
+		for(std::vector<Message>::iterator mIt=messages.begin();mIt!=messages.end();++mIt)
+			{
+			if(host)
+				processHostMessage(*mIt);
+			else
+				processClientMessage(*mIt);
+			}
+		
+		/* Welcome all new clients with a snapshot of the current state: */
+		for(std::vector<Comm::NetPipePtr>::iterator npIt=pipes.begin();npIt!=pipes.end();++npIt)
+			{
+			/* Assign a site ID whose namespace does not contain any current sketch objects' identifiers, e.g., after recovering an earlier collaboration: */
+			unsigned int maxSiteId=settings.getMaxObjectSiteId();
+			if(nextSiteId<=maxSiteId)
+				nextSiteId=maxSiteId+1;
+			Peer* peer=new Peer(this,nextSiteId++,*npIt);
+			peers.push_back(peer);
+			
+			IO::VariableMemoryFile welcome;
+			welcome.setEndianness(Misc::LittleEndian);
+			welcome.write(protocolHeader,strlen(protocolHeader));
+			welcome.write<Misc::UInt8>(Welcome);
+			welcome.write<Misc::UInt32>(peer->id);
+			send(peer,welcome);
+			sendSnapshot(peer);
+			peer->start();
+			}
+		
+		/* Disconnect peers whose connections failed or that fell too far behind: */
+		for(size_t i=0;i<peers.size();)
+			{
+			if(peers[i]->alive)
+				{
+				Threads::Mutex::Lock sendLock(peers[i]->sendMutex);
+				if(peers[i]->sendFailed)
+					peers[i]->alive=false;
+				}
+			if(peers[i]->alive)
+				++i;
+			else
+				disconnect(peers[i]);
+			}
+		
+		if(pipe!=0)
+			{
+			/* Tell the other nodes in the cluster that all updates were shared: */
+			pipe->write<Misc::UInt8>(EndOfUpdates);
+			pipe->flush();
+			}
+		}
+	else
+		{
+		/* Apply all updates that the head node applied during this frame: */
+		std::vector<Misc::UInt8> data;
+		MessageType type;
+		while((type=MessageType(pipe->read<Misc::UInt8>()))!=EndOfUpdates)
+			{
+			unsigned int originId=pipe->read<Misc::UInt32>();
+			readData(*pipe,data);
+			applyUpdate(type,originId,data);
+			}
+		}
+	}
+
+void SketchCollaboration::glRenderAction(RenderState& renderState) const
+	{
+	/* Draw all strokes that collaborators are still drawing: */
+	for(std::vector<RemoteStroke>::const_iterator rsIt=remoteStrokes.begin();rsIt!=remoteStrokes.end();++rsIt)
+		if(rsIt->points.size()>=2)
+			{
+			renderState.setRenderer(Curve::getRenderer());
+			Curve::getRenderer()->draw(rsIt->points,rsIt->color,rsIt->lineWidth,renderState.getDataItem());
+			}
+	}
@@ -0,0 +1,218 @@
+/***********************************************************************
+SketchCollaboration - Class to share a sketch between SketchPad instances
+on separate machines by replicating their journaled edit operations
+over TCP.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef SKETCHCOLLABORATION_INCLUDED
+#define SKETCHCOLLABORATION_INCLUDED
+
+#include <string>
+#include <vector>
+#include <Misc/SizedTypes.h>
+#include <Threads/Mutex.h>
+#include <Threads/Cond.h>
+#include <Threads/Thread.h>
+#include <IO/File.h>
+#include <IO/VariableMemoryFile.h>
+#include <Comm/NetPipe.h>
+
+#include "SketchGeometry.h"
+#include "PointArena.h"
+#include "SketchSettings.h"
+
+/* Forward declarations: */
+namespace Comm {
+class ListeningTCPSocket;
+}
+class RenderState;
+class SketchObjectCreator;
+class SketchJournal;
+
+class SketchCollaboration
+	{
+	/* Embedded classes: */
+	private:
+	enum MessageType // Enumerated type for messages exchanged between collaborating instances and for updates shared inside a cluster
+		{
+		Welcome=0, // The host assigns a site ID to a newly connected client
+		Snapshot, // Complete state of all sketch objects
+		Batch, // Block of edit operation records journaled during one frame
+		Reject, // The host discarded a client's batch that referred to sketch objects changed by concurrent edits
+		Resync, // A client requests a snapshot after applying concurrent edits out of order
+		LiveStrokes, // New points of strokes that are still being drawn
+		PeerLeft, // A client disconnected from the host
+		Disconnected, // Internal message: the connection to a peer was closed
+		Reorder, // Internal message: a client moves the sketch objects that its unsequenced batches placed at the ends of the list behind another site's batch
+		EndOfUpdates // Internal message: the head node shared all updates of the current frame
+		};
+	
+	struct Message // Structure for a message received from a peer by a background thread
+		{
+		/* Elements: */
+		public:
+		unsigned int peerId; // Site ID of the peer that sent the message
+		MessageType type; // Type of the message
+		Misc::UInt32 seq; // Host sequence number, or the host sequence number on which a client based a batch
+		Misc::UInt32 originId; // Site ID of the instance that originated the message's contents
+		Misc::UInt32 batchId; // Originating client's ID of a batch or rejected batch
+		std::vector<Misc::UInt64> touchedIds; // Sorted identifiers of the existing sketch objects that a client's batch refers to
+		std::vector<Misc::UInt8> data; // Payload of the message
+		};
+	
+	struct Peer // Structure for a connection to a collaborating instance
+		{
+		/* Elements: */
+		public:
+		SketchCollaboration* collaboration; // The collaboration object owning the connection
+		unsigned int id; // Site ID of the peer
+		Comm::NetPipePtr pipe; // TCP pipe connected to the peer
+		bool alive; // Flag whether messages can still be sent to the peer
+		Threads::Thread receiveThread; // Thread receiving messages from the peer
+		Threads::Mutex sendMutex; // Mutex protecting the peer's outgoing message queue
+		Threads::Cond sendCond; // Condition variable to wake up the send thread when messages are queued
+		IO::VariableMemoryFile* outgoing; // Messages queued for the peer that the send thread did not take yet
+		IO::VariableMemoryFile* sending; // Messages the send thread is currently writing to the peer's pipe
+		size_t numQueued; // Number of bytes in the outgoing queue
+		size_t backlog; // Number of bytes queued for or being written to the peer
+		bool sendFailed; // Flag whether writing to the peer's pipe failed
+		Threads::Thread sendThread; // Thread writing queued messages to the peer
+		
+		/* Constructors and destructors: */
+		Peer(SketchCollaboration* sCollaboration,unsigned int sId,Comm::NetPipePtr sPipe); // Creates a connection to the given peer over the given pipe; does not start the connection's threads
+		~Peer(void); // Stops the connection's threads and closes the connection
+		
+		/* Methods: */
+		void* receiveThreadMethod(void); // Method receiving messages from the peer and queueing them for the main thread
+		void* sendThreadMethod(void); // Method writing the messages queued by the main thread to the peer
+		void start(void); // Starts receiving messages from and sending messages to the peer
+		};
+	
+	struct PendingBatch // Structure for a batch that a client sent to the host but that was not yet sequenced
+		{
+		/* Elements: */
+		public:
+		Misc::UInt32 batchId; // Client's ID of the batch
+		bool lost; // Flag whether a snapshot replaced the batch's effects on the client, which then has to apply the batch when the host sequences it
+		std::vector<SketchSettings::Placement> placements; // Placements of sketch objects at the ends of the list made by the batch, which the host will make after all batches it sequences first
+		};
+	
+	struct SequencedUpdate // Structure for an update that the host sequenced recently
+		{
+		/* Elements: */
+		public:
+		Misc::UInt32 seq; // Host sequence number of the update
+		unsigned int originId; // Site ID of the instance that originated the update
+		bool snapshot; // Flag whether the update replaced all sketch objects
+		std::vector<Misc::UInt64> touchedIds; // Sorted identifiers of the existing sketch objects that a batch referred to
+		};
+	
+	struct LocalStroke // Structure for a stroke that a local sketching tool is still drawing
+		{
+		/* Elements: */
+		public:
+		const void* toolId; // Opaque ID of the sketching tool drawing the stroke
+		Misc::UInt32 strokeId; // Unique ID of the stroke at this instance
+		Color color; // The stroke's color
+		float lineWidth; // The stroke's line width
+		PointList newPoints; // Points added to the stroke since they were last sent
+		bool finished; // Flag whether the tool finished drawing the stroke
+		};
+	
+	struct RemoteStroke // Structure for a stroke that a collaborator is still drawing
+		{
+		/* Elements: */
+		public:
+		unsigned int originId; // Site ID of the instance drawing the stroke
+		Misc::UInt32 strokeId; // ID of the stroke at its instance
+		Color color; // The stroke's color
+		float lineWidth; // The stroke's line width
+		PointList points; // Points of the stroke received so far
+		};
+	
+	/* Elements: */
+	static const char* protocolHeader; // Header string exchanged when a client connects to the host
+	static const size_t maxBacklog=size_t(64)<<20; // Maximum number of bytes queued for a peer; a peer that falls further behind is disconnected
+	static const size_t maxMessageSize=maxBacklog; // Maximum size of a message's payload or identifier list in bytes; a peer sending a larger one is disconnected
+	static const size_t maxSequencedUpdates=256; // Number of recently sequenced updates the host remembers to check clients' batches for conflicts
+	SketchObjectCreator& creator; // Object creator to read and write sketch objects
+	SketchSettings& settings; // Sketch settings containing the shared sketch objects
+	SketchJournal& journal; // Journal collecting the records of local edit operations
+	bool host; // Flag whether this instance hosts the collaboration
+	bool networked; // Flag whether this node talks to collaborators; false on all but the head node in a cluster
+	Comm::ListeningTCPSocket* listenSocket; // Socket accepting connections from clients on the host
+	Threads::Thread acceptThread; // Thread accepting connections from clients on the host
+	unsigned int siteId; // Site ID of this instance; the host has site ID 0
+	unsigned int nextSiteId; // Site ID to assign to the next client on the host
+	std::vector<Peer*> peers; // List of connected clients on the host, or the connection to the host on a client
+	Threads::Mutex incomingMutex; // Mutex protecting the queues of received messages and new connections
+	std::vector<Message> incoming; // Queue of messages received from peers
+	std::vector<Comm::NetPipePtr> newPipes; // Queue of newly accepted connections on the host
+	Misc::UInt32 seq; // Host sequence number of the most recent update applied to the sketch objects
+	std::vector<SequencedUpdate> sequencedUpdates; // Updates most recently sequenced by the host, in order
+	bool joined; // Flag whether a client installed the host's state and can send edits
+	Misc::UInt32 nextBatchId; // ID of the next batch sent by a client
+	std::vector<PendingBatch> pendingBatches; // Batches sent by a client that the host did not sequence yet, in order
+	std::vector<SketchSettings::Placement> placements; // Placements of sketch objects at the ends of the list made by a client's local edits since its last batch
+	bool resyncing; // Flag whether a client discards updates until it receives a snapshot
+	Misc::UInt32 nextStrokeId; // ID of the next stroke drawn at this instance
+	std::vector<LocalStroke> localStrokes; // Strokes still being drawn locally, or finished since they were last sent
+	std::vector<RemoteStroke> remoteStrokes; // Strokes still being drawn by collaborators
+	
+	/* Private methods: */
+	void startNetworking(std::string& error); // Shares the head node's error message from setting up the network connections with all nodes in a cluster, and throws an exception if it is not empty
+	void readMessage(IO::File& pipe,Message& message) const; // Reads the next message sent by a peer
+	void postMessage(Message& message); // Queues a received message for the main thread; swaps out the message's payload
+	void* acceptThreadMethod(void); // Method accepting connections from clients on the host
+	Peer* findPeer(unsigned int peerId); // Returns the connected peer of the given site ID, or null
+	void send(Peer* peer,IO::VariableMemoryFile& message); // Queues the given message for the given peer unless the connection failed before; stops sending to the peer if its backlog overflows
+	void broadcast(IO::VariableMemoryFile& message,const Peer* except); // Sends the given message to all peers except the given one
+	void writeSnapshot(IO::VariableMemoryFile& message); // Writes a snapshot of the current sketch objects into the given message
+	void sendSnapshot(Peer* peer); // Sends a snapshot of the current sketch objects at the current sequence number to the given client
+	void sendReject(Peer* peer,Misc::UInt32 batchId); // Tells the given client that the host discarded the batch of the given ID
+	void sequence(unsigned int originId,const std::vector<Misc::UInt64>* touchedIds); // Advances the host sequence number for an update originating from the given site that referred to the sketch objects of the given sorted identifiers, or replaced all sketch objects if null
+	bool isConflicting(unsigned int originId,Misc::UInt32 baseSeq,const std::vector<Misc::UInt64>& touchedIds) const; // Returns true if a batch from the given site, based on the given host sequence number, refers to sketch objects of the given sorted identifiers that concurrent updates changed
+	bool commitUpdate(MessageType type,unsigned int originId,const std::vector<Misc::UInt8>& data); // Applies an update received from a peer and shares it with all other nodes in a cluster; returns false if the update failed
+	bool applyUpdate(MessageType type,unsigned int originId,const std::vector<Misc::UInt8>& data); // Applies an update on this node; returns false if the update failed
+	void repeatPendingPlacements(void); // Moves the sketch objects that a client's unsequenced batches placed at the ends of the list to where the host will place them
+	void sendLiveStrokes(void); // Sends the new points of all local strokes to the collaborators
+	void processHostMessage(Message& message); // Handles a message received from a client on the host
+	void processClientMessage(Message& message); // Handles a message received from the host on a client
+	void disconnect(Peer* peer); // Closes the connection to the given peer and deletes it
+	
+	/* Constructors and destructors: */
+	public:
+	SketchCollaboration(int portId,SketchObjectCreator& sCreator,SketchSettings& sSettings,SketchJournal& sJournal); // Hosts a collaboration by accepting clients on the given TCP port
+	SketchCollaboration(const std::string& hostName,int portId,SketchObjectCreator& sCreator,SketchSettings& sSettings,SketchJournal& sJournal); // Joins the collaboration hosted on the given host and TCP port; the host's sketch objects replace the current ones
+	~SketchCollaboration(void); // Closes all connections
+	
+	/* Methods: */
+	bool isHost(void) const // Returns true if this instance hosts the collaboration
+		{
+		return host;
+		}
+	void addLivePoint(const void* toolId,const Point& pos); // Adds a point to the stroke the given sketching tool is drawing, starting a new stroke with the current settings if needed
+	void finishLiveStroke(const void* toolId); // Notifies that the given sketching tool finished drawing its stroke
+	void frame(void); // Exchanges the edit operations journaled during the current frame with all collaborators and applies theirs; must be called before the journal's frame method
+	void glRenderAction(RenderState& renderState) const; // Draws the strokes that collaborators are still drawing
+	};
+
+#endif
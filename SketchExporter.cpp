@@ -0,0 +1,613 @@
+/***********************************************************************
+SketchExporter - Class to export all sketch objects at high resolution,
+either as a raster image rendered offscreen tile by tile, or as a
+vector image.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "SketchExporter.h"
+
+#include <stdio.h>
+#include <strings.h>
+#include <stdexcept>
+#include <Misc/SizedTypes.h>
+#include <Misc/StdError.h>
+#include <Math/Math.h>
+#include <GL/gl.h>
+#include <GL/GLContextData.h>
+#include <GL/Extensions/GLEXTFramebufferObject.h>
+#include <Vrui/Vrui.h>
+
+#include "SketchObject.h"
+#include "SketchObjectList.h"
+#include "SketchSettings.h"
+#include "RenderState.h"
+#include "WorkerPool.h"
+
+/**********************************************
+Declaration of struct SketchExporter::DataItem:
+**********************************************/
+
+struct SketchExporter::DataItem:public GLObject::DataItem
+	{
+	/* Elements: */
+	public:
+	bool supported; // Flag whether the OpenGL context supports rendering into textures
+	GLuint textureId; // ID of the texture object receiving rendered tiles
+	GLuint framebufferId; // ID of the framebuffer object rendering into the texture object
+	
+	/* Constructors and destructors: */
+	DataItem(void);
+	virtual ~DataItem(void);
+	};
+
+/******************************************
+Methods of struct SketchExporter::DataItem:
+******************************************/
+
+SketchExporter::DataItem::DataItem(void)
+	:supported(GLEXTFramebufferObject::isSupported()),
+	 textureId(0),framebufferId(0)
+	{
+	if(supported)
+		{
+		/* Initialize the required extension: */
+		GLEXTFramebufferObject::initExtension();
+		
+		/* Allocate a texture image holding one tile: */
+		glGenTextures(1,&textureId);
+		glBindTexture(GL_TEXTURE_2D,textureId);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAX_LEVEL,0);
+		glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA8,tileSize,tileSize,0,GL_RGBA,GL_UNSIGNED_BYTE,0);
+		glBindTexture(GL_TEXTURE_2D,0);
+		
+		/* Attach the texture to a framebuffer, and restore the current framebuffer binding: */
+		glGenFramebuffersEXT(1,&framebufferId);
+		GLint currentFramebufferId;
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT,&currentFramebufferId);
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,framebufferId);
+		glFramebufferTexture2DEXT(GL_FRAMEBUFFER_EXT,GL_COLOR_ATTACHMENT0_EXT,GL_TEXTURE_2D,textureId,0);
+		supported=glCheckFramebufferStatusEXT(GL_FRAMEBUFFER_EXT)==GL_FRAMEBUFFER_COMPLETE_EXT;
+		glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,currentFramebufferId);
+		}
+	}
+
+SketchExporter::DataItem::~DataItem(void)
+	{
+	/* Delete the framebuffer and texture objects: */
+	if(framebufferId!=0)
+		glDeleteFramebuffersEXT(1,&framebufferId);
+	if(textureId!=0)
+		glDeleteTextures(1,&textureId);
+	}
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+inline void appendUInt16(std::string& data,unsigned int value) // Appends the given 16-bit value in little-endian byte order
+	{
+	data.push_back(char(value&0xffU));
+	data.push_back(char((value>>8)&0xffU));
+	}
+
+inline void appendUInt32(std::string& data,Misc::UInt32 value) // Appends the given 32-bit value in little-endian byte order
+	{
+	for(int i=0;i<4;++i,value>>=8)
+		data.push_back(char(value&0xffU));
+	}
+
+inline void appendTiffEntry(std::string& data,unsigned int tag,unsigned int type,Misc::UInt32 count,Misc::UInt32 value) // Appends a TIFF directory entry; a single short value is stored left-justified, which matches a 32-bit value in little-endian byte order
+	{
+	appendUInt16(data,tag);
+	appendUInt16(data,type);
+	appendUInt32(data,count);
+	appendUInt32(data,value);
+	}
+
+/***************************************************
+Helper class to serialize sketch objects in parallel:
+***************************************************/
+
+class SvgJob:public WorkerPool::Job
+	{
+	/* Elements: */
+	private:
+	const std::vector<const SketchObject*>& objects; // List of objects to serialize
+	std::vector<std::string>& svgs; // List of SVG elements of each object
+	
+	/* Constructors and destructors: */
+	public:
+	SvgJob(const std::vector<const SketchObject*>& sObjects,std::vector<std::string>& sSvgs)
+		:objects(sObjects),svgs(sSvgs)
+		{
+		}
+	
+	/* Methods from WorkerPool::Job: */
+	virtual void process(size_t item)
+		{
+		/* Serialize the object into its own string: */
+		objects[item]->writeSVG(svgs[item]);
+		}
+	};
+
+}
+
+/*******************************
+Methods of class SketchExporter:
+*******************************/
+
+void SketchExporter::queueChunk(SketchExporter::Chunk& chunk)
+	{
+	Threads::MutexCond::Lock queueLock(queueCond);
+	queue.push_back(Chunk());
+	queue.back().rowSize=chunk.rowSize;
+	queue.back().data.swap(chunk.data);
+	queueCond.signal();
+	}
+
+void SketchExporter::fail(const std::string& newError)
+	{
+	/* Keep the first error and discard all queued chunks: */
+	Threads::MutexCond::Lock queueLock(queueCond);
+	if(error.empty())
+		error=newError;
+	queue.clear();
+	queueComplete=true;
+	queueCond.signal();
+	}
+
+void* SketchExporter::writerThreadMethod(void)
+	{
+	while(true)
+		{
+		/* Wait for the next chunk: */
+		Chunk chunk;
+		{
+		Threads::MutexCond::Lock queueLock(queueCond);
+		while(queue.empty()&&!queueComplete)
+			queueCond.wait(queueLock);
+		if(queue.empty())
+			break;
+		chunk.rowSize=queue.front().rowSize;
+		chunk.data.swap(queue.front().data);
+		queue.pop_front();
+		}
+		
+		/* Wake up the main thread to render more tiles: */
+		if(chunk.rowSize!=0)
+			Vrui::requestUpdate();
+		
+		try
+			{
+			if(chunk.rowSize!=0)
+				{
+				/* Write the band's pixel rows in top-down order: */
+				for(size_t row=chunk.data.size()/chunk.rowSize;row>0;--row)
+					file->write(&chunk.data[(row-1)*chunk.rowSize],chunk.rowSize);
+				}
+			else if(!chunk.data.empty())
+				file->write(chunk.data.data(),chunk.data.size());
+			}
+		catch(const std::runtime_error& err)
+			{
+			fail(err.what());
+			}
+		}
+	
+	/* Flush and close the file: */
+	try
+		{
+		if(getError().empty())
+			file->flush();
+		}
+	catch(const std::runtime_error& err)
+		{
+		fail(err.what());
+		}
+	file=0;
+	
+	/* Mark the export as finished: */
+	{
+	Threads::MutexCond::Lock queueLock(queueCond);
+	finished=true;
+	}
+	
+	/* Wake up the main thread to pick up the result: */
+	Vrui::requestUpdate();
+	
+	return 0;
+	}
+
+void SketchExporter::queueTiffHeader(void)
+	{
+	/* Store uncompressed RGB pixels in one strip per band of tiles: */
+	Misc::UInt32 rowSize=imageSize[0]*3U;
+	Misc::UInt32 numStrips=numTiles[1];
+	
+	/* Lay out the file: header, image file directory, out-of-line directory values, strip tables, and pixel data: */
+	const Misc::UInt32 numEntries=13;
+	Misc::UInt32 valuesOffset=8U+2U+numEntries*12U+4U;
+	Misc::UInt32 bitsPerSampleOffset=valuesOffset;
+	Misc::UInt32 resolutionOffset=bitsPerSampleOffset+6U;
+	Misc::UInt32 stripOffsetsOffset=resolutionOffset+8U;
+	Misc::UInt32 stripByteCountsOffset=stripOffsetsOffset+(numStrips>1U?numStrips*4U:0U);
+	Misc::UInt32 dataOffset=stripByteCountsOffset+(numStrips>1U?numStrips*4U:0U);
+	Misc::UInt32 stripSize=rowSize*tileSize;
+	Misc::UInt32 lastStripSize=rowSize*(imageSize[1]-(numStrips-1U)*tileSize);
+	
+	Chunk header;
+	header.rowSize=0;
+	std::string& h=header.data;
+	
+	/* Write the little-endian TIFF header pointing to the image file directory: */
+	h.push_back('I');
+	h.push_back('I');
+	appendUInt16(h,42U);
+	appendUInt32(h,8U);
+	
+	/* Write the image file directory, with entries sorted by tag: */
+	appendUInt16(h,numEntries);
+	appendTiffEntry(h,256U,4U,1U,imageSize[0]); // ImageWidth
+	appendTiffEntry(h,257U,4U,1U,imageSize[1]); // ImageLength
+	appendTiffEntry(h,258U,3U,3U,bitsPerSampleOffset); // BitsPerSample
+	appendTiffEntry(h,259U,3U,1U,1U); // Compression: none
+	appendTiffEntry(h,262U,3U,1U,2U); // PhotometricInterpretation: RGB
+	appendTiffEntry(h,273U,4U,numStrips,numStrips>1U?stripOffsetsOffset:dataOffset); // StripOffsets
+	appendTiffEntry(h,277U,3U,1U,3U); // SamplesPerPixel
+	appendTiffEntry(h,278U,4U,1U,tileSize); // RowsPerStrip
+	appendTiffEntry(h,279U,4U,numStrips,numStrips>1U?stripByteCountsOffset:lastStripSize); // StripByteCounts
+	appendTiffEntry(h,282U,5U,1U,resolutionOffset); // XResolution
+	appendTiffEntry(h,283U,5U,1U,resolutionOffset); // YResolution
+	appendTiffEntry(h,284U,3U,1U,1U); // PlanarConfiguration: contiguous
+	appendTiffEntry(h,296U,3U,1U,1U); // ResolutionUnit: none
+	appendUInt32(h,0U);
+	
+	/* Write the out-of-line directory values: */
+	for(int i=0;i<3;++i)
+		appendUInt16(h,8U);
+	appendUInt32(h,1U);
+	appendUInt32(h,1U);
+	
+	if(numStrips>1U)
+		{
+		/* Write the strip tables: */
+		for(Misc::UInt32 i=0;i<numStrips;++i)
+			appendUInt32(h,dataOffset+i*stripSize);
+		for(Misc::UInt32 i=0;i<numStrips;++i)
+			appendUInt32(h,i+1U<numStrips?stripSize:lastStripSize);
+		}
+	
+	queueChunk(header);
+	}
+
+void SketchExporter::queueSvg(WorkerPool* workerPool)
+	{
+	/* Serialize all top-level sketch objects into separate strings in parallel: */
+	std::vector<const SketchObject*> objects;
+	for(SketchObjectList::const_iterator soIt=settings.getSketchObjects().begin();soIt!=settings.getSketchObjects().end();++soIt)
+		objects.push_back(&*soIt);
+	std::vector<std::string> svgs(objects.size());
+	SvgJob job(objects,svgs);
+	if(workerPool!=0&&objects.size()>1)
+		workerPool->run(job,objects.size());
+	else
+		{
+		for(size_t i=0;i<objects.size();++i)
+			job.process(i);
+		}
+	
+	/* Queue the SVG header, the background, and a group flipping the sketching plane's y axis into image space: */
+	Chunk chunk;
+	chunk.rowSize=0;
+	char buffer[512];
+	Scalar scale=Scalar(1)/pixelSize;
+	int length=snprintf(buffer,sizeof(buffer),
+	                    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	                    "<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"%u\" height=\"%u\" viewBox=\"0 0 %u %u\">\n"
+	                    "<rect width=\"100%%\" height=\"100%%\" fill=\"#%02x%02x%02x\"/>\n"
+	                    "<g transform=\"matrix(%.7g 0 0 %.7g %.7g %.7g)\">\n",
+	                    imageSize[0],imageSize[1],imageSize[0],imageSize[1],
+	                    backgroundColor[0],backgroundColor[1],backgroundColor[2],
+	                    double(scale),double(-scale),double(-region.min[0]*scale),double(region.max[1]*scale));
+	chunk.data.assign(buffer,length);
+	queueChunk(chunk);
+	
+	/* Queue all objects' strings without copying them: */
+	for(std::vector<std::string>::iterator sIt=svgs.begin();sIt!=svgs.end();++sIt)
+		{
+		chunk.rowSize=0;
+		chunk.data.swap(*sIt);
+		queueChunk(chunk);
+		}
+	
+	/* Queue the SVG footer: */
+	static const char footer[]="</g>\n</svg>\n";
+	chunk.rowSize=0;
+	chunk.data.assign(footer,sizeof(footer)-1);
+	queueChunk(chunk);
+	}
+
+bool SketchExporter::renderTile(SketchExporter::DataItem* dataItem,GLContextData& contextData)
+	{
+	/* Calculate the next tile's position in the image, counting rows from the top, and its region of the sketching plane: */
+	unsigned int tile[2]={nextTile%numTiles[0],nextTile/numTiles[0]};
+	GLsizei origin[2],size[2];
+	for(int i=0;i<2;++i)
+		{
+		origin[i]=GLsizei(tile[i]*tileSize);
+		size[i]=GLsizei(Math::min(imageSize[i]-tile[i]*tileSize,(unsigned int)(tileSize)));
+		}
+	Box tileBox=region;
+	tileBox.min[0]=region.min[0]+Scalar(origin[0])*pixelSize;
+	tileBox.max[0]=tileBox.min[0]+Scalar(size[0])*pixelSize;
+	tileBox.max[1]=region.max[1]-Scalar(origin[1])*pixelSize;
+	tileBox.min[1]=tileBox.max[1]-Scalar(size[1])*pixelSize;
+	
+	/* Redirect rendering into the tile's framebuffer: */
+	GLint currentFramebufferId;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT,&currentFramebufferId);
+	glPushAttrib(GL_COLOR_BUFFER_BIT|GL_DEPTH_BUFFER_BIT|GL_ENABLE_BIT|GL_SCISSOR_BIT|GL_VIEWPORT_BIT);
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,dataItem->framebufferId);
+	glViewport(0,0,size[0],size[1]);
+	glDisable(GL_SCISSOR_TEST);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_LIGHTING);
+	glDepthMask(GL_FALSE);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
+	glClearColor(float(backgroundColor[0])/255.0f,float(backgroundColor[1])/255.0f,float(backgroundColor[2])/255.0f,1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	
+	/* Look straight down onto the tile's region of the sketching plane: */
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadIdentity();
+	glOrtho(tileBox.min[0],tileBox.max[0],tileBox.min[1],tileBox.max[1],-1.0,1.0);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadIdentity();
+	
+	/* Draw all sketch objects touching the tile at the exported pixel size: */
+	bool complete;
+	{
+	RenderState renderState(contextData,pixelSize);
+	settings.drawSketchObjects(tileBox,renderState);
+	renderState.setRenderer(0);
+	complete=renderState.isComplete();
+	}
+	
+	if(complete)
+		{
+		/* Read the tile directly into its place in the band, whose rows are in bottom-up order: */
+		glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+		glPixelStorei(GL_PACK_ALIGNMENT,1);
+		glPixelStorei(GL_PACK_ROW_LENGTH,imageSize[0]);
+		glPixelStorei(GL_PACK_SKIP_PIXELS,0);
+		glPixelStorei(GL_PACK_SKIP_ROWS,0);
+		glReadPixels(0,0,size[0],size[1],GL_RGB,GL_UNSIGNED_BYTE,&band[size_t(origin[0])*3]);
+		glPopClientAttrib();
+		}
+	
+	/* Restore OpenGL state and return to the current framebuffer: */
+	glPopMatrix();
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glBindFramebufferEXT(GL_FRAMEBUFFER_EXT,currentFramebufferId);
+	glPopAttrib();
+	
+	/* Render the tile again during the next frame if some objects were not drawn at their final appearance, e.g., image tiles that were not uploaded yet: */
+	if(!complete)
+		return false;
+	
+	++nextTile;
+	if(tile[0]+1==numTiles[0])
+		{
+		/* Hand the completed band to the writer thread: */
+		Chunk chunk;
+		chunk.rowSize=size_t(imageSize[0])*3;
+		chunk.data.assign(band.begin(),band.begin()+chunk.rowSize*size_t(size[1]));
+		queueChunk(chunk);
+		
+		if(nextTile==numTiles[0]*numTiles[1])
+			{
+			/* Tell the writer thread that the image is complete: */
+			Threads::MutexCond::Lock queueLock(queueCond);
+			queueComplete=true;
+			queueCond.signal();
+			}
+		}
+	
+	return true;
+	}
+
+SketchExporter::SketchExporter(const std::string& sFileName,IO::FilePtr sFile,SketchExporter::Format sFormat,const SketchSettings& sSettings,unsigned int maxImageSize,WorkerPool* workerPool)
+	:settings(sSettings),format(sFormat),fileName(sFileName),file(sFile),
+	 region(Box::empty),pixelSize(0),
+	 renderContext(0),renderTime(-1.0),frameTime(-1.0),numIdleFrames(0),nextTile(0),
+	 queueComplete(false),finished(false)
+	{
+	/* Find the extents of all sketch objects, including their line widths: */
+	for(SketchObjectList::const_iterator soIt=settings.getSketchObjects().begin();soIt!=settings.getSketchObjects().end();++soIt)
+		{
+		Box box=soIt->getBoundingBox();
+		Scalar margin=soIt->getMaxLineWidth()*Scalar(0.5);
+		for(int i=0;i<2;++i)
+			{
+			box.min[i]-=margin;
+			box.max[i]+=margin;
+			}
+		region.addBox(box);
+		}
+	if(region.min[0]>region.max[0]||region.min[1]>region.max[1])
+		throw std::runtime_error(Misc::makeStdErr(__PRETTY_FUNCTION__,"No sketch objects to export"));
+	if(maxImageSize==0)
+		throw std::runtime_error(Misc::makeStdErr(__PRETTY_FUNCTION__,"Invalid image size"));
+	
+	/* Fit the region's larger dimension into the requested image size: */
+	Scalar maxSize=Math::max(region.max[0]-region.min[0],region.max[1]-region.min[1]);
+	pixelSize=maxSize>Scalar(0)?maxSize/Scalar(maxImageSize):Scalar(1);
+	for(int i=0;i<2;++i)
+		{
+		imageSize[i]=Math::max((unsigned int)(Math::ceil((region.max[i]-region.min[i])/pixelSize)),1U);
+		imageSize[i]=Math::min(imageSize[i],maxImageSize);
+		numTiles[i]=(imageSize[i]+tileSize-1)/tileSize;
+		}
+	
+	/* Draw over the display's background color: */
+	backgroundColor=Color(Vrui::getBackgroundColor());
+	backgroundColor[3]=255U;
+	
+	if(format==Tiff)
+		{
+		/* Check that the image fits into a classic TIFF file with 32-bit offsets: */
+		if(Misc::UInt64(imageSize[0])*Misc::UInt64(imageSize[1])*3U+Misc::UInt64(numTiles[1])*8U+1024U>Misc::UInt64(0xffffffffU))
+			throw std::runtime_error(Misc::makeStdErr(__PRETTY_FUNCTION__,"Image of %u x %u pixels is too large for a TIFF file",imageSize[0],imageSize[1]));
+		
+		/* Queue the TIFF header and allocate the band of tiles being rendered; the tiles' pixels follow during the next frames: */
+		queueTiffHeader();
+		band.resize(size_t(imageSize[0])*size_t(tileSize)*3);
+		}
+	else
+		{
+		/* Serialize and queue the entire vector image: */
+		queueSvg(workerPool);
+		queueComplete=true;
+		}
+	
+	/* Start the writer thread: */
+	writerThread.start(this,&SketchExporter::writerThreadMethod);
+	}
+
+SketchExporter::~SketchExporter(void)
+	{
+	/* Abort an unfinished export and wait for the writer thread to terminate: */
+	if(!isFinished())
+		fail("Export was interrupted");
+	if(!writerThread.isJoined())
+		writerThread.join();
+	}
+
+void SketchExporter::initContext(GLContextData& contextData) const
+	{
+	/* Raster exports render their tiles into a framebuffer in one of the OpenGL contexts: */
+	if(format==Tiff)
+		{
+		/* Create a context data item and associate it with this object: */
+		DataItem* dataItem=new DataItem;
+		contextData.addDataItem(this,dataItem);
+		}
+	}
+
+bool SketchExporter::getFormat(const std::string& fileName,SketchExporter::Format& format)
+	{
+	/* Find the file name's extension: */
+	std::string::size_type dotPos=fileName.rfind('.');
+	if(dotPos==std::string::npos)
+		return false;
+	const char* extension=fileName.c_str()+dotPos;
+	
+	if(strcasecmp(extension,".tif")==0||strcasecmp(extension,".tiff")==0)
+		format=Tiff;
+	else if(strcasecmp(extension,".svg")==0)
+		format=Svg;
+	else
+		return false;
+	
+	return true;
+	}
+
+bool SketchExporter::isRendering(void) const
+	{
+	Threads::MutexCond::Lock queueLock(queueCond);
+	return !queueComplete;
+	}
+
+bool SketchExporter::isFinished(void) const
+	{
+	Threads::MutexCond::Lock queueLock(queueCond);
+	return finished;
+	}
+
+std::string SketchExporter::getError(void) const
+	{
+	Threads::MutexCond::Lock queueLock(queueCond);
+	return error;
+	}
+
+void SketchExporter::frame(void)
+	{
+	if(!isRendering())
+		return;
+	
+	/* Check whether an OpenGL context rendered during the previous frame: */
+	bool idle;
+	{
+	Threads::Mutex::Lock renderLock(renderMutex);
+	idle=renderTime<frameTime;
+	}
+	if(idle)
+		++numIdleFrames;
+	else
+		numIdleFrames=0;
+	frameTime=Vrui::getApplicationTime();
+	
+	/* Give up if no OpenGL context of this node renders the export: */
+	if(numIdleFrames>=maxIdleFrames)
+		fail("No window on the head node rendered the exported image");
+	}
+
+void SketchExporter::glRenderAction(GLContextData& contextData)
+	{
+	/* Render tiles in only one OpenGL context, and only once per frame: */
+	Threads::Mutex::Lock renderLock(renderMutex);
+	if(renderContext==0)
+		renderContext=&contextData;
+	if(renderContext!=&contextData||renderTime==Vrui::getApplicationTime()||!isRendering())
+		return;
+	renderTime=Vrui::getApplicationTime();
+	
+	/* Bail out if the context can not render offscreen: */
+	DataItem* dataItem=contextData.retrieveDataItem<DataItem>(this);
+	if(dataItem==0||!dataItem->supported)
+		{
+		fail("Offscreen rendering is not supported");
+		return;
+		}
+	
+	for(unsigned int i=0;i<maxTilesPerFrame&&nextTile<numTiles[0]*numTiles[1];++i)
+		{
+		/* Pause while the writer thread catches up with the completed bands: */
+		{
+		Threads::MutexCond::Lock queueLock(queueCond);
+		if(queueComplete||queue.size()>=maxQueuedChunks)
+			break;
+		}
+		
+		/* Render the next tile; try again during the next frame if it was not complete: */
+		if(!renderTile(dataItem,contextData))
+			break;
+		}
+	}
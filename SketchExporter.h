@@ -0,0 +1,126 @@
+/***********************************************************************
+SketchExporter - Class to export all sketch objects at high resolution,
+either as a raster image rendered offscreen tile by tile, or as a
+vector image.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef SKETCHEXPORTER_INCLUDED
+#define SKETCHEXPORTER_INCLUDED
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <Threads/Mutex.h>
+#include <Threads/MutexCond.h>
+#include <Threads/Thread.h>
+#include <IO/File.h>
+#include <GL/gl.h>
+#include <GL/GLObject.h>
+
+#include "SketchGeometry.h"
+
+/* Forward declarations: */
+class SketchSettings;
+class WorkerPool;
+
+class SketchExporter:public GLObject
+	{
+	/* Embedded classes: */
+	public:
+	enum Format // Enumerated type for export file formats
+		{
+		Tiff,Svg
+		};
+	
+	private:
+	struct DataItem; // Forward declaration of per-context data structure
+	
+	struct Chunk // Structure for blocks of data queued for the writer thread
+		{
+		/* Elements: */
+		public:
+		size_t rowSize; // Size of a pixel row in bytes if the chunk is a band of pixel rows in bottom-up order, or zero if the chunk is written as-is
+		std::string data; // The chunk's data
+		};
+	
+	/* Elements: */
+	static const unsigned int tileSize=1024; // Width and height of offscreen tiles in pixels
+	static const unsigned int maxTilesPerFrame=4; // Maximum number of tiles rendered during a single frame
+	static const size_t maxQueuedChunks=2; // Maximum number of bands waiting for the writer thread before rendering pauses
+	static const unsigned int maxIdleFrames=120; // Maximum number of consecutive frames without a rendering OpenGL context before a raster export fails
+	const SketchSettings& settings; // Settings containing the exported sketch objects
+	Format format; // Format of the export file
+	std::string fileName; // Name of the export file for error messages
+	IO::FilePtr file; // The export file; released by the writer thread when done
+	Box region; // Exported region of the sketching plane in navigational coordinates
+	Scalar pixelSize; // Size of an exported pixel in navigational coordinate units
+	unsigned int imageSize[2]; // Width and height of the exported image in pixels
+	unsigned int numTiles[2]; // Number of tiles horizontally and vertically
+	Color backgroundColor; // Color of the exported image's background
+	Threads::Mutex renderMutex; // Mutex serializing offscreen rendering from the rendering threads of all OpenGL contexts
+	const GLContextData* renderContext; // OpenGL context rendering all tiles, or null if not yet chosen
+	double renderTime; // Application time of the frame during which tiles were last rendered
+	double frameTime; // Application time of the previous frame
+	unsigned int numIdleFrames; // Number of consecutive frames during which no OpenGL context rendered tiles
+	unsigned int nextTile; // Index of the next tile to be rendered, in row-major order starting at the top
+	std::vector<char> band; // Pixels of the band of tiles being rendered
+	mutable Threads::MutexCond queueCond; // Condition variable protecting the chunk queue and signaling changes to it
+	std::deque<Chunk> queue; // Queue of chunks waiting for the writer thread
+	bool queueComplete; // Flag whether all chunks have been queued
+	bool finished; // Flag whether the writer thread finished writing the export file
+	std::string error; // Error message if the export failed; empty on success
+	Threads::Thread writerThread; // Thread writing queued chunks to the export file
+	
+	/* Private methods: */
+	void queueChunk(Chunk& chunk); // Queues the given chunk, whose data is swapped out
+	void fail(const std::string& newError); // Aborts the export with the given error message
+	void* writerThreadMethod(void); // Method writing queued chunks in the writer thread
+	void queueTiffHeader(void); // Queues the TIFF header and image file directory
+	void queueSvg(WorkerPool* workerPool); // Serializes all sketch objects, in parallel if there is a pool of worker threads, and queues the SVG file
+	bool renderTile(DataItem* dataItem,GLContextData& contextData); // Renders the next tile into the current band; returns false if the tile must be rendered again during a later frame
+	
+	/* Constructors and destructors: */
+	public:
+	SketchExporter(const std::string& sFileName,IO::FilePtr sFile,Format sFormat,const SketchSettings& sSettings,unsigned int maxImageSize,WorkerPool* workerPool); // Starts exporting all sketch objects to the given file such that the exported image's larger dimension has the given size in pixels; serializes a vector image immediately, and renders a raster image during the following frames
+	private:
+	SketchExporter(const SketchExporter& source); // Prohibit copy constructor
+	SketchExporter& operator=(const SketchExporter& source); // Prohibit assignment operator
+	public:
+	virtual ~SketchExporter(void); // Aborts an unfinished export and waits for the writer thread
+	
+	/* Methods from class GLObject: */
+	virtual void initContext(GLContextData& contextData) const;
+	
+	/* New methods: */
+	static bool getFormat(const std::string& fileName,Format& format); // Sets the export format matching the given file name's extension; returns false if the extension is not supported
+	const std::string& getFileName(void) const // Returns the name of the export file
+		{
+		return fileName;
+		}
+	bool isRendering(void) const; // Returns true if tiles of a raster image still need to be rendered
+	bool isFinished(void) const; // Returns true if the export file was completely written or the export failed
+	std::string getError(void) const; // Returns the error message of a failed export, or an empty string
+	void frame(void); // Aborts a raster export if no OpenGL context rendered tiles during too many consecutive frames, e.g., because the head node in a cluster has no windows; called once per frame
+	void glRenderAction(GLContextData& contextData); // Renders the next tiles of a raster image offscreen; called from the display method of all OpenGL contexts
+	};
+
+#endif
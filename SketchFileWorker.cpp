@@ -0,0 +1,118 @@
+/***********************************************************************
+SketchFileWorker - Class to load or save sketch files in a background
+thread while the main thread keeps rendering.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "SketchFileWorker.h"
+
+#include <stdexcept>
+#include <Misc/Endianness.h>
+#include <Vrui/Vrui.h>
+
+#include "Stats.h"
+#include "SketchSettings.h"
+
+/*********************************
+Methods of class SketchFileWorker:
+*********************************/
+
+void* SketchFileWorker::workerThreadMethod(void)
+	{
+	std::string newError;
+	try
+		{
+		if(operation==Load)
+			{
+			/* Read all sketch objects contained in the file: */
+			creator.readFile(*file,sketchObjects,&progress);
+			}
+		else
+			{
+			/* Write the snapshot to the file: */
+			SKETCHPAD_STATS_TIMER(SaveTime);
+			saveBuffer.writeToSink(*file);
+			file->flush();
+			}
+		}
+	catch(const std::runtime_error& err)
+		{
+		newError=err.what();
+		}
+	
+	/* Close the file: */
+	file=0;
+	
+	/* Mark the operation as finished: */
+	{
+	Threads::Mutex::Lock stateLock(stateMutex);
+	finished=true;
+	error=newError;
+	}
+	
+	/* Wake up the main thread to pick up the result: */
+	Vrui::requestUpdate();
+	
+	return 0;
+	}
+
+SketchFileWorker::SketchFileWorker(const std::string& sFileName,IO::FilePtr sFile)
+	:operation(Load),fileName(sFileName),file(sFile),
+	 saveSize(0),
+	 finished(false)
+	{
+	/* Start the worker thread: */
+	workerThread.start(this,&SketchFileWorker::workerThreadMethod);
+	}
+
+SketchFileWorker::SketchFileWorker(const std::string& sFileName,IO::FilePtr sFile,const SketchObjectCreator& sCreator,const SketchObjectList& saveSketchObjects,SketchObjectCreator::PointEncoding pointEncoding,const SketchSettings* objectIdSettings)
+	:operation(Save),fileName(sFileName),file(sFile),
+	 saveSize(0),
+	 finished(false)
+	{
+	/* Serialize the sketch object list into memory, which is fast compared to writing the file: */
+	saveBuffer.setEndianness(Misc::LittleEndian);
+	sCreator.writeFile(saveSketchObjects,saveBuffer,pointEncoding);
+	if(objectIdSettings!=0)
+		objectIdSettings->writeObjectIds(saveBuffer);
+	saveBuffer.flush();
+	saveSize=saveBuffer.getDataSize();
+	
+	/* Start the worker thread: */
+	workerThread.start(this,&SketchFileWorker::workerThreadMethod);
+	}
+
+SketchFileWorker::~SketchFileWorker(void)
+	{
+	/* Wait for the worker thread to finish: */
+	finish();
+	}
+
+bool SketchFileWorker::isFinished(void) const
+	{
+	Threads::Mutex::Lock stateLock(stateMutex);
+	return finished;
+	}
+
+void SketchFileWorker::finish(void)
+	{
+	if(!workerThread.isJoined())
+		workerThread.join();
+	}
@@ -0,0 +1,105 @@
+/***********************************************************************
+SketchFileWorker - Class to load or save sketch files in a background
+thread while the main thread keeps rendering.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef SKETCHFILEWORKER_INCLUDED
+#define SKETCHFILEWORKER_INCLUDED
+
+#include <string>
+#include <Threads/Mutex.h>
+#include <Threads/Thread.h>
+#include <IO/File.h>
+#include <IO/VariableMemoryFile.h>
+
+#include "SketchObjectList.h"
+#include "SketchObjectCreator.h"
+
+/* Forward declarations: */
+class SketchSettings;
+
+class SketchFileWorker
+	{
+	/* Embedded classes: */
+	public:
+	enum Operation // Enumerated type for background file operations
+		{
+		Load,Save
+		};
+	
+	/* Elements: */
+	private:
+	Operation operation; // The operation performed by this worker
+	std::string fileName; // Name of the sketch file for progress and error messages
+	IO::FilePtr file; // The sketch file being read or written; released by the worker thread when done
+	SketchObjectCreator creator; // Object creator to read sketch objects in the worker thread, separate from the main thread's creator
+	SketchObjectCreator::FileProgress progress; // Progress of reading a sketch file
+	SketchObjectList sketchObjects; // List of sketch objects read from the sketch file
+	IO::VariableMemoryFile saveBuffer; // In-memory snapshot of the sketch file being saved
+	size_t saveSize; // Size of the snapshot being saved in bytes
+	Threads::Thread workerThread; // Thread performing the file operation
+	mutable Threads::Mutex stateMutex; // Mutex protecting the worker's completion state
+	bool finished; // Flag if the worker thread finished its operation
+	std::string error; // Error message if the operation failed; empty on success
+	
+	/* Private methods: */
+	void* workerThreadMethod(void); // Method performing the file operation in the worker thread
+	
+	/* Constructors and destructors: */
+	public:
+	SketchFileWorker(const std::string& sFileName,IO::FilePtr sFile); // Starts loading the given sketch file
+	SketchFileWorker(const std::string& sFileName,IO::FilePtr sFile,const SketchObjectCreator& sCreator,const SketchObjectList& saveSketchObjects,SketchObjectCreator::PointEncoding pointEncoding=SketchObjectCreator::RawPoints,const SketchSettings* objectIdSettings=0); // Takes a snapshot of the given sketch object list and starts saving it to the given sketch file using the given curve point encoding; appends the object identifiers of the given sketch settings, which must contain the saved list, if not null
+	~SketchFileWorker(void); // Waits for the worker thread to finish and destroys the worker
+	
+	/* Methods: */
+	Operation getOperation(void) const // Returns the worker's operation
+		{
+		return operation;
+		}
+	const std::string& getFileName(void) const // Returns the name of the sketch file
+		{
+		return fileName;
+		}
+	unsigned int getNumObjects(void) const // Returns the number of top-level sketch objects in the file being loaded, or 0 if not yet known
+		{
+		return progress.numObjects.get();
+		}
+	unsigned int getNumObjectsRead(void) const // Returns the number of top-level sketch objects loaded so far
+		{
+		return progress.numObjectsRead.get();
+		}
+	size_t getSaveSize(void) const // Returns the size of the sketch file being saved in bytes
+		{
+		return saveSize;
+		}
+	bool isFinished(void) const; // Returns true if the worker thread finished its operation
+	void finish(void); // Waits for the worker thread to finish its operation
+	const std::string& getError(void) const // Returns the error message of a failed operation, or an empty string; only valid after finish()
+		{
+		return error;
+		}
+	SketchObjectList& getSketchObjects(void) // Returns the list of loaded sketch objects; only valid after finish()
+		{
+		return sketchObjects;
+		}
+	};
+
+#endif
@@ -0,0 +1,311 @@
+/***********************************************************************
+SketchHistory - Class to record edits to a list of sketch objects for
+undo and redo, keeping replaced sketch objects instead of copies of the
+entire list.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "SketchHistory.h"
+
+#include "SketchObject.h"
+
+/*****************************************
+Methods of class SketchHistory::Listener:
+*****************************************/
+
+SketchHistory::Listener::~Listener(void)
+	{
+	}
+
+/******************************
+Methods of class SketchHistory:
+******************************/
+
+void SketchHistory::getOwnedObjects(const SketchHistory::Edit& edit,bool applied,std::vector<SketchObject*>& objects)
+	{
+	ObjectSet seen(17);
+	if(applied)
+		{
+		/* Return all objects whose last change was a removal: */
+		for(std::vector<Change>::const_reverse_iterator cIt=edit.changes.rbegin();cIt!=edit.changes.rend();++cIt)
+			if(!seen.isEntry(cIt->object))
+				{
+				seen.setEntry(cIt->object);
+				if(!cIt->insert)
+					objects.push_back(cIt->object);
+				}
+		}
+	else
+		{
+		/* Return all objects whose first change was an insertion: */
+		for(std::vector<Change>::const_iterator cIt=edit.changes.begin();cIt!=edit.changes.end();++cIt)
+			if(!seen.isEntry(cIt->object))
+				{
+				seen.setEntry(cIt->object);
+				if(cIt->insert)
+					objects.push_back(cIt->object);
+				}
+		}
+	}
+
+size_t SketchHistory::getMemorySize(const SketchHistory::Edit& edit,bool applied)
+	{
+	/* Account for the edit itself and the objects it owns: */
+	size_t result=sizeof(Edit)+edit.changes.size()*sizeof(Change);
+	std::vector<SketchObject*> objects;
+	getOwnedObjects(edit,applied,objects);
+	for(std::vector<SketchObject*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+		result+=(*oIt)->getMemorySize();
+	
+	return result;
+	}
+
+void SketchHistory::addReference(SketchObject* object)
+	{
+	ReferenceMap::Iterator rIt=references.findEntry(object);
+	if(rIt.isFinished())
+		references.setEntry(ReferenceMap::Entry(object,1U));
+	else
+		++rIt->getDest();
+	}
+
+void SketchHistory::removeReference(SketchObject* object)
+	{
+	ReferenceMap::Iterator rIt=references.findEntry(object);
+	if(!rIt.isFinished()&&--rIt->getDest()==0U)
+		references.removeEntry(rIt);
+	}
+
+bool SketchHistory::isReferenced(const SketchHistory::Edit& edit,SketchObject* object) const
+	{
+	for(std::vector<Change>::const_iterator cIt=edit.changes.begin();cIt!=edit.changes.end();++cIt)
+		if(cIt->object==object||cIt->succ==object)
+			return true;
+	return false;
+	}
+
+void SketchHistory::deleteEdit(SketchHistory::Edit* edit,bool applied)
+	{
+	/* Forget the edit's references: */
+	for(std::vector<Change>::iterator cIt=edit->changes.begin();cIt!=edit->changes.end();++cIt)
+		{
+		removeReference(cIt->object);
+		if(cIt->succ!=0)
+			removeReference(cIt->succ);
+		}
+	
+	/* Destroy all objects owned by the edit: */
+	std::vector<SketchObject*> objects;
+	getOwnedObjects(*edit,applied,objects);
+	for(std::vector<SketchObject*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+		delete *oIt;
+	
+	delete edit;
+	}
+
+void SketchHistory::addChange(bool insert,SketchObject* object,SketchObject* succ)
+	{
+	/* Bail out if the history is disabled or suspended: */
+	if(!isEnabled())
+		return;
+	
+	/* Record a change outside of an edit as an edit of its own: */
+	bool ownEdit=editLevel==0;
+	if(ownEdit)
+		beginEdit();
+	
+	/* Add the change to the open edit: */
+	if(openEdit==0)
+		openEdit=new Edit;
+	openEdit->changes.push_back(Change(insert,object,succ));
+	addReference(object);
+	if(succ!=0)
+		addReference(succ);
+	
+	/* Remember whether the object was created or removed by the open edit: */
+	if(!createdObjects.isEntry(object)&&!removedObjects.isEntry(object))
+		{
+		if(insert)
+			createdObjects.setEntry(object);
+		else
+			removedObjects.setEntry(object);
+		}
+	
+	if(ownEdit)
+		endEdit();
+	}
+
+void SketchHistory::trim(void)
+	{
+	/* Discard the oldest undoable edits until the history fits its memory budget: */
+	while(memorySize>maxMemorySize&&!undoEdits.empty())
+		{
+		Edit* edit=undoEdits.front();
+		undoEdits.pop_front();
+		memorySize-=edit->undoMemorySize;
+		deleteEdit(edit,true);
+		}
+	}
+
+SketchHistory::SketchHistory(size_t sMaxMemorySize)
+	:maxMemorySize(sMaxMemorySize),memorySize(0),
+	 suspendLevel(0),editLevel(0),openEdit(0),
+	 createdObjects(17),removedObjects(17),references(17)
+	{
+	}
+
+SketchHistory::~SketchHistory(void)
+	{
+	clear();
+	}
+
+void SketchHistory::setMaxMemorySize(size_t newMaxMemorySize)
+	{
+	maxMemorySize=newMaxMemorySize;
+	
+	/* Discard old edits that no longer fit into the new budget: */
+	if(maxMemorySize==0)
+		clear();
+	else
+		trim();
+	}
+
+void SketchHistory::clear(void)
+	{
+	/* Destroy all edits and the objects they own: */
+	for(std::deque<Edit*>::iterator eIt=undoEdits.begin();eIt!=undoEdits.end();++eIt)
+		deleteEdit(*eIt,true);
+	undoEdits.clear();
+	for(std::vector<Edit*>::iterator eIt=redoEdits.begin();eIt!=redoEdits.end();++eIt)
+		deleteEdit(*eIt,false);
+	redoEdits.clear();
+	if(openEdit!=0)
+		deleteEdit(openEdit,true);
+	openEdit=0;
+	createdObjects.clear();
+	removedObjects.clear();
+	memorySize=0;
+	}
+
+void SketchHistory::discardEdits(SketchObject* object)
+	{
+	/* Bail out if no edit refers to the object: */
+	if(!references.isEntry(object))
+		return;
+	
+	/* Discard the most recent undoable edit referring to the object and all older ones, which can only be undone after it: */
+	size_t numUndoEdits=undoEdits.size();
+	while(numUndoEdits>0&&!isReferenced(*undoEdits[numUndoEdits-1],object))
+		--numUndoEdits;
+	for(size_t i=0;i<numUndoEdits;++i)
+		{
+		Edit* edit=undoEdits.front();
+		undoEdits.pop_front();
+		memorySize-=edit->undoMemorySize;
+		deleteEdit(edit,true);
+		}
+	
+	/* Discard the most recently undone edit referring to the object and all less recently undone ones, which can only be redone after it: */
+	size_t numRedoEdits=redoEdits.size();
+	while(numRedoEdits>0&&!isReferenced(*redoEdits[numRedoEdits-1],object))
+		--numRedoEdits;
+	for(size_t i=0;i<numRedoEdits;++i)
+		{
+		memorySize-=redoEdits[i]->redoMemorySize;
+		deleteEdit(redoEdits[i],false);
+		}
+	redoEdits.erase(redoEdits.begin(),redoEdits.begin()+numRedoEdits);
+	
+	/* Discard the changes recorded so far by the open edit if they refer to the object: */
+	if(openEdit!=0&&isReferenced(*openEdit,object))
+		{
+		deleteEdit(openEdit,true);
+		openEdit=0;
+		createdObjects.clear();
+		removedObjects.clear();
+		}
+	}
+
+void SketchHistory::beginEdit(void)
+	{
+	++editLevel;
+	}
+
+void SketchHistory::endEdit(void)
+	{
+	/* Bail out if this does not finish the outermost edit: */
+	if(editLevel==0||--editLevel>0)
+		return;
+	
+	createdObjects.clear();
+	removedObjects.clear();
+	if(openEdit!=0)
+		{
+		Edit* edit=openEdit;
+		openEdit=0;
+		
+		/* Calculate the memory used by the edit in its applied and undone states: */
+		edit->undoMemorySize=getMemorySize(*edit,true);
+		edit->redoMemorySize=getMemorySize(*edit,false);
+		
+		/* Discard all undone edits, which can no longer be redone: */
+		for(std::vector<Edit*>::iterator eIt=redoEdits.begin();eIt!=redoEdits.end();++eIt)
+			{
+			memorySize-=(*eIt)->redoMemorySize;
+			deleteEdit(*eIt,false);
+			}
+		redoEdits.clear();
+		
+		/* Add the edit to the undoable edits and discard old edits if over budget: */
+		undoEdits.push_back(edit);
+		memorySize+=edit->undoMemorySize;
+		trim();
+		}
+	}
+
+const SketchHistory::Edit* SketchHistory::undo(void)
+	{
+	if(!canUndo())
+		return 0;
+	
+	/* Move the most recent edit to the redoable edits: */
+	Edit* edit=undoEdits.back();
+	undoEdits.pop_back();
+	memorySize-=edit->undoMemorySize;
+	redoEdits.push_back(edit);
+	memorySize+=edit->redoMemorySize;
+	
+	return edit;
+	}
+
+const SketchHistory::Edit* SketchHistory::redo(void)
+	{
+	if(!canRedo())
+		return 0;
+	
+	/* Move the most recently undone edit back to the undoable edits; the budget is enforced when the next edit is recorded: */
+	Edit* edit=redoEdits.back();
+	redoEdits.pop_back();
+	memorySize-=edit->redoMemorySize;
+	undoEdits.push_back(edit);
+	memorySize+=edit->undoMemorySize;
+	
+	return edit;
+	}
@@ -0,0 +1,166 @@
+/***********************************************************************
+SketchHistory - Class to record edits to a list of sketch objects for
+undo and redo, keeping replaced sketch objects instead of copies of the
+entire list.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef SKETCHHISTORY_INCLUDED
+#define SKETCHHISTORY_INCLUDED
+
+#include <stddef.h>
+#include <vector>
+#include <deque>
+#include <Misc/HashTable.h>
+
+/* Forward declarations: */
+class SketchObject;
+
+class SketchHistory
+	{
+	/* Embedded classes: */
+	public:
+	struct Change // Structure describing an object being inserted into or removed from a list
+		{
+		/* Elements: */
+		public:
+		bool insert; // Flag whether the object was inserted or removed
+		SketchObject* object; // The inserted or removed object
+		SketchObject* succ; // The object's successor in the list at the time of the change, or null if the object was or is the last one
+		
+		/* Constructors and destructors: */
+		Change(bool sInsert,SketchObject* sObject,SketchObject* sSucc)
+			:insert(sInsert),object(sObject),succ(sSucc)
+			{
+			}
+		};
+	
+	class Listener // Base class for objects notified of the changes made when undoing or redoing edits
+		{
+		/* Constructors and destructors: */
+		public:
+		virtual ~Listener(void);
+		
+		/* Methods: */
+		virtual void insertObject(const SketchObject* succ,const SketchObject* object) =0; // Notifies that the given object is about to be inserted in front of the given object, or appended if null
+		virtual void removeObject(const SketchObject* object) =0; // Notifies that the given object is about to be removed
+		};
+	
+	struct Edit // Structure describing an undoable edit
+		{
+		/* Elements: */
+		public:
+		std::vector<Change> changes; // List of changes in the order they were made
+		size_t undoMemorySize; // Memory used by the objects owned by the edit while it can be undone
+		size_t redoMemorySize; // Memory used by the objects owned by the edit while it can be redone
+		
+		/* Constructors and destructors: */
+		Edit(void)
+			:undoMemorySize(0),redoMemorySize(0)
+			{
+			}
+		};
+	
+	private:
+	typedef Misc::HashTable<SketchObject*,void> ObjectSet; // Type for hash tables to represent sets of sketch objects
+	typedef Misc::HashTable<SketchObject*,unsigned int> ReferenceMap; // Type for hash tables counting the changes referring to sketch objects
+	
+	/* Elements: */
+	size_t maxMemorySize; // Maximum memory used by objects owned by the history; history is disabled if zero
+	size_t memorySize; // Memory currently used by objects owned by the history
+	std::deque<Edit*> undoEdits; // Edits that can be undone, from oldest to most recent
+	std::vector<Edit*> redoEdits; // Edits that can be redone, from least recently to most recently undone
+	unsigned int suspendLevel; // Nesting level of calls to suspend
+	unsigned int editLevel; // Nesting level of calls to beginEdit
+	Edit* openEdit; // Edit currently being recorded, or null
+	ObjectSet createdObjects; // Set of objects whose first change in the open edit was an insertion
+	ObjectSet removedObjects; // Set of objects whose first change in the open edit was a removal
+	ReferenceMap references; // Number of recorded changes referring to each object as the changed object or its successor
+	
+	/* Private methods: */
+	static void getOwnedObjects(const Edit& edit,bool applied,std::vector<SketchObject*>& objects); // Returns the objects that are not in the list after the given edit was applied or undone
+	static size_t getMemorySize(const Edit& edit,bool applied); // Returns the memory used by the objects owned by the given edit
+	void addReference(SketchObject* object); // Counts a recorded change referring to the given object
+	void removeReference(SketchObject* object); // Uncounts a recorded change referring to the given object
+	bool isReferenced(const Edit& edit,SketchObject* object) const; // Returns true if any change of the given edit refers to the given object
+	void deleteEdit(Edit* edit,bool applied); // Destroys the given edit and the objects it owns
+	void addChange(bool insert,SketchObject* object,SketchObject* succ); // Records a change as part of the open edit, or as an edit of its own
+	void trim(void); // Discards the oldest edits until the history fits its memory budget
+	
+	/* Constructors and destructors: */
+	public:
+	SketchHistory(size_t sMaxMemorySize); // Creates an empty history with the given memory budget in bytes
+	private:
+	SketchHistory(const SketchHistory& source); // Prohibit copy constructor
+	SketchHistory& operator=(const SketchHistory& source); // Prohibit assignment operator
+	public:
+	~SketchHistory(void); // Destroys the history and all sketch objects it owns
+	
+	/* Methods: */
+	bool isEnabled(void) const // Returns true if the history records changes
+		{
+		return maxMemorySize>0&&suspendLevel==0;
+		}
+	size_t getMemorySize(void) const // Returns the memory currently used by objects owned by the history
+		{
+		return memorySize;
+		}
+	void suspend(void) // Stops recording changes without discarding recorded edits; calls can be nested
+		{
+		++suspendLevel;
+		}
+	void resume(void) // Records changes again after the matching suspend call
+		{
+		--suspendLevel;
+		}
+	void setMaxMemorySize(size_t newMaxMemorySize); // Sets the history's memory budget in bytes; disables the history if zero
+	void clear(void); // Discards all edits and destroys all sketch objects owned by the history
+	bool isReferenced(SketchObject* object) const // Returns true if any recorded change refers to the given object
+		{
+		return references.isEntry(object);
+		}
+	void discardEdits(SketchObject* object); // Discards all edits referring to the given object, which is about to be destroyed or changed without being recorded, and all edits that can only be undone or redone after them
+	void beginEdit(void); // Starts recording an edit; calls can be nested, and all changes until the matching endEdit call become a single edit
+	void endEdit(void); // Finishes recording an edit
+	bool isCreated(SketchObject* object) const // Returns true if the given object was created by the open edit, and can therefore be changed in place
+		{
+		return createdObjects.isEntry(object);
+		}
+	void recordInsert(SketchObject* object,SketchObject* succ) // Records that the given object was inserted before the given successor, or appended if null
+		{
+		addChange(true,object,succ);
+		}
+	void recordRemove(SketchObject* object,SketchObject* succ) // Records that the given object, which had the given successor, was removed; the history takes ownership of the object
+		{
+		addChange(false,object,succ);
+		}
+	bool canUndo(void) const // Returns true if there is an edit that can be undone
+		{
+		return editLevel==0&&!undoEdits.empty();
+		}
+	bool canRedo(void) const // Returns true if there is an edit that can be redone
+		{
+		return editLevel==0&&!redoEdits.empty();
+		}
+	const Edit* undo(void); // Returns the most recent edit, whose changes the caller must revert in reverse order, or null if there is none
+	const Edit* redo(void); // Returns the most recently undone edit, whose changes the caller must re-apply in order, or null if there is none
+	};
+
+#endif
@@ -0,0 +1,684 @@
+/***********************************************************************
+SketchJournal - Class to autosave sketches as a sequence of periodic
+snapshots and append-only journals of the edit operations performed
+since each snapshot.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "SketchJournal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <algorithm>
+#include <stdexcept>
+#include <Misc/SizedTypes.h>
+#include <Misc/StdError.h>
+#include <Misc/MessageLogger.h>
+#include <Misc/StandardMarshallers.h>
+#include <IO/OpenFile.h>
+#include <Cluster/MulticastPipe.h>
+#include <Geometry/GeometryMarshallers.h>
+#include <Vrui/Vrui.h>
+#include <Vrui/OpenFile.h>
+
+#include "Capsule.h"
+#include "SketchObject.h"
+#include "SketchObjectList.h"
+#include "SketchObjectCreator.h"
+#include "SketchSettings.h"
+#include "SketchFileWorker.h"
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+void shareGenerations(Cluster::MulticastPipe& pipe,std::vector<unsigned int>& generations) // Sends the head node's list of generation numbers to all other cluster nodes
+	{
+	if(Vrui::isHeadNode())
+		{
+		pipe.write<Misc::UInt32>(Misc::UInt32(generations.size()));
+		for(std::vector<unsigned int>::iterator gIt=generations.begin();gIt!=generations.end();++gIt)
+			pipe.write<Misc::UInt32>(Misc::UInt32(*gIt));
+		}
+	else
+		{
+		generations.resize(pipe.read<Misc::UInt32>());
+		for(std::vector<unsigned int>::iterator gIt=generations.begin();gIt!=generations.end();++gIt)
+			*gIt=pipe.read<Misc::UInt32>();
+		}
+	}
+
+}
+
+/**************************************
+Static elements of class SketchJournal:
+**************************************/
+
+const char* SketchJournal::journalHeader="SketchPadJournal v4.0\n";
+
+/******************************
+Methods of class SketchJournal:
+******************************/
+
+std::string SketchJournal::getFileName(unsigned int fileGeneration,const char* extension) const
+	{
+	char generationString[16];
+	snprintf(generationString,sizeof(generationString),".%u",fileGeneration);
+	std::string result=baseName;
+	result.append(generationString);
+	result.append(extension);
+	return result;
+	}
+
+void SketchJournal::findGenerations(std::vector<unsigned int>& snapshotGenerations,std::vector<unsigned int>& journalGenerations) const
+	{
+	/* Split the base name into a directory name and a file name prefix: */
+	std::string::size_type slashPos=baseName.rfind('/');
+	std::string directoryName=slashPos!=std::string::npos?baseName.substr(0,slashPos+1):std::string("./");
+	std::string prefix=slashPos!=std::string::npos?baseName.substr(slashPos+1):baseName;
+	prefix.push_back('.');
+	
+	/* Find all autosave files in the directory: */
+	DIR* directory=opendir(directoryName.c_str());
+	if(directory==0)
+		return;
+	struct dirent* entry;
+	while((entry=readdir(directory))!=0)
+		{
+		/* Check if the entry name matches <prefix><generation>.sketch or <prefix><generation>.journal: */
+		if(strncmp(entry->d_name,prefix.c_str(),prefix.size())==0)
+			{
+			const char* genStart=entry->d_name+prefix.size();
+			char* genEnd;
+			unsigned long fileGeneration=strtoul(genStart,&genEnd,10);
+			if(genEnd!=genStart)
+				{
+				if(strcmp(genEnd,".sketch")==0)
+					snapshotGenerations.push_back((unsigned int)fileGeneration);
+				else if(strcmp(genEnd,".journal")==0)
+					journalGenerations.push_back((unsigned int)fileGeneration);
+				}
+			}
+		}
+	closedir(directory);
+	
+	std::sort(snapshotGenerations.begin(),snapshotGenerations.end());
+	std::sort(journalGenerations.begin(),journalGenerations.end());
+	}
+
+void SketchJournal::removeOldFiles(unsigned int keepGeneration)
+	{
+	std::vector<unsigned int> snapshotGenerations,journalGenerations;
+	findGenerations(snapshotGenerations,journalGenerations);
+	for(std::vector<unsigned int>::iterator gIt=snapshotGenerations.begin();gIt!=snapshotGenerations.end()&&*gIt<keepGeneration;++gIt)
+		unlink(getFileName(*gIt,".sketch").c_str());
+	for(std::vector<unsigned int>::iterator gIt=journalGenerations.begin();gIt!=journalGenerations.end()&&*gIt<keepGeneration;++gIt)
+		unlink(getFileName(*gIt,".journal").c_str());
+	}
+
+void SketchJournal::installSketchObjects(SketchObjectList& newSketchObjects)
+	{
+	/* Finish reading all new sketch objects: */
+	for(SketchObjectList::iterator soIt=newSketchObjects.begin();soIt!=newSketchObjects.end();++soIt)
+		soIt->finishRead();
+	
+	/* Replace the current sketch object list with the new one: */
+	settings.setSketchObjects(newSketchObjects);
+	}
+
+SketchObject* SketchJournal::getObject(Misc::UInt64 objectId)
+	{
+	SketchObject* result=settings.findObject(objectId);
+	if(result==0)
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Invalid object identifier %llu",(unsigned long long)objectId);
+	return result;
+	}
+
+void SketchJournal::openJournal(unsigned int newGeneration)
+	{
+	/* Close the current journal file after writing all pending records, which apply to the previous snapshot: */
+	records.flush();
+	if(journalFile!=0)
+		{
+		records.writeToSink(*journalFile);
+		journalFile->flush();
+		}
+	journalFile=0;
+	
+	/* Peers can not apply the pending records to the new snapshot anymore: */
+	if(records.getDataSize()>0)
+		recordFlags|=NeedsSnapshot;
+	records.clear();
+	touchedIds.clear();
+	
+	/* Create a new journal file and write its header: */
+	journalFile=IO::openFile(getFileName(newGeneration,".journal").c_str(),IO::File::WriteOnly);
+	journalFile->setEndianness(Misc::LittleEndian);
+	journalFile->write(journalHeader,strlen(journalHeader));
+	journalFile->write<Misc::UInt32>(newGeneration);
+	journalFile->flush();
+	numRecords=0;
+	}
+
+void SketchJournal::writeRecordHeader(Operation operation)
+	{
+	/* Write the operation and the identifier base, so that replaying the record assigns the same identifiers to new sketch objects: */
+	records.write<Misc::UInt8>(operation);
+	records.write<Misc::UInt64>(settings.getNextObjectId());
+	++numRecords;
+	}
+
+void SketchJournal::writeObjectId(const SketchObject* object)
+	{
+	records.write<Misc::UInt64>(object->getId());
+	touchedIds.push_back(object->getId());
+	}
+
+void SketchJournal::writeObjects(const std::vector<SketchObject*>& objects)
+	{
+	records.write<Misc::UInt32>(Misc::UInt32(objects.size()));
+	for(std::vector<SketchObject*>::const_iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+		writeObjectId(*oIt);
+	}
+
+void SketchJournal::readObjects(IO::File& file,std::vector<SketchObject*>& objects)
+	{
+	unsigned int numObjects=file.read<Misc::UInt32>();
+	for(unsigned int i=0;i<numObjects;++i)
+		objects.push_back(getObject(file.read<Misc::UInt64>()));
+	}
+
+void SketchJournal::writeSelection(Operation operation)
+	{
+	/* Write the record header and the selected objects in list order: */
+	writeRecordHeader(operation);
+	std::vector<SketchObject*> selection;
+	settings.getSelectedObjects(selection);
+	writeObjects(selection);
+	}
+
+void SketchJournal::readSelection(IO::File& file)
+	{
+	/* Select the indicated objects: */
+	std::vector<SketchObject*> selection;
+	readObjects(file,selection);
+	settings.selectNone();
+	for(std::vector<SketchObject*>::iterator sIt=selection.begin();sIt!=selection.end();++sIt)
+		settings.select(*sIt);
+	}
+
+void SketchJournal::replayRecords(IO::File& file)
+	{
+	/* Set the local selection aside, as selection operations select the objects they were journaled with: */
+	settings.saveSelection();
+	try
+		{
+		/* Replay all records until the end of the file: */
+		while(!file.eof())
+			{
+			/* Assign the same identifiers to new sketch objects as the instance that journaled the record: */
+			Operation operation=Operation(file.read<Misc::UInt8>());
+			settings.setObjectIdBase(file.read<Misc::UInt64>());
+			switch(operation)
+				{
+				case LoadFile:
+					{
+					/* Replace all sketch objects with the contents of the original sketch file: */
+					std::string fileName=Misc::Marshaller<std::string>::read(file);
+					IO::FilePtr sketchFile=Vrui::openFile(fileName.c_str());
+					sketchFile->setEndianness(Misc::LittleEndian);
+					SketchObjectList newSketchObjects;
+					creator.readFile(*sketchFile,newSketchObjects);
+					installSketchObjects(newSketchObjects);
+					break;
+					}
+				
+				case AppendObject:
+					{
+					SketchObject* object=creator.readObject(file);
+					if(object!=0)
+						{
+						object->finishRead();
+						settings.append(object);
+						}
+					break;
+					}
+				
+				case RemoveObject:
+					settings.remove(getObject(file.read<Misc::UInt64>()));
+					break;
+				
+				case InsertObject:
+					{
+					Misc::UInt64 succId=file.read<Misc::UInt64>();
+					Misc::UInt64 objectId=file.read<Misc::UInt64>();
+					SketchObject* object=creator.readObject(file);
+					if(object!=0)
+						{
+						SketchObject* succ=succId!=0?settings.findObject(succId):0;
+						if((succId!=0&&succ==0)||objectId==0||settings.findObject(objectId)!=0)
+							{
+							delete object;
+							throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Invalid object identifier %llu",(unsigned long long)(succId!=0&&succ==0?succId:objectId));
+							}
+						
+						/* Insert the object under its journaled identifier in front of the journaled successor, or append it: */
+						object->finishRead();
+						settings.setObjectIdBase(objectId);
+						settings.insertAfter(succ,object);
+						}
+					break;
+					}
+				
+				case Rubout:
+					{
+					Point c0,c1;
+					file.read(c0.getComponents(),3);
+					file.read(c1.getComponents(),3);
+					Scalar radius=file.read<Misc::Float32>();
+					std::vector<SketchObject*> objects;
+					readObjects(file,objects);
+					settings.rubout(Capsule(c0,c1,radius),objects);
+					break;
+					}
+				
+				case TransformSelection:
+					{
+					readSelection(file);
+					Transformation transform=Misc::Marshaller<Transformation>::read(file);
+					settings.transformSelectedObjects(transform);
+					break;
+					}
+				
+				case ApplySettingsToSelection:
+					{
+					readSelection(file);
+					Color color;
+					for(int i=0;i<4;++i)
+						color[i]=file.read<Misc::UInt8>();
+					float lineWidth=file.read<Misc::Float32>();
+					
+					/* Apply the journaled settings and restore the current settings: */
+					Color oldColor=settings.getColor();
+					float oldLineWidth=settings.getLineWidth();
+					settings.setColor(color);
+					settings.setLineWidth(lineWidth);
+					settings.applySettingsToSelection();
+					settings.setColor(oldColor);
+					settings.setLineWidth(oldLineWidth);
+					break;
+					}
+				
+				case SnapSelectionToGrid:
+					{
+					readSelection(file);
+					Scalar gridSize=file.read<Misc::Float32>();
+					
+					/* Snap to the journaled grid and restore the current grid: */
+					Scalar oldGridSize=settings.getGridSize();
+					settings.setGridSize(gridSize);
+					settings.snapSelectedObjectsToGrid();
+					settings.setGridSize(oldGridSize);
+					break;
+					}
+				
+				case CloneSelection:
+					readSelection(file);
+					settings.cloneSelection();
+					break;
+				
+				case GroupSelection:
+					readSelection(file);
+					settings.groupSelection();
+					break;
+				
+				case UngroupSelection:
+					readSelection(file);
+					settings.ungroupSelection();
+					break;
+				
+				case SelectionToBack:
+					readSelection(file);
+					settings.selectionToBack();
+					break;
+				
+				case SelectionToFront:
+					readSelection(file);
+					settings.selectionToFront();
+					break;
+				
+				case DeleteSelection:
+					readSelection(file);
+					settings.deleteSelection();
+					break;
+				
+				default:
+					throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Invalid journal operation %u",(unsigned int)operation);
+				}
+			}
+		}
+	catch(const std::runtime_error&)
+		{
+		/* Restore the local identifier namespace and selection, minus all objects the records removed, and pass the error on: */
+		settings.resetObjectIdBase();
+		settings.restoreSelection();
+		throw;
+		}
+	
+	/* Restore the local identifier namespace and selection, minus all objects the records removed: */
+	settings.resetObjectIdBase();
+	settings.restoreSelection();
+	}
+
+bool SketchJournal::replayJournal(IO::File& file)
+	{
+	/* Check the journal file header: */
+	size_t headerLength=strlen(journalHeader);
+	char header[32];
+	file.read(header,headerLength);
+	if(memcmp(header,journalHeader,headerLength)!=0)
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Unrecognized journal file header");
+	file.read<Misc::UInt32>();
+	
+	try
+		{
+		/* Replay all records until the end of the file: */
+		replayRecords(file);
+		}
+	catch(const std::runtime_error&)
+		{
+		/* The journal ended in an incomplete or invalid record: */
+		return false;
+		}
+	
+	return true;
+	}
+
+void SketchJournal::finishSnapshot(void)
+	{
+	/* Wait for the snapshot worker to terminate: */
+	snapshotWorker->finish();
+	
+	if(snapshotWorker->getError().empty())
+		{
+		/* Commit the snapshot and remove all older autosave files: */
+		rename(getFileName(snapshotGeneration,".sketch.tmp").c_str(),getFileName(snapshotGeneration,".sketch").c_str());
+		removeOldFiles(snapshotGeneration);
+		}
+	else
+		{
+		/* Show an error message; the older snapshot and journals remain valid: */
+		Misc::formattedUserError("Autosave: Could not write snapshot %s due to exception %s",snapshotWorker->getFileName().c_str(),snapshotWorker->getError().c_str());
+		}
+	
+	delete snapshotWorker;
+	snapshotWorker=0;
+	}
+
+SketchJournal::SketchJournal(const std::string& sBaseName,double sSnapshotInterval,SketchObjectCreator& sCreator,SketchSettings& sSettings)
+	:baseName(sBaseName),snapshotInterval(sSnapshotInterval),
+	 creator(sCreator),settings(sSettings),
+	 generation(0),numRecords(0),recordFlags(0x0U),lastSnapshotTime(0.0),
+	 snapshotWorker(0),snapshotGeneration(0)
+	{
+	records.setEndianness(Misc::LittleEndian);
+	}
+
+SketchJournal::~SketchJournal(void)
+	{
+	/* Finish a pending snapshot and write all pending records; the journal file is flushed when it is closed: */
+	if(snapshotWorker!=0)
+		finishSnapshot();
+	flushRecords(0);
+	}
+
+bool SketchJournal::recover(void)
+	{
+	/* Find all existing autosave files, using the head node's files in a cluster: */
+	std::vector<unsigned int> snapshotGenerations,journalGenerations;
+	Cluster::MulticastPipe* pipe=Vrui::getMainPipe();
+	if(pipe==0||Vrui::isHeadNode())
+		findGenerations(snapshotGenerations,journalGenerations);
+	if(pipe!=0)
+		{
+		shareGenerations(*pipe,snapshotGenerations);
+		shareGenerations(*pipe,journalGenerations);
+		pipe->flush();
+		}
+	if(snapshotGenerations.empty()&&journalGenerations.empty())
+		return false;
+	
+	/* Load the most recent snapshot, or start from an empty sketch if there is none: */
+	unsigned int firstGeneration=0;
+	SketchObjectList newSketchObjects;
+	if(!snapshotGenerations.empty())
+		{
+		firstGeneration=snapshotGenerations.back();
+		IO::FilePtr snapshotFile=Vrui::openFile(getFileName(firstGeneration,".sketch").c_str());
+		snapshotFile->setEndianness(Misc::LittleEndian);
+		creator.readFile(*snapshotFile,newSketchObjects);
+		installSketchObjects(newSketchObjects);
+		settings.readObjectIds(*snapshotFile);
+		}
+	else
+		installSketchObjects(newSketchObjects);
+	generation=firstGeneration;
+	
+	/* Replay all journals written since the snapshot was taken: */
+	for(std::vector<unsigned int>::iterator gIt=journalGenerations.begin();gIt!=journalGenerations.end();++gIt)
+		if(*gIt>=firstGeneration)
+			{
+			generation=*gIt;
+			IO::FilePtr file=Vrui::openFile(getFileName(*gIt,".journal").c_str());
+			file->setEndianness(Misc::LittleEndian);
+			if(!replayJournal(*file))
+				break;
+			}
+	
+	return true;
+	}
+
+void SketchJournal::start(double applicationTime)
+	{
+	/* Find the next unused generation number: */
+	std::vector<unsigned int> snapshotGenerations,journalGenerations;
+	findGenerations(snapshotGenerations,journalGenerations);
+	unsigned int newGeneration=generation+1;
+	if(!snapshotGenerations.empty()&&newGeneration<=snapshotGenerations.back())
+		newGeneration=snapshotGenerations.back()+1;
+	if(!journalGenerations.empty()&&newGeneration<=journalGenerations.back())
+		newGeneration=journalGenerations.back()+1;
+	
+	/* Write an initial snapshot of the current sketch objects and their identifiers, which the journal refers to: */
+	{
+	IO::FilePtr snapshotFile=IO::openFile(getFileName(newGeneration,".sketch.tmp").c_str(),IO::File::WriteOnly);
+	snapshotFile->setEndianness(Misc::LittleEndian);
+	creator.writeFile(settings.getSketchObjects(),*snapshotFile);
+	settings.writeObjectIds(*snapshotFile);
+	snapshotFile->flush();
+	}
+	rename(getFileName(newGeneration,".sketch.tmp").c_str(),getFileName(newGeneration,".sketch").c_str());
+	
+	/* Start a new journal and remove all older autosave files: */
+	generation=newGeneration;
+	openJournal(generation);
+	removeOldFiles(generation);
+	lastSnapshotTime=applicationTime;
+	}
+
+void SketchJournal::startSnapshot(double applicationTime)
+	{
+	/* Bail out if autosaving is disabled or a snapshot is still being written: */
+	if(journalFile==0||snapshotWorker!=0)
+		return;
+	
+	/* Take a snapshot of the current sketch objects and their identifiers and write it in the background: */
+	unsigned int newGeneration=generation+1;
+	std::string snapshotFileName=getFileName(newGeneration,".sketch.tmp");
+	IO::FilePtr snapshotFile=IO::openFile(snapshotFileName.c_str(),IO::File::WriteOnly);
+	snapshotFile->setEndianness(Misc::LittleEndian);
+	snapshotWorker=new SketchFileWorker(snapshotFileName,snapshotFile,creator,settings.getSketchObjects(),SketchObjectCreator::RawPoints,&settings);
+	snapshotGeneration=newGeneration;
+	
+	/* Continue journaling relative to the new snapshot: */
+	generation=newGeneration;
+	openJournal(generation);
+	lastSnapshotTime=applicationTime;
+	}
+
+void SketchJournal::loadFile(const std::string& fileName)
+	{
+	writeRecordHeader(LoadFile);
+	Misc::Marshaller<std::string>::write(fileName,records);
+	recordFlags|=NeedsSnapshot;
+	}
+
+void SketchJournal::appendObject(const SketchObject* object)
+	{
+	writeRecordHeader(AppendObject);
+	creator.writeObject(object,records);
+	}
+
+void SketchJournal::removeObject(const SketchObject* object)
+	{
+	writeRecordHeader(RemoveObject);
+	writeObjectId(object);
+	}
+
+void SketchJournal::insertObject(const SketchObject* succ,const SketchObject* object)
+	{
+	/* Write the successor's identifier, or 0 to append the object, and the identifier the object had before it was removed: */
+	writeRecordHeader(InsertObject);
+	if(succ!=0)
+		writeObjectId(succ);
+	else
+		records.write<Misc::UInt64>(0);
+	writeObjectId(object);
+	creator.writeObject(object,records);
+	}
+
+void SketchJournal::rubout(const Capsule& eraser,const std::vector<SketchObject*>& objects)
+	{
+	/* Write the eraser and the objects it applies to, so that replaying the record does not depend on other objects overlapping the eraser: */
+	writeRecordHeader(Rubout);
+	records.write(eraser.getC0().getComponents(),3);
+	records.write(eraser.getC1().getComponents(),3);
+	records.write<Misc::Float32>(eraser.getRadius());
+	writeObjects(objects);
+	}
+
+void SketchJournal::transformSelection(const Transformation& transform)
+	{
+	writeSelection(TransformSelection);
+	Misc::Marshaller<Transformation>::write(transform,records);
+	}
+
+void SketchJournal::selectionOperation(Operation operation)
+	{
+	writeSelection(operation);
+	
+	/* Write the settings used by the operation: */
+	if(operation==ApplySettingsToSelection)
+		{
+		const Color& color=settings.getColor();
+		for(int i=0;i<4;++i)
+			records.write<Misc::UInt8>(color[i]);
+		records.write<Misc::Float32>(settings.getLineWidth());
+		}
+	else if(operation==SnapSelectionToGrid)
+		records.write<Misc::Float32>(settings.getGridSize());
+	}
+
+void SketchJournal::installSnapshot(IO::File& file,double applicationTime)
+	{
+	/* Read and install the sketch objects contained in the snapshot and their identifiers: */
+	SketchObjectList newSketchObjects;
+	creator.readFile(file,newSketchObjects);
+	installSketchObjects(newSketchObjects);
+	settings.readObjectIds(file);
+	
+	/* Start a new autosave snapshot as the journal can not refer to the installed sketch objects: */
+	if(snapshotWorker!=0)
+		finishSnapshot();
+	startSnapshot(applicationTime);
+	}
+
+void SketchJournal::stopAutosave(void)
+	{
+	/* Finish a pending snapshot and close the journal file: */
+	if(snapshotWorker!=0)
+		finishSnapshot();
+	journalFile=0;
+	}
+
+void SketchJournal::flushRecords(IO::File* sink)
+	{
+	records.flush();
+	if(records.getDataSize()>0)
+		{
+		/* Write the pending records to the journal file and the given sink: */
+		if(journalFile!=0)
+			records.writeToSink(*journalFile);
+		if(sink!=0)
+			records.writeToSink(*sink);
+		records.clear();
+		}
+	recordFlags=0x0U;
+	touchedIds.clear();
+	}
+
+void SketchJournal::getTouchedIds(std::vector<Misc::UInt64>& ids) const
+	{
+	ids=touchedIds;
+	std::sort(ids.begin(),ids.end());
+	ids.erase(std::unique(ids.begin(),ids.end()),ids.end());
+	}
+
+void SketchJournal::journalRecords(const void* data,size_t dataSize)
+	{
+	/* Append the records to the journal file; they were already applied to the sketch objects: */
+	if(journalFile!=0&&dataSize>0)
+		{
+		journalFile->write(static_cast<const Misc::UInt8*>(data),dataSize);
+		++numRecords;
+		}
+	}
+
+void SketchJournal::frame(double applicationTime)
+	{
+	/* Push all records written during the last frame to the journal file: */
+	flushRecords(0);
+	if(journalFile==0)
+		return;
+	journalFile->flush();
+	
+	/* Commit a finished background snapshot: */
+	if(snapshotWorker!=0&&snapshotWorker->isFinished())
+		finishSnapshot();
+	
+	/* Take a new snapshot if there were edits since the last one and the snapshot interval expired: */
+	if(numRecords>0&&applicationTime>=lastSnapshotTime+snapshotInterval)
+		startSnapshot(applicationTime);
+	}
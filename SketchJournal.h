@@ -0,0 +1,130 @@
+/***********************************************************************
+SketchJournal - Class to autosave sketches as a sequence of periodic
+snapshots and append-only journals of the edit operations performed
+since each snapshot.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef SKETCHJOURNAL_INCLUDED
+#define SKETCHJOURNAL_INCLUDED
+
+#include <string>
+#include <vector>
+#include <Misc/SizedTypes.h>
+#include <IO/File.h>
+#include <IO/VariableMemoryFile.h>
+
+#include "SketchGeometry.h"
+#include "SketchHistory.h"
+
+/* Forward declarations: */
+class Capsule;
+class SketchObject;
+class SketchObjectList;
+class SketchObjectCreator;
+class SketchSettings;
+class SketchFileWorker;
+
+class SketchJournal:public SketchHistory::Listener
+	{
+	/* Embedded classes: */
+	public:
+	enum Operation // Enumerated type for journaled edit operations
+		{
+		LoadFile=0,AppendObject,RemoveObject,Rubout,
+		TransformSelection,ApplySettingsToSelection,SnapSelectionToGrid,CloneSelection,
+		GroupSelection,UngroupSelection,SelectionToBack,SelectionToFront,DeleteSelection,
+		InsertObject
+		};
+	
+	enum RecordFlags // Enumerated type for flags describing the pending records
+		{
+		NeedsSnapshot=0x1U // Some records can not be applied by other instances, e.g., loading a local file, or were already committed to a superseded journal
+		};
+	
+	/* Elements: */
+	private:
+	static const char* journalHeader; // Header string identifying journal files
+	std::string baseName; // Base path name of all autosave files
+	double snapshotInterval; // Minimum time between snapshots in seconds
+	SketchObjectCreator& creator; // Object creator to read and write sketch objects
+	SketchSettings& settings; // Sketch settings containing the journaled sketch objects
+	unsigned int generation; // Generation number of the current snapshot and journal
+	IO::FilePtr journalFile; // The current journal file
+	size_t numRecords; // Number of records written to the current journal file
+	IO::VariableMemoryFile records; // Records of edit operations journaled since the last flush
+	unsigned int recordFlags; // Bit mask of record flags describing the pending records
+	std::vector<Misc::UInt64> touchedIds; // Identifiers of the existing sketch objects that the pending records refer to
+	double lastSnapshotTime; // Application time at which the last snapshot was taken
+	SketchFileWorker* snapshotWorker; // Worker writing a snapshot in the background, or null
+	unsigned int snapshotGeneration; // Generation number of the snapshot being written in the background
+	
+	/* Private methods: */
+	std::string getFileName(unsigned int fileGeneration,const char* extension) const; // Returns the name of an autosave file of the given generation
+	void findGenerations(std::vector<unsigned int>& snapshotGenerations,std::vector<unsigned int>& journalGenerations) const; // Returns the sorted generation numbers of all existing snapshot and journal files
+	void removeOldFiles(unsigned int keepGeneration); // Removes all autosave files older than the given generation
+	void installSketchObjects(SketchObjectList& newSketchObjects); // Replaces the current sketch objects with the given newly-read sketch objects
+	SketchObject* getObject(Misc::UInt64 objectId); // Returns the top-level sketch object of the given identifier; throws an exception if there is none
+	void openJournal(unsigned int newGeneration); // Starts a new journal file of the given generation
+	void writeRecordHeader(Operation operation); // Writes a record header for the given operation, including the identifier the next new sketch object will receive
+	void writeObjectId(const SketchObject* object); // Writes the identifier of the given existing sketch object and notes that the pending records refer to it
+	void writeObjects(const std::vector<SketchObject*>& objects); // Writes the identifiers of the given existing sketch objects
+	void readObjects(IO::File& file,std::vector<SketchObject*>& objects); // Reads identifiers written by writeObjects and returns the respective sketch objects
+	void writeSelection(Operation operation); // Writes a record header for the given operation followed by the current selection
+	void readSelection(IO::File& file); // Reads a selection and selects the respective sketch objects
+	bool replayJournal(IO::File& file); // Replays all complete records from the given journal file; returns false if the journal ended in an incomplete record
+	void finishSnapshot(void); // Finishes a completed background snapshot
+	
+	/* Constructors and destructors: */
+	public:
+	SketchJournal(const std::string& sBaseName,double sSnapshotInterval,SketchObjectCreator& sCreator,SketchSettings& sSettings); // Creates a journal for the autosave files of the given base name; does not touch any files yet, and only collects records for collaboration until start() is called
+	virtual ~SketchJournal(void); // Waits for a pending snapshot and closes the journal
+	
+	/* Methods from class SketchHistory::Listener: */
+	virtual void insertObject(const SketchObject* succ,const SketchObject* object);
+	virtual void removeObject(const SketchObject* object);
+	
+	/* Methods: */
+	bool recover(void); // Replaces the current sketch objects with the state stored in existing autosave files; returns true if there were any; in a cluster, the head node reads the files and streams them to all other nodes
+	void start(double applicationTime); // Writes an initial snapshot of the current sketch objects and starts journaling
+	void startSnapshot(double applicationTime); // Starts writing a snapshot of the current sketch objects in the background and starts a new journal; does nothing if not autosaving
+	bool isAutosaving(void) const // Returns true if records are written to autosave files
+		{
+		return journalFile!=0;
+		}
+	void stopAutosave(void); // Stops writing autosave files, but keeps collecting records
+	void loadFile(const std::string& fileName); // Journals that all sketch objects were replaced by the contents of the given sketch file
+	void appendObject(const SketchObject* object); // Journals that the given object is about to be appended
+	void rubout(const Capsule& eraser,const std::vector<SketchObject*>& objects); // Journals that the given eraser is about to be applied to the given sketch objects
+	void transformSelection(const Transformation& transform); // Journals that the current selection is about to be transformed
+	void selectionOperation(Operation operation); // Journals that the given operation is about to be applied to the current selection
+	unsigned int getRecordFlags(void) const // Returns the bit mask of record flags describing the pending records
+		{
+		return recordFlags;
+		}
+	void getTouchedIds(std::vector<Misc::UInt64>& ids) const; // Returns the sorted identifiers of the existing sketch objects that the pending records refer to
+	void flushRecords(IO::File* sink); // Writes all pending records to the journal file and the given sink if not null, and starts collecting new records
+	void replayRecords(IO::File& file); // Applies all records from the given file, e.g., records received from a collaborator, without journaling them again; throws an exception on an invalid record
+	void installSnapshot(IO::File& file,double applicationTime); // Replaces the current sketch objects with the contents of the given sketch file, e.g., a snapshot received from a collaborator, and starts a new autosave snapshot
+	void journalRecords(const void* data,size_t dataSize); // Appends the given block of records, which were already applied, to the journal file
+	void frame(double applicationTime); // Writes pending records to the journal and takes periodic snapshots; called once per frame
+	};
+
+#endif
@@ -31,6 +31,11 @@ SketchObject::~SketchObject(void)
 	{
 	}
 
+void SketchObject::finishRead(void)
+	{
+	/* Doesn't do anything */
+	}
+
 /************************************
 Methods of class SketchObjectFactory:
 ************************************/
@@ -38,3 +43,7 @@ Methods of class SketchObjectFactory:
 SketchObjectFactory::~SketchObjectFactory(void)
 	{
 	}
+
+void SketchObjectFactory::glRenderPrediction(const Point& predictedPos,RenderState& renderState) const
+	{
+	}
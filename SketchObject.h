@@ -24,6 +24,9 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef SKETCHOBJECT_INCLUDED
 #define SKETCHOBJECT_INCLUDED
 
+#include <stddef.h>
+#include <string>
+#include <Misc/SizedTypes.h>
 #include <Math/Math.h>
 
 #include "SketchGeometry.h"
@@ -34,6 +37,7 @@ class File;
 }
 class Capsule;
 class RenderState;
+class SketchObjectChunk;
 class SketchObjectList;
 class SketchObjectContainer;
 class SketchSettings;
@@ -42,6 +46,7 @@ class SketchObjectCreator;
 class SketchObject
 	{
 	friend class SketchObjectList;
+	friend class SketchSettings;
 	
 	/* Embedded classes: */
 	public:
@@ -136,33 +141,43 @@ class SketchObject
 	
 	/* Elements: */
 	private:
-	SketchObject* pred; // Pointer to sketch object's predecessor in a linked list
-	SketchObject* succ; // Pointer to sketch object's successor in a linked list
+	SketchObjectChunk* chunk; // Pointer to the chunk of the list containing the sketch object, or null if the sketch object is not in a list
+	unsigned int slot; // Index of the sketch object inside its chunk
+	Misc::UInt64 id; // Identifier of the sketch object that is the same at all collaborating instances, assigned when it becomes a top-level object; 0 if it never was one
 	protected:
 	Box boundingBox; // Axis-aligned box bounding the sketch object
 	
 	/* Constructors and destructors: */
 	public:
 	SketchObject(void)
-		:pred(0),succ(0),boundingBox(Box::empty)
+		:chunk(0),slot(0),id(0),boundingBox(Box::empty)
 		{
 		}
 	virtual ~SketchObject(void);
 	
 	/* Methods: */
+	Misc::UInt64 getId(void) const // Returns the sketch object's identifier
+		{
+		return id;
+		}
 	const Box& getBoundingBox(void) const // Returns the sketch object's bounding box
 		{
 		return boundingBox;
 		}
 	virtual unsigned int getTypeCode(void) const =0; // Returns an integer uniquely identifying a sketching object class
+	virtual Scalar getMaxLineWidth(void) const =0; // Returns the largest line width used to draw any part of the sketch object
+	virtual size_t getMemorySize(void) const =0; // Returns the approximate memory used by the sketch object, not counting data it currently shares with other sketch objects
 	virtual bool pick(PickResult& result) =0; // Picks this object with the given pick query; updates query object and returns true if object is picked
 	virtual SketchObject* clone(void) const =0; // Creates an identical copy of the sketch object
 	virtual void applySettings(const SketchSettings& settings) =0; // Applies settings from the given settings object to the sketch object
 	virtual void transform(const Transformation& transform) =0; // Transforms the sketch object with the given transformation
 	virtual void snapToGrid(Scalar gridSize) =0; // Snaps the sketch object to a grid of the given grid spacing
+	virtual bool isErased(const Capsule& eraser) =0; // Returns false if rubbing out the sketch object with the given eraser capsule is guaranteed not to change it
 	virtual void rubout(const Capsule& eraser,SketchObjectContainer& container) =0; // Erases the part of the object that lies within the capsule defined by the two center points and the radius
 	virtual void write(IO::File& file,const SketchObjectCreator& creator) const =0; // Writes the sketch object to the given binary file
-	virtual void read(IO::File& file,SketchObjectCreator& creator) =0; // Reads the sketch object from the given binary file
+	virtual void read(IO::File& file,SketchObjectCreator& creator) =0; // Reads the sketch object from the given binary file; can be called from a background thread
+	virtual void writeSVG(std::string& svg) const =0; // Appends SVG elements drawing the sketch object in navigational coordinates to the given string; can be called from multiple threads for different objects
+	virtual void finishRead(void); // Finishes setting up a sketch object that was just read from a file; must be called from the main thread
 	virtual void glRenderAction(RenderState& renderState) const =0; // Renders the sketch object
 	virtual void glRenderActionHighlight(Scalar cycle,RenderState& renderState) const =0; // Highlights the sketch object
 	};
@@ -189,6 +204,7 @@ class SketchObjectFactory
 	virtual bool buttonUp(const Point& pos) =0; // Registers a button release at the given position; returns true if the currently created sketch object is finished
 	virtual SketchObject* finish(void) =0; // Finishes and returns the currently created sketch object
 	virtual void glRenderAction(RenderState& renderState) const =0; // Renders the sketch object factory's state
+	virtual void glRenderPrediction(const Point& predictedPos,RenderState& renderState) const; // Renders a provisional extension of the sketch object factory's state towards the given predicted tool position; does nothing by default
 	};
 
 #endif
@@ -22,22 +22,26 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include "SketchObjectContainer.h"
 
+#include "RenderState.h"
+
 /**************************************
 Methods of class SketchObjectContainer:
 **************************************/
 
 void SketchObjectContainer::drawObjects(RenderState& renderState) const
 	{
-	/* Render all sketch objects: */
+	/* Render all sketch objects whose bounding boxes, extended by half their line widths, intersect the view box: */
 	for(SketchObjectList::const_iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
-		soIt->glRenderAction(renderState);
+		if(renderState.isVisible(soIt->getBoundingBox(),soIt->getMaxLineWidth()*Scalar(0.5)))
+			soIt->glRenderAction(renderState);
 	}
 
 void SketchObjectContainer::drawObjectsHighlight(Scalar cycle,RenderState& renderState) const
 	{
-	/* Highlight all sketch objects: */
+	/* Highlight all potentially visible sketch objects: */
 	for(SketchObjectList::const_iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
-		soIt->glRenderActionHighlight(cycle,renderState);
+		if(renderState.isVisible(soIt->getBoundingBox(),soIt->getMaxLineWidth()*Scalar(0.5)))
+			soIt->glRenderActionHighlight(cycle,renderState);
 	}
 
 SketchObjectContainer::~SketchObjectContainer(void)
@@ -62,6 +66,11 @@ void SketchObjectContainer::remove(SketchObject* object)
 	sketchObjects.erase(SketchObjectList::iterator(object));
 	}
 
+void SketchObjectContainer::update(SketchObject* object)
+	{
+	/* Doesn't do anything */
+	}
+
 SketchObject::PickResult SketchObjectContainer::pick(const Point& pos,Scalar radius)
 	{
 	/* Create a pick result: */
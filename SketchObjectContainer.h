@@ -37,8 +37,8 @@ class SketchObjectContainer
 	SketchObjectList sketchObjects; // List of sketch objects in the container
 	
 	/* Protected methods: */
-	void drawObjects(RenderState& renderState) const; // Draws all sketch objects in the container in order
-	void drawObjectsHighlight(Scalar cycle,RenderState& renderState) const; // Highlights all sketch objects in the container in order using the given cycle in [-1, 1]
+	void drawObjects(RenderState& renderState) const; // Draws all potentially visible sketch objects in the container in order
+	void drawObjectsHighlight(Scalar cycle,RenderState& renderState) const; // Highlights all potentially visible sketch objects in the container in order using the given cycle in [-1, 1]
 	
 	/* Constructors and destructors: */
 	public:
@@ -56,6 +56,7 @@ class SketchObjectContainer
 	virtual void append(SketchObject* newObject); // Appens the given object to the container's list
 	virtual void insertAfter(SketchObject* pred,SketchObject* newObject); // Inserts the given object after the given predecessor
 	virtual void remove(SketchObject* object); // Removes the given object from the container
+	virtual void update(SketchObject* object); // Notifies the container that the given object's bounding box or line width changed
 	virtual SketchObject::PickResult pick(const Point& pos,Scalar radius); // Returns a pick result for this container
 	};
 
@@ -22,10 +22,15 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include "SketchObjectCreator.h"
 
+#include <string.h>
 #include <Misc/SizedTypes.h>
 #include <Misc/StdError.h>
+#include <Misc/Endianness.h>
 #include <IO/File.h>
+#include <IO/VariableMemoryFile.h>
 
+#include "Stats.h"
+#include "SketchObjectList.h"
 #include "Curve.h"
 #include "Group.h"
 #include "Image.h"
@@ -34,20 +39,37 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 Methods of class SketchObjectCreator:
 ************************************/
 
+const char* SketchObjectCreator::fileHeader="SketchPadFile v5.0\n";
+const char* SketchObjectCreator::fileHeaderV2="SketchPadFile v2.0\n";
+const char* SketchObjectCreator::fileHeaderV3="SketchPadFile v3.0\n";
+const char* SketchObjectCreator::fileHeaderV4="SketchPadFile v4.0\n";
+Threads::Atomic<unsigned int> SketchObjectCreator::numCreators(0);
+unsigned int SketchObjectCreator::numClasses=0;
+
 SketchObjectCreator::SketchObjectCreator(void)
+	:fileVersion(currentFileVersion),readingFile(false),
+	 writingFile(false),pointEncoding(RawPoints),
+	 writeMode(WriteTopLevel),nestedStateSize(0),nextPreparedObject(0)
 	{
-	/* Initialize and assign type codes to all sketch object classes: */
-	Curve::initClass(0);
-	Group::initClass(1);
-	Image::initClass(2);
+	if(numCreators.preAdd(1)==1U)
+		{
+		/* Initialize and assign type codes to all sketch object classes: */
+		numClasses=0;
+		Curve::initClass(numClasses++);
+		Group::initClass(numClasses++);
+		Image::initClass(numClasses++);
+		}
 	}
 
 SketchObjectCreator::~SketchObjectCreator(void)
 	{
-	/* Deinitialize sketch object classes that need deinitialization: */
-	Curve::deinitClass();
-	Group::deinitClass();
-	Image::deinitClass();
+	if(numCreators.preSub(1)==0U)
+		{
+		/* Deinitialize sketch object classes that need deinitialization: */
+		Curve::deinitClass();
+		Group::deinitClass();
+		Image::deinitClass();
+		}
 	}
 
 SketchObject* SketchObjectCreator::createObject(unsigned int typeCode)
@@ -76,20 +98,296 @@ SketchObject* SketchObjectCreator::createObject(unsigned int typeCode)
 
 SketchObject* SketchObjectCreator::readObject(IO::File& file)
 	{
-	/* Read the object's type code and create a new object: */
-	SketchObject* result=createObject(file.read<Misc::UInt16>());
+	/* Read the object's type code: */
+	unsigned int typeCode=file.read<Misc::UInt16>();
 	
-	/* Read the new object's state: */
-	result->read(file,*this);
+	if(fileVersion>=2)
+		{
+		/* Read the size of the object's state and skip objects of unknown types: */
+		size_t stateSize=file.read<Misc::UInt32>();
+		if(typeCode>=numClasses)
+			{
+			file.skip<Misc::UInt8>(stateSize);
+			return 0;
+			}
+		}
+	
+	/* Create a new object and read its state: */
+	SketchObject* result=createObject(typeCode);
+	try
+		{
+		result->read(file,*this);
+		}
+	catch(...)
+		{
+		/* Destroy the partially-read object and re-throw the exception: */
+		delete result;
+		throw;
+		}
 	
 	return result;
 	}
 
+size_t SketchObjectCreator::prepareObject(const SketchObject* object) const
+	{
+	/* Add the object before any objects nested inside it: */
+	size_t index=preparedObjects.size();
+	preparedObjects.push_back(PreparedObject(object));
+	
+	/* Write the object's own state into a buffer, which prepares all nested objects instead of writing them: */
+	IO::VariableMemoryFile* state=new IO::VariableMemoryFile;
+	size_t outerNestedStateSize=nestedStateSize;
+	nestedStateSize=0;
+	try
+		{
+		state->setEndianness(Misc::LittleEndian);
+		object->write(*state,*this);
+		state->flush();
+		}
+	catch(...)
+		{
+		delete state;
+		nestedStateSize=outerNestedStateSize;
+		throw;
+		}
+	size_t stateSize=state->getDataSize()+nestedStateSize;
+	nestedStateSize=outerNestedStateSize;
+	
+	PreparedObject& po=preparedObjects[index];
+	po.stateSize=stateSize;
+	if(preparedObjects.size()==index+1)
+		{
+		/* Keep the buffered state of an object without nested objects: */
+		po.state=state;
+		}
+	else
+		{
+		/* Discard the buffered state; the object's own state will be written again around its nested objects: */
+		delete state;
+		}
+	
+	return stateSize;
+	}
+
+void SketchObjectCreator::emitObject(IO::File& file) const
+	{
+	PreparedObject po=preparedObjects[nextPreparedObject++];
+	
+	/* Write the object's type code and the size of its state: */
+	file.write<Misc::UInt16>(po.object->getTypeCode());
+	file.write<Misc::UInt32>(po.stateSize);
+	
+	/* Write the object's buffered state, or write its state directly, which emits its nested objects: */
+	if(po.state!=0)
+		po.state->writeToSink(file);
+	else
+		po.object->write(file,*this);
+	}
+
+void SketchObjectCreator::clearPreparedObjects(void) const
+	{
+	for(std::vector<PreparedObject>::iterator poIt=preparedObjects.begin();poIt!=preparedObjects.end();++poIt)
+		delete poIt->state;
+	preparedObjects.clear();
+	nestedStateSize=0;
+	nextPreparedObject=0;
+	writeMode=WriteTopLevel;
+	}
+
 void SketchObjectCreator::writeObject(const SketchObject* object,IO::File& file) const
 	{
-	/* Write the object's type code: */
-	file.write<Misc::UInt16>(object->getTypeCode());
+	switch(writeMode)
+		{
+		case WriteTopLevel:
+			/* Determine the state sizes of the object and all objects nested inside it, buffering each object's state at most once, then write them all: */
+			try
+				{
+				writeMode=PrepareNested;
+				prepareObject(object);
+				writeMode=EmitNested;
+				emitObject(file);
+				}
+			catch(...)
+				{
+				clearPreparedObjects();
+				throw;
+				}
+			clearPreparedObjects();
+			break;
+		
+		case PrepareNested:
+			/* Prepare the nested object without writing it into the enclosing object's buffer: */
+			nestedStateSize+=sizeof(Misc::UInt16)+sizeof(Misc::UInt32)+prepareObject(object);
+			break;
+		
+		case EmitNested:
+			/* Write the nested object, which was prepared in the same order: */
+			emitObject(file);
+			break;
+		}
+	}
+
+void SketchObjectCreator::addReadImage(const ImageStore::EntryPtr& storedImage)
+	{
+	/* Image indices only refer to images read earlier from the same sketch file: */
+	if(readingFile)
+		readImages.push_back(storedImage);
+	}
+
+ImageStore::EntryPtr SketchObjectCreator::getReadImage(unsigned int imageIndex) const
+	{
+	return imageIndex<readImages.size()?readImages[imageIndex]:ImageStore::EntryPtr();
+	}
+
+ImageStore::EntryPtr SketchObjectCreator::findReadImage(Misc::UInt64 imageHash) const
+	{
+	for(std::vector<ImageStore::EntryPtr>::const_iterator riIt=readImages.begin();riIt!=readImages.end();++riIt)
+		if((*riIt)->getHash()==imageHash)
+			return *riIt;
 	
-	/* Write the object's state: */
-	object->write(file,*this);
+	return ImageStore::EntryPtr();
+	}
+
+bool SketchObjectCreator::writeImageData(const ImageStore::Entry* storedImage,unsigned int& imageIndex) const
+	{
+	/* Always write image source files outside of sketch files, e.g., into journal records: */
+	if(!writingFile)
+		return true;
+	
+	/* Write each image source file only once per sketch file, and assign it the next image index when it is written: */
+	std::pair<std::map<const ImageStore::Entry*,unsigned int>::iterator,bool> wiIt=writtenImages.insert(std::make_pair(storedImage,(unsigned int)(writtenImages.size())));
+	imageIndex=wiIt.first->second;
+	return wiIt.second;
+	}
+
+void SketchObjectCreator::finishReadFile(void)
+	{
+	/* Reset the file version for objects read outside of files and release all images read from the file: */
+	readingFile=false;
+	fileVersion=currentFileVersion;
+	readImages.clear();
+	}
+
+void SketchObjectCreator::readFile(IO::File& file,SketchObjectList& sketchObjects,SketchObjectCreator::FileProgress* progress)
+	{
+	/* Measure the time spent reading the file: */
+	SKETCHPAD_STATS_TIMER(LoadTime);
+	
+	readingFile=true;
+	readImages.clear();
+	try
+		{
+		readFileContents(file,sketchObjects,progress);
+		}
+	catch(...)
+		{
+		finishReadFile();
+		throw;
+		}
+	finishReadFile();
+	}
+
+void SketchObjectCreator::readFileContents(IO::File& file,SketchObjectList& sketchObjects,SketchObjectCreator::FileProgress* progress)
+	{
+	/* Read the first four bytes of the file to check for a file header: */
+	size_t headerLength=strlen(fileHeader);
+	char header[32];
+	file.read(header,4);
+	size_t numSketchObjects;
+	if(memcmp(header,fileHeader,4)==0)
+		{
+		/* Read and check the rest of the file header, which has the same length for all versions: */
+		file.read(header+4,headerLength-4);
+		if(memcmp(header,fileHeader,headerLength)==0)
+			fileVersion=5;
+		else if(memcmp(header,fileHeaderV4,headerLength)==0)
+			fileVersion=4;
+		else if(memcmp(header,fileHeaderV3,headerLength)==0)
+			fileVersion=3;
+		else if(memcmp(header,fileHeaderV2,headerLength)==0)
+			fileVersion=2;
+		else
+			throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Unrecognized sketch file header");
+		
+		/* Read the number of sketch objects in the file: */
+		numSketchObjects=file.read<Misc::UInt32>();
+		}
+	else
+		{
+		/* The file is a headerless version 1 file starting with a little-endian 32-bit object count: */
+		fileVersion=1;
+		const unsigned char* countBytes=reinterpret_cast<const unsigned char*>(header);
+		numSketchObjects=size_t(countBytes[0])|(size_t(countBytes[1])<<8)|(size_t(countBytes[2])<<16)|(size_t(countBytes[3])<<24);
+		}
+	
+	if(progress!=0)
+		progress->numObjects.set(numSketchObjects);
+	
+	/* Read all sketch objects contained in the file, skipping objects of unknown types: */
+	for(size_t i=0;i<numSketchObjects;++i)
+		{
+		SketchObject* object=readObject(file);
+		if(object!=0)
+			sketchObjects.push_back(object);
+		if(progress!=0)
+			progress->numObjectsRead.set(i+1);
+		}
+	SKETCHPAD_STATS_COUNT(LoadedObjects,(unsigned int)(numSketchObjects));
+	}
+
+void SketchObjectCreator::startFile(size_t numSketchObjects,IO::File& file,SketchObjectCreator::PointEncoding encoding) const
+	{
+	/* Write the file header and the number of sketch objects: */
+	file.write(fileHeader,strlen(fileHeader));
+	file.write<Misc::UInt32>(numSketchObjects);
+	
+	/* Write all sketch objects in the given point encoding, writing each shared image source file only once: */
+	writingFile=true;
+	pointEncoding=encoding;
+	writtenImages.clear();
+	}
+
+void SketchObjectCreator::finishFile(void) const
+	{
+	writingFile=false;
+	pointEncoding=RawPoints;
+	writtenImages.clear();
+	}
+
+void SketchObjectCreator::writeFile(const SketchObjectList& sketchObjects,IO::File& file,SketchObjectCreator::PointEncoding encoding) const
+	{
+	/* Measure the time spent writing the file: */
+	SKETCHPAD_STATS_TIMER(SaveTime);
+	
+	startFile(sketchObjects.size(),file,encoding);
+	try
+		{
+		for(SketchObjectList::const_iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
+			writeObject(&*soIt,file);
+		}
+	catch(...)
+		{
+		finishFile();
+		throw;
+		}
+	finishFile();
+	}
+
+void SketchObjectCreator::writeFile(const std::vector<SketchObject*>& sketchObjects,IO::File& file,SketchObjectCreator::PointEncoding encoding) const
+	{
+	/* Measure the time spent writing the file: */
+	SKETCHPAD_STATS_TIMER(SaveTime);
+	
+	startFile(sketchObjects.size(),file,encoding);
+	try
+		{
+		for(std::vector<SketchObject*>::const_iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
+			writeObject(*soIt,file);
+		}
+	catch(...)
+		{
+		finishFile();
+		throw;
+		}
+	finishFile();
 	}
@@ -23,23 +23,121 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef SKETCHOBJECTCREATOR_INCLUDED
 #define SKETCHOBJECTCREATOR_INCLUDED
 
+#include <stddef.h>
+#include <map>
+#include <vector>
+#include <Misc/SizedTypes.h>
+#include <Threads/Atomic.h>
+
+#include "ImageStore.h"
+
 /* Forward declarations: */
 namespace IO {
 class File;
+class VariableMemoryFile;
 }
 class SketchObject;
+class SketchObjectList;
 
-class SketchObjectCreator
+class SketchObjectCreator // Class to create, read, and write sketch objects; each thread reading or writing sketch objects must use its own creator
 	{
+	/* Embedded classes: */
+	public:
+	enum PointEncoding // Enumerated type for encodings of curve points in sketch files
+		{
+		RawPoints=0, // Uncompressed 3D points
+		DeltaPoints // Differences between 2D points quantized relative to the curve's line width, packed into varints
+		};
+	
+	struct FileProgress // Structure to monitor the progress of reading a sketch file from another thread
+		{
+		/* Elements: */
+		public:
+		Threads::Atomic<unsigned int> numObjects; // Number of top-level sketch objects in the file, or 0 if not yet known
+		Threads::Atomic<unsigned int> numObjectsRead; // Number of top-level sketch objects read so far
+		
+		/* Constructors and destructors: */
+		FileProgress(void)
+			:numObjects(0),numObjectsRead(0)
+			{
+			}
+		};
+	
+	/* Elements: */
+	static const char* fileHeader; // Header string identifying sketch files of the current format version
+	static const unsigned int currentFileVersion=5; // Version of the file format written by this creator
+	private:
+	enum WriteMode // Enumerated type for the stages of writing a sketch object that might contain nested sketch objects
+		{
+		WriteTopLevel, // Not currently writing any sketch object
+		PrepareNested, // Determining the state sizes of a sketch object and all objects nested inside it
+		EmitNested // Writing a sketch object and all objects nested inside it using the prepared state sizes
+		};
+	
+	struct PreparedObject // Structure for a sketch object whose state size was determined before it is written
+		{
+		/* Elements: */
+		public:
+		const SketchObject* object; // The sketch object
+		size_t stateSize; // Size of the object's state including the states of all objects nested inside it
+		IO::VariableMemoryFile* state; // Buffered state of an object without nested objects, or null if the object's state is written directly around its nested objects
+		
+		/* Constructors and destructors: */
+		PreparedObject(const SketchObject* sObject)
+			:object(sObject),stateSize(0),state(0)
+			{
+			}
+		};
+	
+	static const char* fileHeaderV2; // Header string identifying sketch files of format version 2
+	static const char* fileHeaderV3; // Header string identifying sketch files of format version 3
+	static const char* fileHeaderV4; // Header string identifying sketch files of format version 4
+	static Threads::Atomic<unsigned int> numCreators; // Number of existing creators; sketch object classes are initialized while there is at least one
+	static unsigned int numClasses; // Number of registered sketch object classes, whose type codes are 0 to numClasses-1
+	unsigned int fileVersion; // Version of the sketch file currently being read
+	bool readingFile; // Flag if a sketch file is currently being read
+	std::vector<ImageStore::EntryPtr> readImages; // Stored images whose source files were read from the sketch file currently being read, indexed by their order in the file
+	mutable bool writingFile; // Flag if a sketch file is currently being written
+	mutable PointEncoding pointEncoding; // Encoding of curve points in the sketch file currently being written; always raw outside of sketch files
+	mutable std::map<const ImageStore::Entry*,unsigned int> writtenImages; // Map from stored images whose source files were already written to the sketch file currently being written to their indices in the file
+	mutable WriteMode writeMode; // Stage of writing the current top-level sketch object
+	mutable std::vector<PreparedObject> preparedObjects; // The current top-level sketch object and all objects nested inside it, in the order in which they are written
+	mutable size_t nestedStateSize; // Accumulated size of all objects nested inside the object currently being prepared, including their type codes and state sizes
+	mutable size_t nextPreparedObject; // Index of the next prepared object to be written
+	
+	/* Private methods: */
+	size_t prepareObject(const SketchObject* object) const; // Determines the state size of the given sketch object and of all objects nested inside it, buffering the states of objects without nested objects; returns the object's state size
+	void emitObject(IO::File& file) const; // Writes the next prepared sketch object to the given file
+	void clearPreparedObjects(void) const; // Discards all prepared sketch objects and their buffered states
+	void readFileContents(IO::File& file,SketchObjectList& sketchObjects,FileProgress* progress); // Reads the header and all sketch objects of a sketch file
+	void finishReadFile(void); // Finishes reading a sketch file
+	void startFile(size_t numSketchObjects,IO::File& file,PointEncoding encoding) const; // Writes a sketch file header for the given number of sketch objects and prepares writing them in the given point encoding
+	void finishFile(void) const; // Finishes writing a sketch file
+	
 	/* Constructors and destructors: */
 	public:
-	SketchObjectCreator(void); // Assigns unique type codes to all sketch object classes
-	~SketchObjectCreator(void); // Destroys all sketch object classes
+	SketchObjectCreator(void); // Assigns unique type codes to all sketch object classes when the first creator is created
+	~SketchObjectCreator(void); // Destroys all sketch object classes when the last creator is destroyed
 	
 	/* Methods: */
 	SketchObject* createObject(unsigned int typeCode); // Returns a new object of a class matching the given type code
-	SketchObject* readObject(IO::File& file); // Reads a sketch object from the given file
+	unsigned int getFileVersion(void) const // Returns the format version of the sketch file currently being read
+		{
+		return fileVersion;
+		}
+	SketchObject* readObject(IO::File& file); // Reads a sketch object from the given file; returns null if the object is of an unknown type and was skipped
 	void writeObject(const SketchObject* object,IO::File& file) const; // Writes the given sketch object to the given file
+	PointEncoding getPointEncoding(void) const // Returns the encoding in which to write curve points
+		{
+		return pointEncoding;
+		}
+	void addReadImage(const ImageStore::EntryPtr& storedImage); // Assigns the next image index in the sketch file currently being read to the given stored image, whose source file was just read
+	ImageStore::EntryPtr getReadImage(unsigned int imageIndex) const; // Returns the stored image of the given index read earlier from the sketch file currently being read, or null
+	ImageStore::EntryPtr findReadImage(Misc::UInt64 imageHash) const; // Returns the stored image of the given hash value read earlier from the sketch file currently being read, or null; used for format version 3 and 4 files
+	bool writeImageData(const ImageStore::Entry* storedImage,unsigned int& imageIndex) const; // Returns true if the source file of the given stored image needs to be written, i.e., if it was not yet written to the sketch file currently being written; otherwise returns the index of the earlier copy in the given reference
+	void readFile(IO::File& file,SketchObjectList& sketchObjects,FileProgress* progress=0); // Reads a sketch file of any supported format version and appends its sketch objects to the given list; updates the given progress structure if not null
+	void writeFile(const SketchObjectList& sketchObjects,IO::File& file,PointEncoding encoding=RawPoints) const; // Writes the given sketch objects to the given file in the current format version, using the given curve point encoding
+	void writeFile(const std::vector<SketchObject*>& sketchObjects,IO::File& file,PointEncoding encoding=RawPoints) const; // Ditto, for sketch objects that are part of another list
 	};
 
 #endif
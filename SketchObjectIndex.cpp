@@ -0,0 +1,400 @@
+/***********************************************************************
+SketchObjectIndex - Class for incrementally maintained spatial indices
+of sketch objects, based on a balanced tree of bounding rectangles in
+the sketching plane.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "SketchObjectIndex.h"
+
+#include <Math/Math.h>
+
+#include "SketchObject.h"
+
+/**********************************
+Methods of class SketchObjectIndex:
+**********************************/
+
+SketchObjectIndex::Rect SketchObjectIndex::getRect(const SketchObject* object)
+	{
+	/* Extend the object's bounding box by half its line width: */
+	const Box& box=object->getBoundingBox();
+	Scalar margin=object->getMaxLineWidth()*Scalar(0.5);
+	Rect result;
+	for(int i=0;i<2;++i)
+		{
+		result.min[i]=box.min[i]-margin;
+		result.max[i]=box.max[i]+margin;
+		}
+	return result;
+	}
+
+SketchObjectIndex::Rect SketchObjectIndex::getRect(const Box& box)
+	{
+	Rect result;
+	for(int i=0;i<2;++i)
+		{
+		result.min[i]=box.min[i];
+		result.max[i]=box.max[i];
+		}
+	return result;
+	}
+
+int SketchObjectIndex::allocateNode(void)
+	{
+	int result;
+	if(freeNodes>=0)
+		{
+		/* Take the first node from the free list: */
+		result=freeNodes;
+		freeNodes=nodes[result].parent;
+		}
+	else
+		{
+		/* Append a new node to the node array: */
+		result=int(nodes.size());
+		nodes.push_back(Node());
+		}
+	
+	/* Initialize the node as a leaf: */
+	Node& node=nodes[result];
+	node.parent=-1;
+	node.children[0]=node.children[1]=-1;
+	node.height=0;
+	node.object=0;
+	
+	return result;
+	}
+
+void SketchObjectIndex::freeNode(int nodeIndex)
+	{
+	/* Prepend the node to the free list: */
+	nodes[nodeIndex].parent=freeNodes;
+	nodes[nodeIndex].height=-1;
+	freeNodes=nodeIndex;
+	}
+
+void SketchObjectIndex::updateNode(int nodeIndex)
+	{
+	Node& node=nodes[nodeIndex];
+	const Node& c0=nodes[node.children[0]];
+	const Node& c1=nodes[node.children[1]];
+	node.rect=c0.rect.join(c1.rect);
+	node.height=Math::max(c0.height,c1.height)+1;
+	}
+
+int SketchObjectIndex::balance(int aIndex)
+	{
+	/* Bail out if the subtree is a leaf or too short to be unbalanced: */
+	if(nodes[aIndex].isLeaf()||nodes[aIndex].height<2)
+		return aIndex;
+	
+	/* Check which of the node's two children is taller: */
+	int bIndex=nodes[aIndex].children[0];
+	int cIndex=nodes[aIndex].children[1];
+	int imbalance=nodes[cIndex].height-nodes[bIndex].height;
+	if(imbalance>1||imbalance<-1)
+		{
+		/* Rotate the taller child up: */
+		int up=imbalance>1?1:0;
+		int upIndex=nodes[aIndex].children[up];
+		int fIndex=nodes[upIndex].children[0];
+		int gIndex=nodes[upIndex].children[1];
+		
+		/* Replace the node with its taller child in the node's parent: */
+		int parent=nodes[aIndex].parent;
+		nodes[upIndex].parent=parent;
+		if(parent>=0)
+			{
+			if(nodes[parent].children[0]==aIndex)
+				nodes[parent].children[0]=upIndex;
+			else
+				nodes[parent].children[1]=upIndex;
+			}
+		else
+			root=upIndex;
+		
+		/* Make the node a child of its former child, and give it the shorter of the grandchildren: */
+		nodes[upIndex].children[0]=aIndex;
+		nodes[aIndex].parent=upIndex;
+		int keepIndex,moveIndex;
+		if(nodes[fIndex].height>nodes[gIndex].height)
+			{
+			keepIndex=fIndex;
+			moveIndex=gIndex;
+			}
+		else
+			{
+			keepIndex=gIndex;
+			moveIndex=fIndex;
+			}
+		nodes[upIndex].children[1]=keepIndex;
+		nodes[aIndex].children[up]=moveIndex;
+		nodes[moveIndex].parent=aIndex;
+		
+		/* Update the rotated nodes bottom-up: */
+		updateNode(aIndex);
+		updateNode(upIndex);
+		
+		return upIndex;
+		}
+	
+	return aIndex;
+	}
+
+void SketchObjectIndex::refit(int nodeIndex)
+	{
+	/* Walk up the tree, re-balancing and updating all nodes: */
+	while(nodeIndex>=0)
+		{
+		nodeIndex=balance(nodeIndex);
+		updateNode(nodeIndex);
+		nodeIndex=nodes[nodeIndex].parent;
+		}
+	}
+
+void SketchObjectIndex::insertLeaf(int leafIndex)
+	{
+	/* Check if the tree is empty: */
+	if(root<0)
+		{
+		root=leafIndex;
+		nodes[leafIndex].parent=-1;
+		return;
+		}
+	
+	/* Find the best sibling for the new leaf by descending the tree along the cheapest path: */
+	Rect leafRect=nodes[leafIndex].rect;
+	int siblingIndex=root;
+	while(!nodes[siblingIndex].isLeaf())
+		{
+		const Node& node=nodes[siblingIndex];
+		
+		/* Calculate the cost of creating a new parent for this node and the new leaf: */
+		Scalar combined=node.rect.join(leafRect).getPerimeter();
+		Scalar cost=Scalar(2)*combined;
+		
+		/* Calculate the minimum cost of pushing the leaf further down the tree: */
+		Scalar inheritanceCost=Scalar(2)*(combined-node.rect.getPerimeter());
+		Scalar childCosts[2];
+		for(int i=0;i<2;++i)
+			{
+			const Node& child=nodes[node.children[i]];
+			childCosts[i]=child.rect.join(leafRect).getPerimeter()+inheritanceCost;
+			if(!child.isLeaf())
+				childCosts[i]-=child.rect.getPerimeter();
+			}
+		
+		/* Stop descending if creating a parent here is cheapest: */
+		if(cost<childCosts[0]&&cost<childCosts[1])
+			break;
+		
+		/* Descend into the cheaper child: */
+		siblingIndex=node.children[childCosts[0]<=childCosts[1]?0:1];
+		}
+	
+	/* Create a new parent for the sibling and the new leaf: */
+	int oldParent=nodes[siblingIndex].parent;
+	int newParent=allocateNode();
+	Node& parent=nodes[newParent];
+	parent.parent=oldParent;
+	parent.children[0]=siblingIndex;
+	parent.children[1]=leafIndex;
+	nodes[siblingIndex].parent=newParent;
+	nodes[leafIndex].parent=newParent;
+	if(oldParent>=0)
+		{
+		if(nodes[oldParent].children[0]==siblingIndex)
+			nodes[oldParent].children[0]=newParent;
+		else
+			nodes[oldParent].children[1]=newParent;
+		}
+	else
+		root=newParent;
+	
+	/* Update all nodes from the new parent up to the root: */
+	refit(newParent);
+	}
+
+void SketchObjectIndex::removeLeaf(int leafIndex)
+	{
+	/* Check if the leaf is the root: */
+	if(leafIndex==root)
+		{
+		root=-1;
+		return;
+		}
+	
+	/* Replace the leaf's parent with the leaf's sibling: */
+	int parent=nodes[leafIndex].parent;
+	int grandParent=nodes[parent].parent;
+	int sibling=nodes[parent].children[0]==leafIndex?nodes[parent].children[1]:nodes[parent].children[0];
+	nodes[sibling].parent=grandParent;
+	if(grandParent>=0)
+		{
+		if(nodes[grandParent].children[0]==parent)
+			nodes[grandParent].children[0]=sibling;
+		else
+			nodes[grandParent].children[1]=sibling;
+		
+		/* Update all nodes from the grandparent up to the root: */
+		refit(grandParent);
+		}
+	else
+		root=sibling;
+	freeNode(parent);
+	
+	nodes[leafIndex].parent=-1;
+	}
+
+void SketchObjectIndex::collect(const Rect& rect,std::vector<SketchObject*>& objects) const
+	{
+	/* Traverse the tree using an explicit stack, which never holds more than one node per tree level plus one: */
+	std::vector<int> stack;
+	stack.reserve(nodes[root].height+2);
+	stack.push_back(root);
+	while(!stack.empty())
+		{
+		const Node& node=nodes[stack.back()];
+		stack.pop_back();
+		if(node.rect.overlaps(rect))
+			{
+			if(node.isLeaf())
+				objects.push_back(node.object);
+			else
+				{
+				stack.push_back(node.children[0]);
+				stack.push_back(node.children[1]);
+				}
+			}
+		}
+	}
+
+void SketchObjectIndex::addChange(const SketchObjectIndex::Rect& rect)
+	{
+	/* Store the rectangle in the ring buffer and advance the version number: */
+	changes[version%maxNumChanges]=rect;
+	++version;
+	}
+
+SketchObjectIndex::SketchObjectIndex(void)
+	:root(-1),freeNodes(-1),
+	 leafMap(17),
+	 version(0),clearVersion(0)
+	{
+	}
+
+void SketchObjectIndex::clear(void)
+	{
+	nodes.clear();
+	root=-1;
+	freeNodes=-1;
+	leafMap.clear();
+	
+	/* Invalidate all previously recorded changes: */
+	++version;
+	clearVersion=version;
+	}
+
+void SketchObjectIndex::insert(SketchObject* object)
+	{
+	/* Create a new leaf node for the object: */
+	int leafIndex=allocateNode();
+	nodes[leafIndex].rect=getRect(object);
+	nodes[leafIndex].object=object;
+	leafMap.setEntry(LeafMap::Entry(object,leafIndex));
+	
+	/* Insert the new leaf into the tree: */
+	insertLeaf(leafIndex);
+	
+	/* Record the change: */
+	addChange(nodes[leafIndex].rect);
+	}
+
+void SketchObjectIndex::remove(SketchObject* object)
+	{
+	/* Find the object's leaf node: */
+	LeafMap::Iterator lmIt=leafMap.findEntry(object);
+	if(!lmIt.isFinished())
+		{
+		/* Record the change: */
+		int leafIndex=lmIt->getDest();
+		addChange(nodes[leafIndex].rect);
+		
+		/* Remove and free the leaf node: */
+		removeLeaf(leafIndex);
+		freeNode(leafIndex);
+		leafMap.removeEntry(object);
+		}
+	}
+
+void SketchObjectIndex::update(SketchObject* object)
+	{
+	/* Find the object's leaf node: */
+	LeafMap::Iterator lmIt=leafMap.findEntry(object);
+	if(!lmIt.isFinished())
+		{
+		/* Record the change, covering the object's old and new extents: */
+		int leafIndex=lmIt->getDest();
+		Rect newRect=getRect(object);
+		const Rect& oldRect=nodes[leafIndex].rect;
+		addChange(oldRect.join(newRect));
+		
+		/* Check if the object's extent changed: */
+		if(newRect.min[0]!=oldRect.min[0]||newRect.min[1]!=oldRect.min[1]||newRect.max[0]!=oldRect.max[0]||newRect.max[1]!=oldRect.max[1])
+			{
+			/* Re-insert the leaf node with its new extent: */
+			removeLeaf(leafIndex);
+			nodes[leafIndex].rect=newRect;
+			insertLeaf(leafIndex);
+			}
+		}
+	}
+
+void SketchObjectIndex::touch(const SketchObject* object)
+	{
+	addChange(getRect(object));
+	}
+
+bool SketchObjectIndex::getChanges(unsigned int sinceVersion,Box& changedBox) const
+	{
+	/* Bail out if the index was cleared or too many changes were made since the given version: */
+	unsigned int numChanges=version-sinceVersion;
+	if(numChanges>version-clearVersion||numChanges>maxNumChanges)
+		return false;
+	
+	/* Join the rectangles of all changes made since the given version: */
+	changedBox=Box::empty;
+	if(numChanges>0U)
+		{
+		Rect rect=changes[sinceVersion%maxNumChanges];
+		for(unsigned int v=sinceVersion+1U;v!=version;++v)
+			rect=rect.join(changes[v%maxNumChanges]);
+		changedBox=Box(Point(rect.min[0],rect.min[1],Scalar(0)),Point(rect.max[0],rect.max[1],Scalar(0)));
+		}
+	
+	return true;
+	}
+
+void SketchObjectIndex::find(const Box& box,std::vector<SketchObject*>& objects) const
+	{
+	if(root>=0)
+		collect(getRect(box),objects);
+	}
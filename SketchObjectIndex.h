@@ -0,0 +1,131 @@
+/***********************************************************************
+SketchObjectIndex - Class for incrementally maintained spatial indices
+of sketch objects, based on a balanced tree of bounding rectangles in
+the sketching plane.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef SKETCHOBJECTINDEX_INCLUDED
+#define SKETCHOBJECTINDEX_INCLUDED
+
+#include <vector>
+#include <Misc/HashTable.h>
+
+#include "SketchGeometry.h"
+
+/* Forward declarations: */
+class SketchObject;
+
+class SketchObjectIndex
+	{
+	/* Embedded classes: */
+	private:
+	struct Rect // Structure for axis-aligned rectangles in the sketching plane
+		{
+		/* Elements: */
+		public:
+		Scalar min[2],max[2]; // Rectangle's lower-left and upper-right corners
+		
+		/* Methods: */
+		bool overlaps(const Rect& other) const // Returns true if the rectangle overlaps the given one
+			{
+			return min[0]<=other.max[0]&&max[0]>=other.min[0]&&min[1]<=other.max[1]&&max[1]>=other.min[1];
+			}
+		Rect join(const Rect& other) const // Returns the smallest rectangle containing the rectangle and the given one
+			{
+			Rect result;
+			for(int i=0;i<2;++i)
+				{
+				result.min[i]=min[i]<=other.min[i]?min[i]:other.min[i];
+				result.max[i]=max[i]>=other.max[i]?max[i]:other.max[i];
+				}
+			return result;
+			}
+		Scalar getPerimeter(void) const // Returns half the rectangle's perimeter as the cost metric for tree construction
+			{
+			return (max[0]-min[0])+(max[1]-min[1]);
+			}
+		};
+	
+	struct Node // Structure for tree nodes
+		{
+		/* Elements: */
+		public:
+		Rect rect; // Rectangle bounding the node's subtree
+		int parent; // Index of the node's parent, -1 for the root; index of next free node for unused nodes
+		int children[2]; // Indices of the node's children; -1 for leaf nodes
+		int height; // Height of the node's subtree; 0 for leaf nodes
+		SketchObject* object; // Object represented by a leaf node
+		
+		/* Methods: */
+		bool isLeaf(void) const // Returns true if the node is a leaf
+			{
+			return children[0]<0;
+			}
+		};
+	
+	typedef Misc::HashTable<SketchObject*,int> LeafMap; // Type for hash tables mapping indexed objects to their leaf nodes
+	
+	/* Elements: */
+	static const unsigned int maxNumChanges=64; // Number of most recent changes whose rectangles are remembered
+	std::vector<Node> nodes; // Array of tree nodes
+	int root; // Index of the tree's root node, or -1 for empty trees
+	int freeNodes; // Index of the first unused node, or -1
+	LeafMap leafMap; // Map from indexed objects to their leaf nodes
+	Rect changes[maxNumChanges]; // Ring buffer of rectangles covering the most recent changes, indexed by version number
+	unsigned int version; // Number of changes made to the index so far, wrapping around on overflow
+	unsigned int clearVersion; // Version number at which the index was last cleared
+	
+	/* Private methods: */
+	static Rect getRect(const SketchObject* object); // Returns the rectangle covering the given object's drawn extent
+	static Rect getRect(const Box& box); // Returns the projection of the given box into the sketching plane
+	int allocateNode(void); // Returns the index of an unused node
+	void freeNode(int nodeIndex); // Returns the given node to the free list
+	void updateNode(int nodeIndex); // Re-calculates the given interior node's rectangle and height from its children
+	int balance(int nodeIndex); // Re-balances the subtree rooted at the given node by rotation; returns index of new subtree root
+	void refit(int nodeIndex); // Re-fits and re-balances all nodes from the given node up to the root
+	void insertLeaf(int leafIndex); // Inserts the given leaf node into the tree
+	void removeLeaf(int leafIndex); // Removes the given leaf node from the tree
+	void collect(const Rect& rect,std::vector<SketchObject*>& objects) const; // Appends all objects overlapping the given rectangle to the given list
+	void addChange(const Rect& rect); // Records a change covering the given rectangle
+	
+	/* Constructors and destructors: */
+	public:
+	SketchObjectIndex(void); // Creates an empty index
+	
+	/* Methods: */
+	size_t getNumObjects(void) const // Returns the number of indexed objects
+		{
+		return leafMap.getNumEntries();
+		}
+	unsigned int getVersion(void) const // Returns the index's current version number, which changes whenever the drawn extent of any object changes
+		{
+		return version;
+		}
+	void clear(void); // Removes all objects from the index
+	void insert(SketchObject* object); // Adds the given object to the index
+	void remove(SketchObject* object); // Removes the given object from the index
+	void update(SketchObject* object); // Updates the index after the given object's bounding box, line width, or appearance changed
+	void touch(const SketchObject* object); // Records that the given object must be redrawn, e.g., after it moved in the drawing order, without changing the index
+	bool getChanges(unsigned int sinceVersion,Box& changedBox) const; // Sets the given box to the union of all extents changed since the given version; returns false if those changes are no longer known
+	void find(const Box& box,std::vector<SketchObject*>& objects) const; // Appends all objects whose drawn extents overlap the given box in the sketching plane to the given list, in no particular order
+	};
+
+#endif
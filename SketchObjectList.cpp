@@ -23,58 +23,331 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include "SketchObjectList.h"
 
+#include <algorithm>
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+struct OrderLess // Functor to sort sketch objects by list order
+	{
+	/* Methods: */
+	bool operator()(const SketchObject* obj1,const SketchObject* obj2) const
+		{
+		return SketchObjectList::isBefore(obj1,obj2);
+		}
+	};
+
+}
+
 /*********************************
 Methods of class SketchObjectList:
 *********************************/
 
-SketchObjectList::~SketchObjectList(void)
+void SketchObjectList::assignSlots(SketchObjectChunk* chunk,unsigned int firstSlot)
 	{
-	/* Destroy all sketch objects: */
-	while(head!=0)
+	for(unsigned int slot=firstSlot;slot<chunk->objects.size();++slot)
 		{
-		SketchObject* succ=head->succ;
-		delete head;
-		head=succ;
+		chunk->objects[slot]->chunk=chunk;
+		chunk->objects[slot]->slot=slot;
 		}
 	}
 
-size_t SketchObjectList::size(void) const
+void SketchObjectList::addCount(size_t chunkIndex,size_t increment)
 	{
+	/* Update all Fenwick tree nodes whose ranges contain the chunk: */
+	for(size_t node=chunkIndex+1U;node<=chunkCounts.size();node+=node&(~node+1U))
+		chunkCounts[node-1U]+=increment;
+	}
+
+size_t SketchObjectList::getCount(size_t numPositions) const
+	{
+	/* Add up the Fenwick tree nodes covering the given prefix of the array: */
 	size_t result=0;
-	for(const SketchObject* soPtr=head;soPtr!=0;soPtr=soPtr->succ)
-		++result;
+	for(size_t node=numPositions;node>0U;node&=node-1U)
+		result+=chunkCounts[node-1U];
 	return result;
 	}
 
-void SketchObjectList::clear(void)
+void SketchObjectList::appendGap(void)
+	{
+	/* Initialize the new Fenwick tree node with the number of sketch objects in the range of array positions it covers: */
+	size_t node=chunks.size()+1U;
+	size_t count=getCount(node-1U)-getCount(node-(node&(~node+1U)));
+	chunks.push_back(0);
+	chunkCounts.push_back(count);
+	}
+
+void SketchObjectList::placeChunk(SketchObjectChunk* chunk,size_t chunkIndex)
+	{
+	chunks[chunkIndex]=chunk;
+	chunk->index=chunkIndex;
+	addCount(chunkIndex,chunk->objects.size());
+	}
+
+void SketchObjectList::moveChunk(size_t fromIndex,size_t toIndex)
+	{
+	SketchObjectChunk* chunk=chunks[fromIndex];
+	chunks[fromIndex]=0;
+	addCount(fromIndex,size_t(0)-chunk->objects.size());
+	placeChunk(chunk,toIndex);
+	}
+
+void SketchObjectList::removeChunk(SketchObjectChunk* chunk)
+	{
+	/* Unlink the chunk from its neighbors: */
+	if(chunk->pred!=0)
+		chunk->pred->succ=chunk->succ;
+	else
+		firstChunk=chunk->succ;
+	if(chunk->succ!=0)
+		chunk->succ->pred=chunk->pred;
+	else
+		lastChunk=chunk->pred;
+	
+	/* Leave a gap in the chunk's place: */
+	addCount(chunk->index,size_t(0)-chunk->objects.size());
+	chunks[chunk->index]=0;
+	delete chunk;
+	--numChunks;
+	
+	/* Compact the array of chunks if it became sparse: */
+	if(chunks.size()>numChunks*4U)
+		renumberChunks();
+	}
+
+void SketchObjectList::renumberChunks(void)
+	{
+	/* Place all chunks into every other array position in list order: */
+	chunks.assign(numChunks*2U,0);
+	size_t index=0;
+	for(SketchObjectChunk* chunk=firstChunk;chunk!=0;chunk=chunk->succ,index+=2U)
+		{
+		chunks[index]=chunk;
+		chunk->index=index;
+		}
+	
+	/* Rebuild the Fenwick tree in linear time by adding each node to its parent: */
+	size_t numPositions=chunks.size();
+	chunkCounts.assign(numPositions,0);
+	for(size_t i=0;i<numPositions;++i)
+		if(chunks[i]!=0)
+			chunkCounts[i]=chunks[i]->objects.size();
+	for(size_t node=1U;node<=numPositions;++node)
+		{
+		size_t parent=node+(node&(~node+1U));
+		if(parent<=numPositions)
+			chunkCounts[parent-1U]+=chunkCounts[node-1U];
+		}
+	}
+
+void SketchObjectList::insert(SketchObjectChunk* chunk,unsigned int slot,SketchObject* newObject)
+	{
+	/* Insert the sketch object into the chunk: */
+	chunk->objects.insert(chunk->objects.begin()+slot,newObject);
+	assignSlots(chunk,slot);
+	addCount(chunk->index,1U);
+	++numObjects;
+	
+	if(chunk->objects.size()>maxChunkSize)
+		{
+		/* Split the chunk in half: */
+		SketchObjectChunk* newChunk=new SketchObjectChunk;
+		std::vector<SketchObject*>::iterator splitIt=chunk->objects.begin()+maxChunkSize/2U;
+		newChunk->objects.assign(splitIt,chunk->objects.end());
+		chunk->objects.erase(splitIt,chunk->objects.end());
+		assignSlots(newChunk,0);
+		addCount(chunk->index,size_t(0)-newChunk->objects.size());
+		
+		/* Link the new chunk behind the split chunk: */
+		newChunk->pred=chunk;
+		newChunk->succ=chunk->succ;
+		if(chunk->succ!=0)
+			chunk->succ->pred=newChunk;
+		else
+			lastChunk=newChunk;
+		chunk->succ=newChunk;
+		++numChunks;
+		
+		/* Find the closest gap behind the split chunk, growing the array at its end: */
+		size_t gap=chunk->index+1U;
+		for(;gap<=chunk->index+maxShiftDistance;++gap)
+			{
+			if(gap==chunks.size())
+				appendGap();
+			if(chunks[gap]==0)
+				break;
+			}
+		if(gap<=chunk->index+maxShiftDistance)
+			{
+			/* Shift the chunks between the split chunk and the gap back by one position, and place the new chunk behind the split chunk: */
+			for(;gap>chunk->index+1U;--gap)
+				moveChunk(gap-1U,gap);
+			placeChunk(newChunk,gap);
+			}
+		else
+			{
+			/* Re-number all chunks to open new gaps: */
+			renumberChunks();
+			}
+		}
+	}
+
+void SketchObjectList::unlink(SketchObject* obj)
+	{
+	/* Remove the sketch object from its chunk: */
+	SketchObjectChunk* chunk=obj->chunk;
+	chunk->objects.erase(chunk->objects.begin()+obj->slot);
+	assignSlots(chunk,obj->slot);
+	addCount(chunk->index,~size_t(0));
+	--numObjects;
+	
+	/* Convert the sketch object to a singleton: */
+	obj->chunk=0;
+	obj->slot=0;
+	
+	SketchObjectChunk* succ=chunk->succ;
+	if(chunk->objects.empty())
+		{
+		/* Remove the empty chunk: */
+		removeChunk(chunk);
+		}
+	else if(succ!=0&&chunk->objects.size()+succ->objects.size()<=maxChunkSize/2U)
+		{
+		/* Merge the chunk's successor into the chunk to keep the list from fragmenting: */
+		unsigned int firstSlot=chunk->objects.size();
+		chunk->objects.insert(chunk->objects.end(),succ->objects.begin(),succ->objects.end());
+		assignSlots(chunk,firstSlot);
+		addCount(chunk->index,succ->objects.size());
+		removeChunk(succ);
+		}
+	}
+
+SketchObjectList::~SketchObjectList(void)
 	{
 	/* Destroy all sketch objects: */
-	while(head!=0)
+	clear();
+	}
+
+void SketchObjectList::clear(void)
+	{
+	/* Destroy all sketch objects and chunks: */
+	while(firstChunk!=0)
 		{
-		SketchObject* succ=head->succ;
-		delete head;
-		head=succ;
+		SketchObjectChunk* succ=firstChunk->succ;
+		for(std::vector<SketchObject*>::iterator oIt=firstChunk->objects.begin();oIt!=firstChunk->objects.end();++oIt)
+			delete *oIt;
+		delete firstChunk;
+		firstChunk=succ;
 		}
 	
 	/* Clear the list: */
-	tail=0;
+	chunks.clear();
+	chunkCounts.clear();
+	lastChunk=0;
+	numChunks=0;
+	numObjects=0;
 	}
 
-void SketchObjectList::transfer(SketchObjectList& other)
+SketchObjectList& SketchObjectList::insert(const SketchObjectList::iterator& insertIt,SketchObject* newObject)
+	{
+	if(insertIt.obj!=0)
+		{
+		/* Insert the sketch object in front of the iterated object: */
+		insert(insertIt.obj->chunk,insertIt.obj->slot,newObject);
+		}
+	else
+		{
+		/* Create the first chunk if the list is empty: */
+		if(lastChunk==0)
+			{
+			firstChunk=lastChunk=new SketchObjectChunk;
+			firstChunk->pred=0;
+			firstChunk->succ=0;
+			numChunks=1;
+			renumberChunks();
+			}
+		
+		/* Append the sketch object to the last chunk: */
+		insert(lastChunk,lastChunk->objects.size(),newObject);
+		}
+	
+	return *this;
+	}
+
+void SketchObjectList::transfer(SketchObjectList& receiver)
 	{
 	/* Bail out if the list is empty: */
-	if(head==0)
+	if(firstChunk==0)
 		return;
 	
-	/* Append the head of this list to the tail of the other list: */
-	if(other.tail!=0)
-		other.tail->succ=head;
-	else
-		other.head=head;
-	head->pred=other.tail;
-	other.tail=tail;
+	/* Append this list's chunks to the other list: */
+	receiver.numObjects+=numObjects;
+	SketchObjectChunk* last=receiver.lastChunk;
+	if(last!=0&&last->objects.size()+firstChunk->objects.size()<=maxChunkSize)
+		{
+		/* Merge the first transferred chunk into the other list's last chunk, so that transferring small lists does not fragment the other list: */
+		SketchObjectChunk* first=firstChunk;
+		unsigned int firstSlot=last->objects.size();
+		last->objects.insert(last->objects.end(),first->objects.begin(),first->objects.end());
+		assignSlots(last,firstSlot);
+		firstChunk=first->succ;
+		delete first;
+		--numChunks;
+		}
+	if(firstChunk!=0)
+		{
+		/* Link the remaining chunks behind the other list's last chunk: */
+		firstChunk->pred=last;
+		if(last!=0)
+			last->succ=firstChunk;
+		else
+			receiver.firstChunk=firstChunk;
+		receiver.lastChunk=lastChunk;
+		}
+	receiver.numChunks+=numChunks;
+	receiver.renumberChunks();
 	
 	/* Clear this list: */
-	head=0;
-	tail=0;
+	chunks.clear();
+	chunkCounts.clear();
+	firstChunk=0;
+	lastChunk=0;
+	numChunks=0;
+	numObjects=0;
+	}
+
+size_t SketchObjectList::getIndex(const SketchObject* obj) const
+	{
+	/* Add the numbers of sketch objects in all preceding chunks to the object's slot index: */
+	return getCount(obj->chunk->index)+obj->slot;
+	}
+
+SketchObject* SketchObjectList::getObject(size_t index) const
+	{
+	/* Bail out if the index is out of range: */
+	if(index>=numObjects)
+		return 0;
+	
+	/* Descend the Fenwick tree to find the number of array positions preceding the chunk containing the index, skipping gaps as they contain no sketch objects: */
+	size_t numPositions=chunkCounts.size();
+	size_t step=1U;
+	while(step<=numPositions/2U)
+		step<<=1;
+	size_t chunkIndex=0;
+	for(;step>0U;step>>=1)
+		if(chunkIndex+step<=numPositions&&chunkCounts[chunkIndex+step-1U]<=index)
+			{
+			chunkIndex+=step;
+			index-=chunkCounts[chunkIndex-1U];
+			}
+	
+	return chunks[chunkIndex]->objects[index];
+	}
+
+void SketchObjectList::sort(std::vector<SketchObject*>& objects)
+	{
+	std::sort(objects.begin(),objects.end(),OrderLess());
 	}
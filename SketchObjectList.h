@@ -24,8 +24,22 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef SKETCHOBJECTLIST_INCLUDED
 #define SKETCHOBJECTLIST_INCLUDED
 
+#include <vector>
+
 #include "SketchObject.h"
 
+class SketchObjectChunk // Class for runs of consecutive sketch objects in a list, stored contiguously
+	{
+	friend class SketchObjectList;
+	
+	/* Elements: */
+	private:
+	SketchObjectChunk* pred; // Pointer to the previous chunk in the list, or null
+	SketchObjectChunk* succ; // Pointer to the next chunk in the list, or null
+	size_t index; // Position of the chunk in its list's array of chunks, which increases along the list but can skip gaps
+	std::vector<SketchObject*> objects; // The chunk's sketch objects in list order
+	};
+
 class SketchObjectList
 	{
 	/* Embedded classes: */
@@ -72,7 +86,7 @@ class SketchObjectList
 		iterator& operator++(void)
 			{
 			if(obj!=0)
-				obj=obj->succ;
+				obj=getSucc(obj);
 			return *this;
 			}
 		};
@@ -121,7 +135,7 @@ class SketchObjectList
 		const_iterator& operator++(void)
 			{
 			if(obj!=0)
-				obj=obj->succ;
+				obj=getSucc(obj);
 			return *this;
 			}
 		};
@@ -165,34 +179,47 @@ class SketchObjectList
 		reverse_iterator& operator++(void)
 			{
 			if(obj!=0)
-				obj=obj->pred;
+				obj=getPred(obj);
 			return *this;
 			}
 		};
 	
 	/* Elements: */
 	private:
-	SketchObject* head; // Pointer to first sketch object in list or 0 for empty list
-	SketchObject* tail; // Pointer to last sketch object in list or 0 for empty list
+	static const unsigned int maxChunkSize=256; // Maximum number of sketch objects in a chunk
+	static const unsigned int prefetchDistance=4; // Number of sketch objects to prefetch ahead of the current one during list traversals
+	static const size_t maxShiftDistance=16; // Maximum number of chunks shifted back to make room for a split chunk before all chunks are re-numbered
+	std::vector<SketchObjectChunk*> chunks; // Array of chunks in list order, with null gaps to add split chunks without re-numbering all following chunks
+	std::vector<size_t> chunkCounts; // Fenwick tree over the numbers of sketch objects in all array positions, to convert between sketch objects and their indices
+	SketchObjectChunk* firstChunk; // Pointer to the first chunk in the list, or null
+	SketchObjectChunk* lastChunk; // Pointer to the last chunk in the list, or null
+	size_t numChunks; // Number of chunks in the list
+	size_t numObjects; // Number of sketch objects in the list
 	
 	/* Private methods: */
-	void unlink(SketchObject* obj) // Removes the given sketch object from the list
+	static SketchObject* getPred(const SketchObject* obj) // Returns the predecessor of the given sketch object in its list, or null if the object is the first one
 		{
-		/* Unlink the sketch object from the list: */
-		if(obj->pred!=0)
-			obj->pred->succ=obj->succ;
-		else
-			head=obj->succ;
-		if(obj->succ!=0)
-			obj->succ->pred=obj->pred;
+		const SketchObjectChunk* chunk=obj->chunk;
+		if(obj->slot>0U)
+			return chunk->objects[obj->slot-1];
 		else
-			tail=obj->pred;
+			return chunk->pred!=0?chunk->pred->objects.back():0;
 		}
+	static void assignSlots(SketchObjectChunk* chunk,unsigned int firstSlot); // Assigns the given chunk and its slot indices to all sketch objects in the chunk starting from the given slot
+	void addCount(size_t chunkIndex,size_t increment); // Adds the given increment, modulo the range of size_t, to the number of sketch objects in the given array position
+	size_t getCount(size_t numPositions) const; // Returns the total number of sketch objects in the given number of array positions from the front of the array
+	void appendGap(void); // Appends a gap to the end of the array of chunks
+	void placeChunk(SketchObjectChunk* chunk,size_t chunkIndex); // Places the given chunk into the given gap in the array of chunks
+	void moveChunk(size_t fromIndex,size_t toIndex); // Moves the chunk at the first array position into the gap at the second array position
+	void removeChunk(SketchObjectChunk* chunk); // Unlinks the given chunk from the list, leaves a gap in its place, and deletes it
+	void renumberChunks(void); // Re-numbers all chunks in list order leaving a gap behind each one, and rebuilds the Fenwick tree
+	void insert(SketchObjectChunk* chunk,unsigned int slot,SketchObject* newObject); // Inserts the given sketch object into the given chunk in front of the given slot
+	void unlink(SketchObject* obj); // Removes the given sketch object from the list
 	
 	/* Constructors and destructors: */
 	public:
 	SketchObjectList(void) // Creates an empty list
-		:head(0),tail(0)
+		:firstChunk(0),lastChunk(0),numChunks(0),numObjects(0)
 		{
 		}
 	private:
@@ -204,16 +231,19 @@ class SketchObjectList
 	/* Methods: */
 	bool empty(void) const // Returns true if the list is empty
 		{
-		return head==0;
+		return numObjects==0;
+		}
+	size_t size(void) const // Returns number of elements in list
+		{
+		return numObjects;
 		}
-	size_t size(void) const; // Returns number of elements in list; slow
 	const_iterator begin(void) const // Returns a constant iterator to the first list element
 		{
-		return const_iterator(head);
+		return const_iterator(firstChunk!=0?firstChunk->objects.front():0);
 		}
 	iterator begin(void) // Returns a regular iterator to the first list element
 		{
-		return iterator(head);
+		return iterator(firstChunk!=0?firstChunk->objects.front():0);
 		}
 	const_iterator end(void) const // Returns a constant iterator to behind the last element
 		{
@@ -225,7 +255,7 @@ class SketchObjectList
 		}
 	reverse_iterator rbegin(void) // Returns a reverse iterator to the last list element
 		{
-		return reverse_iterator(tail);
+		return reverse_iterator(lastChunk!=0?lastChunk->objects.back():0);
 		}
 	reverse_iterator rend(void) const // Returns a reverse iterator to before the first element
 		{
@@ -234,33 +264,10 @@ class SketchObjectList
 	void clear(void); // Clears the list and destroys all sketch objects
 	SketchObjectList& push_back(SketchObject* newObject) // Appends the given sketch object to the end of the list
 		{
-		if(tail!=0)
-			tail->succ=newObject;
-		else
-			head=newObject;
-		newObject->pred=tail;
-		tail=newObject;
-		return *this;
-		}
-	SketchObjectList& insert(const iterator& insertIt,SketchObject* newObject) // Inserts the given sketch object before the given iterator
-		{
-		if(insertIt.obj!=0)
-			{
-			newObject->pred=insertIt.obj->pred;
-			newObject->succ=insertIt.obj;
-			}
-		else
-			newObject->pred=tail;
-		if(newObject->pred!=0)
-			newObject->pred->succ=newObject;
-		else
-			head=newObject;
-		if(newObject->succ!=0)
-			newObject->succ->pred=newObject;
-		else
-			tail=newObject;
+		insert(end(),newObject);
 		return *this;
 		}
+	SketchObjectList& insert(const iterator& insertIt,SketchObject* newObject); // Inserts the given sketch object before the given iterator
 	SketchObjectList& erase(const iterator& eraseIt) // Removes the iterated sketch object from the list and destroys it
 		{
 		/* Unlink the sketch object from the list: */
@@ -286,10 +293,6 @@ class SketchObjectList
 		/* Unlink the sketch object from the list: */
 		unlink(unlinkIt.obj);
 		
-		/* Convert the sketch object to a singleton and return it: */
-		unlinkIt.obj->pred=0;
-		unlinkIt.obj->succ=0;
-		
 		return unlinkIt.obj;
 		}
 	SketchObject* unlink(const reverse_iterator& unlinkIt) // Removes the iterated object from the list and returns it as a singleton
@@ -297,13 +300,30 @@ class SketchObjectList
 		/* Unlink the sketch object from the list: */
 		unlink(unlinkIt.obj);
 		
-		/* Convert the sketch object to a singleton and return it: */
-		unlinkIt.obj->pred=0;
-		unlinkIt.obj->succ=0;
-		
 		return unlinkIt.obj;
 		}
 	void transfer(SketchObjectList& receiver); // Transfers all list objects from this list to the end of the given list; clears list
+	size_t getIndex(const SketchObject* obj) const; // Returns the index of the given sketch object, which must be a member of this list, counted from the front of the list
+	SketchObject* getObject(size_t index) const; // Returns the sketch object of the given index counted from the front of the list, or null if the index is out of range
+	static bool isBefore(const SketchObject* obj1,const SketchObject* obj2) // Returns true if the first sketch object is closer to the front of their common list than the second
+		{
+		return obj1->chunk!=obj2->chunk?obj1->chunk->index<obj2->chunk->index:obj1->slot<obj2->slot;
+		}
+	static SketchObject* getSucc(const SketchObject* obj) // Returns the successor of the given sketch object in its list, or null if the object is the last one
+		{
+		const SketchObjectChunk* chunk=obj->chunk;
+		unsigned int succSlot=obj->slot+1U;
+		#ifdef __GNUC__
+		/* Prefetch a sketch object a few steps ahead to hide memory latency during list traversals: */
+		if(succSlot+prefetchDistance<chunk->objects.size())
+			__builtin_prefetch(chunk->objects[succSlot+prefetchDistance]);
+		#endif
+		if(succSlot<chunk->objects.size())
+			return chunk->objects[succSlot];
+		else
+			return chunk->succ!=0?chunk->succ->objects.front():0;
+		}
+	static void sort(std::vector<SketchObject*>& objects); // Sorts the given sketch objects, which must be members of the same list, into list order
 	};
 
 #endif
@@ -23,10 +23,14 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include "SketchPad.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <Misc/SizedTypes.h>
 #include <Misc/MessageLogger.h>
 #include <IO/File.h>
-#include <IO/OpenFile.h>
+#include <Cluster/MulticastPipe.h>
 #include <Geometry/HVector.h>
 #include <Geometry/OrthogonalTransformation.h>
 #include <Geometry/LinearUnit.h>
@@ -41,50 +45,84 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <GLMotif/PopupWindow.h>
 #include <GLMotif/RowColumn.h>
 #include <GLMotif/Label.h>
+#include <GLMotif/TextField.h>
 #include <GLMotif/Button.h>
 #include <GLMotif/CascadeButton.h>
 #include <Vrui/Vrui.h>
+#include <Vrui/OpenFile.h>
 #include <Vrui/CoordinateManager.h>
 #include <Vrui/GenericAbstractToolFactory.h>
 #include <Vrui/ToolManager.h>
 #include <Vrui/DisplayState.h>
 
+#include "Stats.h"
 #include "RenderState.h"
 #include "SketchObject.h"
 #include "Curve.h"
 #include "Image.h"
+#include "ImageRenderer.h"
 #include "PaintBucket.h"
 #include "SketchPadTool.h"
 #include "SketchTool.h"
 #include "EraseTool.h"
 #include "SelectTool.h"
+#include "SketchFileWorker.h"
+#include "ImageFileWorker.h"
+#include "SketchJournal.h"
+#include "SketchCollaboration.h"
+#include "SketchBoard.h"
+#include "SketchExporter.h"
+#include "WorkerPool.h"
 
 /**************************
 Methods of class SketchPad:
 **************************/
 
+void SketchPad::installSketchObjects(SketchObjectList& newSketchObjects)
+	{
+	/* Finish reading all new sketch objects: */
+	for(SketchObjectList::iterator soIt=newSketchObjects.begin();soIt!=newSketchObjects.end();++soIt)
+		soIt->finishRead();
+	
+	/* Replace the current sketch object list with the new one, which also clears the selection: */
+	settings.setSketchObjects(newSketchObjects);
+	}
+
+bool SketchPad::checkFileWorker(const char* operationName,const std::string& fileName)
+	{
+	if(fileWorker!=0)
+		{
+		/* Show an error message: */
+		Misc::formattedUserError("%s: Could not access file %s because file %s is still being %s",operationName,fileName.c_str(),fileWorker->getFileName().c_str(),fileWorker->getOperation()==SketchFileWorker::Load?"loaded":"saved");
+		return false;
+		}
+	
+	return true;
+	}
+
 void SketchPad::loadSketchFile(GLMotif::FileSelectionDialog::OKCallbackData* cbData)
 	{
+	/* Bail out if another sketch file operation is still in progress: */
+	if(!checkFileWorker("Load Sketch File",cbData->getSelectedPath()))
+		return;
+	
+	/* Bail out if a paged board is open, as replacing all resident sketch objects would erase the board's tiles: */
+	if(board!=0)
+		{
+		Misc::formattedUserError("Load Sketch File: Could not load file %s because board %s is open",cbData->getSelectedPath().c_str(),board->getDirectoryName().c_str());
+		return;
+		}
+	
 	try
 		{
 		/* Open the selected file: */
 		IO::FilePtr file=cbData->selectedDirectory->openFile(cbData->selectedFileName);
 		file->setEndianness(Misc::LittleEndian);
 		
-		/* Read the number of sketch objects in the file: */
-		size_t numSketchObjects=file->read<Misc::UInt32>();
-		
-		/* Read all sketch objects contained in the file: */
-		SketchObjectList newSketchObjects;
-		for(size_t i=0;i<numSketchObjects;++i)
-			newSketchObjects.push_back(objectCreator.readObject(*file));
-		
-		/* Replace the current sketch object list with the newly-loaded one: */
-		settings.getSketchObjects().clear();
-		newSketchObjects.transfer(settings.getSketchObjects());
-		
-		/* Clear the selection: */
-		settings.selectNone();
+		/* Read all sketch objects contained in the file in the background; they will be installed in a later frame: */
+		fileWorker=new SketchFileWorker(cbData->getSelectedPath(),file);
+		updateFileProgress();
+		Vrui::popupPrimaryWidget(fileProgressDialog);
 		}
 	catch(const std::runtime_error& err)
 		{
@@ -95,19 +133,20 @@ void SketchPad::loadSketchFile(GLMotif::FileSelectionDialog::OKCallbackData* cbD
 
 void SketchPad::saveSketchFile(GLMotif::FileSelectionDialog::OKCallbackData* cbData)
 	{
+	/* Bail out if another sketch file operation is still in progress: */
+	if(!checkFileWorker("Save Sketch File",cbData->getSelectedPath()))
+		return;
+	
 	try
 		{
 		/* Open the selected file: */
 		IO::FilePtr file=cbData->selectedDirectory->openFile(cbData->selectedFileName,IO::File::WriteOnly);
 		file->setEndianness(Misc::LittleEndian);
 		
-		/* Write the number of sketch objects: */
-		const SketchObjectList& sos=settings.getSketchObjects();
-		file->write<Misc::UInt32>(sos.size());
-		
-		/* Write all sketch objects: */
-		for(SketchObjectList::const_iterator soIt=sos.begin();soIt!=sos.end();++soIt)
-			objectCreator.writeObject(&*soIt,*file);
+		/* Take a snapshot of all sketch objects and write it to the file in the background: */
+		fileWorker=new SketchFileWorker(cbData->getSelectedPath(),file,objectCreator,settings.getSketchObjects(),pointEncoding);
+		updateFileProgress();
+		Vrui::popupPrimaryWidget(fileProgressDialog);
 		}
 	catch(const std::runtime_error& err)
 		{
@@ -118,17 +157,20 @@ void SketchPad::saveSketchFile(GLMotif::FileSelectionDialog::OKCallbackData* cbD
 
 void SketchPad::loadImage(GLMotif::FileSelectionDialog::OKCallbackData* cbData)
 	{
+	/* Bail out if another image is still being loaded: */
+	if(imageWorker!=0)
+		{
+		Misc::formattedUserError("Load Image: Could not load image %s because image %s is still being loaded",cbData->getSelectedPath().c_str(),imageWorker->getFileName().c_str());
+		return;
+		}
+	
 	try
 		{
 		/* Open the selected file: */
 		IO::FilePtr file=cbData->selectedDirectory->openFile(cbData->selectedFileName);
 		
-		/* Create a sketch object factory for the selected image file: */
-		delete nextSketchFactory;
-		nextSketchFactory=new ImageFactory(settings,cbData->getSelectedPath().c_str(),*file);
-		
-		/* Invalidate all current sketch object factories: */
-		++sketchFactoryVersion;
+		/* Read and decode the image in the background; the sketch object factory will be created in a later frame: */
+		imageWorker=new ImageFileWorker(cbData->getSelectedPath(),file);
 		}
 	catch(const std::runtime_error& err)
 		{
@@ -137,6 +179,53 @@ void SketchPad::loadImage(GLMotif::FileSelectionDialog::OKCallbackData* cbData)
 		}
 	}
 
+void SketchPad::exportSketch(GLMotif::FileSelectionDialog::OKCallbackData* cbData)
+	{
+	/* Bail out if another export is still in progress: */
+	if(exporter!=0)
+		{
+		Misc::formattedUserError("Export Sketch: Could not export to file %s because file %s is still being exported",cbData->getSelectedPath().c_str(),exporter->getFileName().c_str());
+		return;
+		}
+	
+	/* Select the export format from the file name's extension: */
+	SketchExporter::Format format;
+	if(!SketchExporter::getFormat(cbData->getSelectedPath(),format))
+		{
+		Misc::formattedUserError("Export Sketch: Could not export to file %s because its format is not supported",cbData->getSelectedPath().c_str());
+		return;
+		}
+	
+	/* Only the head node in a cluster writes the export file: */
+	if(!Vrui::isHeadNode())
+		return;
+	
+	try
+		{
+		/* Open the selected file: */
+		IO::FilePtr file=cbData->selectedDirectory->openFile(cbData->selectedFileName,IO::File::WriteOnly);
+		
+		/* Export all sketch objects in the background; raster images are rendered tile by tile during the following frames: */
+		exporter=new SketchExporter(cbData->getSelectedPath(),file,format,settings,exportSize,workerPool);
+		}
+	catch(const std::runtime_error& err)
+		{
+		/* Show an error message: */
+		Misc::formattedUserError("Export Sketch: Could not export to file %s due to exception %s",cbData->getSelectedPath().c_str(),err.what());
+		}
+	}
+
+void SketchPad::applySettingsToSelection(void)
+	{
+	/* Bail out if nothing is selected, so that changing settings does not journal no-op edits: */
+	if(!settings.hasSelection())
+		return;
+	
+	if(journal!=0)
+		journal->selectionOperation(SketchJournal::ApplySettingsToSelection);
+	settings.applySettingsToSelection();
+	}
+
 GLMotif::PopupMenu* SketchPad::createFileMenu(void)
 	{
 	/* Create the submenu's top-level shell: */
@@ -153,6 +242,11 @@ GLMotif::PopupMenu* SketchPad::createFileMenu(void)
 	GLMotif::Button* loadImageButton=new GLMotif::Button("LoadImageButton",fileMenuPopup,"Load Image...");
 	imageHelper.addLoadCallback(loadImageButton,Misc::createFunctionCall(this,&SketchPad::loadImage));
 	
+	fileMenuPopup->addSeparator();
+	
+	GLMotif::Button* exportSketchButton=new GLMotif::Button("ExportSketchButton",fileMenuPopup,"Export Sketch...");
+	exportHelper.addSaveCallback(exportSketchButton,Misc::createFunctionCall(this,&SketchPad::exportSketch));
+	
 	fileMenuPopup->manageMenu();
 	return fileMenuPopup;
 	}
@@ -184,8 +278,23 @@ GLMotif::PopupMenu* SketchPad::createSelectMenu(void)
 	return selectMenuPopup;
 	}
 
+void SketchPad::undoSelected(Misc::CallbackData*)
+	{
+	/* Undo the most recent edit; the sketch settings journal the resulting changes: */
+	settings.undo();
+	}
+
+void SketchPad::redoSelected(Misc::CallbackData*)
+	{
+	/* Redo the most recently undone edit: */
+	settings.redo();
+	}
+
 void SketchPad::cloneSelectionSelected(Misc::CallbackData*)
 	{
+	if(journal!=0)
+		journal->selectionOperation(SketchJournal::CloneSelection);
+	
 	/* Clone all selected objects and make them the new selection: */
 	settings.cloneSelection();
 	}
@@ -193,39 +302,57 @@ void SketchPad::cloneSelectionSelected(Misc::CallbackData*)
 void SketchPad::applySettingsSelected(Misc::CallbackData*)
 	{
 	/* Apply the current settings to all selected objects: */
-	settings.applySettingsToSelection();
+	applySettingsToSelection();
 	}
 
 void SketchPad::snapSelectionToGridSelected(Misc::CallbackData*)
 	{
+	if(journal!=0)
+		journal->selectionOperation(SketchJournal::SnapSelectionToGrid);
+	
 	/* Snap all selected objects to the drawing grid: */
 	settings.snapSelectedObjectsToGrid();
 	}
 
 void SketchPad::groupSelectionSelected(Misc::CallbackData*)
 	{
+	if(journal!=0)
+		journal->selectionOperation(SketchJournal::GroupSelection);
+	
 	/* Make a group out of all selected objects: */
 	settings.groupSelection();
 	}
 
 void SketchPad::ungroupSelectionSelected(Misc::CallbackData*)
 	{
+	if(journal!=0)
+		journal->selectionOperation(SketchJournal::UngroupSelection);
+	
 	/* Break open all selected group objects: */
 	settings.ungroupSelection();
 	}
 
 void SketchPad::selectionToBackSelected(Misc::CallbackData*)
 	{
+	if(journal!=0)
+		journal->selectionOperation(SketchJournal::SelectionToBack);
+	
 	settings.selectionToBack();
 	}
 
 void SketchPad::selectionToFrontSelected(Misc::CallbackData*)
 	{
+	if(journal!=0)
+		journal->selectionOperation(SketchJournal::SelectionToFront);
+	
 	settings.selectionToFront();
 	}
 
 void SketchPad::deleteSelectionSelected(Misc::CallbackData*)
 	{
+	if(journal!=0)
+		journal->selectionOperation(SketchJournal::DeleteSelection);
+	
 	/* Delete all selected objects: */
 	settings.deleteSelection();
 	}
@@ -235,6 +362,14 @@ GLMotif::PopupMenu* SketchPad::createEditMenu(void)
 	/* Create the submenu's top-level shell: */
 	GLMotif::PopupMenu* editMenuPopup=new GLMotif::PopupMenu("EditMenuPopup",Vrui::getWidgetManager());
 	
+	GLMotif::Button* undoButton=new GLMotif::Button("UndoButton",editMenuPopup,"Undo");
+	undoButton->getSelectCallbacks().add(this,&SketchPad::undoSelected);
+	
+	GLMotif::Button* redoButton=new GLMotif::Button("RedoButton",editMenuPopup,"Redo");
+	redoButton->getSelectCallbacks().add(this,&SketchPad::redoSelected);
+	
+	editMenuPopup->addSeparator();
+	
 	GLMotif::Button* cloneSelectionButton=new GLMotif::Button("CloneSelectionButton",editMenuPopup,"Clone");
 	cloneSelectionButton->getSelectCallbacks().add(this,&SketchPad::cloneSelectionSelected);
 	
@@ -297,10 +432,26 @@ GLMotif::PopupMenu* SketchPad::createMainMenu(void)
 	gridToggle->setToggle(settings.getGridEnabled());
 	gridToggle->getValueChangedCallbacks().add(this,&SketchPad::gridToggleValueChanged);
 	
+	#if SKETCHPAD_CONFIG_STATS
+	/* Create a toggle button for the statistics window: */
+	statsToggle=new GLMotif::ToggleButton("StatsToggle",mainMenuPopup,"Show Statistics");
+	statsToggle->setToggle(false);
+	statsToggle->getValueChangedCallbacks().add(this,&SketchPad::statsToggleValueChanged);
+	#endif
+	
 	mainMenuPopup->manageMenu();
 	return mainMenuPopup;
 	}
 
+void SketchPad::settingsDraggingCallback(GLMotif::DragWidget::DraggingCallbackData* cbData)
+	{
+	/* Apply all settings changes during a drag to the selected objects as a single edit, which clones each selected object at most once: */
+	if(cbData->reason==GLMotif::DragWidget::DraggingCallbackData::DRAGGING_STARTED)
+		settings.beginEdit();
+	else
+		settings.endEdit();
+	}
+
 void SketchPad::paletteColorSelectorValueChanged(GLMotif::HSVColorSelector::ValueChangedCallbackData* cbData)
 	{
 	/* Convert the new color and the current opacity value to a sketch object color: */
@@ -313,7 +464,7 @@ void SketchPad::paletteColorSelectorValueChanged(GLMotif::HSVColorSelector::Valu
 	settings.setColor(newSketchColor);
 	
 	/* Apply the new sketch settings to all selected objects: */
-	settings.applySettingsToSelection();
+	applySettingsToSelection();
 	}
 
 void SketchPad::opacitySliderValueChanged(GLMotif::Slider::ValueChangedCallbackData* cbData)
@@ -328,7 +479,7 @@ void SketchPad::opacitySliderValueChanged(GLMotif::Slider::ValueChangedCallbackD
 	settings.setColor(newSketchColor);
 	
 	/* Apply the new sketch settings to all selected objects: */
-	settings.applySettingsToSelection();
+	applySettingsToSelection();
 	}
 
 void SketchPad::paintBucketSelected(GLMotif::PaintBucket::SelectCallbackData* cbData)
@@ -349,7 +500,7 @@ void SketchPad::paintBucketSelected(GLMotif::PaintBucket::SelectCallbackData* cb
 	settings.setColor(selectedPaintBucket->getColor());
 	
 	/* Apply the new sketch settings to all selected objects: */
-	settings.applySettingsToSelection();
+	applySettingsToSelection();
 	}
 
 void SketchPad::lineWidthSliderValueChanged(GLMotif::TextFieldSlider::ValueChangedCallbackData* cbData)
@@ -358,7 +509,7 @@ void SketchPad::lineWidthSliderValueChanged(GLMotif::TextFieldSlider::ValueChang
 	lineWidth=Scalar(cbData->value);
 	
 	/* Apply the new sketch settings to all selected objects: */
-	settings.applySettingsToSelection();
+	applySettingsToSelection();
 	}
 
 GLMotif::PopupWindow* SketchPad::createPaletteDialog(void)
@@ -382,12 +533,14 @@ GLMotif::PopupWindow* SketchPad::createPaletteDialog(void)
 	paletteColorSelector->setPreferredSize(Vrui::getUiSize()*Vrui::Scalar(16));
 	paletteColorSelector->setIndicatorSize(Vrui::getUiSize()*Vrui::Scalar(0.75));
 	paletteColorSelector->getValueChangedCallbacks().add(this,&SketchPad::paletteColorSelectorValueChanged);
+	paletteColorSelector->getDraggingCallbacks().add(this,&SketchPad::settingsDraggingCallback);
 	
 	/* Add an opacity slider: */
 	opacitySlider=new GLMotif::Slider("OpacitySlider",colorBox,GLMotif::Slider::VERTICAL,Vrui::getUiStyleSheet()->fontHeight*5.0f);
 	opacitySlider->setValueRange(0.0f,1.0f,0.0f);
 	opacitySlider->setValue(1.0f);
 	opacitySlider->getValueChangedCallbacks().add(this,&SketchPad::opacitySliderValueChanged);
+	opacitySlider->getDraggingCallbacks().add(this,&SketchPad::settingsDraggingCallback);
 	
 	/* Add a set of color buckets: */
 	GLMotif::RowColumn* paintBuckets=new GLMotif::RowColumn("paintBuckets",colorBox,false);
@@ -439,6 +592,7 @@ GLMotif::PopupWindow* SketchPad::createPaletteDialog(void)
 	lineWidthSlider->setValueRange(0.25,25.0,0.0);
 	lineWidthSlider->setValue(lineWidth);
 	lineWidthSlider->getValueChangedCallbacks().add(this,&SketchPad::lineWidthSliderValueChanged);
+	lineWidthSlider->getSlider()->getDraggingCallbacks().add(this,&SketchPad::settingsDraggingCallback);
 	
 	lineWidthBox->manageChild();
 	
@@ -447,6 +601,174 @@ GLMotif::PopupWindow* SketchPad::createPaletteDialog(void)
 	return paletteDialogWindow;
 	}
 
+GLMotif::PopupWindow* SketchPad::createFileProgressDialog(void)
+	{
+	GLMotif::PopupWindow* fileProgressDialogWindow=new GLMotif::PopupWindow("FileProgressDialogWindow",Vrui::getWidgetManager(),"Sketch File");
+	fileProgressDialogWindow->setResizableFlags(true,false);
+	
+	fileProgressLabel=new GLMotif::Label("FileProgressLabel",fileProgressDialogWindow,"Loading sketch file: 0 of 0 objects");
+	
+	return fileProgressDialogWindow;
+	}
+
+void SketchPad::updateFileProgress(void)
+	{
+	/* Format a progress message: */
+	char message[1024];
+	if(fileWorker->getOperation()==SketchFileWorker::Load)
+		{
+		if(fileWorker->getNumObjects()!=0)
+			snprintf(message,sizeof(message),"Loading %s: %u of %u objects",fileWorker->getFileName().c_str(),fileWorker->getNumObjectsRead(),fileWorker->getNumObjects());
+		else
+			snprintf(message,sizeof(message),"Loading %s...",fileWorker->getFileName().c_str());
+		}
+	else
+		snprintf(message,sizeof(message),"Saving %s: %.1f MB...",fileWorker->getFileName().c_str(),double(fileWorker->getSaveSize())/1048576.0);
+	
+	fileProgressLabel->setString(message);
+	}
+
+void SketchPad::finishFileWorker(void)
+	{
+	/* Wait for the worker thread to terminate: */
+	fileWorker->finish();
+	
+	if(!fileWorker->getError().empty())
+		{
+		/* Show an error message: */
+		if(fileWorker->getOperation()==SketchFileWorker::Load)
+			Misc::formattedUserError("Load Sketch File: Could not load file %s due to exception %s",fileWorker->getFileName().c_str(),fileWorker->getError().c_str());
+		else
+			Misc::formattedUserError("Save Sketch File: Could not save file %s due to exception %s",fileWorker->getFileName().c_str(),fileWorker->getError().c_str());
+		}
+	else if(fileWorker->getOperation()==SketchFileWorker::Load)
+		{
+		/* Install the loaded sketch objects: */
+		if(journal!=0)
+			journal->loadFile(fileWorker->getFileName());
+		installSketchObjects(fileWorker->getSketchObjects());
+		
+		/* Start a new autosave snapshot as the journal now depends on the loaded file: */
+		if(journal!=0)
+			journal->startSnapshot(Vrui::getApplicationTime());
+		}
+	
+	/* Destroy the worker and hide the progress dialog: */
+	delete fileWorker;
+	fileWorker=0;
+	Vrui::popdownPrimaryWidget(fileProgressDialog);
+	}
+
+void SketchPad::finishImageWorker(void)
+	{
+	/* Wait for the worker thread to terminate: */
+	imageWorker->finish();
+	
+	if(!imageWorker->getError().empty())
+		{
+		/* Show an error message: */
+		Misc::formattedUserError("Load Image: Could not load image %s due to exception %s",imageWorker->getFileName().c_str(),imageWorker->getError().c_str());
+		}
+	else
+		{
+		/* Create a sketch object factory for the loaded image: */
+		delete nextSketchFactory;
+		nextSketchFactory=new ImageFactory(settings,imageWorker->getFileName(),imageWorker->getStoredImage());
+		
+		/* Invalidate all current sketch object factories: */
+		++sketchFactoryVersion;
+		}
+	
+	/* Destroy the worker: */
+	delete imageWorker;
+	imageWorker=0;
+	}
+
+void SketchPad::finishExporter(void)
+	{
+	/* Show an error message if the export failed: */
+	std::string error=exporter->getError();
+	if(!error.empty())
+		Misc::formattedUserError("Export Sketch: Could not export to file %s due to exception %s",exporter->getFileName().c_str(),error.c_str());
+	
+	/* Destroy the exporter: */
+	delete exporter;
+	exporter=0;
+	}
+
+#if SKETCHPAD_CONFIG_STATS
+
+void SketchPad::statsToggleValueChanged(GLMotif::ToggleButton::ValueChangedCallbackData* cbData)
+	{
+	if(cbData->set)
+		{
+		/* Show the statistics window: */
+		updateStatsDialog();
+		Vrui::popupPrimaryWidget(statsDialog);
+		}
+	else
+		Vrui::popdownPrimaryWidget(statsDialog);
+	}
+
+void SketchPad::statsDialogCloseCallback(Misc::CallbackData*)
+	{
+	statsToggle->setToggle(false);
+	}
+
+GLMotif::PopupWindow* SketchPad::createStatsDialog(void)
+	{
+	GLMotif::PopupWindow* statsDialogWindow=new GLMotif::PopupWindow("StatsDialogWindow",Vrui::getWidgetManager(),"Statistics");
+	statsDialogWindow->setCloseButton(true);
+	statsDialogWindow->setResizableFlags(false,false);
+	statsDialogWindow->popDownOnClose();
+	statsDialogWindow->getCloseCallbacks().add(this,&SketchPad::statsDialogCloseCallback);
+	
+	GLMotif::RowColumn* statsDialog=new GLMotif::RowColumn("StatsDialog",statsDialogWindow,false);
+	statsDialog->setOrientation(GLMotif::RowColumn::VERTICAL);
+	statsDialog->setPacking(GLMotif::RowColumn::PACK_TIGHT);
+	statsDialog->setNumMinorWidgets(2);
+	
+	/* Add a labeled text field for each counter: */
+	for(int i=0;i<Stats::NumCounters;++i)
+		{
+		char name[32];
+		snprintf(name,sizeof(name),"Counter%dLabel",i);
+		new GLMotif::Label(name,statsDialog,Stats::getCounterName(Stats::Counter(i)));
+		snprintf(name,sizeof(name),"Counter%dField",i);
+		statsCounterFields[i]=new GLMotif::TextField(name,statsDialog,10);
+		statsCounterFields[i]->setValue(0U);
+		}
+	
+	/* Add a labeled text field for each timer, showing milliseconds: */
+	for(int i=0;i<Stats::NumTimers;++i)
+		{
+		char name[32];
+		snprintf(name,sizeof(name),"Timer%dLabel",i);
+		std::string label=Stats::getTimerName(Stats::Timer(i));
+		label.append(" (ms)");
+		new GLMotif::Label(name,statsDialog,label.c_str());
+		snprintf(name,sizeof(name),"Timer%dField",i);
+		statsTimerFields[i]=new GLMotif::TextField(name,statsDialog,10);
+		statsTimerFields[i]->setPrecision(3);
+		statsTimerFields[i]->setFloatFormat(GLMotif::TextField::FIXED);
+		statsTimerFields[i]->setValue(0.0);
+		}
+	
+	statsDialog->manageChild();
+	
+	return statsDialogWindow;
+	}
+
+void SketchPad::updateStatsDialog(void)
+	{
+	for(int i=0;i<Stats::NumCounters;++i)
+		statsCounterFields[i]->setValue(Stats::getFrameCounter(Stats::Counter(i)));
+	for(int i=0;i<Stats::NumTimers;++i)
+		statsTimerFields[i]->setValue(Stats::getFrameTime(Stats::Timer(i))*1000.0);
+	}
+
+#endif
+
 SketchPad::SketchPad(int& argc,char**& argv)
 	:Vrui::Application(argc,argv),
 	 lineWidth(0.75f),
@@ -454,34 +776,184 @@ SketchPad::SketchPad(int& argc,char**& argv)
 	 sketchFactoryType(0),sketchFactoryVersion(0U),nextSketchFactory(0),
 	 mainMenu(0),paletteDialog(0),
 	 imageHelper(Vrui::getWidgetManager(),"Image.png",".ppm;.png;.jpg;.jpeg;.tif;.tiff"),
-	 sketchFileHelper(Vrui::getWidgetManager(),"SketchFile.sketch",".sketch")
+	 sketchFileHelper(Vrui::getWidgetManager(),"SketchFile.sketch",".sketch"),
+	 exportHelper(Vrui::getWidgetManager(),"Sketch.tif",".tif;.tiff;.svg"),
+	 exportSize(8192),exporter(0),
+	 pointEncoding(SketchObjectCreator::DeltaPoints),
+	 fileWorker(0),fileProgressDialog(0),fileProgressLabel(0),
+	 imageWorker(0),
+	 journal(0),collaboration(0),board(0),
+	 workerPool(0)
+	 #if SKETCHPAD_CONFIG_STATS
+	 ,statsToggle(0),statsDialog(0),statsFile(0)
+	 #endif
 	{
 	/* Parse the command line: */
 	const char* sketchFileName=0;
+	const char* autosaveBaseName=0;
+	double autosaveInterval=300.0;
+	int collaborationPort=0;
+	std::string collaborationHost;
+	const char* boardName=0;
+	Scalar boardTileSize(48);
+	size_t boardMemorySize=size_t(1024)<<20;
+	long numWorkerThreads=sysconf(_SC_NPROCESSORS_ONLN)-1; // The main thread participates in parallel operations
+	const char* statsFileName=0;
 	for(int i=1;i<argc;++i)
 		{
 		if(argv[i][0]=='-')
 			{
+			if(strcasecmp(argv[i]+1,"autosave")==0&&i+1<argc)
+				{
+				++i;
+				autosaveBaseName=argv[i];
+				}
+			else if(strcasecmp(argv[i]+1,"autosaveInterval")==0&&i+1<argc)
+				{
+				++i;
+				autosaveInterval=atof(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"collaborationPort")==0&&i+1<argc)
+				{
+				/* Host a collaboration on the given TCP port: */
+				++i;
+				collaborationPort=atoi(argv[i]);
+				collaborationHost.clear();
+				}
+			else if(strcasecmp(argv[i]+1,"collaborate")==0&&i+1<argc)
+				{
+				/* Join the collaboration hosted at the given <host name>:<port>: */
+				++i;
+				const char* colon=strrchr(argv[i],':');
+				if(colon!=0)
+					{
+					collaborationHost=std::string(argv[i],colon);
+					collaborationPort=atoi(colon+1);
+					}
+				else
+					Misc::formattedUserError("SketchPad: Ignoring malformed collaboration address %s",argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"board")==0&&i+1<argc)
+				{
+				/* Page the sketch objects of the board in the given directory around the displayed region: */
+				++i;
+				boardName=argv[i];
+				}
+			else if(strcasecmp(argv[i]+1,"boardTileSize")==0&&i+1<argc)
+				{
+				/* Set the tile size of newly-created boards in navigational units: */
+				++i;
+				boardTileSize=Scalar(atof(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"boardMemory")==0&&i+1<argc)
+				{
+				/* Limit the memory used by resident board tiles, in MB: */
+				++i;
+				boardMemorySize=size_t(atol(argv[i]))<<20;
+				}
+			else if(strcasecmp(argv[i]+1,"numWorkerThreads")==0&&i+1<argc)
+				{
+				++i;
+				numWorkerThreads=atol(argv[i]);
+				}
+			else if(strcasecmp(argv[i]+1,"statsFile")==0&&i+1<argc)
+				{
+				++i;
+				statsFileName=argv[i];
+				}
+			else if(strcasecmp(argv[i]+1,"imageMemory")==0&&i+1<argc)
+				{
+				/* Limit the texture memory per OpenGL context used by image tiles, in MB: */
+				++i;
+				ImageRenderer::setMaxTileMemorySize(size_t(atol(argv[i]))<<20);
+				}
+			else if(strcasecmp(argv[i]+1,"compressImages")==0)
+				ImageRenderer::setCompressTiles(true);
+			else if(strcasecmp(argv[i]+1,"noLayerCache")==0)
+				layerCache.setEnabled(false);
+			else if(strcasecmp(argv[i]+1,"exportSize")==0&&i+1<argc)
+				{
+				/* Set the width or height, whichever is larger, of exported images in pixels: */
+				++i;
+				exportSize=(unsigned int)(atoi(argv[i]));
+				}
+			else if(strcasecmp(argv[i]+1,"rawPoints")==0)
+				pointEncoding=SketchObjectCreator::RawPoints;
+			else if(strcasecmp(argv[i]+1,"undoMemory")==0&&i+1<argc)
+				{
+				/* Limit the memory used by sketch objects kept for undo, in MB; zero disables undo: */
+				++i;
+				settings.setHistoryMemorySize(size_t(atol(argv[i]))<<20);
+				}
+			else if(strcasecmp(argv[i]+1,"predictionTime")==0&&i+1<argc)
+				{
+				/* Extrapolate sketching tools' motion by the given time in ms when rendering: */
+				++i;
+				SketchTool::setPredictionTime(atof(argv[i])*0.001);
+				}
 			}
 		else if(sketchFileName==0)
 			sketchFileName=argv[i];
 		}
 	
-	if(sketchFileName!=0)
+	if(numWorkerThreads>0)
+		{
+		/* Create a pool of worker threads to rub out sketch objects in parallel: */
+		workerPool=new WorkerPool((unsigned int)(numWorkerThreads));
+		settings.setWorkerPool(workerPool);
+		}
+	
+	if(boardName!=0)
+		{
+		/* Open or create the paged board; its tiles are written back in place of autosave files, and collaborators could not share its paged-out objects: */
+		if(autosaveBaseName!=0||collaborationPort!=0)
+			{
+			Misc::formattedUserError("SketchPad: Ignoring autosave and collaboration for board %s",boardName);
+			autosaveBaseName=0;
+			collaborationPort=0;
+			}
+		try
+			{
+			board=new SketchBoard(boardName,boardTileSize,boardMemorySize,objectCreator,settings,pointEncoding);
+			}
+		catch(const std::runtime_error& err)
+			{
+			Misc::formattedUserError("SketchPad: Unable to open board %s due to exception %s",boardName,err.what());
+			}
+		}
+	
+	bool recovered=false;
+	if(autosaveBaseName!=0||collaborationPort!=0)
+		{
+		/* Create a journal to autosave and/or share all edit operations: */
+		journal=new SketchJournal(autosaveBaseName!=0?autosaveBaseName:"",autosaveInterval,objectCreator,settings);
+		}
+	if(autosaveBaseName!=0)
 		{
-		/* Load the given sketch file: */
+		/* Recover the state of a previous session from its autosave files: */
 		try
 			{
-			/* Open the selected file: */
-			IO::FilePtr file=IO::openFile(sketchFileName);
+			recovered=journal->recover();
+			}
+		catch(const std::runtime_error& err)
+			{
+			Misc::formattedUserError("SketchPad: Unable to recover autosave files %s due to exception %s",autosaveBaseName,err.what());
+			}
+		}
+	
+	if(sketchFileName!=0&&!recovered)
+		{
+		/* Load the given sketch file, which adds its sketch objects to an open board: */
+		try
+			{
+			/* Open the given file; in a cluster, the head node reads it and streams it to all other nodes: */
+			IO::FilePtr file=Vrui::openFile(sketchFileName);
 			file->setEndianness(Misc::LittleEndian);
 			
-			/* Read the number of sketch objects in the file: */
-			size_t numSketchObjects=file->read<Misc::UInt32>();
-			
 			/* Read all sketch objects contained in the file: */
-			for(size_t i=0;i<numSketchObjects;++i)
-				settings.getSketchObjects().push_back(objectCreator.readObject(*file));
+			SketchObjectList newSketchObjects;
+			objectCreator.readFile(*file,newSketchObjects);
+			installSketchObjects(newSketchObjects);
 			}
 		catch(const std::runtime_error& err)
 			{
@@ -489,6 +961,52 @@ SketchPad::SketchPad(int& argc,char**& argv)
 			}
 		}
 	
+	if(autosaveBaseName!=0&&Vrui::isHeadNode())
+		{
+		/* Only the head node in a cluster writes autosave files: */
+		try
+			{
+			/* Write an initial snapshot and start journaling all edits: */
+			journal->start(Vrui::getApplicationTime());
+			}
+		catch(const std::runtime_error& err)
+			{
+			Misc::formattedUserError("SketchPad: Unable to start autosaving to %s due to exception %s",autosaveBaseName,err.what());
+			journal->stopAutosave();
+			}
+		}
+	
+	if(collaborationPort!=0)
+		{
+		/* Host or join a collaboration; a joining instance receives the host's sketch objects: */
+		try
+			{
+			if(collaborationHost.empty())
+				collaboration=new SketchCollaboration(collaborationPort,objectCreator,settings,*journal);
+			else
+				collaboration=new SketchCollaboration(collaborationHost,collaborationPort,objectCreator,settings,*journal);
+			}
+		catch(const std::runtime_error& err)
+			{
+			Misc::formattedUserError("SketchPad: Unable to start collaboration due to exception %s",err.what());
+			}
+		}
+	
+	if(journal!=0)
+		{
+		if(collaboration!=0||journal->isAutosaving())
+			{
+			/* Journal all edits, including those made by undo and redo: */
+			settings.setHistoryListener(journal);
+			}
+		else
+			{
+			/* The journal is not needed: */
+			delete journal;
+			journal=0;
+			}
+		}
+	
 	/* Initialize sketch settings: */
 	settings.setGridEnabled(true);
 	
@@ -500,6 +1018,28 @@ SketchPad::SketchPad(int& argc,char**& argv)
 	paletteDialog=createPaletteDialog();
 	Vrui::popupPrimaryWidget(paletteDialog);
 	
+	/* Create the sketch file progress dialog: */
+	fileProgressDialog=createFileProgressDialog();
+	
+	#if SKETCHPAD_CONFIG_STATS
+	/* Create the statistics dialog: */
+	statsDialog=createStatsDialog();
+	
+	/* Only the head node in a cluster writes the statistics file: */
+	if(statsFileName!=0&&Vrui::isHeadNode())
+		{
+		/* Open the statistics file and write its header line: */
+		statsFile=fopen(statsFileName,"wt");
+		if(statsFile!=0)
+			Stats::writeCsvHeader(statsFile);
+		else
+			Misc::formattedUserError("SketchPad: Unable to open statistics file %s",statsFileName);
+		}
+	#else
+	if(statsFileName!=0)
+		Misc::formattedUserError("SketchPad: Statistics are disabled; ignoring statistics file %s",statsFileName);
+	#endif
+	
 	/* Create an abstract base class for sketching-related tools: */
 	typedef Vrui::GenericAbstractToolFactory<SketchPadTool> BaseToolFactory;
 	BaseToolFactory* baseToolFactory=new BaseToolFactory("SketchPadTool","SketchPad",0,*Vrui::getToolManager());
@@ -516,8 +1056,33 @@ SketchPad::SketchPad(int& argc,char**& argv)
 
 SketchPad::~SketchPad(void)
 	{
+	/* Wait for any background sketch file or image operation to finish, and abort an unfinished export: */
+	delete fileWorker;
+	delete imageWorker;
+	delete exporter;
+	
+	/* Write back and close the paged board: */
+	delete board;
+	
+	/* Leave the collaboration and close the autosave journal: */
+	delete collaboration;
+	settings.setHistoryListener(0);
+	delete journal;
+	
+	/* Shut down the worker threads: */
+	settings.setWorkerPool(0);
+	delete workerPool;
+	
 	delete mainMenu;
 	delete paletteDialog;
+	delete fileProgressDialog;
+	
+	#if SKETCHPAD_CONFIG_STATS
+	/* Close the statistics file: */
+	if(statsFile!=0)
+		fclose(statsFile);
+	delete statsDialog;
+	#endif
 	}
 
 void SketchPad::toolCreationCallback(Vrui::ToolManager::ToolCreationCallbackData* cbData)
@@ -555,6 +1120,18 @@ void SketchPad::toolDestructionCallback(Vrui::ToolManager::ToolDestructionCallba
 
 void SketchPad::frame(void)
 	{
+	#if SKETCHPAD_CONFIG_STATS
+	/* Capture the statistics of the previous frame: */
+	Stats::finishFrame();
+	if(statsFile!=0)
+		Stats::writeCsvRecord(statsFile,Vrui::getApplicationTime());
+	if(statsToggle->getToggle())
+		updateStatsDialog();
+	#endif
+	
+	/* Measure the time spent in this method: */
+	SKETCHPAD_STATS_TIMER(FrameTime);
+	
 	/* Retrieve the current navigation transformation's scaling factor: */
 	Scalar navScaling(Vrui::getNavigationTransformation().getScaling());
 	
@@ -567,6 +1144,99 @@ void SketchPad::frame(void)
 	/* Adjust the pick distance: */
 	settings.setPickRadius(Vrui::getPointPickDistance());
 	
+	if(fileWorker!=0)
+		{
+		/* Check if the background sketch file operation finished, using the head node's decision in a cluster: */
+		bool finished=fileWorker->isFinished();
+		Cluster::MulticastPipe* pipe=Vrui::getMainPipe();
+		if(pipe!=0)
+			{
+			if(Vrui::isHeadNode())
+				{
+				pipe->write<Misc::UInt8>(finished?1U:0U);
+				pipe->flush();
+				}
+			else
+				finished=pipe->read<Misc::UInt8>()!=0U;
+			}
+		
+		if(finished)
+			finishFileWorker();
+		else
+			{
+			/* Update the progress dialog and check again soon: */
+			updateFileProgress();
+			Vrui::scheduleUpdate(Vrui::getApplicationTime()+0.1);
+			}
+		}
+	
+	if(imageWorker!=0)
+		{
+		/* Check if the background image load finished, using the head node's decision in a cluster: */
+		bool finished=imageWorker->isFinished();
+		Cluster::MulticastPipe* pipe=Vrui::getMainPipe();
+		if(pipe!=0)
+			{
+			if(Vrui::isHeadNode())
+				{
+				pipe->write<Misc::UInt8>(finished?1U:0U);
+				pipe->flush();
+				}
+			else
+				finished=pipe->read<Misc::UInt8>()!=0U;
+			}
+		
+		if(finished)
+			finishImageWorker();
+		}
+	
+	if(exporter!=0)
+		{
+		/* Finish a completed or stalled export, or keep rendering frames while the exporter renders tiles: */
+		exporter->frame();
+		if(exporter->isFinished())
+			finishExporter();
+		else if(exporter->isRendering())
+			Vrui::requestUpdate();
+		}
+	
+	if(board!=0)
+		{
+		/* Page in the board tiles around the displayed region, padded by twice the display size in all directions: */
+		Vrui::Point center=Vrui::getInverseNavigationTransformation().transform(Vrui::getDisplayCenter());
+		Scalar radius=Scalar(Vrui::getDisplaySize())*Scalar(2)/navScaling;
+		Box region(Point(Scalar(center[0])-radius,Scalar(center[1])-radius,Scalar(0)),Point(Scalar(center[0])+radius,Scalar(center[1])+radius,Scalar(0)));
+		board->frame(region,Vrui::getApplicationTime());
+		}
+	
+	if(collaboration!=0)
+		{
+		/* Exchange this frame's edit operations with all collaborators before they are flushed to the journal: */
+		collaboration->frame();
+		}
+	
+	if(journal!=0)
+		{
+		/* Flush the autosave journal and take a periodic snapshot if needed: */
+		try
+			{
+			journal->frame(Vrui::getApplicationTime());
+			}
+		catch(const std::runtime_error& err)
+			{
+			/* Disable autosaving: */
+			Misc::formattedUserError("SketchPad: Disabling autosave due to exception %s",err.what());
+			if(collaboration!=0)
+				journal->stopAutosave();
+			else
+				{
+				settings.setHistoryListener(0);
+				delete journal;
+				journal=0;
+				}
+			}
+		}
+	
 	if(settings.getGridEnabled())
 		{
 		/* Calculate an appropriate size for a drawing support grid, starting at 1/4" at 1:1 scale: */
@@ -600,6 +1270,9 @@ void SketchPad::frame(void)
 
 void SketchPad::display(GLContextData& contextData) const
 	{
+	/* Measure the time spent in this method: */
+	SKETCHPAD_STATS_TIMER(DisplayTime);
+	
 	/*********************************************************************
 	Calculate the intersection of the view frustum with the drawing plane:
 	*********************************************************************/
@@ -651,17 +1324,26 @@ void SketchPad::display(GLContextData& contextData) const
 	/* Create a rendering state: */
 	RenderState renderState(contextData);
 	
-	/* Draw the sketching environment: */
-	settings.glRenderAction(viewBox,renderState);
+	/* Draw the sketching environment through the layer cache and highlight selected objects on top: */
+	layerCache.draw(settings,viewBox,renderState);
+	settings.renderHighlights(viewBox,renderState);
 	
 	/* Draw the current state of all sketch tools: */
 	for(std::vector<SketchPadTool*>::const_iterator sptIt=sketchPadTools.begin();sptIt!=sketchPadTools.end();++sptIt)
 		(*sptIt)->glRenderAction(renderState);
 	
+	/* Draw the strokes that collaborators are still drawing: */
+	if(collaboration!=0)
+		collaboration->glRenderAction(renderState);
+	
 	/* Draw the rendering grid: */
 	settings.renderGrid(viewBox,renderState);
 	}
 	
+	/* Render the next tiles of a raster export offscreen: */
+	if(exporter!=0)
+		exporter->glRenderAction(contextData);
+	
 	/* Return to standard OpenGL state: */
 	glDisable(GL_BLEND);
 	glDepthMask(GL_TRUE);
@@ -24,8 +24,10 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef SKETCHPAD_INCLUDED
 #define SKETCHPAD_INCLUDED
 
+#include <string>
 #include <vector>
 #include <GLMotif/ToggleButton.h>
+#include <GLMotif/DragWidget.h>
 #include <GLMotif/Slider.h>
 #include <GLMotif/TextFieldSlider.h>
 #include <GLMotif/HSVColorSelector.h>
@@ -35,16 +37,27 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include "SketchGeometry.h"
 #include "Capsule.h"
 #include "SketchSettings.h"
+#include "LayerCache.h"
 #include "SketchObjectList.h"
 #include "SketchObjectCreator.h"
 #include "PaintBucket.h"
+#include "Stats.h"
 
 /* Forward declarations: */
 namespace GLMotif {
 class PopupMenu;
 class PopupWindow;
+class Label;
+class TextField;
 }
 class SketchObjectFactory;
+class SketchFileWorker;
+class ImageFileWorker;
+class SketchJournal;
+class SketchCollaboration;
+class SketchBoard;
+class SketchExporter;
+class WorkerPool;
 
 class SketchPad:public Vrui::Application
 	{
@@ -61,6 +74,7 @@ class SketchPad:public Vrui::Application
 	Scalar lingerRadius; // Radius of the tool linger detection neighborhood in physical coordinate units
 	SketchObjectCreator objectCreator; // Object to manage sketch object classes
 	SketchSettings settings; // Settings to create new sketch objects
+	LayerCache layerCache; // Cache for the image of all sketch objects in each OpenGL context
 	int sketchFactoryType; // Code for the current sketch object factory type
 	unsigned int sketchFactoryVersion; // Version number of the current sketch object factory
 	SketchObjectFactory* nextSketchFactory; // If not null, sketch object factory to return on next call to getSketchFactory
@@ -71,16 +85,41 @@ class SketchPad:public Vrui::Application
 	GLMotif::PaintBucket* selectedPaintBucket; // Pointer to the currently selected paint bucket
 	GLMotif::FileSelectionHelper imageHelper; // Helper object to load images
 	GLMotif::FileSelectionHelper sketchFileHelper; // Helper object to load/save sketch files
+	GLMotif::FileSelectionHelper exportHelper; // Helper object to export sketches to image files
+	unsigned int exportSize; // Width or height, whichever is larger, of exported images in pixels
+	SketchExporter* exporter; // Exporter writing all sketch objects to an image file in the background, or null
+	SketchObjectCreator::PointEncoding pointEncoding; // Encoding of curve points in saved sketch files
+	SketchFileWorker* fileWorker; // Worker loading or saving a sketch file in the background, or null
+	GLMotif::PopupWindow* fileProgressDialog; // Dialog window showing the progress of a background sketch file operation
+	GLMotif::Label* fileProgressLabel; // Label showing the progress of a background sketch file operation
+	ImageFileWorker* imageWorker; // Worker reading and decoding an image file in the background, or null
+	SketchJournal* journal; // Journal autosaving and/or collecting all edit operations for collaboration, or null if both are disabled
+	SketchCollaboration* collaboration; // Connection to collaborating SketchPad instances, or null
+	SketchBoard* board; // Paged board keeping only the tiles around the displayed region resident, or null
+	WorkerPool* workerPool; // Pool of worker threads to rub out or edit sketch objects in parallel, or null
 	std::vector<SketchPadTool*> sketchPadTools; // List of existing sketching tools
+	#if SKETCHPAD_CONFIG_STATS
+	GLMotif::ToggleButton* statsToggle; // Toggle button to show or hide the statistics window
+	GLMotif::PopupWindow* statsDialog; // Dialog window showing the previous frame's statistics
+	GLMotif::TextField* statsCounterFields[Stats::NumCounters]; // Text fields showing the previous frame's counter values
+	GLMotif::TextField* statsTimerFields[Stats::NumTimers]; // Text fields showing the previous frame's timer values
+	FILE* statsFile; // CSV file receiving every frame's statistics, or null
+	#endif
 	
 	/* Private methods: */
+	void installSketchObjects(SketchObjectList& newSketchObjects); // Replaces the current sketch objects with the given newly-read sketch objects
+	bool checkFileWorker(const char* operationName,const std::string& fileName); // Returns true if no background sketch file operation is in progress; shows an error message otherwise
 	void loadSketchFile(GLMotif::FileSelectionDialog::OKCallbackData* cbData); // Callback when user selected a sketch file to load
 	void saveSketchFile(GLMotif::FileSelectionDialog::OKCallbackData* cbData); // Callback when user selected a sketch file to save
 	void loadImage(GLMotif::FileSelectionDialog::OKCallbackData* cbData); // Callback when user selected an image to load
+	void exportSketch(GLMotif::FileSelectionDialog::OKCallbackData* cbData); // Callback when user selected an image file to export all sketch objects to
+	void applySettingsToSelection(void); // Applies the current settings to all selected objects and journals the edit, unless nothing is selected
 	GLMotif::PopupMenu* createFileMenu(void); // Creates the "File" submenu
 	void selectNoneSelected(Misc::CallbackData* cbData); // Callback called when the "Selection"->"Select None" menu entry is selected
 	void selectAllSelected(Misc::CallbackData* cbData); // Callback called when the "Selection"->"Select All" menu entry is selected
 	GLMotif::PopupMenu* createSelectMenu(void); // Creates the "Select" submenu
+	void undoSelected(Misc::CallbackData* cbData); // Callback called when the "Edit"->"Undo" menu entry is selected
+	void redoSelected(Misc::CallbackData* cbData); // Callback called when the "Edit"->"Redo" menu entry is selected
 	void cloneSelectionSelected(Misc::CallbackData* cbData); // Callback called when the "Selection"->"Clone" menu entry is selected
 	void applySettingsSelected(Misc::CallbackData* cbData); // Callback called when the "Selection"->"Apply Settings" menu entry is selected
 	void snapSelectionToGridSelected(Misc::CallbackData* cbData); // Callback called when the "Selection"->"Snap To Grid" menu entry is selected
@@ -92,11 +131,23 @@ class SketchPad:public Vrui::Application
 	GLMotif::PopupMenu* createEditMenu(void); // Creates the "Edit" submenu
 	void gridToggleValueChanged(GLMotif::ToggleButton::ValueChangedCallbackData* cbData); // Callback called when the "Show Grid" toggle button changes value
 	GLMotif::PopupMenu* createMainMenu(void); // Creates the application's main menu
+	void settingsDraggingCallback(GLMotif::DragWidget::DraggingCallbackData* cbData); // Callback called when the user starts or stops dragging a widget that changes the sketch settings
 	void paletteColorSelectorValueChanged(GLMotif::HSVColorSelector::ValueChangedCallbackData* cbData); // Callback called when the color selector's color changes
 	void opacitySliderValueChanged(GLMotif::Slider::ValueChangedCallbackData* cbData); // Callback called when the opacity slider's value changes
 	void paintBucketSelected(GLMotif::PaintBucket::SelectCallbackData* cbData); // Callback called when a paint bucket is selected
 	void lineWidthSliderValueChanged(GLMotif::TextFieldSlider::ValueChangedCallbackData* cbData); // Callback called when the line width slider changes value
 	GLMotif::PopupWindow* createPaletteDialog(void); // Creates the palette window
+	GLMotif::PopupWindow* createFileProgressDialog(void); // Creates the sketch file progress window
+	void updateFileProgress(void); // Updates the sketch file progress window from the background file worker
+	void finishFileWorker(void); // Finishes a completed background sketch file operation
+	void finishImageWorker(void); // Finishes a completed background image load
+	void finishExporter(void); // Finishes a completed or failed sketch export
+	#if SKETCHPAD_CONFIG_STATS
+	void statsToggleValueChanged(GLMotif::ToggleButton::ValueChangedCallbackData* cbData); // Callback called when the "Show Statistics" toggle button changes value
+	void statsDialogCloseCallback(Misc::CallbackData* cbData); // Callback called when the statistics window is closed
+	GLMotif::PopupWindow* createStatsDialog(void); // Creates the statistics window
+	void updateStatsDialog(void); // Updates the statistics window with the previous frame's statistics
+	#endif
 	
 	/* Constructors and destructors: */
 	public:
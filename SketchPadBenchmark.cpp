@@ -0,0 +1,424 @@
+/***********************************************************************
+SketchPadBenchmark - Headless benchmark harness timing the sketch object
+creation, file, picking, erasing, and rendering preparation paths on
+synthetic boards, for tracking performance regressions.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <stdexcept>
+#include <Misc/Endianness.h>
+#include <Math/Math.h>
+#include <Math/Constants.h>
+#include <IO/VariableMemoryFile.h>
+#include <Realtime/Time.h>
+
+#include "SketchGeometry.h"
+#include "Capsule.h"
+#include "ChunkAllocator.h"
+#include "PolylineRenderer.h"
+#include "SketchObject.h"
+#include "SketchObjectList.h"
+#include "SketchObjectCreator.h"
+#include "SketchSettings.h"
+#include "WorkerPool.h"
+#include "Curve.h"
+#include "Group.h"
+#include "Image.h"
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+Scalar randomScalar(Scalar min,Scalar max) // Returns a pseudo-random scalar in [min, max)
+	{
+	return min+(max-min)*Scalar(double(rand())/(double(RAND_MAX)+1.0));
+	}
+
+void report(const char* name,size_t numItems,double time,bool csv) // Prints the result of a benchmark
+	{
+	if(csv)
+		printf("%s,%u,%.3f,%.3f\n",name,(unsigned int)(numItems),time*1000.0,numItems>0?time*1.0e6/double(numItems):0.0);
+	else
+		printf("%-24s %10u %12.3f %14.3f\n",name,(unsigned int)(numItems),time*1000.0,numItems>0?time*1.0e6/double(numItems):0.0);
+	}
+
+void createWigglyPath(const Point& start,Scalar length,unsigned int numPoints,std::vector<Point>& path) // Creates a path of the given length and number of points that turns at every point
+	{
+	/* Pick a random direction and a wiggle amplitude on the order of the point spacing: */
+	Scalar angle=randomScalar(Scalar(0),Scalar(2)*Math::Constants<Scalar>::pi);
+	Vector dir(Math::cos(angle),Math::sin(angle),Scalar(0));
+	Vector normal(-dir[1],dir[0],Scalar(0));
+	Scalar step=length/Scalar(numPoints);
+	
+	path.clear();
+	for(unsigned int i=0;i<numPoints;++i)
+		path.push_back(start+dir*(step*Scalar(i))+normal*(step*Math::sin(Scalar(i)*Math::Constants<Scalar>::pi*Scalar(0.25))));
+	}
+
+SketchObject* drawCurve(CurveFactory& factory,const std::vector<Point>& path) // Draws a curve along the given path like a sketching tool would, and returns it
+	{
+	factory.buttonDown(path.front());
+	for(std::vector<Point>::const_iterator pIt=path.begin()+1;pIt!=path.end();++pIt)
+		factory.motion(*pIt,false,false);
+	factory.buttonUp(path.back());
+	return factory.finish();
+	}
+
+void createImageFile(unsigned int size,IO::File& file) // Writes a synthetic gradient image of the given size in binary PPM format to the given file
+	{
+	char header[64];
+	snprintf(header,sizeof(header),"P6\n%u %u\n255\n",size,size);
+	file.write(header,strlen(header));
+	std::vector<unsigned char> row(size*3);
+	for(unsigned int y=0;y<size;++y)
+		{
+		for(unsigned int x=0;x<size;++x)
+			{
+			row[x*3+0]=(unsigned char)((x*255U)/size);
+			row[x*3+1]=(unsigned char)((y*255U)/size);
+			row[x*3+2]=(unsigned char)(((x^y)*255U)/size);
+			}
+		file.write(&row.front(),row.size());
+		}
+	}
+
+}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	unsigned int numCurves=1000;
+	unsigned int numPoints=200;
+	unsigned int numHatchLines=2000;
+	unsigned int groupDepth=32;
+	unsigned int numImages=16;
+	unsigned int numPicks=10000;
+	unsigned int numStrokes=64;
+	unsigned int numAllocations=1000000;
+	unsigned int numWorkerThreads=0;
+	unsigned int seed=1U;
+	bool csv=false;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"curves")==0&&i+1<argc)
+				numCurves=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"points")==0&&i+1<argc)
+				numPoints=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"hatch")==0&&i+1<argc)
+				numHatchLines=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"depth")==0&&i+1<argc)
+				groupDepth=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"images")==0&&i+1<argc)
+				numImages=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"picks")==0&&i+1<argc)
+				numPicks=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"strokes")==0&&i+1<argc)
+				numStrokes=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"allocations")==0&&i+1<argc)
+				numAllocations=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"numWorkerThreads")==0&&i+1<argc)
+				numWorkerThreads=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"seed")==0&&i+1<argc)
+				seed=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"csv")==0)
+				csv=true;
+			else
+				{
+				fprintf(stderr,"Usage: %s [-curves <num>] [-points <num>] [-hatch <num>] [-depth <num>] [-images <num>] [-picks <num>] [-strokes <num>] [-allocations <num>] [-numWorkerThreads <num>] [-seed <seed>] [-csv]\n",argv[0]);
+				return 1;
+				}
+			}
+		}
+	if(numPoints<2)
+		numPoints=2;
+	srand(seed);
+	
+	try
+		{
+		/* Use the polyline renderer without a Vrui kernel: */
+		PolylineRenderer::setHeadless(true);
+		
+		/* Create the sketch object classes and the board: */
+		SketchObjectCreator creator;
+		SketchSettings settings;
+		settings.setColor(Color(0U,0U,0U));
+		settings.setLineWidth(0.01f);
+		settings.setDetailSize(Scalar(0.001));
+		settings.setPickRadius(Scalar(0.05));
+		WorkerPool* workerPool=0;
+		if(numWorkerThreads>0)
+			{
+			workerPool=new WorkerPool(numWorkerThreads);
+			settings.setWorkerPool(workerPool);
+			}
+		Scalar boardSize(100);
+		
+		if(csv)
+			printf("Benchmark,Items,Total (ms),Per Item (us)\n");
+		else
+			printf("%-24s %10s %12s %14s\n","Benchmark","Items","Total (ms)","Per Item (us)");
+		
+		/*****************************************************************
+		Create the synthetic board through the sketch object factories:
+		*****************************************************************/
+		
+		CurveFactory curveFactory(settings);
+		std::vector<std::vector<Point> > curvePaths(numCurves);
+		for(unsigned int i=0;i<numCurves;++i)
+			{
+			Point origin(randomScalar(Scalar(0),boardSize),randomScalar(Scalar(0),boardSize),Scalar(0));
+			createWigglyPath(origin,Scalar(10),numPoints,curvePaths[i]);
+			}
+		{
+		Realtime::TimePointMonotonic start;
+		for(unsigned int i=0;i<numCurves;++i)
+			settings.append(drawCurve(curveFactory,curvePaths[i]));
+		report("Curve Ingestion",size_t(numCurves)*size_t(numPoints-1),start.setAndDiff(),csv);
+		}
+		
+		/* Add a dense hatch pattern of straight lines in the center of the board: */
+		{
+		Realtime::TimePointMonotonic start;
+		Scalar hatchMin=boardSize*Scalar(0.4);
+		Scalar hatchMax=boardSize*Scalar(0.6);
+		std::vector<Point> path(5);
+		for(unsigned int i=0;i<numHatchLines;++i)
+			{
+			Scalar offset=hatchMin+(hatchMax-hatchMin)*Scalar(i/2)/Scalar((numHatchLines+1)/2);
+			for(int j=0;j<5;++j)
+				{
+				Scalar along=hatchMin+(hatchMax-hatchMin)*Scalar(j)*Scalar(0.25);
+				path[j]=i%2==0?Point(along,offset,Scalar(0)):Point(offset,along,Scalar(0));
+				}
+			settings.append(drawCurve(curveFactory,path));
+			}
+		report("Hatch Ingestion",numHatchLines,start.setAndDiff(),csv);
+		}
+		
+		/* Add a chain of nested groups, each containing a few short curves: */
+		if(groupDepth>0)
+			{
+			Realtime::TimePointMonotonic start;
+			Group* group=0;
+			std::vector<Point> path;
+			for(unsigned int level=0;level<groupDepth;++level)
+				{
+				Group* parent=new Group;
+				if(group!=0)
+					parent->append(group);
+				for(int i=0;i<4;++i)
+					{
+					Point origin(randomScalar(Scalar(0),boardSize),randomScalar(Scalar(0),boardSize),Scalar(0));
+					createWigglyPath(origin,Scalar(2),32,path);
+					parent->append(drawCurve(curveFactory,path));
+					}
+				group=parent;
+				}
+			settings.append(group);
+			report("Group Nesting",groupDepth,start.setAndDiff(),csv);
+			}
+		
+		/* Add synthetic images: */
+		if(numImages>0)
+			{
+			Realtime::TimePointMonotonic start;
+			for(unsigned int i=0;i<numImages;++i)
+				{
+				IO::VariableMemoryFile imageFile;
+				createImageFile(256,imageFile);
+				imageFile.flush();
+				ImageFactory imageFactory(settings,"Synthetic.ppm",imageFile);
+				Point p0(randomScalar(Scalar(0),boardSize),randomScalar(Scalar(0),boardSize),Scalar(0));
+				Point p1=p0+Vector(Scalar(4),Scalar(4),Scalar(0));
+				imageFactory.buttonDown(p0);
+				imageFactory.motion(p1,false,false);
+				imageFactory.buttonUp(p1);
+				settings.append(imageFactory.finish());
+				}
+			report("Image Creation",numImages,start.setAndDiff(),csv);
+			}
+		
+		/*****************************************************************
+		Benchmark the file paths by writing and re-reading the board:
+		*****************************************************************/
+		
+		IO::VariableMemoryFile boardFile;
+		boardFile.setEndianness(Misc::LittleEndian);
+		size_t numObjects=settings.getSketchObjects().size();
+		{
+		Realtime::TimePointMonotonic start;
+		creator.writeFile(settings.getSketchObjects(),boardFile);
+		boardFile.flush();
+		report("Write Objects",numObjects,start.setAndDiff(),csv);
+		}
+		{
+		Realtime::TimePointMonotonic start;
+		SketchObjectList readObjects;
+		creator.readFile(boardFile,readObjects);
+		double time=start.setAndDiff();
+		if(readObjects.size()!=numObjects)
+			throw std::runtime_error("Read a different number of sketch objects than were written");
+		report("Read Objects",numObjects,time,csv);
+		
+		/* Continue with the read board: */
+		settings.setSketchObjects(readObjects);
+		}
+		
+		/* Repeat with curve points stored as quantized differences: */
+		IO::VariableMemoryFile deltaBoardFile;
+		deltaBoardFile.setEndianness(Misc::LittleEndian);
+		{
+		Realtime::TimePointMonotonic start;
+		creator.writeFile(settings.getSketchObjects(),deltaBoardFile,SketchObjectCreator::DeltaPoints);
+		deltaBoardFile.flush();
+		report("Write Objects (Delta)",numObjects,start.setAndDiff(),csv);
+		}
+		{
+		Realtime::TimePointMonotonic start;
+		SketchObjectList readObjects;
+		creator.readFile(deltaBoardFile,readObjects);
+		double time=start.setAndDiff();
+		if(readObjects.size()!=numObjects)
+			throw std::runtime_error("Read a different number of sketch objects than were written");
+		report("Read Objects (Delta)",numObjects,time,csv);
+		}
+		
+		/*****************************************************************
+		Benchmark preparing curves for rendering:
+		*****************************************************************/
+		
+		{
+		Realtime::TimePointMonotonic start;
+		size_t numLodPoints=0;
+		PolylineRenderer::LodTierList lodTiers;
+		for(std::vector<std::vector<Point> >::iterator cpIt=curvePaths.begin();cpIt!=curvePaths.end();++cpIt)
+			{
+			PolylineRenderer::Polyline polyline(cpIt->begin(),cpIt->end());
+			PolylineRenderer::createLodTiers(polyline,lodTiers);
+			numLodPoints+=polyline.size();
+			}
+		report("LOD Tiers",numLodPoints,start.setAndDiff(),csv);
+		}
+		
+		/*****************************************************************
+		Benchmark picking at random positions:
+		*****************************************************************/
+		
+		{
+		Realtime::TimePointMonotonic start;
+		for(unsigned int i=0;i<numPicks;++i)
+			settings.pick(Point(randomScalar(Scalar(0),boardSize),randomScalar(Scalar(0),boardSize),Scalar(0)));
+		report("Pick",numPicks,start.setAndDiff(),csv);
+		}
+		
+		/*****************************************************************
+		Benchmark editing and cloning all sketch objects:
+		*****************************************************************/
+		
+		{
+		size_t numObjects=settings.getSketchObjects().size();
+		settings.selectAll();
+		Realtime::TimePointMonotonic start;
+		settings.transformSelectedObjects(Transformation::translate(Vector(Scalar(0.001),Scalar(0.002),Scalar(0))));
+		report("Transform Selection",numObjects,start.setAndDiff(),csv);
+		settings.setGridSize(Scalar(0.001));
+		settings.setGridEnabled(true);
+		settings.snapSelectedObjectsToGrid();
+		settings.setGridEnabled(false);
+		report("Snap Selection",numObjects,start.setAndDiff(),csv);
+		settings.cloneSelection();
+		report("Clone Selection",numObjects,start.setAndDiff(),csv);
+		
+		/* Delete the clones to leave the board as it was: */
+		settings.deleteSelection();
+		}
+		
+		/*****************************************************************
+		Benchmark rubbing out the board in horizontal strokes:
+		*****************************************************************/
+		
+		{
+		Realtime::TimePointMonotonic start;
+		Scalar radius(0.1);
+		size_t numCapsules=0;
+		for(unsigned int i=0;i<numStrokes;++i)
+			{
+			/* Sweep the eraser across the board in steps of its radius: */
+			Scalar y=randomScalar(Scalar(0),boardSize);
+			for(Scalar x=Scalar(0);x<boardSize;x+=radius,++numCapsules)
+				settings.rubout(Capsule(Point(x,y,Scalar(0)),Point(x+radius,y,Scalar(0)),radius));
+			}
+		report("Rubout Sweep",numCapsules,start.setAndDiff(),csv);
+		}
+		
+		/*****************************************************************
+		Benchmark the cached polyline memory allocator under churn:
+		*****************************************************************/
+		
+		{
+		Realtime::TimePointMonotonic start;
+		ChunkAllocator allocator;
+		allocator.addBlock(1U<<20);
+		std::vector<ChunkAllocator::Chunk> chunks;
+		for(unsigned int i=0;i<numAllocations;++i)
+			{
+			/* Allocate or release with equal probability once a working set has built up: */
+			if(chunks.size()<1024||rand()%2==0)
+				{
+				size_t size=2+size_t(rand()%1023);
+				ChunkAllocator::Chunk chunk;
+				if(!allocator.allocate(size,chunk))
+					{
+					allocator.addBlock(1U<<20);
+					allocator.allocate(size,chunk);
+					}
+				chunks.push_back(chunk);
+				}
+			else
+				{
+				size_t index=size_t(rand())%chunks.size();
+				allocator.release(chunks[index]);
+				chunks[index]=chunks.back();
+				chunks.pop_back();
+				}
+			}
+		report("Chunk Allocator Churn",numAllocations,start.setAndDiff(),csv);
+		}
+		
+		/* Shut down the worker threads: */
+		settings.setWorkerPool(0);
+		delete workerPool;
+		}
+	catch(const std::runtime_error& err)
+		{
+		fprintf(stderr,"%s: Terminated due to exception %s\n",argv[0],err.what());
+		return 1;
+		}
+	
+	return 0;
+	}
@@ -0,0 +1,123 @@
+/***********************************************************************
+SketchPadTest - Headless test harness checking the behavior of sketch
+object lists, settings, and the undo history without a Vrui kernel.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <stdio.h>
+#include <vector>
+#include <stdexcept>
+
+#include "SketchGeometry.h"
+#include "PolylineRenderer.h"
+#include "SketchObject.h"
+#include "SketchObjectList.h"
+#include "SketchSettings.h"
+#include "Curve.h"
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+unsigned int numFailures=0; // Number of failed checks
+
+void check(bool condition,const char* testName,const char* description) // Reports a failed check
+	{
+	if(!condition)
+		{
+		fprintf(stderr,"%s: %s\n",testName,description);
+		++numFailures;
+		}
+	}
+
+SketchObject* drawLine(CurveFactory& factory,const Point& start,const Point& end) // Draws a straight curve between the given points like a sketching tool would, and returns it
+	{
+	factory.buttonDown(start);
+	for(int i=1;i<=8;++i)
+		factory.motion(Geometry::affineCombination(start,end,Scalar(i)/Scalar(8)),false,false);
+	factory.buttonUp(end);
+	return factory.finish();
+	}
+
+/******
+Tests:
+******/
+
+void testUndoAfterPageOut(void) // Checks that paging out sketch objects only discards the edits that refer to them
+	{
+	const char* testName="Undo after page-out";
+	SketchSettings settings;
+	settings.setLineWidth(0.01f);
+	settings.setDetailSize(Scalar(0.001));
+	CurveFactory factory(settings);
+	
+	/* Page in a sketch object from a board tile, and draw an unrelated one far away: */
+	SketchObject* pagedObject=drawLine(factory,Point(0,0,0),Point(1,0,0));
+	settings.pageIn(pagedObject,0);
+	SketchObject* drawnObject=drawLine(factory,Point(100,100,0),Point(101,100,0));
+	settings.append(drawnObject);
+	check(!settings.isInHistory(pagedObject),testName,"Paged-in sketch object is referenced by the history");
+	check(settings.isInHistory(drawnObject),testName,"Drawn sketch object is not referenced by the history");
+	
+	/* Page out the unrelated tile's sketch object, and undo and redo drawing the other one: */
+	std::vector<SketchObject*> pagedOut;
+	pagedOut.push_back(pagedObject);
+	settings.pageOut(pagedOut);
+	check(settings.getSketchObjects().size()==1,testName,"Page-out did not remove the paged-out sketch object");
+	check(settings.undo(),testName,"Could not undo after paging out an unrelated sketch object");
+	check(settings.getSketchObjects().empty(),testName,"Undo did not remove the drawn sketch object");
+	check(settings.redo(),testName,"Could not redo after paging out an unrelated sketch object");
+	check(settings.getSketchObjects().size()==1,testName,"Redo did not restore the drawn sketch object");
+	
+	/* Page out the drawn sketch object, which must discard the edit referring to it: */
+	pagedOut.clear();
+	pagedOut.push_back(&*settings.getSketchObjects().begin());
+	settings.pageOut(pagedOut);
+	check(!settings.undo(),testName,"Could undo an edit referring to a paged-out sketch object");
+	}
+
+}
+
+int main(int argc,char* argv[])
+	{
+	try
+		{
+		/* Use the polyline renderer without a Vrui kernel: */
+		PolylineRenderer::setHeadless(true);
+		
+		/* Run all tests: */
+		testUndoAfterPageOut();
+		}
+	catch(const std::runtime_error& err)
+		{
+		fprintf(stderr,"%s: Terminated due to exception %s\n",argv[0],err.what());
+		return 1;
+		}
+	
+	if(numFailures>0)
+		{
+		fprintf(stderr,"%s: %u checks failed\n",argv[0],numFailures);
+		return 1;
+		}
+	printf("%s: All checks passed\n",argv[0]);
+	return 0;
+	}
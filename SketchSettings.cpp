@@ -23,6 +23,9 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include "SketchSettings.h"
 
+#include <vector>
+#include <Misc/StdError.h>
+#include <IO/File.h>
 #include <Math/Math.h>
 #include <Math/Constants.h>
 #include <GL/gl.h>
@@ -30,13 +33,229 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <GL/GLGeometryWrappers.h>
 #include <GL/GLTransformationWrappers.h>
 
+#include "Stats.h"
+#include "Capsule.h"
 #include "RenderState.h"
 #include "Group.h"
+#include "DeferredContainer.h"
+#include "WorkerPool.h"
+
+namespace {
+
+/*******************************************
+Helper class to rub out objects in parallel:
+*******************************************/
+
+class RuboutJob:public WorkerPool::Job
+	{
+	/* Elements: */
+	private:
+	const Capsule& eraser; // The eraser capsule
+	const std::vector<SketchObject*>& objects; // List of objects to rub out
+	const std::vector<DeferredContainer*>& changes; // List of containers recording the changes made by rubbing out each object
+	
+	/* Constructors and destructors: */
+	public:
+	RuboutJob(const Capsule& sEraser,const std::vector<SketchObject*>& sObjects,const std::vector<DeferredContainer*>& sChanges)
+		:eraser(sEraser),objects(sObjects),changes(sChanges)
+		{
+		}
+	
+	/* Methods from WorkerPool::Job: */
+	virtual void process(size_t item)
+		{
+		/* Rub out the object, recording the resulting list changes: */
+		objects[item]->rubout(eraser,*changes[item]);
+		}
+	};
+
+/***********************************************************
+Helper class to edit or clone selected objects in parallel:
+***********************************************************/
+
+class SelectionJob:public WorkerPool::Job
+	{
+	/* Embedded classes: */
+	public:
+	enum Operation // Enumerated type for operations applied to selected objects
+		{
+		ApplySettings,Transform,SnapToGrid,Clone
+		};
+	
+	/* Elements: */
+	private:
+	Operation operation; // The operation to apply
+	const std::vector<SketchObject*>& objects; // List of objects to edit or clone
+	const SketchSettings* settings; // Settings to apply to the objects
+	Transformation transform; // Transformation to apply to the objects
+	Scalar gridSize; // Grid size to which to snap the objects
+	std::vector<SketchObject*>* clones; // List receiving the clones of the objects
+	
+	/* Constructors and destructors: */
+	public:
+	SelectionJob(const std::vector<SketchObject*>& sObjects,const SketchSettings& sSettings) // Creates a job applying the given settings
+		:operation(ApplySettings),objects(sObjects),settings(&sSettings),transform(Transformation::identity),gridSize(0),clones(0)
+		{
+		}
+	SelectionJob(const std::vector<SketchObject*>& sObjects,const Transformation& sTransform) // Creates a job applying the given transformation
+		:operation(Transform),objects(sObjects),settings(0),transform(sTransform),gridSize(0),clones(0)
+		{
+		}
+	SelectionJob(const std::vector<SketchObject*>& sObjects,Scalar sGridSize) // Creates a job snapping to a grid of the given size
+		:operation(SnapToGrid),objects(sObjects),settings(0),transform(Transformation::identity),gridSize(sGridSize),clones(0)
+		{
+		}
+	SelectionJob(const std::vector<SketchObject*>& sObjects,std::vector<SketchObject*>& sClones) // Creates a job cloning the objects into the given list, which is resized
+		:operation(Clone),objects(sObjects),settings(0),transform(Transformation::identity),gridSize(0),clones(&sClones)
+		{
+		clones->resize(objects.size(),0);
+		}
+	
+	/* Methods from WorkerPool::Job: */
+	virtual void process(size_t item)
+		{
+		/* Apply the operation to the object, which only changes that object or creates a new one: */
+		switch(operation)
+			{
+			case ApplySettings:
+				objects[item]->applySettings(*settings);
+				break;
+			
+			case Transform:
+				objects[item]->transform(transform);
+				break;
+			
+			case SnapToGrid:
+				objects[item]->snapToGrid(gridSize);
+				break;
+			
+			case Clone:
+				(*clones)[item]=objects[item]->clone();
+				break;
+			}
+		}
+	
+	/* New methods: */
+	void run(WorkerPool* workerPool) // Processes all objects in the given worker pool, or on the calling thread if there is no pool
+		{
+		if(workerPool!=0&&objects.size()>1)
+			workerPool->run(*this,objects.size());
+		else
+			{
+			for(size_t i=0;i<objects.size();++i)
+				process(i);
+			}
+		}
+	};
+
+}
 
 /*******************************
 Methods of class SketchSettings:
 *******************************/
 
+void SketchSettings::addObjectId(SketchObject* object,bool newObject)
+	{
+	/* Assign the next identifier from the current base or from this site's namespace: */
+	if(newObject||object->id==0)
+		{
+		if(objectIdBase!=0)
+			object->id=objectIdBase++;
+		else
+			object->id=nextObjectId;
+		}
+	objectIds.setEntry(SketchObjectIdMap::Entry(object->id,object));
+	
+	/* Never assign an identifier from this site's namespace twice: */
+	if((object->id>>siteIdShift)==siteId&&nextObjectId<=object->id)
+		nextObjectId=object->id+1;
+	}
+
+void SketchSettings::removeObjectId(SketchObject* object)
+	{
+	objectIds.removeEntry(object->id);
+	}
+
+void SketchSettings::logPlacement(const SketchObject* object,bool toFront)
+	{
+	if(placementLog!=0)
+		{
+		Placement p;
+		p.objectId=object->id;
+		p.toFront=toFront;
+		placementLog->push_back(p);
+		}
+	}
+
+void SketchSettings::linkObject(SketchObject* object,SketchObject* succ)
+	{
+	/* Insert the object into the list, the identifier map, and the spatial index: */
+	sketchObjects.insert(SketchObjectList::iterator(succ),object);
+	addObjectId(object,false);
+	index.insert(object);
+	}
+
+void SketchSettings::unlinkObject(SketchObject* object)
+	{
+	/* De-select the object and remove it from the spatial index, the identifier map, and the list: */
+	selectedObjects.removeEntry(object);
+	savedSelection.removeEntry(object);
+	index.remove(object);
+	removeObjectId(object);
+	sketchObjects.unlink(SketchObjectList::iterator(object));
+	}
+
+void SketchSettings::replaceObject(SketchObject* object,SketchObject* replacement)
+	{
+	/* Remove the object and insert the replacement in its place under the object's identifier: */
+	bool selected=selectedObjects.isEntry(object);
+	bool saved=savedSelection.isEntry(object);
+	SketchObject* succ=SketchObjectList::getSucc(object);
+	remove(object);
+	replacement->id=object->id;
+	linkObject(replacement,succ);
+	history.recordInsert(replacement,succ);
+	
+	/* Select the replacement if the object was selected: */
+	if(selected)
+		selectedObjects.setEntry(replacement);
+	if(saved)
+		savedSelection.setEntry(replacement);
+	}
+
+SketchObject* SketchSettings::makeEditable(SketchObject* object)
+	{
+	/* Change the object in place if the history does not need its current state, discarding recorded edits that would undo or redo the change: */
+	if(!history.isEnabled())
+		{
+		history.discardEdits(object);
+		return object;
+		}
+	if(history.isCreated(object))
+		return object;
+	
+	/* Replace the object with a clone, which shares the object's unchanged data, and keep the object in the history: */
+	SketchObject* result=object->clone();
+	replaceObject(object,result);
+	
+	return result;
+	}
+
+void SketchSettings::moveObject(SketchObject* object,bool toFront)
+	{
+	/* Unlink the object from the list and re-insert it at the beginning or end of the list: */
+	SketchObject* succ=SketchObjectList::getSucc(object);
+	sketchObjects.unlink(SketchObjectList::iterator(object));
+	history.recordRemove(object,succ);
+	SketchObject* newSucc=!toFront&&!sketchObjects.empty()?&*sketchObjects.begin():0;
+	sketchObjects.insert(SketchObjectList::iterator(newSucc),object);
+	history.recordInsert(object,newSucc);
+	logPlacement(object,toFront);
+	
+	/* Redraw the object in its new place in the drawing order: */
+	index.touch(object);
+	}
+
 SketchSettings::SketchSettings(void)
 	:color(255U,255U,255U),
 	 lineWidth(1.0f),
@@ -46,15 +265,40 @@ SketchSettings::SketchSettings(void)
 	 highlightColor(0U,0U,0U),
 	 lingerSize(0),lingerTime(0.5),
 	 highlightCycleLength(1),highlightCycle(0),
-	 selectedObjects(17)
+	 selectedObjects(17),savedSelection(17),
+	 objectIds(17),siteId(0),nextObjectId(1),objectIdBase(0),placementLog(0),
+	 workerPool(0),
+	 history(size_t(64)<<20),
+	 historyListener(0)
 	{
 	}
 
+void SketchSettings::append(SketchObject* newObject)
+	{
+	/* Call the base class method: */
+	SketchObjectContainer::append(newObject);
+	
+	/* Assign a new identifier to the new object and add it to the spatial index: */
+	addObjectId(newObject,true);
+	index.insert(newObject);
+	
+	/* Record the change in the history: */
+	history.recordInsert(newObject,0);
+	logPlacement(newObject,true);
+	}
+
 void SketchSettings::insertAfter(SketchObject* pred,SketchObject* newObject)
 	{
 	/* Call the base class method: */
 	SketchObjectContainer::insertAfter(pred,newObject);
 	
+	/* Assign a new identifier to the new object, add it to the spatial index, and record the change in the history; the base class method inserts the new object in front of the given object: */
+	addObjectId(newObject,true);
+	index.insert(newObject);
+	history.recordInsert(newObject,pred);
+	if(pred==0)
+		logPlacement(newObject,true);
+	
 	/* Check if the predecessor is selected: */
 	if(pred!=0&&selectedObjects.isEntry(pred))
 		{
@@ -65,11 +309,51 @@ void SketchSettings::insertAfter(SketchObject* pred,SketchObject* newObject)
 
 void SketchSettings::remove(SketchObject* object)
 	{
-	/* De-select the object: */
-	selectedObjects.removeEntry(object);
+	if(history.isEnabled())
+		{
+		/* Remove the object and hand it to the history: */
+		SketchObject* succ=SketchObjectList::getSucc(object);
+		unlinkObject(object);
+		history.recordRemove(object,succ);
+		}
+	else
+		{
+		/* Discard recorded edits that refer to the object: */
+		history.discardEdits(object);
+		
+		/* De-select the object and remove it from the spatial index and the identifier map: */
+		selectedObjects.removeEntry(object);
+		savedSelection.removeEntry(object);
+		index.remove(object);
+		removeObjectId(object);
+		
+		/* Call the base class method: */
+		SketchObjectContainer::remove(object);
+		}
+	}
+
+void SketchSettings::update(SketchObject* object)
+	{
+	/* Update the object's entry in the spatial index: */
+	index.update(object);
+	}
+
+SketchObject::PickResult SketchSettings::pick(const Point& pos,Scalar radius)
+	{
+	/* Find all objects whose extents overlap the pick sphere's bounding box and sort them into list order: */
+	std::vector<SketchObject*> candidates;
+	index.find(Box(pos-Vector(radius,radius,radius),pos+Vector(radius,radius,radius)),candidates);
+	SketchObjectList::sort(candidates);
 	
-	/* Call the base class method: */
-	SketchObjectContainer::remove(object);
+	/* Create a pick result: */
+	SketchObject::PickResult result(pos,radius);
+	
+	/* Pick candidate objects from topmost to bottommost: */
+	SKETCHPAD_STATS_COUNT(PickedObjects,(unsigned int)(candidates.size()));
+	for(std::vector<SketchObject*>::reverse_iterator cIt=candidates.rbegin();cIt!=candidates.rend();++cIt)
+		(*cIt)->pick(result);
+	
+	return result;
 	}
 
 bool SketchSettings::setHighlightCycle(double applicationTime)
@@ -133,10 +417,148 @@ void SketchSettings::setLingerTime(double newLingerTime)
 	lingerTime=newLingerTime;
 	}
 
+void SketchSettings::setWorkerPool(WorkerPool* newWorkerPool)
+	{
+	workerPool=newWorkerPool;
+	}
+
+void SketchSettings::setHistoryMemorySize(size_t newHistoryMemorySize)
+	{
+	history.setMaxMemorySize(newHistoryMemorySize);
+	}
+
+void SketchSettings::setHistoryListener(SketchHistory::Listener* newHistoryListener)
+	{
+	historyListener=newHistoryListener;
+	}
+
+void SketchSettings::setSketchObjects(SketchObjectList& newSketchObjects)
+	{
+	/* Clear the selection, the spatial index, the identifier map, and the history and delete all current sketch objects: */
+	selectedObjects.clear();
+	savedSelection.clear();
+	index.clear();
+	objectIds.clear();
+	history.clear();
+	sketchObjects.clear();
+	
+	/* Assign new identifiers to all new sketch objects in list order, add them to the spatial index, and take them over: */
+	for(SketchObjectList::iterator soIt=newSketchObjects.begin();soIt!=newSketchObjects.end();++soIt)
+		{
+		addObjectId(&*soIt,true);
+		index.insert(&*soIt);
+		}
+	newSketchObjects.transfer(sketchObjects);
+	}
+
+void SketchSettings::pageIn(SketchObject* object,SketchObject* succ)
+	{
+	linkObject(object,succ);
+	}
+
+void SketchSettings::pageOut(const std::vector<SketchObject*>& objects)
+	{
+	/* Remove and delete the objects after discarding any edits that refer to them, which can no longer be undone or redone: */
+	for(std::vector<SketchObject*>::const_iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+		{
+		history.discardEdits(*oIt);
+		unlinkObject(*oIt);
+		delete *oIt;
+		}
+	}
+
+SketchObject* SketchSettings::findObject(Misc::UInt64 objectId)
+	{
+	SketchObjectIdMap::Iterator oiIt=objectIds.findEntry(objectId);
+	return !oiIt.isFinished()?oiIt->getDest():0;
+	}
+
+void SketchSettings::setSiteId(unsigned int newSiteId)
+	{
+	/* Start the new site's namespace after all of its identifiers that are already in use: */
+	siteId=newSiteId;
+	nextObjectId=(Misc::UInt64(siteId)<<siteIdShift)+1;
+	for(SketchObjectIdMap::Iterator oiIt=objectIds.begin();!oiIt.isFinished();++oiIt)
+		if((oiIt->getSource()>>siteIdShift)==siteId&&nextObjectId<=oiIt->getSource())
+			nextObjectId=oiIt->getSource()+1;
+	}
+
+unsigned int SketchSettings::getMaxObjectSiteId(void) const
+	{
+	unsigned int result=0;
+	for(SketchObjectIdMap::ConstIterator oiIt=objectIds.begin();!oiIt.isFinished();++oiIt)
+		if(result<(unsigned int)(oiIt->getSource()>>siteIdShift))
+			result=(unsigned int)(oiIt->getSource()>>siteIdShift);
+	return result;
+	}
+
+void SketchSettings::writeObjectIds(IO::File& file) const
+	{
+	file.write<Misc::UInt32>(Misc::UInt32(sketchObjects.size()));
+	for(SketchObjectList::const_iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
+		file.write<Misc::UInt64>(soIt->id);
+	}
+
+void SketchSettings::readObjectIds(IO::File& file)
+	{
+	/* Check that the identifiers match the sketch objects: */
+	size_t numIds=file.read<Misc::UInt32>();
+	if(numIds!=sketchObjects.size())
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Mismatching number of object identifiers");
+	
+	std::vector<Misc::UInt64> ids(numIds);
+	if(!ids.empty())
+		file.read(&ids.front(),ids.size());
+	
+	/* Replace the sketch objects' identifiers: */
+	objectIds.clear();
+	bool valid=true;
+	std::vector<Misc::UInt64>::iterator iIt=ids.begin();
+	for(SketchObjectList::iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end()&&valid;++soIt,++iIt)
+		{
+		valid=*iIt!=0&&findObject(*iIt)==0;
+		if(valid)
+			{
+			soIt->id=*iIt;
+			addObjectId(&*soIt,false);
+			}
+		}
+	
+	if(!valid)
+		{
+		/* Fall back to new identifiers and signal the error: */
+		objectIds.clear();
+		for(SketchObjectList::iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
+			addObjectId(&*soIt,true);
+		throw Misc::makeStdErr(__PRETTY_FUNCTION__,"Duplicate object identifiers");
+		}
+	}
+
+void SketchSettings::setPlacementLog(std::vector<SketchSettings::Placement>* newPlacementLog)
+	{
+	placementLog=newPlacementLog;
+	}
+
+void SketchSettings::repeatPlacements(const std::vector<SketchSettings::Placement>& placements)
+	{
+	for(std::vector<Placement>::const_iterator pIt=placements.begin();pIt!=placements.end();++pIt)
+		{
+		SketchObject* object=findObject(pIt->objectId);
+		if(object!=0)
+			{
+			/* Move the object to the beginning or end of the list and redraw it in its new place in the drawing order: */
+			sketchObjects.unlink(SketchObjectList::iterator(object));
+			SketchObject* newSucc=!pIt->toFront&&!sketchObjects.empty()?&*sketchObjects.begin():0;
+			sketchObjects.insert(SketchObjectList::iterator(newSucc),object);
+			index.touch(object);
+			}
+		}
+	}
+
 Point SketchSettings::snap(const Point& pos)
 	{
 	/* Pick all objects: */
-	SketchObject::PickResult pickResult=SketchObjectContainer::pick(pos,pickRadius);
+	SketchObject::PickResult pickResult=pick(pos,pickRadius);
 	if(pickResult.isValid())
 		{
 		/* Return the picked point: */
@@ -170,18 +592,33 @@ SketchObject::PickResult SketchSettings::pickSelected(const Point& pos)
 	SketchObject::PickResult result(pos,pickRadius);
 	
 	/* Pick the selected objects: */
+	SKETCHPAD_STATS_COUNT(PickedObjects,(unsigned int)(selectedObjects.getNumEntries()));
 	for(SketchObjectSet::Iterator ssoIt=selectedObjects.begin();!ssoIt.isFinished();++ssoIt)
 		ssoIt->getSource()->pick(result);
 	
 	return result;
 	}
 
+void SketchSettings::getSelectedObjects(std::vector<SketchObject*>& objects) const
+	{
+	/* Collect the selected objects and sort them into list order, so that operations on the selection keep their relative drawing order: */
+	for(SketchObjectSet::ConstIterator ssoIt=selectedObjects.begin();!ssoIt.isFinished();++ssoIt)
+		objects.push_back(ssoIt->getSource());
+	SketchObjectList::sort(objects);
+	}
+
 void SketchSettings::select(const Point& pos)
 	{
+	/* Find all objects whose extents overlap the pick sphere's bounding box and sort them into list order: */
+	std::vector<SketchObject*> candidates;
+	index.find(Box(pos-Vector(pickRadius,pickRadius,pickRadius),pos+Vector(pickRadius,pickRadius,pickRadius)),candidates);
+	SketchObjectList::sort(candidates);
+	
 	/* Pick an object at the given position: */
+	SKETCHPAD_STATS_COUNT(PickedObjects,(unsigned int)(candidates.size()));
 	SketchObject::PickResult pickResult(pos,pickRadius);
-	for(SketchObjectList::iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
-		soIt->pick(pickResult);
+	for(std::vector<SketchObject*>::iterator cIt=candidates.begin();cIt!=candidates.end();++cIt)
+		(*cIt)->pick(pickResult);
 	
 	/* Select a picked object: */
 	if(pickResult.isValid())
@@ -190,21 +627,129 @@ void SketchSettings::select(const Point& pos)
 
 void SketchSettings::select(const Box& box)
 	{
-	/* Check every object against the box: */
-	for(SketchObjectList::iterator soIt=sketchObjects.begin();soIt!=sketchObjects.end();++soIt)
+	/* Find all objects whose extents overlap the box: */
+	std::vector<SketchObject*> candidates;
+	index.find(box,candidates);
+	
+	/* Check every candidate object against the box: */
+	for(std::vector<SketchObject*>::iterator cIt=candidates.begin();cIt!=candidates.end();++cIt)
 		{
-		const Box& obox=soIt->getBoundingBox();
+		const Box& obox=(*cIt)->getBoundingBox();
 		if(box.min[0]<=obox.min[0]&&box.max[0]>=obox.max[0]&&box.min[1]<=obox.min[1]&&box.max[1]>=obox.max[1])
-			selectedObjects.setEntry(&*soIt);
+			selectedObjects.setEntry(*cIt);
 		}
 	}
 
+void SketchSettings::findErasedObjects(const Capsule& eraser,std::vector<SketchObject*>& objects)
+	{
+	/* Find all objects whose extents overlap the eraser capsule's bounding box: */
+	Point min,max;
+	for(int i=0;i<3;++i)
+		{
+		min[i]=Math::min(eraser.getC0()[i],eraser.getC1()[i])-eraser.getRadius();
+		max[i]=Math::max(eraser.getC0()[i],eraser.getC1()[i])+eraser.getRadius();
+		}
+	std::vector<SketchObject*> candidates;
+	index.find(Box(min,max),candidates);
+	
+	/* Keep only those candidate objects that the eraser might change, so that the history does not clone objects that stay unchanged: */
+	for(std::vector<SketchObject*>::iterator cIt=candidates.begin();cIt!=candidates.end();++cIt)
+		if(eraser.doesIntersect((*cIt)->getBoundingBox())&&(*cIt)->isErased(eraser))
+			objects.push_back(*cIt);
+	}
+
+void SketchSettings::rubout(const Capsule& eraser,const std::vector<SketchObject*>& objects)
+	{
+	SKETCHPAD_STATS_COUNT(RuboutObjects,(unsigned int)(objects.size()));
+	
+	history.beginEdit();
+	if(workerPool!=0&&objects.size()>1)
+		{
+		/* Rub out clones of all objects whose current state the history needs, so that unchanged objects can be kept: */
+		std::vector<SketchObject*> targets;
+		for(std::vector<SketchObject*>::const_iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+			{
+			if(!history.isEnabled())
+				history.discardEdits(*oIt);
+			targets.push_back(history.isEnabled()&&!history.isCreated(*oIt)?(*oIt)->clone():*oIt);
+			}
+		
+		/* Rub out all objects in parallel; rubbing out an object only deletes or splits that object, so the resulting list changes can be recorded independently: */
+		std::vector<DeferredContainer*> changes;
+		for(size_t i=0;i<objects.size();++i)
+			changes.push_back(new DeferredContainer);
+		RuboutJob job(eraser,targets,changes);
+		workerPool->run(job,objects.size());
+		
+		/* Apply the recorded changes to the object list in a fixed order: */
+		for(size_t i=0;i<objects.size();++i)
+			{
+			if(targets[i]!=objects[i])
+				{
+				/* Discard the clone if the object was not changed, or replace the object with it otherwise: */
+				if(changes[i]->empty())
+					delete targets[i];
+				else
+					replaceObject(objects[i],targets[i]);
+				}
+			changes[i]->commit(*this);
+			delete changes[i];
+			}
+		}
+	else
+		{
+		/* Erase from all objects in turn: */
+		for(std::vector<SketchObject*>::const_iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+			{
+			if(history.isEnabled()&&!history.isCreated(*oIt))
+				{
+				/* Rub out a clone of the object and replace the object with it if it changed: */
+				SketchObject* target=(*oIt)->clone();
+				DeferredContainer changes;
+				target->rubout(eraser,changes);
+				if(changes.empty())
+					delete target;
+				else
+					{
+					replaceObject(*oIt,target);
+					changes.commit(*this);
+					}
+				}
+			else
+				{
+				if(!history.isEnabled())
+					history.discardEdits(*oIt);
+				(*oIt)->rubout(eraser,*this);
+				}
+			}
+		}
+	history.endEdit();
+	}
+
 void SketchSettings::selectNone(void)
 	{
 	/* Clear the selection set: */
 	selectedObjects.clear();
 	}
 
+void SketchSettings::saveSelection(void)
+	{
+	/* Move the current selection aside, leaving an empty selection: */
+	savedSelection.clear();
+	for(SketchObjectSet::Iterator ssoIt=selectedObjects.begin();!ssoIt.isFinished();++ssoIt)
+		savedSelection.setEntry(ssoIt->getSource());
+	selectedObjects.clear();
+	}
+
+void SketchSettings::restoreSelection(void)
+	{
+	/* Replace the current selection with the saved one, which lost all objects removed in the meantime and followed all replaced objects: */
+	selectedObjects.clear();
+	for(SketchObjectSet::Iterator ssoIt=savedSelection.begin();!ssoIt.isFinished();++ssoIt)
+		selectedObjects.setEntry(ssoIt->getSource());
+	savedSelection.clear();
+	}
+
 void SketchSettings::selectAll(void)
 	{
 	/* Add all sketch objects to the selection set: */
@@ -218,43 +763,71 @@ void SketchSettings::cloneSelection(void)
 	if(selectedObjects.getNumEntries()==0)
 		return;
 	
-	/* Clone the first selected object: */
-	SketchObjectSet::Iterator ssoIt=selectedObjects.begin();
-	SketchObject* firstClone=ssoIt->getSource()->clone();
-	sketchObjects.push_back(firstClone);
-	++ssoIt;
-	while(!ssoIt.isFinished())
-		{
-		/* Clone the object: */
-		sketchObjects.push_back(ssoIt->getSource()->clone());
-		++ssoIt;
-		}
+	/* Clone all selected objects in parallel: */
+	std::vector<SketchObject*> objects;
+	getSelectedObjects(objects);
+	std::vector<SketchObject*> clones;
+	SelectionJob job(objects,clones);
+	job.run(workerPool);
+	
+	/* Append the clones to the list in the selected objects' list order: */
+	history.beginEdit();
+	for(std::vector<SketchObject*>::iterator cIt=clones.begin();cIt!=clones.end();++cIt)
+		append(*cIt);
+	history.endEdit();
 	
 	/* Clear the current selection and select all cloned objects: */
 	selectedObjects.clear();
-	for(SketchObjectList::iterator soIt=firstClone;soIt!=sketchObjects.end();++soIt)
-		selectedObjects.setEntry(&*soIt);
+	for(std::vector<SketchObject*>::iterator cIt=clones.begin();cIt!=clones.end();++cIt)
+		selectedObjects.setEntry(*cIt);
 	}
 
 void SketchSettings::applySettingsToSelection(void)
 	{
-	/* Apply the current settings to all selected objects: */
-	for(SketchObjectSet::Iterator ssoIt=selectedObjects.begin();!ssoIt.isFinished();++ssoIt)
-		ssoIt->getSource()->applySettings(*this);
+	/* Replace all selected objects whose current state the history needs with clones: */
+	std::vector<SketchObject*> objects;
+	getSelectedObjects(objects);
+	history.beginEdit();
+	for(std::vector<SketchObject*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+		*oIt=makeEditable(*oIt);
+	
+	/* Apply the current settings to all objects in parallel and update them in the spatial index: */
+	SelectionJob job(objects,*this);
+	job.run(workerPool);
+	for(std::vector<SketchObject*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+		index.update(*oIt);
+	history.endEdit();
 	}
 
 void SketchSettings::groupSelection(void)
 	{
 	/* Create a new group object and add all selected objects to it: */
+	std::vector<SketchObject*> objects;
+	getSelectedObjects(objects);
+	history.beginEdit();
 	Group* newGroup=new Group;
-	for(SketchObjectSet::Iterator ssoIt=selectedObjects.begin();!ssoIt.isFinished();++ssoIt)
+	for(std::vector<SketchObject*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
 		{
-		SketchObject* obj=sketchObjects.unlink(SketchObjectList::iterator(ssoIt->getSource()));
-		newGroup->append(obj);
+		if(history.isEnabled())
+			{
+			/* Add a clone of the object to the group and keep the object in the history: */
+			newGroup->append((*oIt)->clone());
+			remove(*oIt);
+			}
+		else
+			{
+			history.discardEdits(*oIt);
+			savedSelection.removeEntry(*oIt);
+			index.remove(*oIt);
+			removeObjectId(*oIt);
+			SketchObject* obj=sketchObjects.unlink(SketchObjectList::iterator(*oIt));
+			newGroup->append(obj);
+			}
 		}
 	
 	/* Add the new group to the list of sketch objects: */
-	sketchObjects.push_back(newGroup);
+	append(newGroup);
+	history.endEdit();
 	
 	/* Select the new group: */
 	selectedObjects.clear();
@@ -267,18 +840,41 @@ void SketchSettings::ungroupSelection(void)
 	std::vector<SketchObject*> newSelectedObjects;
 	
 	/* Ungroup all selected group objects: */
-	for(SketchObjectSet::Iterator ssoIt=selectedObjects.begin();!ssoIt.isFinished();++ssoIt)
+	std::vector<SketchObject*> objects;
+	getSelectedObjects(objects);
+	history.beginEdit();
+	for(std::vector<SketchObject*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
 		{
 		/* Check if the object is a group: */
-		Group* group=dynamic_cast<Group*>(ssoIt->getSource());
-		if(group!=0)
+		Group* group=dynamic_cast<Group*>(*oIt);
+		if(group!=0&&history.isEnabled())
 			{
-			/* Remove the group from the object list: */
+			/* Append clones of the group's members to the object list and keep the group in the history: */
+			for(SketchObjectList::iterator mIt=group->getSketchObjects().begin();mIt!=group->getSketchObjects().end();++mIt)
+				{
+				SketchObject* member=mIt->clone();
+				append(member);
+				newSelectedObjects.push_back(member);
+				}
+			remove(group);
+			}
+		else if(group!=0)
+			{
+			/* Remove the group from the object list and the spatial index: */
+			history.discardEdits(group);
+			savedSelection.removeEntry(group);
+			index.remove(group);
+			removeObjectId(group);
 			sketchObjects.unlink(SketchObjectList::iterator(group));
 			
-			/* Add the group's former members to the new selection list: */
+			/* Add the group's former members to the new selection list, the identifier map, and the spatial index: */
 			for(SketchObjectList::iterator mIt=group->getSketchObjects().begin();mIt!=group->getSketchObjects().end();++mIt)
+				{
 				newSelectedObjects.push_back(&*mIt);
+				addObjectId(&*mIt,true);
+				index.insert(&*mIt);
+				logPlacement(&*mIt,true);
+				}
 			
 			/* Transfer the group's members to the object list: */
 			group->transferMembers(sketchObjects);
@@ -289,9 +885,10 @@ void SketchSettings::ungroupSelection(void)
 		else
 			{
 			/* Add the object to the new selection list: */
-			newSelectedObjects.push_back(ssoIt->getSource());
+			newSelectedObjects.push_back(*oIt);
 			}
 		}
+	history.endEdit();
 	
 	/* Select all objects from the new selection list: */
 	selectedObjects.clear();
@@ -301,29 +898,35 @@ void SketchSettings::ungroupSelection(void)
 
 void SketchSettings::selectionToBack(void)
 	{
-	/* Unlink all selected objects from the object list and re-insert them at the beginning of the list: */
-	for(SketchObjectSet::Iterator ssoIt=selectedObjects.begin();!ssoIt.isFinished();++ssoIt)
-		{
-		sketchObjects.unlink(SketchObjectList::iterator(ssoIt->getSource()));
-		sketchObjects.insert(sketchObjects.begin(),ssoIt->getSource());
-		}
+	/* Unlink all selected objects from the object list and re-insert them at the beginning of the list, back to front to keep their relative order: */
+	std::vector<SketchObject*> objects;
+	getSelectedObjects(objects);
+	history.beginEdit();
+	for(std::vector<SketchObject*>::reverse_iterator oIt=objects.rbegin();oIt!=objects.rend();++oIt)
+		moveObject(*oIt,false);
+	history.endEdit();
 	}
 
 void SketchSettings::selectionToFront(void)
 	{
-	/* Unlink all selected objects from the object list and re-insert them at the end of the list: */
-	for(SketchObjectSet::Iterator ssoIt=selectedObjects.begin();!ssoIt.isFinished();++ssoIt)
-		{
-		sketchObjects.unlink(SketchObjectList::iterator(ssoIt->getSource()));
-		sketchObjects.insert(sketchObjects.end(),ssoIt->getSource());
-		}
+	/* Unlink all selected objects from the object list and re-insert them at the end of the list, front to back to keep their relative order: */
+	std::vector<SketchObject*> objects;
+	getSelectedObjects(objects);
+	history.beginEdit();
+	for(std::vector<SketchObject*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+		moveObject(*oIt,true);
+	history.endEdit();
 	}
 
 void SketchSettings::deleteSelection(void)
 	{
-	/* Delete all selected objects: */
-	for(SketchObjectSet::Iterator ssoIt=selectedObjects.begin();!ssoIt.isFinished();++ssoIt)
-		sketchObjects.erase(SketchObjectList::iterator(ssoIt->getSource()));
+	/* Delete all selected objects, or hand them to the history: */
+	std::vector<SketchObject*> objects;
+	getSelectedObjects(objects);
+	history.beginEdit();
+	for(std::vector<SketchObject*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+		remove(*oIt);
+	history.endEdit();
 	
 	/* Clear the selection: */
 	selectedObjects.clear();
@@ -331,31 +934,132 @@ void SketchSettings::deleteSelection(void)
 
 void SketchSettings::transformSelectedObjects(const Transformation& transform)
 	{
-	/* Apply the given transformation to all selected objects: */
-	for(SketchObjectSet::Iterator ssoIt=selectedObjects.begin();!ssoIt.isFinished();++ssoIt)
-		ssoIt->getSource()->transform(transform);
+	/* Replace all selected objects whose current state the history needs with clones: */
+	std::vector<SketchObject*> objects;
+	getSelectedObjects(objects);
+	history.beginEdit();
+	for(std::vector<SketchObject*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+		*oIt=makeEditable(*oIt);
+	
+	/* Transform all objects in parallel and update them in the spatial index: */
+	SelectionJob job(objects,transform);
+	job.run(workerPool);
+	for(std::vector<SketchObject*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+		index.update(*oIt);
+	history.endEdit();
 	}
 
 void SketchSettings::snapSelectedObjectsToGrid(void)
 	{
 	if(gridEnabled)
 		{
-		/* Snap all selected objects: */
-		for(SketchObjectSet::Iterator ssoIt=selectedObjects.begin();!ssoIt.isFinished();++ssoIt)
-			ssoIt->getSource()->snapToGrid(gridSize);
+		/* Replace all selected objects whose current state the history needs with clones: */
+		std::vector<SketchObject*> objects;
+		getSelectedObjects(objects);
+		history.beginEdit();
+		for(std::vector<SketchObject*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+			*oIt=makeEditable(*oIt);
+		
+		/* Snap all objects in parallel and update them in the spatial index: */
+		SelectionJob job(objects,gridSize);
+		job.run(workerPool);
+		for(std::vector<SketchObject*>::iterator oIt=objects.begin();oIt!=objects.end();++oIt)
+			index.update(*oIt);
+		history.endEdit();
 		}
 	}
 
+bool SketchSettings::undo(void)
+	{
+	/* Get the most recent edit: */
+	const SketchHistory::Edit* edit=history.undo();
+	if(edit==0)
+		return false;
+	
+	/* Revert the edit's changes in reverse order: */
+	for(std::vector<SketchHistory::Change>::const_reverse_iterator cIt=edit->changes.rbegin();cIt!=edit->changes.rend();++cIt)
+		{
+		if(cIt->insert)
+			{
+			if(historyListener!=0)
+				historyListener->removeObject(cIt->object);
+			unlinkObject(cIt->object);
+			}
+		else
+			{
+			if(historyListener!=0)
+				historyListener->insertObject(cIt->succ,cIt->object);
+			linkObject(cIt->object,cIt->succ);
+			if(cIt->succ==0)
+				logPlacement(cIt->object,true);
+			}
+		}
+	
+	return true;
+	}
+
+bool SketchSettings::redo(void)
+	{
+	/* Get the most recently undone edit: */
+	const SketchHistory::Edit* edit=history.redo();
+	if(edit==0)
+		return false;
+	
+	/* Re-apply the edit's changes in order: */
+	for(std::vector<SketchHistory::Change>::const_iterator cIt=edit->changes.begin();cIt!=edit->changes.end();++cIt)
+		{
+		if(cIt->insert)
+			{
+			if(historyListener!=0)
+				historyListener->insertObject(cIt->succ,cIt->object);
+			linkObject(cIt->object,cIt->succ);
+			if(cIt->succ==0)
+				logPlacement(cIt->object,true);
+			}
+		else
+			{
+			if(historyListener!=0)
+				historyListener->removeObject(cIt->object);
+			unlinkObject(cIt->object);
+			}
+		}
+	
+	return true;
+	}
+
 void SketchSettings::drawSelectedObjects(const Transformation& transform,RenderState& renderState) const
 	{
-	/* Draw all selected objects at their tentative new positions: */
+	/* Transform the view box into the selected objects' current coordinate frame: */
+	bool cull=renderState.isCulling();
+	Box viewBox=renderState.getViewBox();
+	if(cull)
+		{
+		Box objectViewBox=Box::empty;
+		if(viewBox.min[0]<=viewBox.max[0]&&viewBox.min[1]<=viewBox.max[1])
+			for(int i=0;i<8;++i)
+				objectViewBox.addPoint(transform.inverseTransform(viewBox.getVertex(i)));
+		renderState.setViewBox(objectViewBox);
+		}
+	
+	/* Finish any pending batched rendering before changing the modelview matrix: */
+	renderState.setRenderer(0);
+	
+	/* Draw all potentially visible selected objects at their tentative new positions: */
 	glPushMatrix();
 	glMultMatrix(transform);
 	
 	for(SketchObjectSet::ConstIterator ssoIt=selectedObjects.begin();!ssoIt.isFinished();++ssoIt)
-		ssoIt->getSource()->glRenderAction(renderState);
+		if(renderState.isVisible(ssoIt->getSource()->getBoundingBox(),ssoIt->getSource()->getMaxLineWidth()*Scalar(0.5)))
+			ssoIt->getSource()->glRenderAction(renderState);
+	
+	/* Finish batched rendering of the selected objects: */
+	renderState.setRenderer(0);
 	
 	glPopMatrix();
+	
+	/* Restore the original view box: */
+	if(cull)
+		renderState.setViewBox(viewBox);
 	}
 
 void SketchSettings::highlightSelectedObjects(const Transformation& transform,RenderState& renderState) const
@@ -412,16 +1116,39 @@ void SketchSettings::highlightSelectedObjects(const Transformation& transform,Re
 	#endif
 	}
 
-void SketchSettings::glRenderAction(const Box& viewBox,RenderState& renderState) const
+void SketchSettings::drawSketchObjects(const Box& box,RenderState& renderState) const
+	{
+	/* Cull all sketch objects against the box from now on: */
+	renderState.setViewBox(box);
+	
+	/* Find all potentially visible sketch objects: */
+	std::vector<SketchObject*> visibleObjects;
+	index.find(box,visibleObjects);
+	if(visibleObjects.size()*4U<index.getNumObjects())
+		{
+		/* Render the visible sketch objects in list order: */
+		SketchObjectList::sort(visibleObjects);
+		for(std::vector<SketchObject*>::iterator voIt=visibleObjects.begin();voIt!=visibleObjects.end();++voIt)
+			(*voIt)->glRenderAction(renderState);
+		}
+	else
+		{
+		/* Most sketch objects are visible; walking the list is cheaper than sorting the visible ones: */
+		drawObjects(renderState);
+		}
+	}
+
+void SketchSettings::renderHighlights(const Box& viewBox,RenderState& renderState) const
 	{
-	/* Render all sketch objects: */
-	drawObjects(renderState);
+	/* Cull all highlights against the view box from now on: */
+	renderState.setViewBox(viewBox);
 	
 	#if 1
 	
-	/* Highlight all selected sketch objects: */
+	/* Highlight all potentially visible selected sketch objects: */
 	for(SketchObjectSet::ConstIterator ssoIt=selectedObjects.begin();!ssoIt.isFinished();++ssoIt)
-		ssoIt->getSource()->glRenderActionHighlight(highlightCycle,renderState);
+		if(renderState.isVisible(ssoIt->getSource()->getBoundingBox(),ssoIt->getSource()->getMaxLineWidth()*Scalar(0.5)))
+			ssoIt->getSource()->glRenderActionHighlight(highlightCycle,renderState);
 	
 	#else
 	
@@ -24,23 +24,46 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef SKETCHSETTINGS_INCLUDED
 #define SKETCHSETTINGS_INCLUDED
 
+#include <stddef.h>
+#include <vector>
+#include <Misc/SizedTypes.h>
 #include <Misc/HashTable.h>
 
 #include "SketchGeometry.h"
 #include "SketchObject.h"
 #include "SketchObjectList.h"
 #include "SketchObjectContainer.h"
+#include "SketchObjectIndex.h"
+#include "SketchHistory.h"
 
 /* Forward declarations: */
+namespace IO {
+class File;
+}
+class Capsule;
 class RenderState;
+class WorkerPool;
 
 class SketchSettings:public SketchObjectContainer
 	{
 	/* Embedded classes: */
+	public:
+	struct Placement // Structure recording that an edit moved a top-level sketch object to one end of the list
+		{
+		/* Elements: */
+		public:
+		Misc::UInt64 objectId; // Identifier of the moved sketch object
+		bool toFront; // Flag whether the object was moved to the end of the list, i.e., on top of all others, or to the beginning
+		};
+	
 	private:
 	typedef Misc::HashTable<SketchObject*,void> SketchObjectSet; // Type for hash tables to represent sets of sketch objects
+	typedef Misc::HashTable<Misc::UInt64,SketchObject*> SketchObjectIdMap; // Type for hash tables mapping identifiers to top-level sketch objects
 	
 	/* Elements: */
+	public:
+	static const unsigned int siteIdShift=40; // Number of low-order bits of sketch object identifiers below the site ID of the instance that created the object
+	
 	private:
 	
 	/* Versioned settings: */
@@ -61,14 +84,37 @@ class SketchSettings:public SketchObjectContainer
 	Scalar highlightCycle; // Current cycle value to highlight selected objects
 	
 	SketchObjectSet selectedObjects; // Set of currently selected sketch objects
+	SketchObjectSet savedSelection; // Set of selected sketch objects set aside by saveSelection; loses removed objects and follows replaced objects until restored
+	SketchObjectIndex index; // Spatial index of all sketch objects
+	SketchObjectIdMap objectIds; // Map from identifiers to all top-level sketch objects
+	unsigned int siteId; // Site ID whose namespace contains the identifiers of sketch objects created at this instance
+	Misc::UInt64 nextObjectId; // Identifier after the largest one of this site's namespace that was ever used
+	Misc::UInt64 objectIdBase; // Identifier to assign to the next new sketch object instead of one from this site's namespace, or 0
+	std::vector<Placement>* placementLog; // List to record the placements of top-level sketch objects at the ends of the list, or null
+	WorkerPool* workerPool; // Pool of worker threads to rub out or edit sketch objects in parallel, or null to work on the calling thread
+	SketchHistory history; // History of edits to the sketch objects for undo and redo
+	SketchHistory::Listener* historyListener; // Object notified of the changes made by undo and redo, or null
+	
+	/* Private methods: */
+	void addObjectId(SketchObject* object,bool newObject); // Enters the given top-level object into the identifier map; assigns a new identifier if the object is new or never had one
+	void removeObjectId(SketchObject* object); // Removes the given top-level object from the identifier map; the object keeps its identifier in case it is re-inserted
+	void logPlacement(const SketchObject* object,bool toFront); // Records that the given object was moved to one end of the list if placements are logged
+	void linkObject(SketchObject* object,SketchObject* succ); // Inserts the given object before the given successor, or appends it if null, without recording the change
+	void unlinkObject(SketchObject* object); // Removes the given object without destroying it or recording the change
+	void replaceObject(SketchObject* object,SketchObject* replacement); // Replaces the given object with the given replacement at the same list position and selection state
+	SketchObject* makeEditable(SketchObject* object); // Returns an object that can be changed in place instead of the given object; replaces the object with a clone if the history needs its current state
+	void moveObject(SketchObject* object,bool toFront); // Moves the given object to the front or the back of the list
 	
 	/* Constructors and destructors: */
 	public:
 	SketchSettings(void); // Creates a default set of sketch settings
 	
 	/* Methods from SketchObjectContainer: */
+	virtual void append(SketchObject* newObject);
 	virtual void insertAfter(SketchObject* pred,SketchObject* newObject);
 	virtual void remove(SketchObject* object);
+	virtual void update(SketchObject* object);
+	virtual SketchObject::PickResult pick(const Point& pos,Scalar radius);
 	
 	/* Methods: */
 	const Color& getColor(void) const // Returns the current color
@@ -115,6 +161,10 @@ class SketchSettings:public SketchObjectContainer
 		{
 		return lingerTime;
 		}
+	const SketchObjectIndex& getIndex(void) const // Returns the spatial index of all sketch objects, which tracks changes to their drawn extents
+		{
+		return index;
+		}
 	bool setHighlightCycle(double applicationTime); // Sets the highlight cycle value based on the given application time; returns true if there are objects that need highlighting
 	void setColor(const Color& newColor); // Sets the current color
 	void setLineWidth(float newLineWidth); // Sets the current line width
@@ -126,9 +176,38 @@ class SketchSettings:public SketchObjectContainer
 	void setHighlightColor(const Color& newHighlightColor); // Sets the highlight color
 	void setLingerSize(Scalar newLingerSize); // Sets the current linger detection neighborhood size
 	void setLingerTime(double newLingerTime); // Sets the lingering detection time threshold
-	SketchObject::PickResult pick(const Point& pos) // Shortcut for SketchObjectContainer's pick method
+	void setWorkerPool(WorkerPool* newWorkerPool); // Sets a pool of worker threads for parallel rubout and selection edits, or null; pool remains owned by caller
+	void setHistoryMemorySize(size_t newHistoryMemorySize); // Sets the memory budget of the undo history in bytes; disables undo if zero
+	void setHistoryListener(SketchHistory::Listener* newHistoryListener); // Sets an object to be notified of the changes made by undo and redo, or null; listener remains owned by caller
+	void setSketchObjects(SketchObjectList& newSketchObjects); // Replaces all sketch objects with the objects in the given list, which is cleared
+	void pageIn(SketchObject* object,SketchObject* succ); // Inserts the given object, which was paged in from a board tile, before the given successor, or appends it if null, without recording the change
+	void pageOut(const std::vector<SketchObject*>& objects); // Removes and destroys the given unselected objects, which were paged out to board tiles, without recording the change; discards only the edits that refer to them
+	SketchObject* findObject(Misc::UInt64 objectId); // Returns the top-level sketch object of the given identifier, or null
+	Misc::UInt64 getNextObjectId(void) const // Returns the identifier that will be assigned to the next new sketch object
+		{
+		return objectIdBase!=0?objectIdBase:nextObjectId;
+		}
+	void setSiteId(unsigned int newSiteId); // Assigns identifiers from the given site's namespace to new sketch objects, after all identifiers from that namespace already in use
+	unsigned int getMaxObjectSiteId(void) const; // Returns the largest site ID in whose namespace a current top-level sketch object was created
+	void setObjectIdBase(Misc::UInt64 newObjectIdBase) // Assigns consecutive identifiers starting from the given one to new sketch objects, e.g., to create the same identifiers as the collaborator who made an edit
+		{
+		objectIdBase=newObjectIdBase;
+		}
+	void resetObjectIdBase(void) // Assigns identifiers from this site's namespace to new sketch objects again
+		{
+		objectIdBase=0;
+		}
+	void writeObjectIds(IO::File& file) const; // Writes the identifiers of all top-level sketch objects in list order
+	void readObjectIds(IO::File& file); // Assigns identifiers written by writeObjectIds to all top-level sketch objects in list order; throws an exception if the number of objects does not match
+	std::vector<Placement>* getPlacementLog(void) const // Returns the list recording placements of sketch objects at the ends of the list, or null
+		{
+		return placementLog;
+		}
+	void setPlacementLog(std::vector<Placement>* newPlacementLog); // Sets a list to which all placements of sketch objects at the ends of the list are appended, or null; list remains owned by caller
+	void repeatPlacements(const std::vector<Placement>& placements); // Moves the sketch objects of the given placements to the ends of the list again, in order and without recording the change; skips objects that no longer exist
+	SketchObject::PickResult pick(const Point& pos) // Shortcut for the pick method using the current pick radius
 		{
-		return SketchObjectContainer::pick(pos,pickRadius);
+		return pick(pos,pickRadius);
 		}
 	Point snap(const Point& pos); // Snaps the given point and returns the adjusted point
 	SketchObject::PickResult pickSelected(const Point& pos); // Picks only currently selected objects
@@ -136,18 +215,33 @@ class SketchSettings:public SketchObjectContainer
 		{
 		return selectedObjects.isEntry(object);
 		}
+	bool hasSelection(void) const // Returns true if any sketch objects are currently selected
+		{
+		return selectedObjects.getNumEntries()>0;
+		}
+	void getSelectedObjects(std::vector<SketchObject*>& objects) const; // Returns the currently selected objects in list order
 	void select(SketchObject* object) // Adds the given sketch object to the selection
 		{
 		selectedObjects.setEntry(object);
 		}
 	void select(const Point& pos); // Selects all objects picked by a tool at the given position
 	void select(const Box& box); // Selects all objects that lie entirely within the given box
+	void findErasedObjects(const Capsule& eraser,std::vector<SketchObject*>& objects); // Returns all sketch objects that rubbing out with the given eraser capsule might change
+	void rubout(const Capsule& eraser,const std::vector<SketchObject*>& objects); // Erases the parts of the given sketch objects, in order, that lie within the given eraser capsule
+	void rubout(const Capsule& eraser) // Erases the parts of all sketch objects that lie within the given eraser capsule
+		{
+		std::vector<SketchObject*> objects;
+		findErasedObjects(eraser,objects);
+		rubout(eraser,objects);
+		}
 	void unselect(SketchObject* object) // Removes the given sketch object from the selection
 		{
 		selectedObjects.removeEntry(object);
 		}
 	void selectNone(void); // Clears the selection
 	void selectAll(void); // Selects all sketch objects
+	void saveSelection(void); // Sets the current selection aside and clears it, e.g., while replaying edits made by collaborators that use their own selections
+	void restoreSelection(void); // Replaces the current selection with the one set aside by saveSelection, minus all objects removed in the meantime
 	void cloneSelection(void); // Clones all currently selected objects and selects them
 	void applySettingsToSelection(void); // Applies current settings to selected objects
 	void groupSelection(void); // Joins all selected objects into a group
@@ -157,9 +251,32 @@ class SketchSettings:public SketchObjectContainer
 	void deleteSelection(void); // Deletes all selected objects
 	void transformSelectedObjects(const Transformation& transform); // Transforms all selected objects by the given transformation
 	void snapSelectedObjectsToGrid(void); // Snaps all selected objects to the drawing grid
+	void beginEdit(void) // Starts an edit that can be undone as a whole; calls can be nested
+		{
+		history.beginEdit();
+		}
+	void endEdit(void) // Finishes an edit that can be undone as a whole
+		{
+		history.endEdit();
+		}
+	void suspendHistory(void) // Stops recording changes, e.g., while applying edits made by collaborators; changing or destroying sketch objects while suspended discards the recorded edits that refer to them
+		{
+		history.suspend();
+		}
+	void resumeHistory(void) // Records changes again after the matching suspendHistory call
+		{
+		history.resume();
+		}
+	bool isInHistory(SketchObject* object) const // Returns true if undoing or redoing an edit would refer to the given sketch object
+		{
+		return history.isReferenced(object);
+		}
+	bool undo(void); // Undoes the most recent edit; returns false if there was none
+	bool redo(void); // Redoes the most recently undone edit; returns false if there was none
 	void drawSelectedObjects(const Transformation& transform,RenderState& renderState) const; // Draws selected objects with the given transformation
 	void highlightSelectedObjects(const Transformation& transform,RenderState& renderState) const; // Highlights selected objects with the given transformation
-	void glRenderAction(const Box& viewBox,RenderState& renderState) const; // Draws the sketching environment inside the given view bounding box
+	void drawSketchObjects(const Box& box,RenderState& renderState) const; // Draws all sketch objects overlapping the given bounding box
+	void renderHighlights(const Box& viewBox,RenderState& renderState) const; // Highlights all selected sketch objects inside the given view bounding box
 	void renderGrid(const Box& viewBox,RenderState& renderState) const; // Renders a drawing grid
 	};
 
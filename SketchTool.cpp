@@ -26,6 +26,8 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Vrui/ToolManager.h>
 
 #include "SketchObject.h"
+#include "SketchJournal.h"
+#include "SketchCollaboration.h"
 #include "Image.h"
 
 /**********************************************
@@ -33,6 +35,7 @@ Static elements of class SketchPad::SketchTool:
 **********************************************/
 
 SketchPad::SketchTool::Factory* SketchPad::SketchTool::factory=0;
+double SketchPad::SketchTool::predictionTime=0.0;
 
 /**************************************
 Methods of class SketchPad::SketchTool:
@@ -53,24 +56,38 @@ void SketchPad::SketchTool::initClass(Vrui::ToolFactory* baseClass)
 
 SketchPad::SketchTool::SketchTool(const Vrui::ToolFactory* factory,const Vrui::ToolInputAssignment& inputAssignment)
 	:SketchPadTool(factory,inputAssignment),
-	 sketchFactory(0),sketchFactoryVersion(0U),imageFactory(0)
+	 sketchFactory(0),sketchFactoryVersion(0U),imageFactory(0),
+	 lastFrameTime(0.0),predicting(false)
 	{
 	}
 
 SketchPad::SketchTool::~SketchTool(void)
 	{
+	/* End the curve shown to all collaborators: */
+	if(application->collaboration!=0)
+		application->collaboration->finishLiveStroke(this);
+	
 	if(sketchFactory!=0)
 		{
 		/* Finish any sketch objects still being created: */
 		SketchObject* current=sketchFactory->finish();
 		if(current!=0)
-			application->settings.getSketchObjects().push_back(current);
+			{
+			if(application->journal!=0)
+				application->journal->appendObject(current);
+			application->settings.append(current);
+			}
 		
 		/* Delete the sketch object factory: */
 		delete sketchFactory;
 		}
 	}
 
+void SketchPad::SketchTool::setPredictionTime(double newPredictionTime)
+	{
+	predictionTime=newPredictionTime;
+	}
+
 const Vrui::ToolFactory* SketchPad::SketchTool::getFactory(void) const
 	{
 	return factory;
@@ -86,13 +103,22 @@ void SketchPad::SketchTool::buttonCallback(int buttonSlotIndex,Vrui::InputDevice
 		/* Start dragging: */
 		buttonDown(pos);
 		
+		/* Reset motion prediction: */
+		lastFramePos=pos;
+		lastFrameTime=Vrui::getApplicationTime();
+		predicting=false;
+		
 		/* Check if the current sketch object factory is outdated: */
 		if(sketchFactory!=0&&sketchFactoryVersion!=application->sketchFactoryVersion)
 			{
 			/* Finish any sketch objects still being created: */
 			SketchObject* current=sketchFactory->finish();
 			if(current!=0)
-				application->settings.getSketchObjects().push_back(current);
+				{
+				if(application->journal!=0)
+					application->journal->appendObject(current);
+				application->settings.append(current);
+				}
 			
 			/* Delete the sketch object factory: */
 			delete sketchFactory;
@@ -112,6 +138,8 @@ void SketchPad::SketchTool::buttonCallback(int buttonSlotIndex,Vrui::InputDevice
 		
 		/* Deliver a button down event to the sketch factory: */
 		sketchFactory->buttonDown(pos);
+		if(application->collaboration!=0&&imageFactory==0)
+			application->collaboration->addLivePoint(this,pos);
 		}
 	else
 		{
@@ -119,7 +147,10 @@ void SketchPad::SketchTool::buttonCallback(int buttonSlotIndex,Vrui::InputDevice
 		if(sketchFactory->buttonUp(pos))
 			{
 			/* Finalize the current sketch object and append it to the application's list: */
-			application->settings.getSketchObjects().push_back(sketchFactory->finish());
+			SketchObject* current=sketchFactory->finish();
+			if(application->journal!=0)
+				application->journal->appendObject(current);
+			application->settings.append(current);
 			
 			/* Delete the current sketch factory if it is an image factory: */
 			if(imageFactory!=0)
@@ -130,8 +161,11 @@ void SketchPad::SketchTool::buttonCallback(int buttonSlotIndex,Vrui::InputDevice
 				}
 			}
 		
-		/* Deactivate the tool: */
+		/* Deactivate the tool and end the curve shown to all collaborators: */
 		buttonUp(pos);
+		predicting=false;
+		if(application->collaboration!=0)
+			application->collaboration->finishLiveStroke(this);
 		}
 	}
 
@@ -140,7 +174,8 @@ void SketchPad::SketchTool::frame(void)
 	if(isActive())
 		{
 		/* Transform the tool position to navigational coordinates: */
-		Point pos=Point(Vrui::getInverseNavigationTransformation().transform(getButtonDevicePosition(0)));
+		const Vrui::NavTransform& invNav=Vrui::getInverseNavigationTransformation();
+		Point pos=Point(invNav.transform(getButtonDevicePosition(0)));
 		
 		/* Continue dragging: */
 		bool moved=motion(pos);
@@ -148,7 +183,7 @@ void SketchPad::SketchTool::frame(void)
 		if(imageFactory!=0)
 			{
 			/* Map the environment's "up" direction into the sketching plane: */
-			Vector up=Vrui::getInverseNavigationTransformation().transform(Vrui::getUpDirection());
+			Vector up=invNav.transform(Vrui::getUpDirection());
 			
 			/* Calculate a rotation that aligns the "up" vector with the y axis: */
 			imageFactory->setOrientation(Transformation::Rotation::rotateFromTo(Vector(0,1,0),up));
@@ -159,8 +194,23 @@ void SketchPad::SketchTool::frame(void)
 			{
 			/* Deliver a motion event to the sketch object factory: */
 			sketchFactory->motion(pos,isLingering(),!hasMoved());
+			
+			/* Show the curve being drawn to all collaborators: */
+			if(application->collaboration!=0&&imageFactory==0)
+				application->collaboration->addLivePoint(this,pos);
 			}
 		
+		/* Extrapolate the tool's motion over the prediction horizon: */
+		double time=Vrui::getApplicationTime();
+		predicting=predictionTime>0.0&&!isLingering()&&time>lastFrameTime;
+		if(predicting)
+			{
+			Vector velocity=(pos-lastFramePos)/Scalar(time-lastFrameTime);
+			predictedPos=pos+velocity*Scalar(predictionTime);
+			}
+		lastFramePos=pos;
+		lastFrameTime=time;
+		
 		#if 0
 		/* Request another frame while active: */
 		Vrui::scheduleUpdate(Vrui::getNextAnimationTime());
@@ -174,5 +224,9 @@ void SketchPad::SketchTool::glRenderAction(RenderState& renderState) const
 		{
 		/* Draw the sketch object factory's state: */
 		sketchFactory->glRenderAction(renderState);
+		
+		/* Draw a provisional extension of the current sketch object towards the predicted tool position: */
+		if(predicting)
+			sketchFactory->glRenderPrediction(predictedPos,renderState);
 		}
 	}
@@ -44,6 +44,11 @@ class SketchPad::SketchTool:public SketchPad::SketchPadTool
 	SketchObjectFactory* sketchFactory; // Pointer to a factory for sketch objects
 	unsigned int sketchFactoryVersion; // Version number of sketch factory object
 	ImageFactory* imageFactory; // Pointer to sketch factory if current is an image factory
+	static double predictionTime; // Time horizon in seconds by which to extrapolate the tool's motion when rendering, or 0 to disable prediction
+	Point lastFramePos; // Tool position in navigational coordinates at the last frame
+	double lastFrameTime; // Application time of the last frame
+	bool predicting; // Flag whether a predicted tool position is valid for the current frame
+	Point predictedPos; // Tool position in navigational coordinates predicted for the time the current frame is displayed
 	
 	/* Constructors and destructors: */
 	public:
@@ -51,6 +56,9 @@ class SketchPad::SketchTool:public SketchPad::SketchPadTool
 	SketchTool(const Vrui::ToolFactory* factory,const Vrui::ToolInputAssignment& inputAssignment);
 	virtual ~SketchTool(void);
 	
+	/* New methods: */
+	static void setPredictionTime(double newPredictionTime); // Sets the time horizon for rendering predicted tool motion; 0 disables prediction
+	
 	/* Methods from class Vrui::Tool: */
 	virtual const Vrui::ToolFactory* getFactory(void) const;
 	virtual void buttonCallback(int buttonSlotIndex,Vrui::InputDevice::ButtonCallbackData* cbData);
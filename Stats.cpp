@@ -0,0 +1,114 @@
+/***********************************************************************
+Stats - Class to collect lightweight per-frame counters and timers of
+the rendering, editing, and file subsystems; compiled out unless
+enabled at configuration time.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "Stats.h"
+
+#if SKETCHPAD_CONFIG_STATS
+
+/******************************
+Static elements of class Stats:
+******************************/
+
+const char* Stats::counterNames[Stats::NumCounters]=
+	{
+	"Visible Objects","Culled Objects","Renderer Changes","Layer Redraw Pixels",
+	"Polyline Draw Calls","Polyline Cache Misses","Polyline Upload Bytes","Polyline Shared Vertex Copies",
+	"Picked Objects","Rubout Objects","Loaded Objects"
+	};
+const char* Stats::timerNames[Stats::NumTimers]=
+	{
+	"Frame Time","Display Time","Erase Time","Select Time","Load Time","Save Time"
+	};
+Threads::Atomic<unsigned int> Stats::counters[Stats::NumCounters];
+Threads::Spinlock Stats::timerMutex;
+double Stats::timers[Stats::NumTimers];
+unsigned int Stats::lastCounters[Stats::NumCounters];
+double Stats::lastTimers[Stats::NumTimers];
+unsigned int Stats::frameCounters[Stats::NumCounters];
+double Stats::frameTimers[Stats::NumTimers];
+
+/*************************************
+Methods of class Stats::LocalCounters:
+*************************************/
+
+void Stats::LocalCounters::publish(void)
+	{
+	for(int i=0;i<NumCounters;++i)
+		if(values[i]!=0U)
+			{
+			counters[i].postAdd(values[i]);
+			values[i]=0U;
+			}
+	}
+
+/**********************
+Methods of class Stats:
+**********************/
+
+void Stats::addTime(Stats::Timer timer,double time)
+	{
+	Threads::Spinlock::Lock timerLock(timerMutex);
+	timers[timer]+=time;
+	}
+
+void Stats::finishFrame(void)
+	{
+	/* Calculate the counter increments since the previous frame, relying on unsigned wrap-around: */
+	for(int i=0;i<NumCounters;++i)
+		{
+		unsigned int total=counters[i].get();
+		frameCounters[i]=total-lastCounters[i];
+		lastCounters[i]=total;
+		}
+	
+	/* Calculate the timer increments since the previous frame: */
+	Threads::Spinlock::Lock timerLock(timerMutex);
+	for(int i=0;i<NumTimers;++i)
+		{
+		frameTimers[i]=timers[i]-lastTimers[i];
+		lastTimers[i]=timers[i];
+		}
+	}
+
+void Stats::writeCsvHeader(FILE* csvFile)
+	{
+	fprintf(csvFile,"Application Time (s)");
+	for(int i=0;i<NumCounters;++i)
+		fprintf(csvFile,",%s",counterNames[i]);
+	for(int i=0;i<NumTimers;++i)
+		fprintf(csvFile,",%s (ms)",timerNames[i]);
+	fprintf(csvFile,"\n");
+	}
+
+void Stats::writeCsvRecord(FILE* csvFile,double applicationTime)
+	{
+	fprintf(csvFile,"%.6f",applicationTime);
+	for(int i=0;i<NumCounters;++i)
+		fprintf(csvFile,",%u",frameCounters[i]);
+	for(int i=0;i<NumTimers;++i)
+		fprintf(csvFile,",%.3f",frameTimers[i]*1000.0);
+	fprintf(csvFile,"\n");
+	}
+
+#endif
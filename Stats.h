@@ -0,0 +1,153 @@
+/***********************************************************************
+Stats - Class to collect lightweight per-frame counters and timers of
+the rendering, editing, and file subsystems; compiled out unless
+enabled at configuration time.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef STATS_INCLUDED
+#define STATS_INCLUDED
+
+#include "Config.h"
+
+#if SKETCHPAD_CONFIG_STATS
+
+#include <stdio.h>
+#include <Threads/Atomic.h>
+#include <Threads/Spinlock.h>
+#include <Realtime/Time.h>
+
+class Stats
+	{
+	/* Embedded classes: */
+	public:
+	enum Counter // Enumerated type for event counters
+		{
+		VisibleObjects=0,CulledObjects,RendererChanges,LayerRedrawPixels,
+		PolylineDrawCalls,PolylineCacheMisses,PolylineUploadBytes,PolylineSharedVertexCopies,
+		PickedObjects,RuboutObjects,LoadedObjects,
+		NumCounters
+		};
+	
+	enum Timer // Enumerated type for timers
+		{
+		FrameTime=0,DisplayTime,EraseTime,SelectTime,LoadTime,SaveTime,
+		NumTimers
+		};
+	
+	class LocalCounters // Class to accumulate counters inside a single thread and publish them in one go
+		{
+		/* Elements: */
+		private:
+		unsigned int values[NumCounters]; // Counter values not yet published
+		
+		/* Constructors and destructors: */
+		public:
+		LocalCounters(void) // Creates an empty set of counters
+			{
+			for(int i=0;i<NumCounters;++i)
+				values[i]=0U;
+			}
+		~LocalCounters(void) // Publishes all pending counter values
+			{
+			publish();
+			}
+		
+		/* Methods: */
+		void add(Counter counter,unsigned int value) // Adds the given value to the given counter
+			{
+			values[counter]+=value;
+			}
+		void publish(void); // Adds all pending counter values to the global counters and resets them
+		};
+	
+	class ScopedTimer // Class to add the lifetime of a scope to a timer
+		{
+		/* Elements: */
+		private:
+		Timer timer; // The timer to which to add the scope's lifetime
+		Realtime::TimePointMonotonic start; // Time point at which the scope was entered
+		
+		/* Constructors and destructors: */
+		public:
+		ScopedTimer(Timer sTimer) // Starts timing the current scope
+			:timer(sTimer)
+			{
+			}
+		~ScopedTimer(void) // Adds the time spent in the scope to the timer
+			{
+			addTime(timer,start.setAndDiff());
+			}
+		};
+	
+	/* Elements: */
+	private:
+	static const char* counterNames[NumCounters]; // Display names of all counters
+	static const char* timerNames[NumTimers]; // Display names of all timers
+	static Threads::Atomic<unsigned int> counters[NumCounters]; // Running totals of all counters, wrapping around on overflow
+	static Threads::Spinlock timerMutex; // Mutex serializing access to the running timer totals
+	static double timers[NumTimers]; // Running totals of all timers in seconds
+	static unsigned int lastCounters[NumCounters]; // Counter totals at the end of the previous frame
+	static double lastTimers[NumTimers]; // Timer totals at the end of the previous frame
+	static unsigned int frameCounters[NumCounters]; // Counter values accumulated during the previous frame
+	static double frameTimers[NumTimers]; // Timer values accumulated during the previous frame in seconds
+	
+	/* Methods: */
+	public:
+	static const char* getCounterName(Counter counter) // Returns the display name of the given counter
+		{
+		return counterNames[counter];
+		}
+	static const char* getTimerName(Timer timer) // Returns the display name of the given timer
+		{
+		return timerNames[timer];
+		}
+	static void add(Counter counter,unsigned int value) // Adds the given value to the given counter; can be called from any thread
+		{
+		counters[counter].postAdd(value);
+		}
+	static void addTime(Timer timer,double time); // Adds the given time in seconds to the given timer; can be called from any thread
+	static void finishFrame(void); // Captures the counter and timer values accumulated since the previous call; called once per frame from the main thread
+	static unsigned int getFrameCounter(Counter counter) // Returns the given counter's value accumulated during the previous frame
+		{
+		return frameCounters[counter];
+		}
+	static double getFrameTime(Timer timer) // Returns the given timer's value accumulated during the previous frame in seconds
+		{
+		return frameTimers[timer];
+		}
+	static void writeCsvHeader(FILE* csvFile); // Writes a header line naming all counters and timers to the given CSV file
+	static void writeCsvRecord(FILE* csvFile,double applicationTime); // Writes the previous frame's counter and timer values to the given CSV file
+	};
+
+/* Macros to instrument code; they compile to nothing when statistics are disabled: */
+#define SKETCHPAD_STATS_COUNT(counter,value) Stats::add(Stats::counter,value)
+#define SKETCHPAD_STATS_LOCAL_COUNT(localCounters,counter,value) (localCounters).add(Stats::counter,value)
+#define SKETCHPAD_STATS_TIMER(timer) Stats::ScopedTimer statsTimer##timer(Stats::timer)
+
+#else
+
+#define SKETCHPAD_STATS_COUNT(counter,value) ((void)0)
+#define SKETCHPAD_STATS_LOCAL_COUNT(localCounters,counter,value) ((void)0)
+#define SKETCHPAD_STATS_TIMER(timer) ((void)0)
+
+#endif
+
+#endif
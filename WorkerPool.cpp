@@ -0,0 +1,123 @@
+/***********************************************************************
+WorkerPool - Class to process independent work items in parallel on a
+fixed set of worker threads and the calling thread.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include "WorkerPool.h"
+
+/********************************
+Methods of class WorkerPool::Job:
+********************************/
+
+WorkerPool::Job::~Job(void)
+	{
+	}
+
+/***************************
+Methods of class WorkerPool:
+***************************/
+
+void WorkerPool::processItems(void)
+	{
+	/* Grab work items one at a time until all are taken: */
+	size_t item;
+	while((item=nextItem.postAdd(1))<numItems)
+		job->process(item);
+	}
+
+void* WorkerPool::workerThreadMethod(void)
+	{
+	unsigned int lastGeneration=0;
+	while(true)
+		{
+		/* Wait for a new job or the shutdown signal: */
+		{
+		Threads::MutexCond::Lock stateLock(stateCond);
+		while(!shutdown&&generation==lastGeneration)
+			stateCond.wait(stateLock);
+		if(shutdown)
+			break;
+		lastGeneration=generation;
+		}
+		
+		/* Work on the current job: */
+		processItems();
+		
+		/* Tell the calling thread that this worker is done with the current job: */
+		{
+		Threads::MutexCond::Lock stateLock(stateCond);
+		--numActiveThreads;
+		stateCond.broadcast();
+		}
+		}
+	
+	return 0;
+	}
+
+WorkerPool::WorkerPool(unsigned int sNumThreads)
+	:numThreads(sNumThreads),threads(new Threads::Thread[numThreads]),
+	 shutdown(false),generation(0),
+	 job(0),numItems(0),nextItem(0),numActiveThreads(0)
+	{
+	/* Start all worker threads: */
+	for(unsigned int i=0;i<numThreads;++i)
+		threads[i].start(this,&WorkerPool::workerThreadMethod);
+	}
+
+WorkerPool::~WorkerPool(void)
+	{
+	/* Tell all worker threads to terminate: */
+	{
+	Threads::MutexCond::Lock stateLock(stateCond);
+	shutdown=true;
+	stateCond.broadcast();
+	}
+	
+	/* Wait for all worker threads to terminate: */
+	for(unsigned int i=0;i<numThreads;++i)
+		threads[i].join();
+	delete[] threads;
+	}
+
+void WorkerPool::run(WorkerPool::Job& newJob,size_t newNumItems)
+	{
+	/* Publish the new job and wake up the worker threads: */
+	{
+	Threads::MutexCond::Lock stateLock(stateCond);
+	job=&newJob;
+	numItems=newNumItems;
+	nextItem.set(0);
+	numActiveThreads=numThreads;
+	++generation;
+	stateCond.broadcast();
+	}
+	
+	/* Work on the job in the calling thread as well: */
+	processItems();
+	
+	/* Wait until all worker threads are done with the job: */
+	{
+	Threads::MutexCond::Lock stateLock(stateCond);
+	while(numActiveThreads>0)
+		stateCond.wait(stateLock);
+	job=0;
+	}
+	}
@@ -0,0 +1,79 @@
+/***********************************************************************
+WorkerPool - Class to process independent work items in parallel on a
+fixed set of worker threads and the calling thread.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef WORKERPOOL_INCLUDED
+#define WORKERPOOL_INCLUDED
+
+#include <stddef.h>
+#include <Threads/Atomic.h>
+#include <Threads/MutexCond.h>
+#include <Threads/Thread.h>
+
+class WorkerPool
+	{
+	/* Embedded classes: */
+	public:
+	class Job // Base class for jobs consisting of independent work items
+		{
+		/* Constructors and destructors: */
+		public:
+		virtual ~Job(void);
+		
+		/* Methods: */
+		virtual void process(size_t item) =0; // Processes the given work item; called concurrently from multiple threads for different items; must not throw exceptions
+		};
+	
+	/* Elements: */
+	private:
+	unsigned int numThreads; // Number of worker threads
+	Threads::Thread* threads; // Array of worker threads
+	Threads::MutexCond stateCond; // Condition variable protecting the pool state and signaling changes to it
+	bool shutdown; // Flag telling the worker threads to terminate
+	unsigned int generation; // Number of the current job; incremented when a new job starts
+	Job* job; // The current job
+	size_t numItems; // Number of work items in the current job
+	Threads::Atomic<unsigned int> nextItem; // Index of the next work item to be processed
+	unsigned int numActiveThreads; // Number of worker threads still working on the current job
+	
+	/* Private methods: */
+	void processItems(void); // Processes work items of the current job until there are none left
+	void* workerThreadMethod(void); // Method run by the worker threads
+	
+	/* Constructors and destructors: */
+	public:
+	WorkerPool(unsigned int sNumThreads); // Creates a pool with the given number of worker threads
+	private:
+	WorkerPool(const WorkerPool& source); // Prohibit copy constructor
+	WorkerPool& operator=(const WorkerPool& source); // Prohibit assignment operator
+	public:
+	~WorkerPool(void); // Terminates all worker threads
+	
+	/* Methods: */
+	unsigned int getNumThreads(void) const // Returns the number of worker threads, not counting the calling thread
+		{
+		return numThreads;
+		}
+	void run(Job& newJob,size_t newNumItems); // Processes the given number of work items of the given job in the worker threads and the calling thread; returns when all items are processed
+	};
+
+#endif
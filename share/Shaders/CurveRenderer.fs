@@ -20,9 +20,9 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 02111-1307 USA
 ***********************************************************************/
 
-uniform float lineWidth;
 uniform float pixelSize;
 
+varying float lineWidth;
 varying vec2 linePos;
 varying vec2 v0,n0,v1,n1;
 varying vec2 modelPos;
@@ -20,12 +20,19 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 02111-1307 USA
 ***********************************************************************/
 
+uniform float lineWidthScale;
+uniform vec3 vertexTranslation;
+
+attribute vec2 vertexNormal;
+
 varying vec2 vNormal;
+varying float vLineWidth;
 
 void main()
 	{
-	/* Pass vertex color, normal, and model-space position to geometry shader: */
+	/* Pass vertex color, normal, line width, and translated model-space position to geometry shader: */
 	gl_FrontColor=gl_Color;
-	vNormal=gl_Normal.xy;
-	gl_Position=gl_Vertex;
+	vNormal=vertexNormal*2.0;
+	vLineWidth=gl_MultiTexCoord0.x*lineWidthScale;
+	gl_Position=vec4(gl_Vertex.xyz+vertexTranslation*gl_Vertex.w,gl_Vertex.w);
 	}
@@ -26,18 +26,20 @@ Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 layout (lines) in;
 layout (triangle_strip,max_vertices=8) out;
 
-uniform float lineWidth;
 uniform float pixelSize;
 
 in vec2 vNormal[];
+in float vLineWidth[];
 out vec2 linePos;
+out float lineWidth;
 out vec2 v0,n0,v1,n1;
 out vec2 modelPos;
 
 void main()
 	{
 	/* Calculate the outer line half width: */
-	float hw1=(lineWidth+pixelSize)*0.5;
+	float lw=vLineWidth[0];
+	float hw1=(lw+pixelSize)*0.5;
 	
 	/* Calculate the line segment's direction and normal vectors: */
 	v0=gl_in[0].gl_Position.xy;
@@ -53,44 +55,52 @@ void main()
 	
 	/* Emit vertices for three quads representing the extended line segment: */
 	gl_FrontColor=gl_in[0].gl_FrontColor;
+	lineWidth=lw;
 	linePos=vec2(-hw1,hw1);
 	modelPos=v0-v+n;
 	gl_Position=gl_ModelViewProjectionMatrix*vec4(v0-v+n,0.0,1.0);
 	EmitVertex();
 	gl_FrontColor=gl_in[0].gl_FrontColor;
+	lineWidth=lw;
 	linePos=vec2(-hw1,-hw1);
 	modelPos=v0-v-n;
 	gl_Position=gl_ModelViewProjectionMatrix*vec4(v0-v-n,0.0,1.0);
 	EmitVertex();
 	
 	gl_FrontColor=gl_in[0].gl_FrontColor;
+	lineWidth=lw;
 	linePos=vec2(0,hw1);
 	modelPos=v0+n;
 	gl_Position=gl_ModelViewProjectionMatrix*vec4(v0+n,0.0,1.0);
 	EmitVertex();
 	gl_FrontColor=gl_in[0].gl_FrontColor;
+	lineWidth=lw;
 	linePos=vec2(0,-hw1);
 	modelPos=v0-n;
 	gl_Position=gl_ModelViewProjectionMatrix*vec4(v0-n,0.0,1.0);
 	EmitVertex();
 	
 	gl_FrontColor=gl_in[0].gl_FrontColor;
+	lineWidth=lw;
 	linePos=vec2(0,hw1);
 	modelPos=v1+n;
 	gl_Position=gl_ModelViewProjectionMatrix*vec4(v1+n,0.0,1.0);
 	EmitVertex();
 	gl_FrontColor=gl_in[0].gl_FrontColor;
+	lineWidth=lw;
 	linePos=vec2(0,-hw1);
 	modelPos=v1-n;
 	gl_Position=gl_ModelViewProjectionMatrix*vec4(v1-n,0.0,1.0);
 	EmitVertex();
 	
 	gl_FrontColor=gl_in[0].gl_FrontColor;
+	lineWidth=lw;
 	linePos=vec2(hw1,hw1);
 	modelPos=v1+v+n;
 	gl_Position=gl_ModelViewProjectionMatrix*vec4(v1+v+n,0.0,1.0);
 	EmitVertex();
 	gl_FrontColor=gl_in[0].gl_FrontColor;
+	lineWidth=lw;
 	linePos=vec2(hw1,-hw1);
 	modelPos=v1+v-n;
 	gl_Position=gl_ModelViewProjectionMatrix*vec4(v1+v-n,0.0,1.0);
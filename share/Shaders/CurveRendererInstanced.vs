@@ -0,0 +1,68 @@
+/***********************************************************************
+CurveRendererInstanced.vs - Vertex shader for anti-aliased curve
+rendering that expands instanced line segments without a geometry shader.
+Copyright (c) 2025 Oliver Kreylos
+
+This file is part of the SketchPad vector drawing package.
+
+The SketchPad vector drawing package is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The SketchPad vector drawing package is distributed in the hope that it
+will be useful, but WITHOUT ANY WARRANTY; without even the implied
+warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the SketchPad vector drawing package; if not, write to the Free
+Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#version 150 compatibility
+
+uniform float lineWidthScale;
+uniform float pixelSize;
+uniform vec3 vertexTranslation;
+
+in vec2 segmentStart;
+in vec2 segmentStartNormal;
+in vec2 segmentEnd;
+in vec2 segmentEndNormal;
+in vec4 segmentColor;
+in float segmentLineWidth;
+
+out vec2 linePos;
+out float lineWidth;
+out vec2 v0,n0,v1,n1;
+out vec2 modelPos;
+
+void main()
+	{
+	/* Calculate the outer line half width: */
+	float lw=segmentLineWidth*lineWidthScale;
+	float hw1=(lw+pixelSize)*0.5;
+	
+	/* Calculate the line segment's translated end points and its direction and normal vectors: */
+	v0=segmentStart+vertexTranslation.xy;
+	v1=segmentEnd+vertexTranslation.xy;
+	vec2 v;
+	if(v1==v0) // Use an arbitrary direction for zero-length line segments
+		v=vec2(hw1,0.0);
+	else
+		v=normalize(v1-v0)*hw1;
+	vec2 n=vec2(-v.y,v.x);
+	n0=segmentStartNormal*2.0;
+	n1=segmentEndNormal*2.0;
+	
+	/* Place this vertex on one of the eight corners of the three quads representing the extended line segment: */
+	float along=gl_VertexID<2?-1.0:(gl_VertexID<6?0.0:1.0);
+	float side=(gl_VertexID&1)==0?1.0:-1.0;
+	gl_FrontColor=segmentColor;
+	lineWidth=lw;
+	linePos=vec2(along*hw1,side*hw1);
+	modelPos=(gl_VertexID<4?v0:v1)+v*along+n*side;
+	gl_Position=gl_ModelViewProjectionMatrix*vec4(modelPos,0.0,1.0);
+	}